@@ -21,7 +21,7 @@ int main(int argc, char *argv[]) {
           config.printHelp(std::cout);
           return EXIT_SUCCESS;
         }
-        UserState state(config.host, config.port);
+        UserState state(config.host, config.port, config.keep_alive);
         
 
         CommandManager commandManager;
@@ -81,6 +81,7 @@ void registerCommands(CommandManager &manager) {
   manager.registerCommand(std::make_shared<ShowAssetCommand>());    // TCP
   manager.registerCommand(std::make_shared<BidCommand>());          // TCP
   manager.registerCommand(std::make_shared<ShowRecordCommand>());   // TCP
+  manager.registerCommand(std::make_shared<WatchCommand>());        // TCP
   manager.registerCommand(std::make_shared<HelpCommand>(manager));
 }
 
@@ -88,7 +89,7 @@ ClientConfig::ClientConfig(int argc, char *argv[]) {
   program_path = argv[0];
   int opt;
 
-  while ((opt = getopt(argc, argv, "hn:p:")) != -1) {
+  while ((opt = getopt(argc, argv, "hkn:p:")) != -1) {
     switch (opt) {
       case 'n':
         host = std::string(optarg);
@@ -96,6 +97,9 @@ ClientConfig::ClientConfig(int argc, char *argv[]) {
       case 'p':
         port = std::string(optarg);
         break;
+      case 'k':
+        keep_alive = true;
+        break;
       case 'h':
         help = true;
         break;
@@ -110,12 +114,15 @@ ClientConfig::ClientConfig(int argc, char *argv[]) {
 }
 
 void ClientConfig::printHelp(std::ostream &stream) {
-  stream << "Usage: " << program_path << " [-n GSIP] [-p GSport]"
+  stream << "Usage: " << program_path << " [-n GSIP] [-p GSport] [-k]"
          << std::endl;
   stream << "Available options:" << std::endl;
   stream << "-n GSIP\t\tSet hostname of Auction Server. Default: "
          << DEFAULT_HOSTNAME << std::endl;
   stream << "-p GSport\tSet port of Auction Server. Default: " << DEFAULT_PORT
          << std::endl;
+  stream << "-k\t\tKeep TCP connections to the Auction Server open between "
+            "requests."
+         << std::endl;
   stream << "-h\t\tPrint this menu." << std::endl;
 }
\ No newline at end of file
@@ -16,6 +16,7 @@ class ClientConfig {
   char* program_path;
   std::string host = DEFAULT_HOSTNAME;
   std::string port = DEFAULT_PORT;
+  bool keep_alive = false;
   bool help = false;
 
   ClientConfig(int argc, char* argv[]);
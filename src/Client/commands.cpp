@@ -1,14 +1,18 @@
 #include "commands.hpp"
 
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <set>
 
 #include <unistd.h>
 
 // #include "client_Auction.hpp"
+#include "../common/field_validation.hpp"
 #include "../common/protocol.hpp"
+#include "../common/sha256.hpp"
 
 extern bool is_shutting_down;
 
@@ -533,6 +537,16 @@ void ListCommand::handle(std::string args, UserState &state) {
   // avoid unused parameter warning
   (void)args;
 
+  if (state.list_since_supported) {
+    try {
+      listChangedAuctions(state);
+      return;
+    } catch (ErrorUdpPacketException &e) {
+      // Servers without incremental listings reply ERR, so list everything
+      state.list_since_supported = false;
+    }
+  }
+
   // Populate and send packet
   ListAuctionsServerbound packet_out;
 
@@ -559,6 +573,46 @@ void ListCommand::handle(std::string args, UserState &state) {
   }
 }
 
+/* Only asks for the auctions changed since the last listing, and applies
+ * them to the list kept from it */
+void ListCommand::listChangedAuctions(UserState &state) {
+  ListSinceServerbound packet_out;
+  packet_out.epoch = state.auction_list_epoch;
+  packet_out.version = state.auction_list_version;
+
+  ReplyListSinceClientbound rlc;
+  state.sendUdpPacketAndWaitForReply(packet_out, rlc);
+
+  switch (rlc.status) {
+  case ReplyListSinceClientbound::status::ALL:
+    state.auction_list.clear();
+    [[fallthrough]];
+  case ReplyListSinceClientbound::status::OK:
+    for (auto &[auction_id, active] : rlc.auctions) {
+      state.auction_list[auction_id] = active;
+    }
+    state.auction_list_epoch = rlc.epoch;
+    state.auction_list_version = rlc.version;
+    break;
+
+  case ReplyListSinceClientbound::status::ERR:
+  default:
+    std::cout
+        << "Failed to list auctions: an unknown error occurred on the server "
+        << "side. Please try again." << std::endl;
+    return;
+  }
+
+  if (state.auction_list.empty()) {
+    std::cout << "Failed to list auctions: there are no ongoing auctions."
+              << std::endl;
+    return;
+  }
+  std::cout << "Displaying all the auctions:" << std::endl;
+  printAuctions(std::vector<std::pair<uint32_t, bool>>(
+      state.auction_list.begin(), state.auction_list.end()));
+}
+
 void ShowAssetCommand::handle(std::string args, UserState &state) {
   // Argument parsing
   std::istringstream iss(args);
@@ -584,6 +638,85 @@ void ShowAssetCommand::handle(std::string args, UserState &state) {
   uint32_t auction_id =
       static_cast<uint32_t>(std::stoi(auction_id_str, NULL, 10));
 
+  // Downloads are received into a partial file, which is kept if they are
+  // interrupted, along with the hash of the asset, to be resumed next time
+  std::string partial_path =
+      ".asset-" + auctionID_ToString(auction_id) + ".part";
+  std::string hash_path = partial_path + ".sha256";
+
+  ShowAssetRangeServerbound packet_out;
+  packet_out.auction_id = auction_id;
+  std::string partial_hash;
+  std::ifstream hash_file(hash_path);
+  if (hash_file >> partial_hash && is_sha256_hex(partial_hash) &&
+      std::filesystem::exists(partial_path)) {
+    packet_out.offset =
+        static_cast<uint32_t>(std::filesystem::file_size(partial_path));
+    packet_out.hash = partial_hash;
+  }
+  hash_file.close();
+
+  ReplyShowAssetRangeClientbound rsr;
+  rsr.save_path = partial_path;
+  try {
+    state.sendTcpPacketAndWaitForReply(packet_out, rsr);
+  } catch (ErrorTcpPacketException &e) {
+    // Servers without ranged downloads reply ERR
+    showWholeAsset(auction_id, state);
+    return;
+  } catch (...) {
+    // The partial file is only written to once the header is read, until
+    // then an earlier download can still be resumed
+    if (rsr.header_received) {
+      if (is_sha256_hex(rsr.hash)) {
+        std::ofstream(hash_path) << rsr.hash << std::endl;
+        std::cout
+            << "The download will resume from where it stopped next time."
+            << std::endl;
+      } else {
+        std::filesystem::remove(hash_path);
+      }
+    }
+    throw;
+  }
+
+  switch (rsr.status) {
+  case ReplyShowAssetRangeClientbound::status::OK:
+    if (rsr.hash != "-" && sha256_file(partial_path) != rsr.hash) {
+      std::filesystem::remove(partial_path);
+      std::filesystem::remove(hash_path);
+      std::cout << "Failed to show asset: the received asset is corrupted. "
+                << "Please try again." << std::endl;
+      break;
+    }
+    std::filesystem::rename(partial_path, rsr.file_name);
+    std::filesystem::remove(hash_path);
+    if (rsr.offset > 0) {
+      std::cout << "Resumed the download from byte " << rsr.offset << "."
+                << std::endl;
+    }
+    std::cout << "Received the asset '" << rsr.file_name
+              << "' of the auction with ID [" << auctionID_ToString(auction_id)
+              << "] in the current directory." << std::endl;
+    break;
+
+  case ReplyShowAssetRangeClientbound::status::NOK:
+    std::cout << "Failed to show asset: the auction with ID ["
+              << auctionID_ToString(auction_id) << "] does not exist."
+              << std::endl;
+    break;
+
+  case ReplyShowAssetRangeClientbound::status::ERR:
+  default:
+    std::cout
+        << "Failed to show asset: an unknown error occurred on the server "
+        << "side. Please try again." << std::endl;
+    break;
+  }
+}
+
+/* Downloads the whole asset in one go, for servers without ranged downloads */
+void ShowAssetCommand::showWholeAsset(uint32_t auction_id, UserState &state) {
   // Populate and send packet
   ShowAssetServerbound packet_out;
   packet_out.auction_id = auction_id;
@@ -784,7 +917,7 @@ void HelpCommand::handle(std::string args, UserState &state) {
 }
 
 void printBidsInfo(const std::vector<Bid> bids) {
-  for (const auto bid : bids) {
+  for (const auto &bid : bids) {
     std::cout << "Bidder User ID: " << bid.bidder_user_id << std::endl;
     std::cout << " Value bidded: " << bid.bid_value << std::endl;
     std::cout << "Date Time: " << bid.date_time << std::endl;
@@ -801,30 +934,109 @@ void printAuctions(const std::vector<std::pair<uint32_t, bool>> &auctions) {
   }
 }
 
-bool isValidAuctionName(const std::string &str) {
-  return std::all_of(str.begin(), str.end(), [](char c) {
-    return std::isalnum(c) || c == '_' || c == '-';
-  });
-}
+bool isValidAuctionName(const std::string &str) { return is_name_field(str); }
+
+bool is_alphanumeric(std::string &str) { return is_alphanumeric_field(str); }
 
-bool is_alphanumeric(std::string &str) {
-  for (char c : str) {
-    if (!isalnum(c)) {
-      return false;
+void WatchCommand::handle(std::string args, UserState &state) {
+  // Argument parsing
+  std::istringstream iss(args);
+  std::string auction_id_str;
+  WatchServerbound packet_out;
+
+  while (iss >> auction_id_str) {
+    // Check if auction_id_str is too long
+    if (auction_id_str.length() != AUCTION_ID_MAX_LEN) {
+      std::cout << "Invalid auction ID. It must be " << AUCTION_ID_MAX_LEN
+                << " digits long" << std::endl;
+      return;
+    }
+    // Check if auction_id_str is Numeric
+    if (!is_numeric(auction_id_str)) {
+      std::cout << "Invalid auction ID. It must be a number" << std::endl;
+      return;
     }
+    packet_out.auction_ids.push_back(
+        static_cast<uint32_t>(std::stoi(auction_id_str, NULL, 10)));
   }
-  return true;
-}
+  if (packet_out.auction_ids.empty()) {
+    std::cout << "Invalid arguments. Usage: watch <auction_id> [auction_id ...]"
+              << std::endl;
+    return;
+  }
+  if (packet_out.auction_ids.size() > WATCH_MAX_AUCTIONS) {
+    std::cout << "Invalid arguments. At most " << WATCH_MAX_AUCTIONS
+              << " auctions can be watched at once" << std::endl;
+    return;
+  }
+
+  ReplyWatchClientbound rwa;
+  state.openTcpStream(packet_out, rwa);
+
+  switch (rwa.status) {
+  case ReplyWatchClientbound::status::OK:
+    break;
+
+  case ReplyWatchClientbound::status::NOK:
+    state.closeTcpStream();
+    std::cout << "Failed to watch: one of the auctions does not exist."
+              << std::endl;
+    return;
 
-bool is_numeric(std::string &str) {
-  for (char c : str) {
-    if (!isdigit(c)) {
-      return false;
+  case ReplyWatchClientbound::status::ERR:
+  default:
+    state.closeTcpStream();
+    std::cout << "Failed to watch: an unknown error occurred on the server "
+              << "side. Please try again." << std::endl;
+    return;
+  }
+
+  std::cout << "Watching auctions. Press ENTER to stop watching." << std::endl;
+
+  // The server closes the stream once every watched auction has ended
+  std::set<uint32_t> watching(packet_out.auction_ids.begin(),
+                              packet_out.auction_ids.end());
+  try {
+    WatchEventClientbound event;
+    while (!watching.empty()) {
+      if (!state.waitForStreamPacket(event)) {
+        std::cout << "Stopped watching." << std::endl;
+        break;
+      }
+
+      switch (event.event) {
+      case WatchEventClientbound::event::BID:
+        std::cout << "Auction [" << auctionID_ToString(event.auction_id)
+                  << "]: new highest bid of " << event.bid_value
+                  << " by user " << fillZeros(event.user_id, USER_ID_STR_LEN)
+                  << std::endl;
+        break;
+
+      case WatchEventClientbound::event::END:
+      default:
+        std::cout << "Auction [" << auctionID_ToString(event.auction_id)
+                  << "] has ended";
+        if (event.bid_value > 0) {
+          std::cout << ", won by user "
+                    << fillZeros(event.user_id, USER_ID_STR_LEN)
+                    << " with a bid of " << event.bid_value;
+        } else {
+          std::cout << " without bids";
+        }
+        std::cout << "." << std::endl;
+        watching.erase(event.auction_id);
+        break;
+      }
     }
+  } catch (...) {
+    state.closeTcpStream();
+    throw;
   }
-  return true;
+  state.closeTcpStream();
 }
 
+bool is_numeric(std::string &str) { return is_digits(str); }
+
 uint32_t parse_user_id(std::string &args) {
   size_t converted = 0;
   if (args.length() != USER_ID_STR_LEN) {
@@ -69,6 +69,7 @@ public:
 
 class ListCommand : public CommandHandler {
   void handle(std::string args, UserState &state);
+  void listChangedAuctions(UserState &state);
 
 public:
   ListCommand()
@@ -95,6 +96,7 @@ public:
 
 class ShowAssetCommand : public CommandHandler {
   void handle(std::string args, UserState &state);
+  void showWholeAsset(uint32_t auction_id, UserState &state);
 
 public:
   ShowAssetCommand()
@@ -152,6 +154,14 @@ public:
       : CommandHandler("show_record", "sr", "<AID>", "Show Auction Record") {}
 };
 
+class WatchCommand : public CommandHandler {
+  void handle(std::string args, UserState &state);
+
+public:
+  WatchCommand()
+      : CommandHandler("watch", "w", "<AID> [AID ...]", "Watch Auctions") {}
+};
+
 bool is_numeric(std::string &str);
 
 bool isValidAuctionName(const std::string &str);
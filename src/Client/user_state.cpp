@@ -1,13 +1,20 @@
 #include "user_state.hpp"
 
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
 #include "user_state.hpp"
 
-UserState::UserState(std::string &hostname, std::string &port) {
+extern bool is_shutting_down;
+
+UserState::UserState(std::string &hostname, std::string &port,
+                     bool __keep_alive)
+    : keep_alive{__keep_alive} {
   this->setupSockets();
   this->resolveServerAddress(hostname, port);
   this->user_id = NO_USER_ID;
@@ -46,6 +53,10 @@ bool UserState::isLoggedIn() {
   return this->user_id != NO_USER_ID;
 }
 
+bool UserState::isTcpKeptAlive() {
+  return this->tcp_socket_fd != -1 && this->tcp_kept_alive;
+}
+
 void UserState::logout() {
   this->user_id = NO_USER_ID;
   this->password = "";
@@ -116,27 +127,135 @@ void UserState::waitForUdpPacket(UdpPacket &packet) {
 
 void UserState::sendTcpPacketAndWaitForReply(TcpPacket &out_packet,
                                                TcpPacket &in_packet) {
+  sendTcpPacketsAndWaitForReplies({&out_packet}, {&in_packet});
+}
+
+void UserState::sendTcpPacketsAndWaitForReplies(
+    const std::vector<TcpPacket *> &out_packets,
+    const std::vector<TcpPacket *> &in_packets) {
+  size_t sent = 0;
+  while (sent < out_packets.size()) {
+    size_t first = sent;
+    try {
+      connectTcpSocket();
+      sent = tcp_kept_alive ? out_packets.size() : sent + 1;
+      for (size_t i = first; i < sent; ++i) {
+        sendTcpPacket(*out_packets[i]);
+      }
+      for (size_t i = first; i < sent; ++i) {
+        waitForTcpPacket(*in_packets[i]);
+      }
+    } catch (...) {
+      closeTcpSocket();
+      throw;
+    }
+    if (!tcp_kept_alive) {
+      closeTcpSocket();
+    }
+  }
+}
+
+void UserState::openTcpStream(TcpPacket &out_packet, TcpPacket &in_packet) {
   try {
-    openTcpSocket();
+    connectTcpSocket();
     sendTcpPacket(out_packet);
     waitForTcpPacket(in_packet);
   } catch (...) {
     closeTcpSocket();
     throw;
   }
-  closeTcpSocket();
-};
+}
+
+bool UserState::waitForStreamPacket(TcpPacket &packet) {
+  bool skip_stdin = false;
+  while (true) {
+    fd_set file_descriptors;
+    FD_ZERO(&file_descriptors);
+    FD_SET(tcp_socket_fd, &file_descriptors);
+    if (!skip_stdin) {
+      FD_SET(fileno(stdin), &file_descriptors);
+    }
+
+    // Wake up every second to notice the user shutting down
+    struct timeval timeout;
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+
+    int ready_fd = select(std::max(tcp_socket_fd, fileno(stdin)) + 1,
+                          &file_descriptors, NULL, NULL, &timeout);
+    if (is_shutting_down) {
+      throw OperationCancelledException();
+    }
+    if (ready_fd == -1) {
+      throw UnrecoverableError("Failed waiting for TCP packet on select",
+                               errno);
+    }
+    if (FD_ISSET(tcp_socket_fd, &file_descriptors)) {
+      packet.receive(tcp_socket_fd);
+      return true;
+    }
+    if (!skip_stdin && FD_ISSET(fileno(stdin), &file_descriptors)) {
+      if (std::cin.peek() != '\n') {
+        // Leave anything else to the command prompt
+        skip_stdin = true;
+        continue;
+      }
+      std::cin.get();
+      return false;
+    }
+  }
+}
+
+void UserState::closeTcpStream() { closeTcpSocket(); }
 
 void UserState::sendTcpPacket(TcpPacket &packet) {
+  packet.send(tcp_socket_fd);
+}
+
+void UserState::waitForTcpPacket(TcpPacket &packet) {
+  packet.receive(tcp_socket_fd);
+}
+
+/* Reuses the kept-alive connection, unless the server has closed it */
+void UserState::connectTcpSocket() {
+  if (tcp_socket_fd != -1) {
+    if (tcpConnectionIsIdle()) {
+      return;
+    }
+    closeTcpSocket();
+  }
+
+  openTcpSocket();
   if (connect(tcp_socket_fd, server_tcp_addr->ai_addr,
               server_tcp_addr->ai_addrlen) != 0) {
     throw ConnectionTimeoutException();
   }
-  packet.send(tcp_socket_fd);
+
+  tcp_kept_alive = false;
+  if (!keep_alive) {
+    return;
+  }
+  try {
+    KeepAliveServerbound request;
+    ReplyKeepAliveClientbound reply;
+    request.send(tcp_socket_fd);
+    reply.receive(tcp_socket_fd);
+    tcp_kept_alive = reply.status == ReplyKeepAliveClientbound::OK;
+  } catch (ErrorTcpPacketException &e) {
+    // The server does not support keep-alive, stop asking for it
+    keep_alive = false;
+    closeTcpSocket();
+    connectTcpSocket();
+  }
 }
 
-void UserState::waitForTcpPacket(TcpPacket &packet) {
-  packet.receive(tcp_socket_fd);
+/* An idle connection has nothing to read; a closed one reads as EOF */
+bool UserState::tcpConnectionIsIdle() {
+  struct pollfd connection;
+  connection.fd = tcp_socket_fd;
+  connection.events = POLLIN;
+  connection.revents = 0;
+  return poll(&connection, 1, 0) == 0;
 }
 
 void UserState::openTcpSocket() {
@@ -159,14 +278,24 @@ void UserState::openTcpSocket() {
     throw UnrecoverableError("Failed to set TCP send timeout socket option",
                              errno);
   }
+  // Pipelined requests are small writes back to back, which would otherwise
+  // wait for the server to acknowledge the previous one
+  int no_delay = 1;
+  if (setsockopt(this->tcp_socket_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay,
+                 sizeof(no_delay)) < 0) {
+    throw UnrecoverableError("Failed to set TCP no delay socket option",
+                             errno);
+  }
 }
 
 void UserState::closeTcpSocket() {
-  if (close(this->tcp_socket_fd) != 0) {
+  int fd = this->tcp_socket_fd;
+  this->tcp_socket_fd = -1;
+  if (close(fd) != 0) {
     if (errno == EBADF) {
       // was already closed
       return;
     }
     throw UnrecoverableError("Failed to close TCP socket", errno);
   }
-}
\ No newline at end of file
+}
@@ -3,6 +3,9 @@
 
 #include <netdb.h>
 
+#include <map>
+#include <vector>
+
 // #include "client_Auction.hpp"
 #include "../common/protocol.hpp"
 #include "../common/common.hpp"
@@ -15,26 +18,53 @@ class UserState {
   struct addrinfo* server_tcp_addr = NULL;
   uint32_t user_id;
   std::string password;
+  // Whether to ask the server to keep TCP connections open between requests
+  bool keep_alive;
+  // Whether the open TCP connection was kept alive by the server
+  bool tcp_kept_alive = false;
 
   void setupSockets();
   void resolveServerAddress(std::string& hostname, std::string& port);
   void sendUdpPacket(UdpPacket& packet);
   void waitForUdpPacket(UdpPacket& packet);
   void openTcpSocket();
+  void connectTcpSocket();
+  bool tcpConnectionIsIdle();
   void sendTcpPacket(TcpPacket& packet);
   void waitForTcpPacket(TcpPacket& packet);
   void closeTcpSocket();
 
  public:
-  UserState(std::string& hostname, std::string& port);
+  // The auctions as of the last listing, kept to only ask for changes
+  std::map<uint32_t, bool> auction_list;
+  uint32_t auction_list_epoch = 0;
+  uint32_t auction_list_version = 0;
+  // Cleared when the server does not know incremental listings
+  bool list_since_supported = true;
+
+  UserState(std::string& hostname, std::string& port, bool __keep_alive);
   ~UserState();
   bool isLoggedIn();
+  // Whether the open TCP connection was kept alive by the server
+  bool isTcpKeptAlive();
   void login (uint32_t, std::string& pwd);
   void logout();
   void sendUdpPacketAndWaitForReply(UdpPacket& out_packet,
                                     UdpPacket& in_packet);
   void sendTcpPacketAndWaitForReply(TcpPacket& out_packet,
                                     TcpPacket& in_packet);
+  // Sends every request before reading any reply; replies are read in the
+  // order the requests were sent. Without keep-alive, the server serves a
+  // single request per connection, so the requests are sent one at a time.
+  void sendTcpPacketsAndWaitForReplies(
+      const std::vector<TcpPacket*>& out_packets,
+      const std::vector<TcpPacket*>& in_packets);
+  // For requests whose reply is followed by packets pushed by the server:
+  // the connection stays open until closeTcpStream
+  void openTcpStream(TcpPacket& out_packet, TcpPacket& in_packet);
+  // Returns false if the user pressed ENTER to stop waiting
+  bool waitForStreamPacket(TcpPacket& packet);
+  void closeTcpStream();
   uint32_t getUserId();
   std::string getPassword();
 
@@ -0,0 +1,108 @@
+#include "auction_catalog.hpp"
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+#include "../common/constants.hpp"
+#include "../common/exceptions.hpp"
+
+/* Clients start from epoch 0, which is never drawn */
+static uint32_t draw_epoch() {
+  std::random_device random;
+  return std::uniform_int_distribution<uint32_t>(1, INT32_MAX)(random);
+}
+
+AuctionCatalog::AuctionCatalog() : epoch{draw_epoch()} {}
+
+void AuctionCatalog::seed(StorageEngine &storage) {
+  std::vector<std::pair<uint32_t, bool>> auctions;
+  try {
+    auctions = storage.getAllAuctions();
+  } catch (NoAuctionsException &e) {
+    return;
+  }
+
+  std::scoped_lock<std::mutex> guard(lock);
+  for (auto &[auction_id, active] : auctions) {
+    if (!active) {
+      continue;
+    }
+    AuctionData auction = storage.getAuction(auction_id);
+    std::time_t end_time =
+        auction.getStartTime() +
+        static_cast<std::time_t>(auction.getDurationSeconds());
+    expiries.emplace(end_time, auction_id);
+    end_times[auction_id] = end_time;
+  }
+}
+
+void AuctionCatalog::record(uint32_t auction_id, bool active) {
+  changes.push_back(Change{++version, auction_id, active});
+  if (changes.size() > AUCTION_CATALOG_LOG_MAX_LEN) {
+    oldest_version = changes.front().version;
+    changes.pop_front();
+  }
+}
+
+void AuctionCatalog::expireAuctions() {
+  std::time_t now = std::time(nullptr);
+  while (!expiries.empty() && expiries.begin()->first <= now) {
+    uint32_t auction_id = expiries.begin()->second;
+    expiries.erase(expiries.begin());
+    end_times.erase(auction_id);
+    record(auction_id, false);
+  }
+}
+
+void AuctionCatalog::auctionOpened(uint32_t auction_id, std::time_t end_time) {
+  std::scoped_lock<std::mutex> guard(lock);
+  record(auction_id, true);
+  expiries.emplace(end_time, auction_id);
+  end_times[auction_id] = end_time;
+}
+
+void AuctionCatalog::auctionClosed(uint32_t auction_id) {
+  std::scoped_lock<std::mutex> guard(lock);
+  auto end_time = end_times.find(auction_id);
+  if (end_time != end_times.end()) {
+    expiries.erase({end_time->second, auction_id});
+    end_times.erase(end_time);
+  }
+  record(auction_id, false);
+}
+
+uint32_t AuctionCatalog::currentEpoch() const { return epoch; }
+
+uint32_t AuctionCatalog::currentVersion() {
+  std::scoped_lock<std::mutex> guard(lock);
+  expireAuctions();
+  return version;
+}
+
+size_t AuctionCatalog::activeAuctions() {
+  std::scoped_lock<std::mutex> guard(lock);
+  expireAuctions();
+  return end_times.size();
+}
+
+std::optional<uint32_t> AuctionCatalog::changesSince(
+    uint32_t since_epoch, uint32_t since,
+    std::vector<std::pair<uint32_t, bool>> &auctions) {
+  std::scoped_lock<std::mutex> guard(lock);
+  expireAuctions();
+  if (since_epoch != epoch || since < oldest_version || since > version) {
+    return std::nullopt;
+  }
+
+  // Only the latest state of each auction is sent, in ID order
+  std::map<uint32_t, bool> changed;
+  auto first = std::upper_bound(
+      changes.begin(), changes.end(), since,
+      [](uint32_t v, const Change &change) { return v < change.version; });
+  for (auto change = first; change != changes.end(); ++change) {
+    changed[change->auction_id] = change->active;
+  }
+  auctions.assign(changed.begin(), changed.end());
+  return version;
+}
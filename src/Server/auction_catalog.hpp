@@ -0,0 +1,63 @@
+#ifndef AUCTION_CATALOG_H
+#define AUCTION_CATALOG_H
+
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../common/storage_engine.hpp"
+
+// Versions the list of auctions, so clients polling it can ask only for
+// what changed since the version they last saw. Every opened, closed or
+// expired auction bumps the version and is recorded in a bounded change
+// log; clients behind the oldest logged change get the full list instead.
+//
+// Versions are only meaningful within the epoch they were handed out with,
+// drawn at random on startup, so versions of a previous run are never
+// mistaken for current ones.
+class AuctionCatalog {
+  struct Change {
+    uint32_t version;
+    uint32_t auction_id;
+    bool active;
+  };
+
+  const uint32_t epoch;
+  uint32_t version = 0;
+  // Changes after this version are all in the log
+  uint32_t oldest_version = 0;
+  std::deque<Change> changes;
+  // Active auctions by end time, to record them as they expire
+  std::set<std::pair<std::time_t, uint32_t>> expiries;
+  std::unordered_map<uint32_t, std::time_t> end_times;
+  std::mutex lock;
+
+  void record(uint32_t auction_id, bool active);
+  void expireAuctions();
+
+public:
+  AuctionCatalog();
+
+  // Learns the end time of the auctions already active on startup
+  void seed(StorageEngine &storage);
+  void auctionOpened(uint32_t auction_id, std::time_t end_time);
+  void auctionClosed(uint32_t auction_id);
+
+  uint32_t currentEpoch() const;
+  uint32_t currentVersion();
+  size_t activeAuctions();
+  // Fills in the latest state of every auction changed after the given
+  // version and returns the current version, or returns nothing if the
+  // version is from another epoch or the changes are no longer all known
+  std::optional<uint32_t>
+  changesSince(uint32_t since_epoch, uint32_t since,
+               std::vector<std::pair<uint32_t, bool>> &auctions);
+};
+
+#endif
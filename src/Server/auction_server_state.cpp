@@ -1,5 +1,6 @@
 #include "auction_server_state.hpp"
 
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <cstring>
@@ -8,16 +9,17 @@
 #include <iostream>
 
 #include "../common/common.hpp"
+#include "../common/packet_writer.hpp"
 #include "../common/protocol.hpp"
+#include "packet_dispatch.hpp"
 #include "packet_handlers.hpp"
 
-AuctionServerState::AuctionServerState(std::string &port, bool __verbose,
-                                       FileManager &fileManager,
+AuctionServerState::AuctionServerState(std::string &port,
+                                       StorageEngine &__storage,
                                        uint32_t __auctionsCount)
-    : cdebug{DebugStream(__verbose)}, file_manager{fileManager} {
+    : storage{__storage} {
   this->setup_sockets();
   this->resolveServerAddress(port);
-  this->registerPacketHandlers();
   this->auctionsCount = __auctionsCount;
 }
 
@@ -36,26 +38,30 @@ AuctionServerState::~AuctionServerState() {
   }
 }
 
-void AuctionServerState::registerPacketHandlers() {
-  // UDP
-  udp_packet_handlers.insert({LoginServerbound::ID, handle_login_user});
-  udp_packet_handlers.insert({LogoutServerbound::ID, handle_logout_user});
-  udp_packet_handlers.insert(
-      {UnregisterServerbound::ID, handle_unregister_user});
-  udp_packet_handlers.insert(
-      {ListMyAuctionsServerbound::ID, handle_list_myauctions});
-  udp_packet_handlers.insert({MyBidsServerbound::ID, handle_list_mybids});
-  udp_packet_handlers.insert(
-      {ListAuctionsServerbound::ID, handle_list_auctions});
-  udp_packet_handlers.insert({ShowRecordServerbound::ID, handle_show_record});
-
-  // TCP
-  tcp_packet_handlers.insert({OpenAuctionServerbound::ID, handle_open_auction});
-  tcp_packet_handlers.insert(
-      {CloseAuctionServerbound::ID, handle_close_auction});
-  tcp_packet_handlers.insert({ShowAssetServerbound::ID, handle_show_asset});
-  tcp_packet_handlers.insert({BidServerbound::ID, handle_bid});
-}
+// Packet handlers, keyed by the ID of the packet they handle
+static constexpr PacketRoute<UdpPacketHandler> UDP_ROUTES[] = {
+    {pack_packet_id(LoginServerbound::ID), handle_login_user},
+    {pack_packet_id(LogoutServerbound::ID), handle_logout_user},
+    {pack_packet_id(UnregisterServerbound::ID), handle_unregister_user},
+    {pack_packet_id(ListMyAuctionsServerbound::ID), handle_list_myauctions},
+    {pack_packet_id(MyBidsServerbound::ID), handle_list_mybids},
+    {pack_packet_id(ListAuctionsServerbound::ID), handle_list_auctions},
+    {pack_packet_id(ListSinceServerbound::ID), handle_list_since},
+    {pack_packet_id(ShowRecordServerbound::ID), handle_show_record},
+    {pack_packet_id(AdminStatsServerbound::ID), handle_admin_stats},
+};
+
+static constexpr PacketRoute<TcpPacketHandler> TCP_ROUTES[] = {
+    {pack_packet_id(OpenAuctionServerbound::ID), handle_open_auction},
+    {pack_packet_id(CloseAuctionServerbound::ID), handle_close_auction},
+    {pack_packet_id(ShowAssetServerbound::ID), handle_show_asset},
+    {pack_packet_id(ShowAssetRangeServerbound::ID), handle_show_asset_range},
+    {pack_packet_id(BidServerbound::ID), handle_bid},
+    {pack_packet_id(WatchServerbound::ID), handle_watch},
+};
+
+static constexpr PacketDispatchTable UDP_DISPATCH(UDP_ROUTES);
+static constexpr PacketDispatchTable TCP_DISPATCH(TCP_ROUTES);
 
 void AuctionServerState::setup_sockets() {
   // Create a UDP socket
@@ -137,28 +143,45 @@ void AuctionServerState::resolveServerAddress(std::string &port) {
     throw UnrecoverableError("Failed to bind TCP address", errno);
   }
 
-  std::cout << "Listening for connections on port " << port << std::endl;
+  cinfo << "Listening for connections on port " << port << std::endl;
 }
 
-void AuctionServerState::callUdpPacketHandler(std::string packet_id,
-                                              std::stringstream &stream,
+void AuctionServerState::callUdpPacketHandler(PacketId packet_id,
+                                              PacketReader &reader,
                                               Address &addr_from) {
-  auto handler = this->udp_packet_handlers.find(packet_id);
-  if (handler == this->udp_packet_handlers.end()) {
+  UdpPacketHandler handler = UDP_DISPATCH.find(packet_id);
+  if (handler == nullptr) {
     cdebug << "Received unknown Packet ID" << std::endl;
     throw InvalidPacketException();
   }
 
-  handler->second(stream, addr_from, *this);
+  handler(reader, addr_from, *this);
 }
 
-void AuctionServerState::callTcpPacketHandler(std::string packet_id,
+void AuctionServerState::callTcpPacketHandler(PacketId packet_id,
                                               int connection_fd) {
-  auto handler = this->tcp_packet_handlers.find(packet_id);
-  if (handler == this->tcp_packet_handlers.end()) {
+  TcpPacketHandler handler = TCP_DISPATCH.find(packet_id);
+  if (handler == nullptr) {
     cdebug << "Received unknown Packet ID" << std::endl;
     throw InvalidPacketException();
   }
 
-  handler->second(connection_fd, *this);
+  handler(connection_fd, *this);
+}
+
+void AuctionServerState::sendUdpPacket(UdpPacket &reply, Address &addr_to) {
+  char buffer[SOCKET_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  reply.serialize(writer);
+  if (sendto(addr_to.socket, buffer, writer.size(), 0,
+             (struct sockaddr *)&addr_to.addr, addr_to.size) == -1) {
+    throw UnrecoverableError("Failed to send UDP packet", errno);
+  }
+
+  if (!addr_to.cached_request.empty()) {
+    udp_reply_cache.store(addr_to.addr, addr_to.cached_request, writer.data());
+  }
+  if (addr_to.captured_reply != nullptr) {
+    addr_to.captured_reply->assign(writer.data());
+  }
 }
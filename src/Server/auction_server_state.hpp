@@ -9,68 +9,40 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
-#include <unordered_map>
 
 #include "../common/auction_data.hpp"
 #include "../common/constants.hpp"
 #include "../common/exceptions.hpp"
-#include "../common/file_manager.hpp"
+#include "../common/logger.hpp"
+#include "../common/storage_engine.hpp"
 #include "../common/protocol.hpp"
+#include "auction_catalog.hpp"
+#include "server_metrics.hpp"
+#include "traffic_capture.hpp"
+#include "udp_reply_cache.hpp"
 #include "user_data.hpp"
+#include "watch_hub.hpp"
 
 class Address {
 public:
   int socket;
   struct sockaddr_in addr;
   socklen_t size;
-};
-
-class DebugStream {
-  bool active;
-
-public:
-  DebugStream(bool __active) : active{__active} {};
-
-  template <class T> DebugStream &operator<<(T val) {
-    if (active) {
-      std::cout << val;
-    }
-    return *this;
-  }
-
-  DebugStream &operator<<(std::ostream &(*f)(std::ostream &)) {
-    if (active) {
-      f(std::cout);
-    }
-    return *this;
-  }
-
-  DebugStream &operator<<(std::ostream &(*f)(std::ios &)) {
-    if (active) {
-      f(std::cout);
-    }
-    return *this;
-  }
-
-  DebugStream &operator<<(std::ostream &(*f)(std::ios_base &)) {
-    if (active) {
-      f(std::cout);
-    }
-    return *this;
-  }
+  // The UDP request being answered, when its reply is to be cached
+  std::string_view cached_request;
+  // Where the reply goes, when the request is being captured
+  std::string *captured_reply = nullptr;
 };
 
 class AuctionServerState;
 
-typedef void (*UdpPacketHandler)(std::stringstream &, Address &,
+typedef void (*UdpPacketHandler)(PacketReader &, Address &,
                                  AuctionServerState &);
 typedef void (*TcpPacketHandler)(int connection_fd, AuctionServerState &);
 
 class AuctionServerState {
-  std::unordered_map<std::string, UdpPacketHandler> udp_packet_handlers;
-  std::unordered_map<std::string, TcpPacketHandler> tcp_packet_handlers;
-
   std::mutex AuctionsLock;
   std::mutex UsersLock;
 
@@ -81,18 +53,35 @@ public:
   int tcp_socket_fd = -1;
   struct addrinfo *server_udp_addr = NULL;
   struct addrinfo *server_tcp_addr = NULL;
-  DebugStream cdebug;
+  // Only written out in verbose mode
+  LogStream cdebug{Logger::DEBUG};
   u_int32_t auctionsCount;
-  FileManager &file_manager;
-
-  AuctionServerState(std::string &port, bool __verbose,
-                     FileManager &__file_manager, uint32_t __auctionsCount);
+  StorageEngine &storage;
+  UdpReplyCache udp_reply_cache;
+  AuctionCatalog catalog;
+  WatchHub watch_hub;
+  ServerMetrics metrics;
+  TrafficCapture capture;
+
+  AuctionServerState(std::string &port, StorageEngine &__storage,
+                     uint32_t __auctionsCount);
   ~AuctionServerState();
   void resolveServerAddress(std::string &port);
-  void registerPacketHandlers();
-  void callUdpPacketHandler(std::string packet_id, std::stringstream &stream,
+  void callUdpPacketHandler(PacketId packet_id, PacketReader &reader,
                             Address &addr_from);
-  void callTcpPacketHandler(std::string packet_id, int connection_fd);
+  void callTcpPacketHandler(PacketId packet_id, int connection_fd);
+  // Sends a reply to a UDP request, caching it if the request asked for it
+  template <class Reply> void sendUdpReply(Reply &reply, Address &addr_to) {
+    metrics.replying(reply);
+    sendUdpPacket(reply, addr_to);
+    metrics.replied();
+  }
+  template <class Reply> void sendTcpReply(Reply &reply, int connection_fd) {
+    metrics.replying(reply);
+    reply.send(connection_fd);
+    metrics.replied();
+  }
+  void sendUdpPacket(UdpPacket &reply, Address &addr_to);
 };
 
 /** Exceptions **/
@@ -0,0 +1,81 @@
+#ifndef PACKET_DISPATCH_H
+#define PACKET_DISPATCH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../common/protocol.hpp"
+
+template <typename Handler> struct PacketRoute {
+  PacketId id;
+  Handler handler;
+};
+
+// Perfect hash table from packet IDs to handlers, built at compile time.
+// The hash multiplier is searched for while building the table, so adding
+// a route never requires tuning it by hand.
+template <typename Handler, size_t N> class PacketDispatchTable {
+  static constexpr uint32_t SLOT_BITS = 5;
+  static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+  static_assert(N <= SLOTS / 2, "Too many routes for the dispatch table");
+
+  struct Slot {
+    PacketId id = 0;
+    Handler handler = nullptr;
+  };
+
+  std::array<Slot, SLOTS> slots{};
+  uint32_t multiplier = 0;
+
+  static constexpr size_t slotOf(PacketId id, uint32_t hash_multiplier) {
+    return static_cast<size_t>((id * hash_multiplier) >> (32 - SLOT_BITS));
+  }
+
+  static constexpr bool
+  isPerfectHash(const PacketRoute<Handler> (&routes)[N], uint32_t candidate) {
+    std::array<bool, SLOTS> used{};
+    for (size_t i = 0; i < N; ++i) {
+      size_t slot = slotOf(routes[i].id, candidate);
+      if (used[slot]) {
+        return false;
+      }
+      used[slot] = true;
+    }
+    return true;
+  }
+
+public:
+  constexpr explicit PacketDispatchTable(
+      const PacketRoute<Handler> (&routes)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      for (size_t j = i + 1; j < N; ++j) {
+        if (routes[i].id == routes[j].id) {
+          // Fails the build when the table is built at compile time
+          throw std::logic_error("Duplicate packet route");
+        }
+      }
+    }
+
+    uint32_t candidate = 0x9E3779B1u; // 2^32 / golden ratio
+    while (!isPerfectHash(routes, candidate)) {
+      candidate += 2;
+    }
+    multiplier = candidate;
+
+    for (size_t i = 0; i < N; ++i) {
+      Slot &slot = slots[slotOf(routes[i].id, multiplier)];
+      slot.id = routes[i].id;
+      slot.handler = routes[i].handler;
+    }
+  }
+
+  // Returns nullptr for unknown packet IDs
+  constexpr Handler find(PacketId id) const {
+    const Slot &slot = slots[slotOf(id, multiplier)];
+    return slot.id == id ? slot.handler : nullptr;
+  }
+};
+
+#endif
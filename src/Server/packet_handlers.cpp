@@ -1,21 +1,30 @@
 #include "packet_handlers.hpp"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <optional>
+
+#include "../common/common.hpp"
+#include "../common/logger.hpp"
 
 // UDP
 
-void handle_login_user(std::stringstream &buffer, Address &addr_from,
+void handle_login_user(PacketReader &reader, Address &addr_from,
                        AuctionServerState &state) {
   LoginServerbound packet;
   ReplyLoginClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << userTag(packet.user_id) << "Asked to login" << std::endl;
 
-    UserData user(packet.user_id, packet.password, state.file_manager);
+    UserData user(packet.user_id, packet.password, state.storage);
 
     user.login();
 
@@ -53,27 +62,27 @@ void handle_login_user(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyLoginClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr << "[Login] There was an unhandled exception that prevented "
-                 "the server from logging in:"
-              << e.what() << std::endl;
+    cerror << "[Login] There was an unhandled exception that prevented "
+              "the server from logging in:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_logout_user(std::stringstream &buffer, Address &addr_from,
+void handle_logout_user(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state) {
   LogoutServerbound packet;
   ReplyLogoutClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << userTag(packet.user_id) << "Asked to logout user"
                  << std::endl;
 
-    UserData user(packet.user_id, packet.password, state.file_manager);
+    UserData user(packet.user_id, packet.password, state.storage);
 
     user.logout();
 
@@ -104,28 +113,28 @@ void handle_logout_user(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyLogoutClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr << "[Logout] There was an unhandled exception that prevented "
-                 "the server from logging out:"
-              << e.what() << std::endl;
+    cerror << "[Logout] There was an unhandled exception that prevented "
+              "the server from logging out:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_unregister_user(std::stringstream &buffer, Address &addr_from,
+void handle_unregister_user(PacketReader &reader, Address &addr_from,
                             AuctionServerState &state) {
 
   UnregisterServerbound packet;
   ReplyUnregisterClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << userTag(packet.user_id) << "Asked to unregister user"
                  << std::endl;
 
-    UserData user(packet.user_id, packet.password, state.file_manager);
+    UserData user(packet.user_id, packet.password, state.storage);
 
     user.unregisterUser();
     response.status = ReplyUnregisterClientbound::OK;
@@ -151,17 +160,16 @@ void handle_unregister_user(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyUnregisterClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr << "[Unregister] There was an unhandled exception that prevented "
-                 "the server from unregistering:"
-              << e.what() << std::endl;
+    cerror << "[Unregister] There was an unhandled exception that prevented "
+              "the server from unregistering:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_list_myauctions(std::stringstream &buffer, Address &addr_from,
+void handle_list_myauctions(PacketReader &reader, Address &addr_from,
                             AuctionServerState &state)
 
 {
@@ -169,11 +177,12 @@ void handle_list_myauctions(std::stringstream &buffer, Address &addr_from,
   ReplyListMyAuctionsClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << userTag(packet.user_id) << "Asked to list user auctions"
                  << std::endl;
 
-    UserData user(packet.user_id, state.file_manager);
+    UserData user(packet.user_id, state.storage);
     std::vector<std::pair<uint32_t, bool>> auctions =
         user.listMyAuctions("HOSTED");
     response.status = ReplyListMyAuctionsClientbound::OK;
@@ -199,18 +208,17 @@ void handle_list_myauctions(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyListMyAuctionsClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr
+    cerror
         << "[ListMyAuctions] There was an unhandled exception that prevented "
            "the server from listing auctions:"
         << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_list_mybids(std::stringstream &buffer, Address &addr_from,
+void handle_list_mybids(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state)
 
 {
@@ -218,11 +226,12 @@ void handle_list_mybids(std::stringstream &buffer, Address &addr_from,
   ReplyMyBidsClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << userTag(packet.user_id) << "Asked to list user bids"
                  << std::endl;
 
-    UserData user(packet.user_id, state.file_manager);
+    UserData user(packet.user_id, state.storage);
     std::vector<std::pair<uint32_t, bool>> auctions =
         user.listMyAuctions("BIDDED");
     response.status = ReplyMyBidsClientbound::OK;
@@ -247,27 +256,27 @@ void handle_list_mybids(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyMyBidsClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr << "[ListMyBids] There was an unhandled exception that prevented "
-                 "the server from listing auctions:"
-              << e.what() << std::endl;
+    cerror << "[ListMyBids] There was an unhandled exception that prevented "
+              "the server from listing auctions:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_list_auctions(std::stringstream &buffer, Address &addr_from,
+void handle_list_auctions(PacketReader &reader, Address &addr_from,
                           AuctionServerState &state) {
   ListAuctionsServerbound packet;
   ReplyListAuctionsClientbound response;
 
   try {
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << "Asked to list auctions" << std::endl;
 
     std::vector<std::pair<uint32_t, bool>> auctions =
-        state.file_manager.getAllAuctions();
+        state.storage.getAllAuctions();
     response.status = ReplyListAuctionsClientbound::OK;
     response.auctions = auctions;
   }
@@ -285,29 +294,71 @@ void handle_list_auctions(std::stringstream &buffer, Address &addr_from,
     state.cdebug << "Failed to read from file" << std::endl;
     response.status = ReplyListAuctionsClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr
-        << "[ListAuctions] There was an unhandled exception that prevented "
-           "the server from listing auctions:"
-        << e.what() << std::endl;
+    cerror << "[ListAuctions] There was an unhandled exception that prevented "
+              "the server from listing auctions:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
 }
 
-void handle_show_record(std::stringstream &buffer, Address &addr_from,
+void handle_list_since(PacketReader &reader, Address &addr_from,
+                       AuctionServerState &state) {
+  ListSinceServerbound packet;
+  ReplyListSinceClientbound response;
+
+  try {
+    packet.deserialize(reader);
+    state.metrics.parsed();
+    state.cdebug << "Asked to list auctions changed since version "
+                 << packet.epoch << "." << packet.version << std::endl;
+
+    response.epoch = state.catalog.currentEpoch();
+    std::optional<uint32_t> version = state.catalog.changesSince(
+        packet.epoch, packet.version, response.auctions);
+    if (version.has_value()) {
+      response.status = ReplyListSinceClientbound::OK;
+      response.version = *version;
+    } else {
+      // Taken before listing, so later changes are sent next time
+      response.status = ReplyListSinceClientbound::ALL;
+      response.version = state.catalog.currentVersion();
+      try {
+        response.auctions = state.storage.getAllAuctions();
+      } catch (NoAuctionsException &e) {
+        response.auctions.clear();
+      }
+    }
+  } catch (FileOpenException &e) {
+    state.cdebug << "Failed to open file" << std::endl;
+    response.status = ReplyListSinceClientbound::ERR;
+  } catch (FileReadException &e) {
+    state.cdebug << "Failed to read from file" << std::endl;
+    response.status = ReplyListSinceClientbound::ERR;
+  } catch (std::exception &e) {
+    cerror << "[ListSince] There was an unhandled exception that prevented "
+              "the server from listing auctions:"
+           << e.what() << std::endl;
+    return;
+  }
+
+  state.sendUdpReply(response, addr_from);
+}
+
+void handle_show_record(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state) {
   ShowRecordServerbound packet;
   ReplyShowRecordClientbound response;
 
   try {
 
-    packet.deserialize(buffer);
+    packet.deserialize(reader);
+    state.metrics.parsed();
     state.cdebug << auctionTag(packet.auction_id) << "Asked to show record"
                  << std::endl;
 
-    AuctionData auction = state.file_manager.getAuction(packet.auction_id);
+    AuctionData auction = state.storage.getAuction(packet.auction_id);
 
     response.auction = auction;
     response.status = ReplyShowRecordClientbound::OK;
@@ -328,14 +379,102 @@ void handle_show_record(std::stringstream &buffer, Address &addr_from,
                  << std::endl;
     response.status = ReplyShowRecordClientbound::ERR;
   } catch (std::exception &e) {
-    std::cerr << "[ShowRecord] There was an unhandled exception that prevented "
-                 "the server from showing record:"
-              << e.what() << std::endl;
+    cerror << "[ShowRecord] There was an unhandled exception that prevented "
+              "the server from showing record:"
+           << e.what() << std::endl;
     return;
   }
 
-  send_packet(response, addr_from.socket, (struct sockaddr *)&addr_from.addr,
-              addr_from.size);
+  state.sendUdpReply(response, addr_from);
+}
+
+// Replies that mean the request was carried out
+static bool is_success_status(const char *status) {
+  return std::strcmp(status, "OK") == 0 || std::strcmp(status, "ACC") == 0 ||
+         std::strcmp(status, "REG") == 0 || std::strcmp(status, "ALL") == 0 ||
+         std::strcmp(status, ServerMetrics::RESENT) == 0;
+}
+
+static void gather_admin_stats(
+    AuctionServerState &state,
+    std::vector<std::pair<std::string, uint64_t>> &stats) {
+  typedef ServerMetrics M;
+  uint64_t requests[M::PACKET_COUNT][M::STATUS_COUNT];
+  state.metrics.requestCounts(requests);
+  StorageStats storage = state.storage.stats();
+
+  stats.emplace_back("uptime_s", state.metrics.uptime().count());
+  stats.emplace_back("tcp_workers", TCP_WORKER_POOL_SIZE);
+  stats.emplace_back("busy_workers", state.metrics.busy_workers.load());
+  stats.emplace_back("worker_busy_ms",
+                     state.metrics.worker_busy_ns.load() / 1000000);
+  stats.emplace_back("watchers", state.watch_hub.watcherCount());
+  stats.emplace_back("pending_writes", storage.pending_writes);
+  stats.emplace_back("write_failures", storage.write_failures);
+  stats.emplace_back("users", storage.users);
+  stats.emplace_back("logged_in_users", storage.logged_in_users);
+  stats.emplace_back("auctions", state.storage.getAuctionsCount() - 1);
+  stats.emplace_back("active_auctions", state.catalog.activeAuctions());
+
+  // Cache hit rates follow from the replies: resent replies are reply
+  // cache hits, and full listings are change log misses
+  uint64_t reply_cache_hits = 0;
+  uint64_t reply_cache_lookups = 0;
+  for (size_t packet = 0; packet < M::PACKET_COUNT; ++packet) {
+    uint64_t total = 0;
+    uint64_t errors = 0;
+    for (size_t status = 0; status < M::STATUS_COUNT; ++status) {
+      total += requests[packet][status];
+      if (!is_success_status(M::STATUS_NAMES[status])) {
+        errors += requests[packet][status];
+      }
+    }
+    PacketId packet_id = pack_packet_id(M::PACKET_NAMES[packet]);
+    if (UdpReplyCache::cachesRepliesTo(packet_id)) {
+      reply_cache_hits += requests[packet][M::statusIndex(M::RESENT)];
+      reply_cache_lookups += total;
+    }
+    stats.emplace_back(std::string("requests_") + M::PACKET_NAMES[packet],
+                       total);
+    stats.emplace_back(std::string("errors_") + M::PACKET_NAMES[packet],
+                       errors);
+  }
+  stats.emplace_back("reply_cache_hits", reply_cache_hits);
+  stats.emplace_back("reply_cache_lookups", reply_cache_lookups);
+
+  uint64_t *list_since =
+      requests[M::packetIndex(pack_packet_id(ListSinceServerbound::ID))];
+  uint64_t change_log_hits = list_since[M::statusIndex("OK")];
+  stats.emplace_back("change_log_hits", change_log_hits);
+  stats.emplace_back("change_log_lookups",
+                     change_log_hits + list_since[M::statusIndex("ALL")]);
+}
+
+void handle_admin_stats(PacketReader &reader, Address &addr_from,
+                        AuctionServerState &state) {
+  AdminStatsServerbound packet;
+  ReplyAdminStatsClientbound response;
+
+  try {
+    packet.deserialize(reader);
+    state.metrics.parsed();
+
+    if ((ntohl(addr_from.addr.sin_addr.s_addr) >> 24) != IN_LOOPBACKNET) {
+      state.cdebug << "Refused stats to a non-loopback address" << std::endl;
+      response.status = ReplyAdminStatsClientbound::NOK;
+    } else {
+      gather_admin_stats(state, response.stats);
+      response.status = ReplyAdminStatsClientbound::OK;
+    }
+  } catch (std::exception &e) {
+    cerror << "[Stats] There was an unhandled exception that prevented "
+              "the server from gathering its stats:"
+           << e.what() << std::endl;
+    response.stats.clear();
+    response.status = ReplyAdminStatsClientbound::ERR;
+  }
+
+  state.sendUdpReply(response, addr_from);
 }
 
 // TCP
@@ -344,14 +483,20 @@ void handle_open_auction(int connection_fd, AuctionServerState &state) {
 
   OpenAuctionServerbound packet;
   ReplyOpenAuctionClientbound response;
+  AssetUpload asset;
 
   try {
+    state.storage.prepareAssetUpload(asset);
+    packet.file_path = asset.staging_path;
+    packet.file_contents = asset.contents;
     packet.receive(connection_fd);
+    state.metrics.parsed();
+    asset.hash = packet.file_hash;
 
     state.cdebug << userTag(packet.user_id) << "Asked to start Auction"
                  << std::endl;
 
-    UserData user(packet.user_id, state.file_manager);
+    UserData user(packet.user_id, state.storage);
 
     time_t now = time(0);
 
@@ -366,8 +511,10 @@ void handle_open_auction(int connection_fd, AuctionServerState &state) {
       throw InvalidAuctionAssetException(packet.file_name);
     }
 
-    user.openAuction(auction, packet.password);
+    user.openAuction(auction, packet.password, asset);
     response.auction_id = auction.getId();
+    state.catalog.auctionOpened(auction.getId(),
+                                now + static_cast<time_t>(packet.time_active));
 
     response.status = ReplyOpenAuctionClientbound::OK;
 
@@ -418,15 +565,13 @@ void handle_open_auction(int connection_fd, AuctionServerState &state) {
   } catch (std::exception &e) {
 
     response.status = ReplyOpenAuctionClientbound::NOK;
-    std::cerr
-        << "[OpenAuction] There was an unhandled exception that prevented "
-           "the server from opening the auction:"
-        << e.what() << std::endl;
-
-    return;
+    cerror << "[OpenAuction] There was an unhandled exception that prevented "
+              "the server from opening the auction:"
+           << e.what() << std::endl;
+    throw;
   }
 
-  response.send(connection_fd);
+  state.sendTcpReply(response, connection_fd);
 }
 
 void handle_close_auction(int connection_fd, AuctionServerState &state) {
@@ -437,15 +582,18 @@ void handle_close_auction(int connection_fd, AuctionServerState &state) {
   try {
 
     packet.receive(connection_fd);
+    state.metrics.parsed();
 
     state.cdebug << userTag(packet.user_id) << " Asked to close Auction"
                  << std::endl;
 
-    UserData user(packet.user_id, state.file_manager);
+    UserData user(packet.user_id, state.storage);
 
-    AuctionData auction = state.file_manager.getAuction(packet.auction_id);
+    AuctionData auction = state.storage.getAuction(packet.auction_id);
 
     user.closeAuction(auction);
+    state.watch_hub.publishEnd(packet.auction_id);
+    state.catalog.auctionClosed(packet.auction_id);
 
     response.status = ReplyCloseAuctionClientbound::OK;
 
@@ -485,14 +633,12 @@ void handle_close_auction(int connection_fd, AuctionServerState &state) {
     response.status = ReplyCloseAuctionClientbound::ERR;
   } catch (std::exception &e) {
 
-    std::cerr
-        << "[CloseAuction] There was an unhandled exception that prevented "
-           "the server from closing the auction:"
-        << e.what() << std::endl;
-
-    return;
+    cerror << "[CloseAuction] There was an unhandled exception that prevented "
+              "the server from closing the auction:"
+           << e.what() << std::endl;
+    throw;
   }
-  response.send(connection_fd);
+  state.sendTcpReply(response, connection_fd);
 }
 
 void handle_show_asset(int connection_fd, AuctionServerState &state) {
@@ -502,16 +648,19 @@ void handle_show_asset(int connection_fd, AuctionServerState &state) {
 
   try {
     packet.receive(connection_fd);
+    state.metrics.parsed();
 
-    AuctionData auction = state.file_manager.getAuction(packet.auction_id);
+    AuctionData auction = state.storage.getAuction(packet.auction_id);
 
-    std::filesystem::path asset_path = state.file_manager.showAsset(auction);
+    AssetSource asset = state.storage.showAsset(auction);
 
     response.status = ReplyShowAssetClientbound::OK;
 
-    response.file_name = asset_path.filename().string();
+    // Stored assets are named by their hash, not by their file name
+    response.file_name = auction.getAssetFname();
 
-    response.file_path = asset_path;
+    response.file_path = asset.path;
+    response.file_contents = asset.contents;
 
     state.cdebug << auctionTag(packet.auction_id) << "Asked to show asset"
                  << std::endl;
@@ -541,14 +690,77 @@ void handle_show_asset(int connection_fd, AuctionServerState &state) {
     response.status = ReplyShowAssetClientbound::NOK;
   } catch (std::exception &e) {
 
-    std::cerr << "[ShowAsset] There was an unhandled exception that prevented "
-                 "the server from showing the asset:"
-              << e.what() << std::endl;
+    cerror << "[ShowAsset] There was an unhandled exception that prevented "
+              "the server from showing the asset:"
+           << e.what() << std::endl;
+    throw;
+  }
 
-    return;
+  state.sendTcpReply(response, connection_fd);
+}
+
+void handle_show_asset_range(int connection_fd, AuctionServerState &state) {
+
+  ShowAssetRangeServerbound packet;
+  ReplyShowAssetRangeClientbound response;
+
+  try {
+    packet.receive(connection_fd);
+    state.metrics.parsed();
+
+    AuctionData auction = state.storage.getAuction(packet.auction_id);
+
+    AssetSource asset = state.storage.showAsset(auction);
+
+    response.status = ReplyShowAssetRangeClientbound::OK;
+    response.file_name = auction.getAssetFname();
+    response.file_path = asset.path;
+    response.file_contents = asset.contents;
+    response.hash = asset.hash;
+
+    // Resume only if the client has the start of this very asset
+    uint32_t file_size = asset.contents
+                             ? static_cast<uint32_t>(asset.contents->length())
+                             : getFileSize(asset.path);
+    if (!asset.hash.empty() && packet.hash == asset.hash &&
+        packet.offset <= file_size) {
+      response.offset = packet.offset;
+    } else {
+      response.offset = 0;
+    }
+
+    state.cdebug << auctionTag(packet.auction_id)
+                 << "Asked to show asset from byte " << response.offset
+                 << std::endl;
+  } catch (AuctionDoesNotExistException &e) {
+    state.cdebug << auctionTag(packet.auction_id) << "Auction does not exist"
+                 << std::endl;
+    response.status = ReplyShowAssetRangeClientbound::NOK;
+  } catch (InvalidFilePathException &e) {
+    state.cdebug << auctionTag(packet.auction_id) << "Invalid file path"
+                 << std::endl;
+    response.status = ReplyShowAssetRangeClientbound::NOK;
+  } catch (AssetDoesNotExistException &e) {
+    state.cdebug << auctionTag(packet.auction_id) << "Asset does not exist"
+                 << std::endl;
+    response.status = ReplyShowAssetRangeClientbound::NOK;
+  } catch (FileOpenException &e) {
+    state.cdebug << auctionTag(packet.auction_id) << "Failed to open file"
+                 << std::endl;
+    response.status = ReplyShowAssetRangeClientbound::NOK;
+  } catch (FileReadException &e) {
+    state.cdebug << auctionTag(packet.auction_id) << "Failed to read from file"
+                 << std::endl;
+    response.status = ReplyShowAssetRangeClientbound::NOK;
+  } catch (std::exception &e) {
+
+    cerror << "[ShowAssetRange] There was an unhandled exception that "
+              "prevented the server from showing the asset:"
+           << e.what() << std::endl;
+    throw;
   }
 
-  response.send(connection_fd);
+  state.sendTcpReply(response, connection_fd);
 }
 
 void handle_bid(int connection_fd, AuctionServerState &state) {
@@ -559,12 +771,15 @@ void handle_bid(int connection_fd, AuctionServerState &state) {
   try {
 
     packet.receive(connection_fd);
+    state.metrics.parsed();
 
-    UserData user(packet.user_id, packet.password, state.file_manager);
+    UserData user(packet.user_id, packet.password, state.storage);
 
-    AuctionData auction = state.file_manager.getAuction(packet.auction_id);
+    AuctionData auction = state.storage.getAuction(packet.auction_id);
 
     user.bid(auction, packet.bid_value, packet.password);
+    state.watch_hub.publishBid(packet.auction_id, packet.user_id,
+                               packet.bid_value);
 
     response.status = ReplyBidClientbound::ACC;
 
@@ -621,12 +836,70 @@ void handle_bid(int connection_fd, AuctionServerState &state) {
     response.status = ReplyBidClientbound::NOK;
   } catch (std::exception &e) {
 
-    std::cerr << "[Bid] There was an unhandled exception that prevented "
-                 "the server from bidding:"
-              << e.what() << std::endl;
+    cerror << "[Bid] There was an unhandled exception that prevented "
+              "the server from bidding:"
+           << e.what() << std::endl;
+    throw;
+  }
+
+  state.sendTcpReply(response, connection_fd);
+}
+
+void handle_watch(int connection_fd, AuctionServerState &state) {
+  WatchServerbound packet;
+  ReplyWatchClientbound response;
+  std::vector<AuctionData> watched;
+  std::optional<WatchRegistration> registration;
+
+  try {
+    packet.receive(connection_fd);
+    state.metrics.parsed();
+
+    std::sort(packet.auction_ids.begin(), packet.auction_ids.end());
+    packet.auction_ids.erase(
+        std::unique(packet.auction_ids.begin(), packet.auction_ids.end()),
+        packet.auction_ids.end());
+
+    // Bids and closes from here on are kept by the hub, as they may not be
+    // in what is read from storage
+    registration.emplace(state.watch_hub, packet.auction_ids);
+    for (uint32_t auction_id : packet.auction_ids) {
+      watched.push_back(state.storage.getAuction(auction_id));
+    }
+
+    response.status = ReplyWatchClientbound::OK;
+    state.cdebug << "Watching " << watched.size() << " auction(s)"
+                 << std::endl;
+  } catch (AuctionDoesNotExistException &e) {
+    state.cdebug << "Asked to watch an auction that does not exist"
+                 << std::endl;
+    response.status = ReplyWatchClientbound::NOK;
+  } catch (AuctionIdException &e) {
+    state.cdebug << "Asked to watch an invalid auction id" << std::endl;
+    response.status = ReplyWatchClientbound::NOK;
+  } catch (FileOpenException &e) {
+    state.cdebug << "Failed to open file" << std::endl;
+    response.status = ReplyWatchClientbound::ERR;
+  } catch (FileReadException &e) {
+    state.cdebug << "Failed to read from file" << std::endl;
+    response.status = ReplyWatchClientbound::ERR;
+  } catch (std::exception &e) {
+    cerror << "[Watch] There was an unhandled exception that prevented "
+              "the server from watching auctions:"
+           << e.what() << std::endl;
+    throw;
+  }
 
+  state.sendTcpReply(response, connection_fd);
+  if (response.status != ReplyWatchClientbound::OK) {
     return;
   }
 
-  response.send(connection_fd);
+  // The worker closes its own descriptor, the hub keeps the connection
+  int watch_fd = dup(connection_fd);
+  if (watch_fd < 0) {
+    throw UnrecoverableError("Failed to hand the connection to watchers",
+                             errno);
+  }
+  registration->complete(watch_fd, watched);
 }
@@ -31,25 +31,32 @@ public:
 
 // UDP
 
-void handle_login_user(std::stringstream &buffer, Address &addr_from,
+void handle_login_user(PacketReader &reader, Address &addr_from,
                        AuctionServerState &state);
 
-void handle_logout_user(std::stringstream &buffer, Address &addr_from,
+void handle_logout_user(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state);
 
-void handle_unregister_user(std::stringstream &buffer, Address &addr_from,
+void handle_unregister_user(PacketReader &reader, Address &addr_from,
                             AuctionServerState &state);
 
-void handle_list_myauctions(std::stringstream &buffer, Address &addr_from,
+void handle_list_myauctions(PacketReader &reader, Address &addr_from,
                             AuctionServerState &state);
 
-void handle_list_mybids(std::stringstream &buffer, Address &addr_from,
+void handle_list_mybids(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state);
 
-void handle_list_auctions(std::stringstream &buffer, Address &addr_from,
+void handle_list_auctions(PacketReader &reader, Address &addr_from,
                           AuctionServerState &state);
 
-void handle_show_record(std::stringstream &buffer, Address &addr_from,
+void handle_list_since(PacketReader &reader, Address &addr_from,
+                       AuctionServerState &state);
+
+void handle_show_record(PacketReader &reader, Address &addr_from,
+                        AuctionServerState &state);
+
+// Only answered over the loopback interface
+void handle_admin_stats(PacketReader &reader, Address &addr_from,
                         AuctionServerState &state);
 
 // TCP
@@ -59,6 +66,11 @@ void handle_close_auction(int connection_fd, AuctionServerState &state);
 
 void handle_show_asset(int connection_fd, AuctionServerState &state);
 
+void handle_show_asset_range(int connection_fd, AuctionServerState &state);
+
 void handle_bid(int connection_fd, AuctionServerState &state);
 
+// Hands the connection over to the watch hub
+void handle_watch(int connection_fd, AuctionServerState &state);
+
 #endif
\ No newline at end of file
@@ -1,78 +1,105 @@
 #include "server.hpp"
 
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <thread>
 
 #include "../common/common.hpp"
 #include "../common/exceptions.hpp"
-#include "../common/file_manager.hpp"
+#include "../common/logger.hpp"
 #include "../common/protocol.hpp"
+#include "../common/storage_engine.hpp"
+#include "../common/tracing.hpp"
 
 extern bool is_shutting_down;
 
+// Set by SIGUSR1 to have the metrics written out right away
+static volatile sig_atomic_t metrics_dump_requested = 0;
+// Set by SIGUSR2 to switch request tracing on or off
+static volatile sig_atomic_t trace_switch_requested = 0;
+
 int main(int argc, char *argv[]) {
   try {
 
-    // Create the directory structure
+    Server config(argc, argv);
 
-    FileManager fileManager = FileManager();
+    // Before any thread is started, so they all inherit the blocked signals
+    setup_dump_signal_handlers();
+    Logger::start(config.verbose ? Logger::DEBUG : Logger::INFO);
 
-    Server config(argc, argv);
+    // Create the directory structure, if storing on disk
+    std::unique_ptr<StorageEngine> storage =
+        make_storage_engine(config.storage_engine);
 
-    uint32_t auctionsCount = fileManager.getAuctionsCount();
+    uint32_t auctionsCount = storage->getAuctionsCount();
 
-    AuctionServerState state(config.port, config.verbose, fileManager,
-                             auctionsCount);
+    AuctionServerState state(config.port, *storage, auctionsCount);
 
-    state.registerPacketHandlers();
+    state.catalog.seed(*storage);
+    if (!config.capture_file.empty()) {
+      state.capture.open(config.capture_file);
+    }
 
     setup_signal_handlers();
 
     state.cdebug << "Verbose mode is active" << std::endl << std::endl;
 
     std::thread tcp_thread(main_tcp, std::ref(state));
+    std::thread archive_thread(main_archive, std::ref(state),
+                               config.archive_age);
+    std::thread metrics_thread(main_metrics, std::ref(state),
+                               std::ref(config));
     uint32_t ex_trial = 0;
     while (!is_shutting_down) {
       try {
         wait_for_udp_packet(state);
         ex_trial = 0;
       } catch (std::exception &e) {
-        std::cerr << "Encountered unrecoverable error while running the "
-                     "application. Retrying..."
-                  << std::endl
-                  << e.what() << std::endl;
+        cerror << "Encountered unrecoverable error while running the "
+                  "application. Retrying..."
+               << std::endl
+               << e.what() << std::endl;
         ex_trial++;
       } catch (...) {
-        std::cerr << "Encountered unrecoverable error while running the "
-                     "application.Retrying..."
-                  << std::endl;
+        cerror << "Encountered unrecoverable error while running the "
+                  "application.Retrying..."
+               << std::endl;
         ex_trial++;
       }
       if (ex_trial >= EXCEPTION_RETRY_MAX) {
-        std::cerr << "Max trials reached, shutting down..." << std::endl;
+        cerror << "Max trials reached, shutting down..." << std::endl;
         is_shutting_down = true;
       }
     }
 
-    fileManager.shutdown();
+    storage->shutdown();
 
-    std::cout << "Shutting down UDP server..." << std::endl;
+    cinfo << "Shutting down UDP server..." << std::endl;
 
     tcp_thread.join();
+    archive_thread.join();
+    metrics_thread.join();
+    state.capture.close();
+    Logger::stop();
   } catch (std::exception &e) {
-    std::cerr << "Encountered unrecoverable error while running the "
-                 "application. Shutting down..."
-              << std::endl
-              << e.what() << std::endl;
+    cerror << "Encountered unrecoverable error while running the "
+              "application. Shutting down..."
+           << std::endl
+           << e.what() << std::endl;
+    Logger::stop();
     return EXIT_FAILURE;
   } catch (...) {
-    std::cerr << "Encountered unrecoverable error while running the "
-                 "application. Shutting down..."
-              << std::endl;
+    cerror << "Encountered unrecoverable error while running the "
+              "application. Shutting down..."
+           << std::endl;
+    Logger::stop();
     return EXIT_FAILURE;
   }
 
@@ -84,7 +111,7 @@ void main_tcp(AuctionServerState &state) {
 
   if (listen(state.tcp_socket_fd, TCP_MAX_QUEUE_SIZE) < 0) {
     perror("Error while executing listen");
-    std::cerr << "TCP server is being shutdown..." << std::endl;
+    cerror << "TCP server is being shutdown..." << std::endl;
     is_shutting_down = true;
     return;
   }
@@ -95,32 +122,149 @@ void main_tcp(AuctionServerState &state) {
       wait_for_tcp_packet(state, worker_pool);
       ex_trial = 0;
     } catch (std::exception &e) {
-      std::cerr << "Encountered unrecoverable error while running the "
-                   "application. Retrying..."
-                << std::endl
-                << e.what() << std::endl;
+      cerror << "Encountered unrecoverable error while running the "
+                "application. Retrying..."
+             << std::endl
+             << e.what() << std::endl;
       ex_trial++;
     } catch (...) {
-      std::cerr << "Encountered unrecoverable error while running the "
-                   "application. Retrying..."
-                << std::endl;
+      cerror << "Encountered unrecoverable error while running the "
+                "application. Retrying..."
+             << std::endl;
       ex_trial++;
     }
     if (ex_trial >= EXCEPTION_RETRY_MAX) {
-      std::cerr << "Max trials reached, shutting down..." << std::endl;
+      cerror << "Max trials reached, shutting down..." << std::endl;
       is_shutting_down = true;
     }
   }
 
-  std::cout << "Shutting down TCP server... This might take a while if there "
-               "are open connections. Press CTRL + C again to forcefully close "
-               "the server."
-            << std::endl;
+  cinfo << "Shutting down TCP server... This might take a while if there "
+           "are open connections. Press CTRL + C again to forcefully close "
+           "the server."
+        << std::endl;
+}
+
+void main_archive(AuctionServerState &state, uint32_t archive_age) {
+  while (!is_shutting_down) {
+    // Sleep in small steps so shutdown is not delayed
+    for (uint32_t i = 0;
+         i < ARCHIVE_COMPACTION_INTERVAL_SECONDS && !is_shutting_down; ++i) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    if (is_shutting_down) {
+      break;
+    }
+
+    try {
+      uint32_t archived = state.storage.archiveClosedAuctions(archive_age);
+      if (archived > 0) {
+        state.cdebug << "Archived " << archived << " closed auction(s)"
+                     << std::endl;
+      }
+    } catch (std::exception &e) {
+      cerror << "Failed to archive closed auctions: " << e.what() << std::endl;
+    }
+  }
+}
+
+static void request_dump(int sig) {
+  if (sig == SIGUSR1) {
+    metrics_dump_requested = 1;
+  } else {
+    trace_switch_requested = 1;
+  }
+}
+
+/* SIGUSR1 and SIGUSR2 are blocked in every thread but the metrics one, since
+ * they would fail socket calls with a timeout set in whichever thread they
+ * interrupted */
+void setup_dump_signal_handlers() {
+  struct sigaction sa;
+  sa.sa_handler = request_dump;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+
+  if (sigaction(SIGUSR1, &sa, NULL) == -1) {
+    throw UnrecoverableError("Setting SIGUSR1 signal handler", errno);
+  }
+  if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+    throw UnrecoverableError("Setting SIGUSR2 signal handler", errno);
+  }
+
+  sigset_t dump_signals;
+  sigemptyset(&dump_signals);
+  sigaddset(&dump_signals, SIGUSR1);
+  sigaddset(&dump_signals, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &dump_signals, NULL);
+}
+
+// Writes through a temporary file, so readers never see a partial dump
+static void write_dump_file(const std::string &path,
+                            const std::function<void(std::ostream &)> &dump) {
+  std::string temporary_path = path + ".tmp";
+  std::ofstream file(temporary_path, std::ios::trunc);
+  dump(file);
+  file.close();
+  if (!file || std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    cerror << "Failed to write " << path << std::endl;
+  }
+}
+
+void main_metrics(AuctionServerState &state, Server &config) {
+  sigset_t dump_signals;
+  sigemptyset(&dump_signals);
+  sigaddset(&dump_signals, SIGUSR1);
+  sigaddset(&dump_signals, SIGUSR2);
+  pthread_sigmask(SIG_UNBLOCK, &dump_signals, NULL);
+
+  auto write_metrics = [&state](std::ostream &stream) {
+    state.metrics.writePrometheus(stream);
+    write_lock_report(stream, state.storage.lockStats(), LOCK_REPORT_TOP_N);
+  };
+  bool sampling = false;
+
+  while (!is_shutting_down) {
+    // Sleep in small steps so shutdown and signals are not delayed
+    for (uint32_t i = 0;
+         i < METRICS_DUMP_INTERVAL_SECONDS && !is_shutting_down &&
+         !metrics_dump_requested && !trace_switch_requested;
+         ++i) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    bool requested = metrics_dump_requested;
+    metrics_dump_requested = 0;
+    if (!config.metrics_file.empty()) {
+      write_dump_file(config.metrics_file, write_metrics);
+    } else if (requested) {
+      write_metrics(std::cout);
+      std::cout.flush();
+    }
+
+    // Each switch off, and shutting down while sampling, writes the spans
+    // recorded since sampling was switched on
+    bool switched = trace_switch_requested;
+    trace_switch_requested = 0;
+    if (config.trace_file.empty()) {
+      continue;
+    }
+    if (switched && !sampling) {
+      Tracer::setSampling(config.trace_sample_every);
+      sampling = true;
+      cinfo << "Tracing one in every " << config.trace_sample_every
+            << " request(s)" << std::endl;
+    } else if (sampling && (switched || is_shutting_down)) {
+      Tracer::setSampling(0);
+      sampling = false;
+      write_dump_file(config.trace_file, Tracer::flushChromeTrace);
+      cinfo << "Wrote traces to " << config.trace_file << std::endl;
+    }
+  }
 }
 
 void wait_for_udp_packet(AuctionServerState &server_state) {
   Address addr_from;
-  std::stringstream stream;
   char buffer[SOCKET_BUFFER_LEN];
 
   addr_from.size = sizeof(addr_from.addr);
@@ -139,41 +283,74 @@ void wait_for_udp_packet(AuctionServerState &server_state) {
 
   char addr_str[INET_ADDRSTRLEN + 1] = {0};
   inet_ntop(AF_INET, &addr_from.addr.sin_addr, addr_str, INET_ADDRSTRLEN);
-  std::cout << "Receiving incoming UDP message from " << addr_str << ":"
-            << ntohs(addr_from.addr.sin_port) << std::endl;
+  cinfo << "Receiving incoming UDP message from " << addr_str << ":"
+        << ntohs(addr_from.addr.sin_port) << std::endl;
 
-  stream.write(buffer, n);
-
-  return handle_packet(stream, addr_from, server_state);
+  return handle_packet(std::string_view(buffer, static_cast<size_t>(n)),
+                       addr_from, server_state);
 }
 
-void handle_packet(std::stringstream &buffer, Address &addr_from,
+void handle_packet(std::string_view datagram, Address &addr_from,
                    AuctionServerState &server_state) {
+  // Outlives the try block, so a malformed request is timed with its reply
+  std::optional<ServerMetrics::Request> request;
+  TraceRequest trace;
+  std::optional<CapturedUdpRequest> captured;
+  if (server_state.capture.active()) {
+    captured.emplace(server_state.capture, addr_from.addr, datagram);
+    addr_from.captured_reply = &captured->reply;
+  }
   try {
-    char packet_id[PACKET_ID_LEN + 1];
-    buffer >> packet_id;
-
-    if (!buffer.good()) {
-      std::cerr << "Received malformatted packet ID" << std::endl;
+    if (datagram.length() <= PACKET_ID_LEN) {
+      cerror << "Received malformatted packet ID" << std::endl;
       throw InvalidPacketException();
     }
 
-    std::string packet_id_str = std::string(packet_id);
+    PacketId packet_id = pack_packet_id(datagram.substr(0, PACKET_ID_LEN));
+    request.emplace(server_state.metrics, packet_id);
+    trace.setName(ServerMetrics::PACKET_NAMES[ServerMetrics::packetIndex(
+        packet_id)]);
+    if (UdpReplyCache::cachesRepliesTo(packet_id)) {
+      std::optional<std::string> reply =
+          server_state.udp_reply_cache.find(addr_from.addr, datagram);
+      if (reply.has_value()) {
+        server_state.cdebug << "Resending the reply to a repeated request"
+                            << std::endl;
+        server_state.metrics.replying(ServerMetrics::RESENT);
+        if (sendto(addr_from.socket, reply->data(), reply->length(), 0,
+                   (struct sockaddr *)&addr_from.addr, addr_from.size) == -1) {
+          throw UnrecoverableError("Failed to send UDP packet", errno);
+        }
+        server_state.metrics.replied();
+        if (captured.has_value()) {
+          captured->reply = *reply;
+        }
+        return;
+      }
+      addr_from.cached_request = datagram;
+    } else {
+      server_state.udp_reply_cache.forget(addr_from.addr);
+    }
 
-    server_state.callUdpPacketHandler(packet_id_str, buffer, addr_from);
+    PacketReader reader(datagram.substr(PACKET_ID_LEN));
+    server_state.callUdpPacketHandler(packet_id, reader, addr_from);
   } catch (InvalidPacketException &e) {
     try {
       ErrorUdpPacket error_packet;
+      server_state.metrics.replying("ERR");
       send_packet(error_packet, addr_from.socket,
                   (struct sockaddr *)&addr_from.addr, addr_from.size);
+      server_state.metrics.replied();
+      if (captured.has_value()) {
+        captured->reply = std::string(ErrorUdpPacket::ID) + "\n";
+      }
     } catch (std::exception &ex) {
-      std::cerr << "Failed to reply with ERR packet: " << ex.what()
-                << std::endl;
+      cerror << "Failed to reply with ERR packet: " << ex.what() << std::endl;
     }
   } catch (std::exception &e) {
-    std::cerr << "Failed to handle UDP packet: " << e.what() << std::endl;
+    cerror << "Failed to handle UDP packet: " << e.what() << std::endl;
   } catch (...) {
-    std::cerr << "Failed to handle UDP packet: unknown" << std::endl;
+    cerror << "Failed to handle UDP packet: unknown" << std::endl;
   }
 }
 
@@ -202,11 +379,19 @@ void wait_for_tcp_packet(AuctionServerState &server_state, WorkerPool &pool) {
     throw UnrecoverableError("Failed to set TCP read timeout socket option",
                              errno);
   }
+  // Replies to pipelined requests are small writes back to back, which
+  // would otherwise wait for the client to acknowledge the previous one
+  int no_delay = 1;
+  if (setsockopt(connection_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay,
+                 sizeof(no_delay)) < 0) {
+    throw UnrecoverableError("Failed to set TCP no delay socket option",
+                             errno);
+  }
 
   char addr_str[INET_ADDRSTRLEN + 1] = {0};
   inet_ntop(AF_INET, &addr_from.addr.sin_addr, addr_str, INET_ADDRSTRLEN);
-  std::cout << "Receiving incoming TCP connection from " << addr_str << ":"
-            << ntohs(addr_from.addr.sin_port) << std::endl;
+  cinfo << "Receiving incoming TCP connection from " << addr_str << ":"
+        << ntohs(addr_from.addr.sin_port) << std::endl;
 
   try {
     pool.delegateConnection(connection_fd);
@@ -222,14 +407,51 @@ Server::Server(int argc, char *argv[]) {
   programPath = argv[0];
   int opt;
 
-  while ((opt = getopt(argc, argv, "-p:v")) != -1) {
+  while ((opt = getopt(argc, argv, "-p:va:s:m:t:T:c:")) != -1) {
     switch (opt) {
     case 'p':
       port = std::string(optarg);
       break;
+    case 'a':
+      try {
+        archive_age = static_cast<uint32_t>(std::stoul(optarg));
+      } catch (...) {
+        std::cerr << "Invalid archive age: " << optarg << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
     case 'v':
       verbose = true;
       break;
+    case 'm':
+      metrics_file = std::string(optarg);
+      break;
+    case 't':
+      trace_file = std::string(optarg);
+      break;
+    case 'c':
+      capture_file = std::string(optarg);
+      break;
+    case 'T':
+      try {
+        trace_sample_every = static_cast<uint32_t>(std::stoul(optarg));
+      } catch (...) {
+        trace_sample_every = 0;
+      }
+      if (trace_sample_every == 0) {
+        std::cerr << "Invalid trace sampling: " << optarg << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      storage_engine = std::string(optarg);
+      if (!is_storage_engine(storage_engine)) {
+        std::cerr << "Invalid storage engine: " << optarg << " (expected "
+                  << STORAGE_ENGINE_FILESYSTEM << " or "
+                  << STORAGE_ENGINE_MEMORY << ")" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
 
     default:
       std::cerr << std::endl;
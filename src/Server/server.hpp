@@ -12,14 +12,30 @@ public:
   char *programPath;
   std::string port = DEFAULT_PORT;
   bool verbose = false;
+  uint32_t archive_age = ARCHIVE_MIN_AGE_SECONDS;
+  std::string storage_engine = DEFAULT_STORAGE_ENGINE;
+  // Metrics are written here periodically, if set
+  std::string metrics_file;
+  // Traces are written here when switched off with SIGUSR2, if set
+  std::string trace_file;
+  uint32_t trace_sample_every = TRACE_DEFAULT_SAMPLE_EVERY;
+  // Requests and their replies are captured here, if set
+  std::string capture_file;
   Server(int argc, char *argv[]);
 };
 
 void main_tcp(AuctionServerState &state);
 
+void main_archive(AuctionServerState &state, uint32_t archive_age);
+
+void setup_dump_signal_handlers();
+
+// Writes out metrics, and switches tracing on and off
+void main_metrics(AuctionServerState &state, Server &config);
+
 void wait_for_udp_packet(AuctionServerState &server_state);
 
-void handle_packet(std::stringstream &buffer, Address &addr_from,
+void handle_packet(std::string_view datagram, Address &addr_from,
                    AuctionServerState &server_state);
 
 void wait_for_tcp_packet(AuctionServerState &server_state, WorkerPool &pool);
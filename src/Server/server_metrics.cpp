@@ -0,0 +1,247 @@
+#include "server_metrics.hpp"
+
+#include <cstring>
+
+#include "../common/tracing.hpp"
+
+// A shard is only written by its own thread, so a plain load and store is
+// enough and avoids a locked read-modify-write on every request
+static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+size_t ServerMetrics::packetIndex(PacketId packet_id) {
+  for (size_t i = 0; i + 1 < PACKET_COUNT; ++i) {
+    if (pack_packet_id(PACKET_NAMES[i]) == packet_id) {
+      return i;
+    }
+  }
+  return PACKET_COUNT - 1;
+}
+
+size_t ServerMetrics::statusIndex(const char *status) {
+  for (size_t i = 0; i + 1 < STATUS_COUNT; ++i) {
+    if (std::strcmp(STATUS_NAMES[i], status) == 0) {
+      return i;
+    }
+  }
+  return STATUS_COUNT - 1;
+}
+
+ServerMetrics::Request::Request(ServerMetrics &__metrics, PacketId packet_id)
+    : metrics{__metrics}, packet{packetIndex(packet_id)},
+      status{STATUS_COUNT - 1}, phase_started{Clock::now()} {
+  currentRequest() = this;
+}
+
+ServerMetrics::Request::~Request() {
+  endPhase(PHASE_COUNT);
+  metrics.record(*this);
+  currentRequest() = nullptr;
+}
+
+void ServerMetrics::Request::endPhase(Phase next) {
+  Clock::time_point now = Clock::now();
+  if (phase != PHASE_COUNT) {
+    phase_ns[phase] += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                             phase_started)
+            .count());
+    if (Tracer::tracing()) {
+      Tracer::record(PHASE_NAMES[phase], phase_started, now);
+    }
+  }
+  if (next != PHASE_COUNT) {
+    timed_phases |= 1u << next;
+  }
+  phase = next;
+  phase_started = now;
+}
+
+ServerMetrics::Request *&ServerMetrics::currentRequest() {
+  thread_local Request *current = nullptr;
+  return current;
+}
+
+void ServerMetrics::parsed() {
+  Request *request = currentRequest();
+  if (request != nullptr && request->phase == PARSE) {
+    request->endPhase(HANDLER);
+  }
+}
+
+void ServerMetrics::replying(const char *status) {
+  Request *request = currentRequest();
+  if (request != nullptr && request->phase != SEND &&
+      request->phase != PHASE_COUNT) {
+    request->status = statusIndex(status);
+    request->endPhase(SEND);
+  }
+}
+
+void ServerMetrics::replied() {
+  Request *request = currentRequest();
+  if (request != nullptr && request->phase == SEND) {
+    request->endPhase(PHASE_COUNT);
+  }
+}
+
+size_t ServerMetrics::bucketOf(uint64_t ns) {
+  const uint64_t max = (uint64_t{1} << MAX_LATENCY_BITS) - 1;
+  if (ns > max) {
+    ns = max;
+  }
+  if (ns < (uint64_t{1} << SUB_BUCKET_BITS)) {
+    return static_cast<size_t>(ns);
+  }
+  uint32_t top_bit = 63 - static_cast<uint32_t>(__builtin_clzll(ns));
+  uint64_t sub_bucket = (ns >> (top_bit - SUB_BUCKET_BITS)) &
+                        ((uint64_t{1} << SUB_BUCKET_BITS) - 1);
+  return static_cast<size_t>(
+      ((top_bit - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) | sub_bucket);
+}
+
+uint64_t ServerMetrics::bucketLowerBound(size_t bucket) {
+  if (bucket < (size_t{1} << SUB_BUCKET_BITS)) {
+    return bucket;
+  }
+  uint32_t top_bit =
+      static_cast<uint32_t>(bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+  uint64_t sub_bucket = bucket & ((size_t{1} << SUB_BUCKET_BITS) - 1);
+  return (uint64_t{1} << top_bit) |
+         (sub_bucket << (top_bit - SUB_BUCKET_BITS));
+}
+
+ServerMetrics::Shard &ServerMetrics::localShard() {
+  thread_local ServerMetrics *owner = nullptr;
+  thread_local Shard *shard = nullptr;
+  if (owner != this) {
+    // Value-initialized, so every counter starts at zero
+    std::unique_ptr<Shard> created = std::make_unique<Shard>();
+    shard = created.get();
+    owner = this;
+
+    std::scoped_lock<std::mutex> lock(shards_lock);
+    shards.push_back(std::move(created));
+  }
+  return *shard;
+}
+
+void ServerMetrics::record(Request &request) {
+  Shard &shard = localShard();
+  add(shard.requests[request.packet][request.status], 1);
+  for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+    if ((request.timed_phases & (1u << phase)) == 0) {
+      continue;
+    }
+    uint64_t ns = request.phase_ns[phase];
+    add(shard.buckets[request.packet][phase][bucketOf(ns)], 1);
+    add(shard.sum_ns[request.packet][phase], ns);
+  }
+}
+
+std::chrono::seconds ServerMetrics::uptime() {
+  return std::chrono::duration_cast<std::chrono::seconds>(Clock::now() -
+                                                          started);
+}
+
+void ServerMetrics::requestCounts(
+    uint64_t (&requests)[PACKET_COUNT][STATUS_COUNT]) {
+  std::scoped_lock<std::mutex> lock(shards_lock);
+  for (size_t packet = 0; packet < PACKET_COUNT; ++packet) {
+    for (size_t status = 0; status < STATUS_COUNT; ++status) {
+      requests[packet][status] = 0;
+      for (std::unique_ptr<Shard> &shard : shards) {
+        requests[packet][status] +=
+            shard->requests[packet][status].load(std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+void ServerMetrics::writePrometheus(std::ostream &stream) {
+  // Merge the shards, then write without holding the lock
+  uint64_t requests[PACKET_COUNT][STATUS_COUNT];
+  requestCounts(requests);
+  std::vector<uint64_t> buckets(PACKET_COUNT * PHASE_COUNT * BUCKET_COUNT);
+  uint64_t sum_ns[PACKET_COUNT][PHASE_COUNT] = {};
+  {
+    std::scoped_lock<std::mutex> lock(shards_lock);
+    for (std::unique_ptr<Shard> &shard : shards) {
+      for (size_t packet = 0; packet < PACKET_COUNT; ++packet) {
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+          for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            buckets[(packet * PHASE_COUNT + phase) * BUCKET_COUNT + bucket] +=
+                shard->buckets[packet][phase][bucket].load(
+                    std::memory_order_relaxed);
+          }
+          sum_ns[packet][phase] +=
+              shard->sum_ns[packet][phase].load(std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  stream << "# HELP as_requests_total Requests served, by packet ID and reply "
+            "status.\n"
+         << "# TYPE as_requests_total counter\n";
+  for (size_t packet = 0; packet < PACKET_COUNT; ++packet) {
+    for (size_t status = 0; status < STATUS_COUNT; ++status) {
+      if (requests[packet][status] == 0) {
+        continue;
+      }
+      stream << "as_requests_total{packet=\"" << PACKET_NAMES[packet]
+             << "\",status=\"" << STATUS_NAMES[status] << "\"} "
+             << requests[packet][status] << "\n";
+    }
+  }
+
+  stream << "# HELP as_busy_workers TCP workers serving a connection.\n"
+         << "# TYPE as_busy_workers gauge\n"
+         << "as_busy_workers " << busy_workers.load() << "\n"
+         << "# HELP as_worker_busy_seconds_total Time TCP workers spent "
+            "serving connections.\n"
+         << "# TYPE as_worker_busy_seconds_total counter\n"
+         << "as_worker_busy_seconds_total "
+         << static_cast<double>(worker_busy_ns.load()) / 1e9 << "\n";
+
+  // Prometheus buckets are cumulative; they are exported at every power of
+  // two from about a microsecond to about 17 seconds
+  stream << "# HELP as_request_duration_seconds Time spent parsing, handling "
+            "and replying to requests.\n"
+         << "# TYPE as_request_duration_seconds histogram\n";
+  for (size_t packet = 0; packet < PACKET_COUNT; ++packet) {
+    for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+      const uint64_t *counts =
+          &buckets[(packet * PHASE_COUNT + phase) * BUCKET_COUNT];
+      uint64_t total = 0;
+      for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        total += counts[bucket];
+      }
+      if (total == 0) {
+        continue;
+      }
+
+      std::string labels = std::string("packet=\"") + PACKET_NAMES[packet] +
+                           "\",phase=\"" + PHASE_NAMES[phase] + "\"";
+      uint64_t cumulative = 0;
+      size_t bucket = 0;
+      for (uint32_t bits = 10; bits <= 34; ++bits) {
+        uint64_t bound = uint64_t{1} << bits;
+        while (bucket < BUCKET_COUNT && bucketLowerBound(bucket) < bound) {
+          cumulative += counts[bucket++];
+        }
+        stream << "as_request_duration_seconds_bucket{" << labels << ",le=\""
+               << static_cast<double>(bound) / 1e9 << "\"} " << cumulative
+               << "\n";
+      }
+      stream << "as_request_duration_seconds_bucket{" << labels
+             << ",le=\"+Inf\"} " << total << "\n"
+             << "as_request_duration_seconds_sum{" << labels << "} "
+             << static_cast<double>(sum_ns[packet][phase]) / 1e9 << "\n"
+             << "as_request_duration_seconds_count{" << labels << "} "
+             << total << "\n";
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "../common/protocol.hpp"
+
+// Counts the requests served per packet ID and reply status, and how long
+// their parse, handler and send phases took. Each thread records into its
+// own shard, which only it writes, so recording takes no lock; shards are
+// merged when the metrics are read.
+class ServerMetrics {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  enum Phase { PARSE, HANDLER, SEND, PHASE_COUNT };
+  static constexpr const char *PHASE_NAMES[PHASE_COUNT] = {"parse", "handler",
+                                                           "send"};
+
+  // Requests with any other ID are counted as "other"
+  static constexpr const char *PACKET_NAMES[] = {
+      LoginServerbound::ID,          LogoutServerbound::ID,
+      UnregisterServerbound::ID,     ListMyAuctionsServerbound::ID,
+      MyBidsServerbound::ID,         ListAuctionsServerbound::ID,
+      ListSinceServerbound::ID,      ShowRecordServerbound::ID,
+      OpenAuctionServerbound::ID,    CloseAuctionServerbound::ID,
+      ShowAssetServerbound::ID,      ShowAssetRangeServerbound::ID,
+      BidServerbound::ID,            WatchServerbound::ID,
+      KeepAliveServerbound::ID,      AdminStatsServerbound::ID,
+      "other"};
+  static constexpr size_t PACKET_COUNT = std::size(PACKET_NAMES);
+
+  // Every reply status, plus replies resent from the UDP reply cache and
+  // requests left unanswered (malformed, or their connection dropped)
+  static constexpr const char *STATUS_NAMES[] = {
+      "OK",  "NOK", "REG", "UNR", "NLG", "ERR",    "EAU", "EOW",
+      "END", "ACC", "ILG", "REF", "ALL", "resent", "none"};
+  static constexpr size_t STATUS_COUNT = std::size(STATUS_NAMES);
+  static constexpr const char *RESENT = "resent";
+
+  // Log-linear buckets in nanoseconds: each power of two is split in
+  // 2^SUB_BUCKET_BITS, so a recorded latency is off by at most 25%
+  static constexpr uint32_t SUB_BUCKET_BITS = 2;
+  static constexpr uint32_t MAX_LATENCY_BITS = 36; // About 68 seconds
+  static constexpr size_t BUCKET_COUNT =
+      (MAX_LATENCY_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+  // Times one request on the thread serving it, from when its packet ID
+  // was read until the request is destroyed
+  class Request {
+    ServerMetrics &metrics;
+    size_t packet;
+    size_t status;
+    // PHASE_COUNT once the reply was sent
+    Phase phase = PARSE;
+    unsigned timed_phases = 1u << PARSE;
+    Clock::time_point phase_started;
+    uint64_t phase_ns[PHASE_COUNT] = {0, 0, 0};
+
+    void endPhase(Phase next);
+
+  public:
+    Request(ServerMetrics &__metrics, PacketId packet_id);
+    ~Request();
+    Request(const Request &) = delete;
+    Request &operator=(const Request &) = delete;
+
+    friend class ServerMetrics;
+  };
+
+  // Called while serving a request, to mark where its phases end; they do
+  // nothing on threads that are not timing a request
+  void parsed();
+  void replying(const char *status);
+  template <class Reply> void replying(Reply &reply) {
+    replying(Reply::STATUS_NAMES[reply.status]);
+  }
+  void replied();
+
+  // Set by the worker pool
+  std::atomic<uint32_t> busy_workers{0};
+  std::atomic<uint64_t> worker_busy_ns{0};
+
+  std::chrono::seconds uptime();
+  // Requests served so far, merged from every shard
+  void requestCounts(uint64_t (&requests)[PACKET_COUNT][STATUS_COUNT]);
+
+  // Prometheus text exposition format
+  void writePrometheus(std::ostream &stream);
+
+  // Unknown IDs map to "other", unknown statuses to "none"
+  static size_t packetIndex(PacketId packet_id);
+  static size_t statusIndex(const char *status);
+  static size_t bucketOf(uint64_t ns);
+  // The smallest latency recorded in a bucket
+  static uint64_t bucketLowerBound(size_t bucket);
+
+private:
+  struct Shard {
+    std::atomic<uint64_t> requests[PACKET_COUNT][STATUS_COUNT];
+    std::atomic<uint64_t> buckets[PACKET_COUNT][PHASE_COUNT][BUCKET_COUNT];
+    std::atomic<uint64_t> sum_ns[PACKET_COUNT][PHASE_COUNT];
+  };
+
+  // Shards of every thread that has recorded a request, kept when the
+  // thread exits so its counts are not lost
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::mutex shards_lock;
+  Clock::time_point started = Clock::now();
+
+  Shard &localShard();
+  void record(Request &request);
+  static Request *&currentRequest();
+};
+
+#endif
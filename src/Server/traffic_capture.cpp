@@ -0,0 +1,97 @@
+#include "traffic_capture.hpp"
+
+#include <arpa/inet.h>
+
+#include "../common/constants.hpp"
+#include "../common/exceptions.hpp"
+
+void TrafficCapture::open(const std::string &path) {
+  file.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!file) {
+    throw FileOpenException(path);
+  }
+  file << CAPTURE_FILE_MAGIC << " " << CAPTURE_FORMAT_VERSION << "\n";
+  started = Clock::now();
+  capturing = true;
+}
+
+uint64_t TrafficCapture::newConnection() {
+  return connections.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+uint64_t TrafficCapture::microsecondsSince(Clock::time_point time) {
+  if (time < started) {
+    return 0;
+  }
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(time - started)
+          .count());
+}
+
+void TrafficCapture::writeUdp(Clock::time_point received_at,
+                              const sockaddr_in &client,
+                              std::string_view request,
+                              std::string_view reply) {
+  char address[INET_ADDRSTRLEN] = {0};
+  inet_ntop(AF_INET, &client.sin_addr, address, sizeof(address));
+
+  std::scoped_lock<std::mutex> guard(lock);
+  if (!capturing) {
+    return;
+  }
+  file << "U " << microsecondsSince(received_at) << " " << address << ":"
+       << ntohs(client.sin_port) << " " << request.length() << " "
+       << reply.length() << "\n"
+       << request << reply << "\n";
+}
+
+void TrafficCapture::writeTcp(Clock::time_point received_at,
+                              uint64_t connection,
+                              const TcpTranscript &transcript) {
+  std::scoped_lock<std::mutex> guard(lock);
+  if (!capturing) {
+    return;
+  }
+  file << "T " << microsecondsSince(received_at) << " " << connection << " "
+       << transcript.received.length() << " " << transcript.sent.length()
+       << " " << transcript.asset_offset << " " << transcript.asset_size
+       << " "
+       << (transcript.asset_hash.empty() ? "-" : transcript.asset_hash)
+       << "\n"
+       << transcript.received << transcript.sent << "\n";
+}
+
+void TrafficCapture::close() {
+  std::scoped_lock<std::mutex> guard(lock);
+  if (capturing) {
+    capturing = false;
+    file.close();
+  }
+}
+
+CapturedUdpRequest::CapturedUdpRequest(TrafficCapture &__capture,
+                                       const sockaddr_in &__client,
+                                       std::string_view __request)
+    : capture{__capture}, client{__client}, request{__request},
+      received_at{TrafficCapture::Clock::now()} {}
+
+CapturedUdpRequest::~CapturedUdpRequest() {
+  capture.writeUdp(received_at, client, request, reply);
+}
+
+CapturedTcpRequest::CapturedTcpRequest(TrafficCapture &__capture,
+                                       uint64_t __connection,
+                                       PacketId packet_id)
+    : capture{__capture}, connection{__connection},
+      received_at{TrafficCapture::Clock::now()} {
+  // The packet ID was read before transcribing started
+  transcript.received.push_back(static_cast<char>((packet_id >> 16) & 0xff));
+  transcript.received.push_back(static_cast<char>((packet_id >> 8) & 0xff));
+  transcript.received.push_back(static_cast<char>(packet_id & 0xff));
+  TcpPacket::transcribe(&transcript);
+}
+
+CapturedTcpRequest::~CapturedTcpRequest() {
+  TcpPacket::transcribe(nullptr);
+  capture.writeTcp(received_at, connection, transcript);
+}
@@ -0,0 +1,86 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "../common/protocol.hpp"
+
+// Writes every request the server answers, with its reply and the time it
+// arrived, so asreplay can drive another server with the same traffic.
+// The file starts with a "AS-CAPTURE <version>" line, followed by records
+// of a header line and the raw request and reply bytes:
+//   U <us> <ip:port> <request bytes> <reply bytes>
+//   T <us> <connection> <request bytes> <reply bytes> <asset offset>
+//     <asset size> <asset hash or ->
+// Times are in microseconds since capturing started. TCP requests leave
+// their asset out, to be inserted at its offset, and so do replies.
+class TrafficCapture {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  void open(const std::string &path);
+  bool active() const {
+    return capturing.load(std::memory_order_relaxed);
+  }
+  // Numbers each TCP connection, so replays reuse kept-alive connections
+  uint64_t newConnection();
+  void writeUdp(Clock::time_point received_at, const sockaddr_in &client,
+                std::string_view request, std::string_view reply);
+  void writeTcp(Clock::time_point received_at, uint64_t connection,
+                const TcpTranscript &transcript);
+  void close();
+
+private:
+  std::atomic<bool> capturing{false};
+  std::mutex lock;
+  std::ofstream file;
+  Clock::time_point started;
+  std::atomic<uint64_t> connections{0};
+
+  uint64_t microsecondsSince(Clock::time_point time);
+};
+
+// Keeps the reply to the UDP request served by this thread, and writes both
+// to the capture once destroyed
+class CapturedUdpRequest {
+  TrafficCapture &capture;
+  sockaddr_in client;
+  std::string_view request;
+  TrafficCapture::Clock::time_point received_at;
+
+public:
+  // Set by whoever sends the reply
+  std::string reply;
+
+  CapturedUdpRequest(TrafficCapture &__capture, const sockaddr_in &__client,
+                     std::string_view __request);
+  ~CapturedUdpRequest();
+  CapturedUdpRequest(const CapturedUdpRequest &) = delete;
+  CapturedUdpRequest &operator=(const CapturedUdpRequest &) = delete;
+};
+
+// Transcribes the TCP request served by this thread, and writes it to the
+// capture once destroyed
+class CapturedTcpRequest {
+  TrafficCapture &capture;
+  uint64_t connection;
+  TrafficCapture::Clock::time_point received_at;
+  TcpTranscript transcript;
+
+public:
+  CapturedTcpRequest(TrafficCapture &__capture, uint64_t __connection,
+                     PacketId packet_id);
+  ~CapturedTcpRequest();
+  CapturedTcpRequest(const CapturedTcpRequest &) = delete;
+  CapturedTcpRequest &operator=(const CapturedTcpRequest &) = delete;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "udp_reply_cache.hpp"
+
+bool UdpReplyCache::cachesRepliesTo(PacketId packet_id) {
+  return packet_id == pack_packet_id(LoginServerbound::ID) ||
+         packet_id == pack_packet_id(LogoutServerbound::ID) ||
+         packet_id == pack_packet_id(UnregisterServerbound::ID);
+}
+
+uint64_t UdpReplyCache::clientKey(const struct sockaddr_in &addr) {
+  return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+// FNV-1a
+uint64_t UdpReplyCache::hashRequest(std::string_view request) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (char c : request) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+// Every cached request starts with the ID of the user it is about
+std::string UdpReplyCache::userOf(std::string_view request) {
+  return std::string(request.substr(PACKET_ID_LEN + 1, USER_ID_STR_LEN));
+}
+
+void UdpReplyCache::erase(std::unordered_map<uint64_t, Entry>::iterator entry) {
+  auto clients = clients_by_user.equal_range(entry->second.user_id);
+  for (auto client = clients.first; client != clients.second; ++client) {
+    if (client->second == entry->first) {
+      clients_by_user.erase(client);
+      break;
+    }
+  }
+  entries.erase(entry);
+}
+
+void UdpReplyCache::expire(Clock::time_point now) {
+  auto ttl = std::chrono::seconds(UDP_REPLY_CACHE_TTL_SECONDS);
+  while (!expiry_order.empty() &&
+         (now - expiry_order.front().second >= ttl ||
+          entries.size() > UDP_REPLY_CACHE_MAX_ENTRIES)) {
+    auto [key, stored_at] = expiry_order.front();
+    expiry_order.pop_front();
+    auto entry = entries.find(key);
+    // The client may have sent a newer request since
+    if (entry != entries.end() && entry->second.stored_at == stored_at) {
+      erase(entry);
+    }
+  }
+}
+
+std::optional<std::string> UdpReplyCache::find(const struct sockaddr_in &addr,
+                                               std::string_view request) {
+  std::unique_lock<std::mutex> guard(lock);
+  Clock::time_point now = Clock::now();
+  expire(now);
+
+  auto entry = entries.find(clientKey(addr));
+  if (entry == entries.end() ||
+      entry->second.request_hash != hashRequest(request)) {
+    return std::nullopt;
+  }
+  return entry->second.reply;
+}
+
+void UdpReplyCache::store(const struct sockaddr_in &addr,
+                          std::string_view request, std::string_view reply) {
+  std::unique_lock<std::mutex> guard(lock);
+  Clock::time_point now = Clock::now();
+  uint64_t key = clientKey(addr);
+  std::string user_id = userOf(request);
+
+  // The request was executed, so what other clients were told about the
+  // user may be out of date
+  std::vector<uint64_t> stale;
+  auto clients = clients_by_user.equal_range(user_id);
+  for (auto client = clients.first; client != clients.second; ++client) {
+    stale.push_back(client->second);
+  }
+  stale.push_back(key);
+  for (uint64_t client : stale) {
+    auto entry = entries.find(client);
+    if (entry != entries.end()) {
+      erase(entry);
+    }
+  }
+
+  entries[key] = Entry{hashRequest(request), user_id, std::string(reply), now};
+  clients_by_user.emplace(user_id, key);
+  expiry_order.emplace_back(key, now);
+  expire(now);
+}
+
+void UdpReplyCache::forget(const struct sockaddr_in &addr) {
+  std::unique_lock<std::mutex> guard(lock);
+  if (!entries.empty()) {
+    auto entry = entries.find(clientKey(addr));
+    if (entry != entries.end()) {
+      erase(entry);
+    }
+  }
+}
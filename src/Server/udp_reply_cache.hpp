@@ -0,0 +1,64 @@
+#ifndef UDP_REPLY_CACHE_H
+#define UDP_REPLY_CACHE_H
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/protocol.hpp"
+
+// Remembers the reply to the last state-changing UDP request of each client,
+// so a request resent because its reply was lost is answered again without
+// being executed twice (a resent login would otherwise fail as "already
+// logged in"). Clients wait for a reply before sending their next request,
+// so only their latest request can be resent. Once another client's
+// request about the same user is executed, the reply may no longer hold
+// (the user logged out or unregistered meanwhile), so it is forgotten.
+class UdpReplyCache {
+  typedef std::chrono::steady_clock Clock;
+
+  struct Entry {
+    uint64_t request_hash;
+    std::string user_id;
+    std::string reply;
+    Clock::time_point stored_at;
+  };
+
+  // Clients are keyed by their IPv4 address and port
+  std::unordered_map<uint64_t, Entry> entries;
+  // Clients with an entry, by the user their request was about
+  std::unordered_multimap<std::string, uint64_t> clients_by_user;
+  // Clients in the order their entries were stored, to expire the oldest
+  std::deque<std::pair<uint64_t, Clock::time_point>> expiry_order;
+  std::mutex lock;
+
+  static uint64_t clientKey(const struct sockaddr_in &addr);
+  static uint64_t hashRequest(std::string_view request);
+  static std::string userOf(std::string_view request);
+  void erase(std::unordered_map<uint64_t, Entry>::iterator entry);
+  void expire(Clock::time_point now);
+
+public:
+  // Requests whose replies depend on the state they change
+  static bool cachesRepliesTo(PacketId packet_id);
+
+  // Returns the reply sent to the same request from the same client, if it
+  // was sent recently
+  std::optional<std::string> find(const struct sockaddr_in &addr,
+                                  std::string_view request);
+  void store(const struct sockaddr_in &addr, std::string_view request,
+             std::string_view reply);
+  // Called on any other request, which the client only sends once it got
+  // the reply to its previous one
+  void forget(const struct sockaddr_in &addr);
+};
+
+#endif
@@ -1,24 +1,21 @@
 #include "user_data.hpp"
 
+#include "../common/constants.hpp"
+#include "../common/field_validation.hpp"
+
 UserData::UserData(uint32_t __id, const std::string &__password,
-                   FileManager &__fileManager)
-    : id(__id), password(__password), fileManager(__fileManager) {
+                   StorageEngine &__storage)
+    : id(__id), password(__password), storage(__storage) {
   if (id > USER_ID_MAX) {
     throw UserIdException(std::to_string(id));
   }
-  if (password.length() != 8) {
+  if (password.length() != PASSWORD_LEN || !is_alphanumeric_field(password)) {
     throw UserPasswordException(password);
   }
-
-  for (char c : password) {
-    if (!std::isalnum(c)) {
-      throw UserPasswordException(password);
-    }
-  }
 }
 
-UserData::UserData(uint32_t __id, FileManager &__fileManager)
-    : id(__id), fileManager(__fileManager) {}
+UserData::UserData(uint32_t __id, StorageEngine &__storage)
+    : id(__id), storage(__storage) {}
 
 uint32_t UserData::getId() const { return id; }
 
@@ -31,8 +28,7 @@ std::string UserData::getIdString() const {
 const std::string &UserData::getPassword() const { return password; }
 
 bool UserData::passwordIsCorrect(const std::string &_password) {
-  std::string userPassword =
-      fileManager.getUserPassword(std::to_string(this->id));
+  std::string userPassword = storage.getUserPassword(std::to_string(this->id));
   if (userPassword == _password) {
     return true;
   } else {
@@ -43,59 +39,59 @@ bool UserData::passwordIsCorrect(const std::string &_password) {
 
 void UserData::login() {
 
-  if (fileManager.UserRegistered(std::to_string(this->id))) {
-    if (fileManager.UserLoggedIn(std::to_string(this->id))) {
+  if (storage.UserRegistered(std::to_string(this->id))) {
+    if (storage.UserLoggedIn(std::to_string(this->id))) {
       throw UserAlreadyLoggedInException(std::to_string(this->id));
     } else {
       if (passwordIsCorrect(this->password)) {
-        fileManager.loginUser(std::to_string(this->id));
+        storage.loginUser(std::to_string(this->id));
       } else {
         throw WrongPasswordException(this->password);
       }
     }
   } else {
     registerUser();
-    fileManager.loginUser(std::to_string(this->id));
+    storage.loginUser(std::to_string(this->id));
     throw UserNotRegisteredException(std::to_string(this->id));
   }
 }
 
 void UserData::logout() {
 
-  if (!fileManager.UserRegistered(std::to_string(this->id))) {
+  if (!storage.UserRegistered(std::to_string(this->id))) {
     throw UserNotRegisteredException(std::to_string(this->id));
-  } else if (!fileManager.UserLoggedIn(std::to_string(this->id))) {
+  } else if (!storage.UserLoggedIn(std::to_string(this->id))) {
     throw UserNotLoggedInException(std::to_string(this->id));
   } else {
-    fileManager.logoutUser(std::to_string(this->id));
+    storage.logoutUser(std::to_string(this->id));
   }
 }
 
 void UserData::registerUser() {
 
   std::string idString = std::to_string(id);
-  fileManager.registerUser(idString, password);
+  storage.registerUser(idString, password);
 }
 
 void UserData::unregisterUser() {
 
-  if (!fileManager.UserRegistered(std::to_string(this->id))) {
+  if (!storage.UserRegistered(std::to_string(this->id))) {
     throw UserNotRegisteredException(std::to_string(this->id));
   }
   std::string idString = std::to_string(id);
-  fileManager.unregisterUser(idString);
+  storage.unregisterUser(idString);
 }
 
 void UserData::openAuction(const AuctionData &data,
-                           const std::string &_password) {
+                           const std::string &_password, AssetUpload &asset) {
 
-  if (!fileManager.UserLoggedIn(std::to_string(this->id))) {
+  if (!storage.UserLoggedIn(std::to_string(this->id))) {
     throw UserNotLoggedInException(std::to_string(this->id));
   } else if (!passwordIsCorrect(_password)) {
     throw WrongPasswordException(_password);
   } else {
     std::string idString = std::to_string(this->id);
-    fileManager.openAuction(idString, data);
+    storage.openAuction(idString, data, asset);
   }
 }
 
@@ -106,16 +102,16 @@ void UserData::closeAuction(AuctionData &auction) {
     throw AuctionDoesNotBelongToUserException(auction.getIdString(),
                                               this->getIdString());
   }
-  fileManager.closeAuction(auction);
+  storage.closeAuction(auction);
 }
 
 std::vector<std::pair<uint32_t, bool>>
 UserData::listMyAuctions(const std::string &directory) {
   std::vector<std::pair<uint32_t, bool>> auctions;
-  if (fileManager.UserLoggedIn(std::to_string(this->id))) {
+  if (storage.UserLoggedIn(std::to_string(this->id))) {
     std::string idString = std::to_string(id);
 
-    auctions = fileManager.getUserAuctions(idString, directory);
+    auctions = storage.getUserAuctions(idString, directory);
 
     if (auctions.empty()) {
       throw UserHasNoAuctionsException(idString);
@@ -130,7 +126,7 @@ UserData::listMyAuctions(const std::string &directory) {
 void UserData::bid(AuctionData &auction, uint32_t bidValue,
                    const std::string &_password) {
 
-  if (!fileManager.UserLoggedIn(std::to_string(this->id))) {
+  if (!storage.UserLoggedIn(std::to_string(this->id))) {
     throw UserNotLoggedInException(std::to_string(this->id));
   } else if (!passwordIsCorrect(_password)) {
     throw WrongPasswordException(_password);
@@ -141,7 +137,7 @@ void UserData::bid(AuctionData &auction, uint32_t bidValue,
   } else if (bidValue <= auction.getHighestBidValue()) {
     throw LargerBidAlreadyExistsException(std::to_string(bidValue));
   } else {
-    fileManager.bid(auction, bidValue, this->getIdString());
+    storage.bid(auction, bidValue, this->getIdString());
   }
 }
 
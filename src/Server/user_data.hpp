@@ -4,12 +4,12 @@
 #include <string>
 
 #include "../common/exceptions.hpp"
-#include "../common/file_manager.hpp"
+#include "../common/storage_engine.hpp"
 
 class UserData {
 public:
-  UserData(uint32_t id, const std::string &password, FileManager &fileManager);
-  UserData(uint32_t id, FileManager &fileManager);
+  UserData(uint32_t id, const std::string &password, StorageEngine &storage);
+  UserData(uint32_t id, StorageEngine &storage);
   uint32_t getId() const;
   std::string getIdString() const;
   const std::string &getPassword() const;
@@ -18,7 +18,8 @@ public:
   void registerUser();
   void unregisterUser();
   std::vector<std::pair<uint32_t, bool>> listMyAuctions(const std::string &directory);
-  void openAuction(const AuctionData &data, const std::string &password);
+  void openAuction(const AuctionData &data, const std::string &password,
+                   AssetUpload &asset);
   void closeAuction(AuctionData &auction);
   bool passwordIsCorrect(const std::string &password);
   void bid(AuctionData &auction, uint32_t bidValue,
@@ -27,7 +28,7 @@ public:
 private:
   uint32_t id;
   std::string password;
-  FileManager &fileManager;
+  StorageEngine &storage;
 };
 
 #endif // USERDATA_HPP
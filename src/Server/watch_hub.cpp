@@ -0,0 +1,313 @@
+#include "watch_hub.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+
+#include "../common/common.hpp"
+#include "../common/constants.hpp"
+#include "../common/exceptions.hpp"
+#include "../common/logger.hpp"
+#include "../common/packet_writer.hpp"
+#include "../common/protocol.hpp"
+
+extern bool is_shutting_down;
+
+// How often the hub thread checks for ended auctions and shutdown
+#define WATCH_HUB_TICK_MS (1000)
+
+static std::string serializeEvent(uint32_t auction_id,
+                                  enum WatchEventClientbound::event event,
+                                  uint32_t user_id, uint32_t bid_value) {
+  WatchEventClientbound packet;
+  packet.auction_id = auction_id;
+  packet.event = event;
+  packet.user_id = user_id;
+  packet.bid_value = bid_value;
+
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  packet.serialize(writer);
+  return std::string(writer.data());
+}
+
+WatchHub::WatchHub() {
+  if (pipe(wakeup_pipe) != 0) {
+    throw UnrecoverableError("Failed to create the watch hub pipe", errno);
+  }
+  fcntl(wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+  thread = std::thread(&WatchHub::run, this);
+}
+
+WatchHub::~WatchHub() {
+  {
+    std::scoped_lock<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeUp();
+  thread.join();
+
+  for (auto &[fd, watcher] : watchers) {
+    close(fd);
+  }
+  close(wakeup_pipe[0]);
+  close(wakeup_pipe[1]);
+}
+
+void WatchHub::wakeUp() {
+  char byte = 0;
+  // A full pipe already wakes the thread up
+  if (write(wakeup_pipe[1], &byte, 1) < 0 && errno != EAGAIN) {
+    cerror << "Failed to wake up the watch hub" << std::endl;
+  }
+}
+
+size_t WatchHub::watcherCount() {
+  std::scoped_lock<std::mutex> guard(lock);
+  return watchers.size();
+}
+
+void WatchHub::prepare(const std::vector<uint32_t> &auction_ids) {
+  std::scoped_lock<std::mutex> guard(lock);
+  for (uint32_t auction_id : auction_ids) {
+    auctions[auction_id].pending++;
+  }
+}
+
+void WatchHub::abandon(const std::vector<uint32_t> &auction_ids) {
+  std::scoped_lock<std::mutex> guard(lock);
+  for (uint32_t auction_id : auction_ids) {
+    auto entry = auctions.find(auction_id);
+    if (entry != auctions.end() && entry->second.pending > 0) {
+      entry->second.pending--;
+    }
+  }
+}
+
+void WatchHub::watch(int connection_fd,
+                     const std::vector<AuctionData> &watched) {
+  std::scoped_lock<std::mutex> guard(lock);
+  Watcher &watcher = watchers[connection_fd];
+
+  for (const AuctionData &data : watched) {
+    WatchedAuction &auction = auctions[data.getId()];
+    if (auction.pending > 0) {
+      auction.pending--;
+    }
+    if (!auction.known) {
+      auction.known = true;
+      auction.end_time = data.getStartTime() +
+                         static_cast<std::time_t>(data.getDurationSeconds());
+    }
+    // An end published while the auction was read is kept
+    auction.ended = auction.ended || !data.isActive();
+    // Bids only go up, so the highest one seen is the latest
+    if (data.hasBids() && data.getHighestBidValue() > auction.bid_value) {
+      auction.bidder_user_id = data.getBids().back().bidder_user_id;
+      auction.bid_value = data.getHighestBidValue();
+    }
+
+    if (auction.bid_value > 0) {
+      queue(connection_fd,
+            serializeEvent(data.getId(), WatchEventClientbound::BID,
+                           auction.bidder_user_id, auction.bid_value));
+    }
+    if (auction.ended) {
+      queue(connection_fd,
+            serializeEvent(data.getId(), WatchEventClientbound::END,
+                           auction.bidder_user_id, auction.bid_value));
+    } else {
+      auction.watchers.push_back(connection_fd);
+      watcher.watching++;
+    }
+  }
+
+  wakeUp();
+}
+
+void WatchHub::publishBid(uint32_t auction_id, uint32_t user_id,
+                          uint32_t bid_value) {
+  std::scoped_lock<std::mutex> guard(lock);
+  auto entry = auctions.find(auction_id);
+  if (entry == auctions.end() || entry->second.ended) {
+    return;
+  }
+
+  WatchedAuction &auction = entry->second;
+  // Bids are published once the auction is unlocked, so a lower one may
+  // arrive after a higher one accepted later
+  if (bid_value <= auction.bid_value) {
+    return;
+  }
+  auction.bidder_user_id = user_id;
+  auction.bid_value = bid_value;
+  publish(auction, serializeEvent(auction_id, WatchEventClientbound::BID,
+                                  user_id, bid_value));
+  wakeUp();
+}
+
+void WatchHub::publishEnd(uint32_t auction_id) {
+  std::scoped_lock<std::mutex> guard(lock);
+  auto entry = auctions.find(auction_id);
+  if (entry == auctions.end() || entry->second.ended) {
+    return;
+  }
+  endAuction(auction_id, entry->second);
+  wakeUp();
+}
+
+void WatchHub::queue(int watcher_fd, std::string_view event) {
+  Watcher &watcher = watchers[watcher_fd];
+  if (watcher.outbox.length() + event.length() > WATCH_OUTBOX_MAX_BYTES) {
+    // Disconnected by the hub thread, which owns the connection
+    watcher.watching = 0;
+    watcher.outbox.clear();
+    shutdown(watcher_fd, SHUT_RDWR);
+    return;
+  }
+  watcher.outbox.append(event);
+}
+
+void WatchHub::publish(WatchedAuction &auction, std::string_view event) {
+  for (int watcher_fd : auction.watchers) {
+    queue(watcher_fd, event);
+  }
+}
+
+void WatchHub::endAuction(uint32_t auction_id, WatchedAuction &auction) {
+  auction.ended = true;
+  publish(auction, serializeEvent(auction_id, WatchEventClientbound::END,
+                                  auction.bidder_user_id, auction.bid_value));
+  for (int watcher_fd : auction.watchers) {
+    Watcher &watcher = watchers[watcher_fd];
+    if (watcher.watching > 0) {
+      watcher.watching--;
+    }
+  }
+  auction.watchers.clear();
+}
+
+void WatchHub::expireAuctions() {
+  std::time_t now = std::time(nullptr);
+  for (auto entry = auctions.begin(); entry != auctions.end();) {
+    WatchedAuction &auction = entry->second;
+    if (auction.known && !auction.ended && now >= auction.end_time) {
+      endAuction(entry->first, auction);
+    }
+    // Ended auctions are only kept while someone may still watch them, and
+    // auctions being read only until their watchers register or give up
+    bool abandoned = !auction.known && auction.pending == 0;
+    if (abandoned ||
+        (auction.ended && auction.watchers.empty() && auction.pending == 0)) {
+      entry = auctions.erase(entry);
+    } else {
+      ++entry;
+    }
+  }
+}
+
+void WatchHub::dropWatcher(int watcher_fd) {
+  for (auto &[auction_id, auction] : auctions) {
+    auto &fds = auction.watchers;
+    fds.erase(std::remove(fds.begin(), fds.end(), watcher_fd), fds.end());
+  }
+  watchers.erase(watcher_fd);
+  close(watcher_fd);
+}
+
+void WatchHub::flush(int watcher_fd) {
+  Watcher &watcher = watchers[watcher_fd];
+  while (!watcher.outbox.empty()) {
+    ssize_t sent = send(watcher_fd, watcher.outbox.data(),
+                        watcher.outbox.length(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        watcher.watching = 0;
+        watcher.outbox.clear();
+      }
+      return;
+    }
+    watcher.outbox.erase(0, static_cast<size_t>(sent));
+  }
+}
+
+void WatchHub::run() {
+  std::vector<struct pollfd> fds;
+  while (true) {
+    fds.clear();
+    {
+      std::scoped_lock<std::mutex> guard(lock);
+      if (stopping || is_shutting_down) {
+        return;
+      }
+      fds.push_back({wakeup_pipe[0], POLLIN, 0});
+      for (auto &[fd, watcher] : watchers) {
+        short events = POLLIN;
+        if (!watcher.outbox.empty()) {
+          events |= POLLOUT;
+        }
+        fds.push_back({fd, events, 0});
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), WATCH_HUB_TICK_MS) < 0 &&
+        errno != EINTR) {
+      cerror << "Failed to wait on watchers: " << errno << std::endl;
+    }
+
+    char drained[64];
+    while (read(wakeup_pipe[0], drained, sizeof(drained)) > 0) {
+    }
+
+    std::scoped_lock<std::mutex> guard(lock);
+    expireAuctions();
+    for (size_t i = 1; i < fds.size(); ++i) {
+      int fd = fds[i].fd;
+      if (watchers.find(fd) == watchers.end()) {
+        continue;
+      }
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        // Watchers send nothing after subscribing, so this is them leaving
+        dropWatcher(fd);
+        continue;
+      }
+      flush(fd);
+    }
+
+    // Watchers are let go once all their auctions ended and were told so
+    for (auto entry = watchers.begin(); entry != watchers.end();) {
+      int fd = entry->first;
+      ++entry;
+      if (watchers[fd].watching == 0) {
+        flush(fd);
+        if (watchers[fd].outbox.empty()) {
+          dropWatcher(fd);
+        }
+      }
+    }
+  }
+}
+
+WatchRegistration::WatchRegistration(WatchHub &__hub,
+                                     std::vector<uint32_t> __auction_ids)
+    : hub{__hub}, auction_ids{std::move(__auction_ids)} {
+  hub.prepare(auction_ids);
+}
+
+WatchRegistration::~WatchRegistration() {
+  if (!registered) {
+    hub.abandon(auction_ids);
+  }
+}
+
+void WatchRegistration::complete(int connection_fd,
+                                 const std::vector<AuctionData> &watched) {
+  hub.watch(connection_fd, watched);
+  registered = true;
+}
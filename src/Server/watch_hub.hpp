@@ -0,0 +1,96 @@
+#ifndef WATCH_HUB_H
+#define WATCH_HUB_H
+
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/auction_data.hpp"
+
+// Pushes bid and end events of auctions to the connections watching them.
+// Bid and close handlers publish events as they happen, so watchers never
+// cause storage reads; each event is serialized once, queued on every
+// watcher of the auction, and written out by the hub thread, which also
+// ends auctions when their time runs out and notices when watchers leave.
+class WatchHub {
+  struct Watcher {
+    // Events not yet written to the connection
+    std::string outbox;
+    // Watched auctions that have not ended yet
+    size_t watching = 0;
+  };
+
+  struct WatchedAuction {
+    // Unset until a watcher brings the auction as read from storage
+    bool known = false;
+    std::time_t end_time = 0;
+    bool ended = false;
+    // Watchers reading the auction from storage, whose events are kept
+    // until they are registered
+    size_t pending = 0;
+    uint32_t bidder_user_id = 0;
+    uint32_t bid_value = 0;
+    // Connections watching the auction
+    std::vector<int> watchers;
+  };
+
+  // Keyed by connection
+  std::unordered_map<int, Watcher> watchers;
+  std::unordered_map<uint32_t, WatchedAuction> auctions;
+  std::mutex lock;
+  // Written to when there are new watchers or events, to wake the thread
+  int wakeup_pipe[2] = {-1, -1};
+  bool stopping = false;
+  std::thread thread;
+
+  void wakeUp();
+  void queue(int watcher_fd, std::string_view event);
+  void publish(WatchedAuction &auction, std::string_view event);
+  void endAuction(uint32_t auction_id, WatchedAuction &auction);
+  void expireAuctions();
+  void dropWatcher(int watcher_fd);
+  // Writes what the connection accepts without blocking
+  void flush(int watcher_fd);
+  void run();
+
+public:
+  WatchHub();
+  ~WatchHub();
+  WatchHub(const WatchHub &) = delete;
+  WatchHub &operator=(const WatchHub &) = delete;
+
+  // Starts keeping the events of the auctions, before they are read from
+  // storage for a new watcher, so none is missed in between
+  void prepare(const std::vector<uint32_t> &auction_ids);
+  // Takes ownership of the connection, which is sent the current highest
+  // bid and state of each prepared auction before any new event
+  void watch(int connection_fd, const std::vector<AuctionData> &watched);
+  // Releases prepared auctions that will not be watched
+  void abandon(const std::vector<uint32_t> &auction_ids);
+  void publishBid(uint32_t auction_id, uint32_t user_id, uint32_t bid_value);
+  void publishEnd(uint32_t auction_id);
+  // Connections currently watching auctions
+  size_t watcherCount();
+};
+
+// Prepares the auctions of a watch request, and abandons them unless the
+// connection was handed to the hub
+class WatchRegistration {
+  WatchHub &hub;
+  std::vector<uint32_t> auction_ids;
+  bool registered = false;
+
+public:
+  WatchRegistration(WatchHub &__hub, std::vector<uint32_t> __auction_ids);
+  ~WatchRegistration();
+  WatchRegistration(const WatchRegistration &) = delete;
+  WatchRegistration &operator=(const WatchRegistration &) = delete;
+  void complete(int connection_fd, const std::vector<AuctionData> &watched);
+};
+
+#endif
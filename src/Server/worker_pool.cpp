@@ -1,10 +1,24 @@
 #include "worker_pool.hpp"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <iostream>
+#include <optional>
 
+#include "../common/common.hpp"
+#include "../common/logger.hpp"
 #include "../common/protocol.hpp"
+#include "../common/tracing.hpp"
+
+extern bool is_shutting_down;
+
+// How often the idle thread closes connections left idle for too long, and
+// retries readable ones while no worker is free
+#define IDLE_CONNECTIONS_TICK_MS (1000)
+#define IDLE_CONNECTIONS_RETRY_MS (10)
 
 Worker::Worker() { thread = std::thread(&Worker::execute, this); }
 
@@ -19,42 +33,128 @@ Worker::~Worker() {
 void Worker::execute() {
   while (!shutdown) {
     std::unique_lock<std::mutex> unique_lock(lock);
-    try {
-      while (!to_execute && !shutdown) {
-        cond.wait(unique_lock);
-      }
+    while (!to_execute && !shutdown) {
+      cond.wait(unique_lock);
+    }
 
-      if (shutdown) {
-        return;
+    if (shutdown) {
+      return;
+    }
+
+    ServerMetrics &metrics = pool->server_state.metrics;
+    metrics.busy_workers.fetch_add(1, std::memory_order_relaxed);
+    ServerMetrics::Clock::time_point started = ServerMetrics::Clock::now();
+    bool idle = serveConnection();
+    metrics.worker_busy_ns.fetch_add(
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                ServerMetrics::Clock::now() - started)
+                .count()),
+        std::memory_order_relaxed);
+    metrics.busy_workers.fetch_sub(1, std::memory_order_relaxed);
+
+    if (idle) {
+      pool->server_state.cdebug << "[Worker #" << worker_id
+                                << "] Leaving connection idle..." << std::endl;
+      pool->leaveIdle(tcp_socket_fd, capture_connection);
+    } else {
+      pool->server_state.cdebug << "[Worker #" << worker_id
+                                << "] Closing connection..." << std::endl;
+      close(tcp_socket_fd);
+    }
+    kept_alive = false;
+    to_execute = false;
+    pool->freeWorker(worker_id);
+  }
+}
+
+/* Serves a single request, unless the client asks for keep-alive, in which
+ * case pipelined requests are served in order until none is pending, and
+ * the connection is then handed to the idle thread instead of holding the
+ * worker. Handlers rethrow the errors they do not answer themselves; the
+ * request may then be partly unread, and the rest of it must not be taken
+ * for the next request, so the connection is dropped */
+bool Worker::serveConnection() {
+  AuctionServerState &state = pool->server_state;
+  bool keep_alive = kept_alive;
+  // Outlives the try block, so a malformed request is timed with its reply
+  std::optional<ServerMetrics::Request> request;
+  std::optional<CapturedTcpRequest> captured;
+  if (!kept_alive) {
+    capture_connection =
+        state.capture.active() ? state.capture.newConnection() : 0;
+  }
+  try {
+    do {
+      TraceRequest trace;
+      PacketId packet_id;
+      {
+        TraceSpan span("read_packet_id");
+        packet_id = read_packet_id(tcp_socket_fd);
+      }
+      trace.setName(ServerMetrics::PACKET_NAMES[ServerMetrics::packetIndex(
+          packet_id)]);
+      request.emplace(state.metrics, packet_id);
+      // Watch connections stream events until they close, and are not
+      // replayed
+      if (state.capture.active() &&
+          packet_id != pack_packet_id(WatchServerbound::ID)) {
+        captured.emplace(state.capture, capture_connection, packet_id);
       }
 
-      std::string packet_id = read_packet_id(tcp_socket_fd);
+      if (packet_id == pack_packet_id(KeepAliveServerbound::ID)) {
+        KeepAliveServerbound packet;
+        packet.receive(tcp_socket_fd);
+        state.metrics.parsed();
 
-      pool->server_state.callTcpPacketHandler(packet_id, tcp_socket_fd);
+        ReplyKeepAliveClientbound response;
+        response.status = ReplyKeepAliveClientbound::OK;
+        state.sendTcpReply(response, tcp_socket_fd);
 
-    } catch (InvalidPacketException &e) {
-      try {
-        ErrorTcpPacket error_packet;
-        error_packet.send(tcp_socket_fd);
-      } catch (...) {
-        std::cerr << "Failed to reply with ERR packet" << std::endl;
+        keep_alive = true;
+        state.cdebug << "[Worker #" << worker_id
+                     << "] Keeping connection alive" << std::endl;
+      } else {
+        state.callTcpPacketHandler(packet_id, tcp_socket_fd);
       }
-    } catch (std::exception &e) {
-      std::cerr << "Worker #" << worker_id
-                << " encountered an exception while running: " << e.what()
-                << std::endl;
+      // Idle time between kept-alive requests is not part of either
+      request.reset();
+      captured.reset();
+      if (packet_id == pack_packet_id(WatchServerbound::ID)) {
+        // The connection now streams events from the watch hub
+        return false;
+      }
+    } while (keep_alive && requestIsPending());
+    return keep_alive && !is_shutting_down;
+
+  } catch (InvalidPacketException &e) {
+    try {
+      ErrorTcpPacket error_packet;
+      state.metrics.replying("ERR");
+      error_packet.send(tcp_socket_fd);
+      state.metrics.replied();
     } catch (...) {
-      std::cerr << "Worker #" << worker_id
-                << " encountered an unknown exception while running."
-                << std::endl;
+      cerror << "Failed to reply with ERR packet" << std::endl;
     }
-
-    pool->server_state.cdebug << "[Worker #" << worker_id
-                              << "] Closing connection..." << std::endl;
-    close(tcp_socket_fd);
-    to_execute = false;
-    pool->freeWorker(worker_id);
+  } catch (std::exception &e) {
+    cerror << "Worker #" << worker_id
+           << " encountered an exception while running: " << e.what()
+           << std::endl;
+  } catch (...) {
+    cerror << "Worker #" << worker_id
+           << " encountered an unknown exception while running." << std::endl;
   }
+  return false;
+}
+
+/* Whether the next request, or the client closing the connection, already
+ * arrived */
+bool Worker::requestIsPending() {
+  struct pollfd request;
+  request.fd = tcp_socket_fd;
+  request.events = POLLIN;
+  request.revents = 0;
+  return poll(&request, 1, 0) > 0;
 }
 
 WorkerPool::WorkerPool(AuctionServerState &__server_state)
@@ -64,9 +164,157 @@ WorkerPool::WorkerPool(AuctionServerState &__server_state)
     workers[i].pool = this;
     workers[i].worker_id = i;
   }
+
+  if (pipe(wakeup_pipe) != 0) {
+    throw UnrecoverableError("Failed to create the idle connections pipe",
+                             errno);
+  }
+  fcntl(wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+  idle_thread = std::thread(&WorkerPool::watchIdleConnections, this);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::scoped_lock<std::mutex> guard(idle_lock);
+    stopping = true;
+  }
+  wakeUp();
+  idle_thread.join();
+
+  std::scoped_lock<std::mutex> guard(idle_lock);
+  for (auto &[fd, connection] : idle_connections) {
+    close(fd);
+  }
+  idle_connections.clear();
+  close(wakeup_pipe[0]);
+  close(wakeup_pipe[1]);
+}
+
+void WorkerPool::wakeUp() {
+  char wakeup = 0;
+  if (write(wakeup_pipe[1], &wakeup, 1) < 0 && errno != EAGAIN) {
+    cerror << "Failed to wake up the idle connections thread" << std::endl;
+  }
+}
+
+void WorkerPool::leaveIdle(int connection_fd, uint64_t capture_connection) {
+  {
+    std::scoped_lock<std::mutex> guard(idle_lock);
+    if (stopping) {
+      close(connection_fd);
+      return;
+    }
+    if (idle_connections.size() >= TCP_KEEPALIVE_MAX_IDLE_CONNECTIONS) {
+      auto oldest = idle_connections.end();
+      for (auto entry = idle_connections.begin();
+           entry != idle_connections.end(); ++entry) {
+        if (!entry->second.readable &&
+            (oldest == idle_connections.end() ||
+             entry->second.idle_since < oldest->second.idle_since)) {
+          oldest = entry;
+        }
+      }
+      if (oldest == idle_connections.end()) {
+        close(connection_fd);
+        return;
+      }
+      close(oldest->first);
+      idle_connections.erase(oldest);
+    }
+    idle_connections[connection_fd] = IdleConnection{
+        capture_connection, std::chrono::steady_clock::now(), false};
+  }
+  wakeUp();
+}
+
+/* Hands idle connections back to the workers as requests arrive on them,
+ * and closes them once the client leaves or after TCP_KEEPALIVE_IDLE_SECONDS
+ */
+void WorkerPool::watchIdleConnections() {
+  std::vector<struct pollfd> fds;
+  std::vector<std::pair<int, uint64_t>> readable;
+  while (true) {
+    fds.clear();
+    bool waiting = false;
+    {
+      std::scoped_lock<std::mutex> guard(idle_lock);
+      if (stopping || is_shutting_down) {
+        return;
+      }
+      fds.push_back({wakeup_pipe[0], POLLIN, 0});
+      for (auto &[fd, connection] : idle_connections) {
+        if (connection.readable) {
+          waiting = true;
+        } else {
+          fds.push_back({fd, POLLIN, 0});
+        }
+      }
+    }
+
+    if (poll(fds.data(), fds.size(),
+             waiting ? IDLE_CONNECTIONS_RETRY_MS : IDLE_CONNECTIONS_TICK_MS) <
+            0 &&
+        errno != EINTR) {
+      cerror << "Failed to wait on idle connections: " << errno << std::endl;
+    }
+
+    char drained[64];
+    while (read(wakeup_pipe[0], drained, sizeof(drained)) > 0) {
+    }
+
+    readable.clear();
+    {
+      std::scoped_lock<std::mutex> guard(idle_lock);
+      for (size_t i = 1; i < fds.size(); ++i) {
+        if (fds[i].revents == 0) {
+          continue;
+        }
+        // A readable socket with nothing to read was closed by the client
+        char next;
+        if (recv(fds[i].fd, &next, 1, MSG_PEEK | MSG_DONTWAIT) == 1) {
+          idle_connections[fds[i].fd].readable = true;
+        } else {
+          close(fds[i].fd);
+          idle_connections.erase(fds[i].fd);
+        }
+      }
+
+      std::chrono::steady_clock::time_point now =
+          std::chrono::steady_clock::now();
+      for (auto entry = idle_connections.begin();
+           entry != idle_connections.end();) {
+        if (entry->second.readable) {
+          readable.emplace_back(entry->first, entry->second.capture_connection);
+          entry = idle_connections.erase(entry);
+        } else if (now - entry->second.idle_since >=
+                   std::chrono::seconds(TCP_KEEPALIVE_IDLE_SECONDS)) {
+          close(entry->first);
+          entry = idle_connections.erase(entry);
+        } else {
+          ++entry;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < readable.size(); ++i) {
+      try {
+        delegateConnection(readable[i].first, true, readable[i].second);
+      } catch (NoWorkersAvailableException &e) {
+        // Kept until a worker is free, without being polled meanwhile
+        std::scoped_lock<std::mutex> guard(idle_lock);
+        for (; i < readable.size(); ++i) {
+          idle_connections[readable[i].first] =
+              IdleConnection{readable[i].second,
+                             std::chrono::steady_clock::now(), true};
+        }
+      }
+    }
+  }
 }
 
-void WorkerPool::delegateConnection(int connection_fd) {
+void WorkerPool::delegateConnection(int connection_fd, bool kept_alive,
+                                    uint64_t capture_connection) {
   std::scoped_lock<std::mutex> slock(busy_threads_lock);
 
   for (size_t i = 0; i < TCP_WORKER_POOL_SIZE; ++i) {
@@ -76,6 +324,8 @@ void WorkerPool::delegateConnection(int connection_fd) {
 
       busy_threads[i] = true;
       workers[i].tcp_socket_fd = connection_fd;
+      workers[i].kept_alive = kept_alive;
+      workers[i].capture_connection = capture_connection;
       workers[i].to_execute = true;
 
       workers[i].cond.notify_one();
@@ -95,19 +345,18 @@ void WorkerPool::freeWorker(uint32_t worker_id) {
   }
 }
 
-std::string read_packet_id(int fd) {
-  char id[PACKET_ID_LEN + 1];
+PacketId read_packet_id(int fd) {
+  char id[PACKET_ID_LEN];
   size_t to_read = PACKET_ID_LEN;
 
   while (to_read > 0) {
     ssize_t n = read(fd, &id[PACKET_ID_LEN - to_read], to_read);
     if (n <= 0) {
-      std::cerr << "Received malformated packet ID" << std::endl;
+      cerror << "Received malformated packet ID" << std::endl;
       throw InvalidPacketException();
     }
     to_read -= (size_t)n;
   }
 
-  id[PACKET_ID_LEN] = '\0';
-  return std::string(id);
+  return pack_packet_id(std::string_view(id, PACKET_ID_LEN));
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #ifndef WORKER_POOL_H
 #define WORKER_POOL_H
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "../common/constants.hpp"
 #include "auction_server_state.hpp"
@@ -14,9 +16,15 @@ class Worker {
   std::thread thread;
 
   void execute();
+  // Returns true if the connection is kept alive and left idle
+  bool serveConnection();
+  bool requestIsPending();
 
 public:
   int tcp_socket_fd = -1;
+  // Set for connections coming back from idle after asking for keep-alive
+  bool kept_alive = false;
+  uint64_t capture_connection = 0;
   bool shutdown = false;
   bool to_execute = false;
   WorkerPool *pool;
@@ -28,20 +36,45 @@ public:
   ~Worker();
 };
 
+// Kept-alive connections between requests are watched by the pool's idle
+// thread rather than by a worker, and delegated again once readable
 class WorkerPool {
+  struct IdleConnection {
+    uint64_t capture_connection;
+    std::chrono::steady_clock::time_point idle_since;
+    // Readable, waiting for a worker to be free
+    bool readable = false;
+  };
+
+  // Keyed by connection. Declared before the workers, which may still leave
+  // a connection idle while they are being shut down
+  std::unordered_map<int, IdleConnection> idle_connections;
+  std::mutex idle_lock;
+  // Written to when a connection is left idle, to wake the idle thread
+  int wakeup_pipe[2] = {-1, -1};
+  bool stopping = false;
+  std::thread idle_thread;
+
   Worker workers[TCP_WORKER_POOL_SIZE];
   bool busy_threads[TCP_WORKER_POOL_SIZE];
   std::mutex busy_threads_lock;
 
+  void wakeUp();
+  void watchIdleConnections();
+
 public:
   AuctionServerState &server_state;
 
   WorkerPool(AuctionServerState &__server_state);
-  void delegateConnection(int connection_fd);
+  ~WorkerPool();
+  void delegateConnection(int connection_fd, bool kept_alive = false,
+                          uint64_t capture_connection = 0);
   void freeWorker(uint32_t worker_id);
+  // Takes ownership of a kept-alive connection with no request pending
+  void leaveIdle(int connection_fd, uint64_t capture_connection);
 };
 
-std::string read_packet_id(int fd);
+PacketId read_packet_id(int fd);
 
 class NoWorkersAvailableException : public std::runtime_error {
 public:
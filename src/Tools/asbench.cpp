@@ -0,0 +1,476 @@
+// Microbenchmarks of the protocol hot paths: serializing and deserializing
+// every UDP packet, sending and receiving every TCP packet over a socket
+// pair, and the field formatters and parsers underneath them. Results are
+// printed as JSON, one object per case, in nanoseconds and heap
+// allocations per operation.
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../common/constants.hpp"
+#include "../common/packet_reader.hpp"
+#include "../common/packet_writer.hpp"
+#include "../common/protocol.hpp"
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t size) noexcept {
+  (void)size;
+  std::free(ptr);
+}
+
+// Keeps the compiler from optimizing away a value that is never read
+template <typename T> static void keep(T &&value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct BenchResult {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+class BenchRunner {
+  std::string filter;
+  std::vector<BenchResult> results;
+
+public:
+  explicit BenchRunner(std::string __filter) : filter{std::move(__filter)} {}
+
+  bool selected(const std::string &name) const {
+    return name.find(filter) != std::string::npos;
+  }
+
+  // Runs op in batches of doubling size until a batch takes long enough
+  // to time reliably
+  void run(const std::string &name, const std::function<void()> &op) {
+    if (!selected(name)) {
+      return;
+    }
+    op(); // Warm up caches and lazily allocated state
+    for (uint64_t batch = 1;; batch *= 2) {
+      uint64_t allocations_before = allocations.load();
+      auto start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < batch; ++i) {
+        op();
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed >= std::chrono::milliseconds(BENCH_MIN_DURATION_MS)) {
+        record(name, batch, elapsed, allocations.load() - allocations_before);
+        return;
+      }
+    }
+  }
+
+  void record(const std::string &name, uint64_t iterations,
+              std::chrono::nanoseconds elapsed, uint64_t allocated) {
+    results.push_back(
+        {name, iterations,
+         static_cast<double>(elapsed.count()) / static_cast<double>(iterations),
+         static_cast<double>(allocated) / static_cast<double>(iterations)});
+  }
+
+  void printJson(std::ostream &stream) const {
+    stream << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+      const BenchResult &result = results[i];
+      stream << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+             << "\", \"iterations\": " << result.iterations
+             << ", \"ns_per_op\": " << result.ns_per_op
+             << ", \"allocs_per_op\": " << result.allocs_per_op << "}";
+    }
+    stream << "\n  ]\n}" << std::endl;
+  }
+};
+
+// Replies, and the events pushed to watchers, are the clientbound packets
+static bool is_serverbound(std::string_view id) {
+  return id[0] != 'R' && id != WatchEventClientbound::ID;
+}
+
+// Serializes the packet, then deserializes what was written into a fresh
+// packet of the same type, as a handler would
+template <typename Packet>
+static void bench_udp(BenchRunner &runner, Packet &packet) {
+  char buffer[SOCKET_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  std::string name = std::string("udp/") + Packet::ID;
+
+  runner.run(name + "/serialize", [&] {
+    writer.clear();
+    packet.serialize(writer);
+    keep(buffer);
+  });
+
+  writer.clear();
+  packet.serialize(writer);
+  std::string datagram(writer.data());
+  // Serverbound packets are dispatched on their ID before being read
+  std::string_view body = is_serverbound(Packet::ID)
+                              ? std::string_view(datagram).substr(PACKET_ID_LEN)
+                              : std::string_view(datagram);
+  runner.run(name + "/deserialize", [&] {
+    Packet received;
+    PacketReader reader(body);
+    received.deserialize(reader);
+    keep(received);
+  });
+}
+
+static void read_packet_id(int fd) {
+  char id[PACKET_ID_LEN];
+  size_t done = 0;
+  while (done < PACKET_ID_LEN) {
+    ssize_t n = read(fd, id + done, PACKET_ID_LEN - done);
+    if (n <= 0) {
+      throw IOException();
+    }
+    done += static_cast<size_t>(n);
+  }
+}
+
+// Sends the packet through one end of a socket pair and receives it from
+// the other, in batches small enough for the socket buffer to hold them
+template <typename Packet>
+static void bench_tcp(BenchRunner &runner, Packet &packet,
+                      const std::function<void(Packet &)> &prepare = {}) {
+  constexpr uint64_t BATCH = 16;
+  std::string name = std::string("tcp/") + Packet::ID;
+  if (!runner.selected(name)) {
+    return;
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    throw IOException();
+  }
+
+  std::chrono::nanoseconds send_time{0};
+  std::chrono::nanoseconds receive_time{0};
+  uint64_t send_allocations = 0;
+  uint64_t receive_allocations = 0;
+  uint64_t iterations = 0;
+  while (send_time + receive_time <
+         std::chrono::milliseconds(2 * BENCH_MIN_DURATION_MS)) {
+    uint64_t allocations_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < BATCH; ++i) {
+      packet.send(fds[0]);
+    }
+    auto sent = std::chrono::steady_clock::now();
+    uint64_t allocations_sent = allocations.load();
+    for (uint64_t i = 0; i < BATCH; ++i) {
+      Packet received;
+      if (prepare) {
+        prepare(received);
+      }
+      if (is_serverbound(Packet::ID)) {
+        read_packet_id(fds[1]);
+      }
+      received.receive(fds[1]);
+      keep(received);
+    }
+    auto done = std::chrono::steady_clock::now();
+
+    send_time += sent - start;
+    receive_time += done - sent;
+    send_allocations += allocations_sent - allocations_before;
+    receive_allocations += allocations.load() - allocations_sent;
+    iterations += BATCH;
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  runner.record(name + "/send", iterations, send_time, send_allocations);
+  runner.record(name + "/receive", iterations, receive_time,
+                receive_allocations);
+}
+
+static std::vector<std::pair<uint32_t, bool>> full_auction_list() {
+  std::vector<std::pair<uint32_t, bool>> auctions;
+  for (uint32_t aid = 1; aid <= AUCTION_MAX_NUMBER; ++aid) {
+    auctions.emplace_back(aid, aid % 3 != 0);
+  }
+  return auctions;
+}
+
+static void bench_fields(BenchRunner &runner) {
+  char buffer[SOCKET_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  auto auctions = full_auction_list();
+
+  runner.run("field/writeAuctions/999", [&] {
+    writer.clear();
+    writer.writeAuctions(auctions);
+    keep(buffer);
+  });
+  runner.run("field/writeUserId", [&] {
+    writer.clear();
+    writer.writeUserId(123456);
+    keep(buffer);
+  });
+  runner.run("field/writeDateTime", [&] {
+    writer.clear();
+    writer.writeDateTime(1700000000);
+    keep(buffer);
+  });
+  runner.run("field/parse_packet_user_id", [&] {
+    uint32_t user_id = parse_packet_user_id("123456");
+    keep(user_id);
+  });
+
+  writer.clear();
+  writer.writeAuctions(auctions);
+  // As in a reply, every pair is preceded by a space
+  std::string list = " " + std::string(writer.data()) + "\n";
+  runner.run("field/readAuctions/999", [&] {
+    PacketReader reader(list);
+    auto read = reader.readAuctions();
+    keep(read);
+  });
+}
+
+static void bench_udp_packets(BenchRunner &runner) {
+  auto auctions = full_auction_list();
+
+  LoginServerbound lin;
+  lin.user_id = 123456;
+  lin.password = "password";
+  bench_udp(runner, lin);
+  ReplyLoginClientbound rli;
+  rli.status = ReplyLoginClientbound::status::OK;
+  bench_udp(runner, rli);
+
+  LogoutServerbound lou;
+  lou.user_id = 123456;
+  lou.password = "password";
+  bench_udp(runner, lou);
+  ReplyLogoutClientbound rlo;
+  rlo.status = ReplyLogoutClientbound::status::OK;
+  bench_udp(runner, rlo);
+
+  UnregisterServerbound unr;
+  unr.user_id = 123456;
+  unr.password = "password";
+  bench_udp(runner, unr);
+  ReplyUnregisterClientbound rur;
+  rur.status = ReplyUnregisterClientbound::status::OK;
+  bench_udp(runner, rur);
+
+  ListMyAuctionsServerbound lma;
+  lma.user_id = 123456;
+  bench_udp(runner, lma);
+  ReplyListMyAuctionsClientbound rma;
+  rma.status = ReplyListMyAuctionsClientbound::status::OK;
+  rma.auctions = auctions;
+  bench_udp(runner, rma);
+
+  MyBidsServerbound lmb;
+  lmb.user_id = 123456;
+  bench_udp(runner, lmb);
+  ReplyMyBidsClientbound rmb;
+  rmb.status = ReplyMyBidsClientbound::status::OK;
+  rmb.auctions = auctions;
+  bench_udp(runner, rmb);
+
+  ListAuctionsServerbound lst;
+  bench_udp(runner, lst);
+  ReplyListAuctionsClientbound rls;
+  rls.status = ReplyListAuctionsClientbound::status::OK;
+  rls.auctions = auctions;
+  bench_udp(runner, rls);
+
+  ListSinceServerbound lsc;
+  lsc.epoch = 1234567890;
+  lsc.version = 100000;
+  bench_udp(runner, lsc);
+  ReplyListSinceClientbound rlc;
+  rlc.status = ReplyListSinceClientbound::status::OK;
+  rlc.epoch = 1234567890;
+  rlc.version = 100042;
+  rlc.auctions = {{1, true}, {2, false}, {3, true}};
+  bench_udp(runner, rlc);
+
+  ShowRecordServerbound src;
+  src.auction_id = 42;
+  bench_udp(runner, src);
+
+  // A closed auction with as many bids as a reply can carry
+  std::vector<Bid> bids;
+  for (uint32_t i = 0; i < 50; ++i) {
+    bids.push_back({100000 + i, 1000 + i, "2023-11-14 22:13:20", 60 + i});
+  }
+  ReplyShowRecordClientbound rrc;
+  rrc.status = ReplyShowRecordClientbound::status::OK;
+  rrc.auction = AuctionData(42, 123456, "auction42", 500, 3600, "asset.jpg",
+                            1700000000, "2023-11-14 23:13:20", 3600, bids);
+  bench_udp(runner, rrc);
+
+  ErrorUdpPacket err;
+  runner.run("udp/ERR/serialize", [&] {
+    char buffer[SOCKET_BUFFER_LEN];
+    PacketWriter writer(buffer, sizeof(buffer));
+    err.serialize(writer);
+    keep(buffer);
+  });
+}
+
+static void bench_tcp_packets(BenchRunner &runner,
+                              const std::filesystem::path &asset_path) {
+  auto asset = std::make_shared<const std::string>(BENCH_ASSET_BYTES, 'a');
+  auto into_memory = [](OpenAuctionServerbound &packet) {
+    packet.file_contents = std::make_shared<std::string>();
+  };
+
+  OpenAuctionServerbound opa;
+  opa.user_id = 123456;
+  opa.password = "password";
+  opa.auction_name = "auction42";
+  opa.start_value = 500;
+  opa.time_active = 3600;
+  opa.file_name = "asset.jpg";
+  opa.file_path = asset_path;
+  bench_tcp<OpenAuctionServerbound>(runner, opa, into_memory);
+  ReplyOpenAuctionClientbound roa;
+  roa.status = ReplyOpenAuctionClientbound::status::OK;
+  roa.auction_id = 42;
+  bench_tcp(runner, roa);
+
+  CloseAuctionServerbound cls;
+  cls.user_id = 123456;
+  cls.password = "password";
+  cls.auction_id = 42;
+  bench_tcp(runner, cls);
+  ReplyCloseAuctionClientbound rcl;
+  rcl.status = ReplyCloseAuctionClientbound::status::OK;
+  bench_tcp(runner, rcl);
+
+  ShowAssetServerbound sas;
+  sas.auction_id = 42;
+  bench_tcp(runner, sas);
+  ReplyShowAssetClientbound rsa;
+  rsa.status = ReplyShowAssetClientbound::status::OK;
+  rsa.file_name = "asset.jpg";
+  rsa.file_size = BENCH_ASSET_BYTES;
+  rsa.file_contents = asset;
+  bench_tcp<ReplyShowAssetClientbound>(
+      runner, rsa, [](ReplyShowAssetClientbound &packet) {
+        packet.save_path = "/dev/null";
+        packet.interactive = false;
+      });
+
+  ShowAssetRangeServerbound sar;
+  sar.auction_id = 42;
+  sar.offset = 1024;
+  sar.hash = std::string(64, 'f');
+  bench_tcp(runner, sar);
+  ReplyShowAssetRangeClientbound rsr;
+  rsr.status = ReplyShowAssetRangeClientbound::status::OK;
+  rsr.file_name = "asset.jpg";
+  rsr.file_size = BENCH_ASSET_BYTES;
+  rsr.hash = std::string(64, 'f');
+  rsr.offset = 0;
+  rsr.file_contents = asset;
+  bench_tcp<ReplyShowAssetRangeClientbound>(
+      runner, rsr, [](ReplyShowAssetRangeClientbound &packet) {
+        packet.save_path = "/dev/null";
+        packet.interactive = false;
+      });
+
+  BidServerbound bid;
+  bid.user_id = 123456;
+  bid.password = "password";
+  bid.auction_id = 42;
+  bid.bid_value = 1000;
+  bench_tcp(runner, bid);
+  ReplyBidClientbound rbd;
+  rbd.status = ReplyBidClientbound::status::ACC;
+  bench_tcp(runner, rbd);
+
+  KeepAliveServerbound kal;
+  bench_tcp(runner, kal);
+  ReplyKeepAliveClientbound rka;
+  rka.status = ReplyKeepAliveClientbound::status::OK;
+  bench_tcp(runner, rka);
+
+  WatchServerbound wat;
+  for (uint32_t aid = 1; aid <= WATCH_MAX_AUCTIONS; ++aid) {
+    wat.auction_ids.push_back(aid);
+  }
+  bench_tcp(runner, wat);
+  ReplyWatchClientbound rwa;
+  rwa.status = ReplyWatchClientbound::status::OK;
+  bench_tcp(runner, rwa);
+
+  WatchEventClientbound evt;
+  evt.auction_id = 42;
+  evt.event = WatchEventClientbound::event::BID;
+  evt.user_id = 123456;
+  evt.bid_value = 1000;
+  bench_tcp(runner, evt);
+}
+
+int main(int argc, char *argv[]) {
+  std::string filter;
+  int opt;
+  while ((opt = getopt(argc, argv, "hf:")) != -1) {
+    switch (opt) {
+    case 'f':
+      filter = optarg;
+      break;
+    case 'h':
+    default:
+      std::cerr << "Usage: " << argv[0] << " [-f filter]" << std::endl
+                << "-f filter\tOnly run the cases whose name contains filter."
+                << std::endl;
+      return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  try {
+    // Asset sent by OPA, which only sends from a file
+    std::filesystem::path asset_path =
+        std::filesystem::temp_directory_path() /
+        ("asbench-" + std::to_string(getpid()) + ".bin");
+    {
+      std::ofstream asset(asset_path, std::ios::binary);
+      asset << std::string(BENCH_ASSET_BYTES, 'a');
+    }
+
+    BenchRunner runner(filter);
+    bench_fields(runner);
+    bench_udp_packets(runner);
+    bench_tcp_packets(runner, asset_path);
+    std::filesystem::remove(asset_path);
+
+    runner.printJson(std::cout);
+  } catch (std::exception &e) {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,494 @@
+#include "asload.hpp"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "../common/field_validation.hpp"
+
+extern bool is_shutting_down;
+
+static uint32_t parse_option_value(const char *value, const char *option) {
+  uint32_t result;
+  if (!parse_digits(value, result)) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+static std::vector<std::filesystem::path>
+find_assets(const std::string &assets_dir) {
+  std::vector<std::filesystem::path> assets;
+  std::error_code error;
+  for (auto &entry : std::filesystem::directory_iterator(assets_dir, error)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() && name.length() <= ASSET_NAME_MAX_LENGTH &&
+        is_file_name_field(name) && entry.file_size() <= ASSET_MAX_BYTES) {
+      assets.push_back(entry.path());
+    }
+  }
+  std::sort(assets.begin(), assets.end());
+  return assets;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    setup_signal_handlers();
+
+    LoadConfig config(argc, argv);
+    if (config.help) {
+      config.printHelp(std::cout);
+      return EXIT_SUCCESS;
+    }
+
+    LoadShared shared;
+    shared.assets = find_assets(config.assets_dir);
+    if (shared.assets.empty() && config.mix[OPEN] > 0) {
+      std::cerr << "No assets to open auctions with in " << config.assets_dir
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Bid on the auctions the server already has, not only on new ones
+    {
+      UserState state(config.host, config.port, false);
+      ListAuctionsServerbound packet_out;
+      ReplyListAuctionsClientbound rls;
+      state.sendUdpPacketAndWaitForReply(packet_out, rls);
+      for (auto &auction : rls.auctions) {
+        shared.highest_auction_id =
+            std::max(shared.highest_auction_id.load(), auction.first);
+      }
+    }
+
+    std::vector<std::vector<SimulatedUser>> shares(config.concurrency);
+    for (uint32_t i = 0; i < config.users; ++i) {
+      SimulatedUser user;
+      user.user_id = LOAD_FIRST_USER_ID + i;
+      // User IDs have 6 digits, filling the 8 characters of a password
+      user.password = "pw" + std::to_string(user.user_id);
+      shares[i % config.concurrency].push_back(std::move(user));
+    }
+
+    std::vector<std::unique_ptr<LoadWorker>> workers;
+    for (uint32_t i = 0; i < config.concurrency; ++i) {
+      workers.push_back(std::make_unique<LoadWorker>(
+          config, shared, std::move(shares[i]), std::random_device{}()));
+    }
+
+    std::chrono::nanoseconds interval{0};
+    if (config.rate > 0) {
+      interval = std::chrono::nanoseconds(
+          uint64_t{config.concurrency} * 1000000000 / config.rate);
+    }
+
+    std::cout << "Running " << config.users << " users over "
+              << config.concurrency << " connections for " << config.duration
+              << "s, "
+              << (config.rate > 0 ? std::to_string(config.rate) + " req/s"
+                                  : std::string("closed-loop"))
+              << "..." << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(config.duration);
+    std::vector<std::thread> threads;
+    for (auto &worker : workers) {
+      threads.emplace_back(
+          [&worker, deadline, interval] { worker->run(deadline, interval); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::array<OperationStats, OPERATION_COUNT> stats;
+    for (auto &worker : workers) {
+      for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+        stats[op].latencies.insert(stats[op].latencies.end(),
+                                   worker->stats[op].latencies.begin(),
+                                   worker->stats[op].latencies.end());
+        stats[op].errors += worker->stats[op].errors;
+      }
+    }
+    printReport(std::cout, stats, elapsed);
+
+    if (!is_shutting_down) {
+      for (auto &worker : workers) {
+        worker->logoutAll();
+      }
+    }
+  } catch (std::exception &e) {
+    std::cerr << "Encountered unrecoverable error while running the load "
+                 "generator. Shutting down..."
+              << std::endl
+              << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+LoadConfig::LoadConfig(int argc, char *argv[]) {
+  program_path = argv[0];
+  parseMix(LOAD_DEFAULT_MIX);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hn:p:u:c:r:d:m:a:P:")) != -1) {
+    switch (opt) {
+    case 'n':
+      host = std::string(optarg);
+      break;
+    case 'p':
+      port = std::string(optarg);
+      break;
+    case 'u':
+      users = parse_option_value(optarg, "-u");
+      break;
+    case 'c':
+      concurrency = parse_option_value(optarg, "-c");
+      break;
+    case 'r':
+      rate = parse_option_value(optarg, "-r");
+      break;
+    case 'd':
+      duration = parse_option_value(optarg, "-d");
+      break;
+    case 'm':
+      mix.fill(0);
+      parseMix(optarg);
+      break;
+    case 'a':
+      assets_dir = std::string(optarg);
+      break;
+    case 'P':
+      pipeline_depth = std::max(parse_option_value(optarg, "-P"), 1u);
+      break;
+    case 'h':
+      help = true;
+      break;
+    default:
+      std::cerr << std::endl;
+      printHelp(std::cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  validate_port_number(port);
+  if (users == 0 || users > USER_ID_MAX - LOAD_FIRST_USER_ID + 1) {
+    std::cerr << "The number of users must be between 1 and "
+              << USER_ID_MAX - LOAD_FIRST_USER_ID + 1 << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  concurrency = std::clamp(concurrency, 1u, users);
+}
+
+// Reads "operation=weight" pairs separated by commas
+void LoadConfig::parseMix(const std::string &spec) {
+  std::istringstream iss(spec);
+  std::string entry;
+  while (std::getline(iss, entry, ',')) {
+    size_t equals = entry.find('=');
+    std::string name = entry.substr(0, equals);
+    auto found = std::find_if(
+        std::begin(OPERATION_NAMES), std::end(OPERATION_NAMES),
+        [&name](const char *operation) { return name == operation; });
+    if (equals == std::string::npos || found == std::end(OPERATION_NAMES)) {
+      std::cerr << "Invalid operation mix entry: " << entry << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    mix[static_cast<size_t>(found - std::begin(OPERATION_NAMES))] =
+        parse_option_value(entry.c_str() + equals + 1, "-m");
+  }
+  if (std::all_of(mix.begin(), mix.end(), [](uint32_t w) { return w == 0; })) {
+    std::cerr << "The operation mix must give some operation a weight"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void LoadConfig::printHelp(std::ostream &stream) {
+  stream << "Usage: " << program_path
+         << " [-n ASIP] [-p ASport] [-u users] [-c connections] [-r rate] "
+            "[-d seconds] [-m mix] [-a assets] [-P depth]"
+         << std::endl;
+  stream << "Available options:" << std::endl;
+  stream << "-n ASIP\t\tSet hostname of Auction Server. Default: "
+         << DEFAULT_HOSTNAME << std::endl;
+  stream << "-p ASport\tSet port of Auction Server. Default: " << DEFAULT_PORT
+         << std::endl;
+  stream << "-u users\tNumber of simulated users. Default: "
+         << LOAD_DEFAULT_USERS << std::endl;
+  stream << "-c connections\tNumber of users making requests at once. "
+            "Default: "
+         << LOAD_DEFAULT_CONCURRENCY << std::endl;
+  stream << "-r rate\t\tTarget requests per second. Default: as fast as the "
+            "server answers"
+         << std::endl;
+  stream << "-d seconds\tHow long to run. Default: "
+         << LOAD_DEFAULT_DURATION_SECONDS << std::endl;
+  stream << "-m mix\t\tOperation weights. Default: " << LOAD_DEFAULT_MIX
+         << std::endl;
+  stream << "-a assets\tDirectory of the assets auctions are opened with. "
+            "Default: "
+         << ASSETS_RELATIVE_DIRERCTORY << std::endl;
+  stream << "-P depth\tPipeline this many bids per bid operation on a "
+            "kept-alive connection, each counted with the latency of the "
+            "batch. Default: 1"
+         << std::endl;
+  stream << "-h\t\tPrint this menu." << std::endl;
+}
+
+LoadWorker::LoadWorker(LoadConfig &config, LoadShared &__shared,
+                       std::vector<SimulatedUser> __users, uint32_t seed)
+    : connection{config.host, config.port, config.pipeline_depth > 1},
+      users{std::move(__users)}, shared{__shared}, random{seed},
+      pick_operation{config.mix.begin(), config.mix.end()},
+      pipeline_depth{config.pipeline_depth} {}
+
+void LoadWorker::run(std::chrono::steady_clock::time_point deadline,
+                     std::chrono::nanoseconds interval) {
+  auto due = std::chrono::steady_clock::now();
+  while (!is_shutting_down && due < deadline) {
+    if (interval.count() > 0) {
+      std::this_thread::sleep_until(due);
+    } else {
+      due = std::chrono::steady_clock::now();
+    }
+
+    Operation operation = static_cast<Operation>(pick_operation(random));
+    bool ok = perform(operation, pickUser());
+
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - due);
+    stats[operation].latencies.insert(
+        stats[operation].latencies.end(),
+        operation == BID ? pipeline_depth : 1,
+        static_cast<uint32_t>(latency.count()));
+    if (!ok) {
+      stats[operation].errors++;
+    }
+    due += interval;
+  }
+}
+
+void LoadWorker::logoutAll() {
+  for (auto &user : users) {
+    if (user.logged_in) {
+      logout(user);
+    }
+  }
+}
+
+SimulatedUser &LoadWorker::pickUser() {
+  std::uniform_int_distribution<size_t> pick(0, users.size() - 1);
+  return users[pick(random)];
+}
+
+uint32_t LoadWorker::pickAuction() {
+  uint32_t highest = std::max(shared.highest_auction_id.load(), 1u);
+  std::uniform_int_distribution<uint32_t> pick(1, highest);
+  return pick(random);
+}
+
+bool LoadWorker::perform(Operation operation, SimulatedUser &user) {
+  try {
+    switch (operation) {
+    case LOGIN:
+      // Users come and go: a logged in user logs out instead
+      return user.logged_in ? logout(user) : login(user);
+    case LIST:
+      return list();
+    case SHOW_RECORD:
+      return showRecord();
+    case BID:
+      return ensureLoggedIn(user) && bid(user);
+    case OPEN:
+      return ensureLoggedIn(user) && open(user);
+    case SHOW_ASSET:
+      return showAsset();
+    case CLOSE:
+      return ensureLoggedIn(user) && close(user);
+    case OPERATION_COUNT:
+    default:
+      return false;
+    }
+  } catch (std::exception &) {
+    return false;
+  }
+}
+
+bool LoadWorker::ensureLoggedIn(SimulatedUser &user) {
+  return user.logged_in || login(user);
+}
+
+bool LoadWorker::login(SimulatedUser &user) {
+  LoginServerbound packet_out;
+  packet_out.user_id = user.user_id;
+  packet_out.password = user.password;
+  ReplyLoginClientbound rli;
+  connection.sendUdpPacketAndWaitForReply(packet_out, rli);
+  user.logged_in = rli.status == ReplyLoginClientbound::status::OK ||
+                   rli.status == ReplyLoginClientbound::status::REG;
+  return user.logged_in;
+}
+
+bool LoadWorker::logout(SimulatedUser &user) {
+  LogoutServerbound packet_out;
+  packet_out.user_id = user.user_id;
+  packet_out.password = user.password;
+  ReplyLogoutClientbound rlo;
+  connection.sendUdpPacketAndWaitForReply(packet_out, rlo);
+  user.logged_in = false;
+  return rlo.status == ReplyLogoutClientbound::status::OK;
+}
+
+bool LoadWorker::list() {
+  ListAuctionsServerbound packet_out;
+  ReplyListAuctionsClientbound rls;
+  connection.sendUdpPacketAndWaitForReply(packet_out, rls);
+  for (auto &auction : rls.auctions) {
+    uint32_t highest = shared.highest_auction_id.load();
+    while (auction.first > highest &&
+           !shared.highest_auction_id.compare_exchange_weak(highest,
+                                                            auction.first)) {
+    }
+  }
+  return rls.status != ReplyListAuctionsClientbound::status::ERR;
+}
+
+bool LoadWorker::showRecord() {
+  ShowRecordServerbound packet_out;
+  packet_out.auction_id = pickAuction();
+  ReplyShowRecordClientbound rrc;
+  connection.sendUdpPacketAndWaitForReply(packet_out, rrc);
+  return rrc.status != ReplyShowRecordClientbound::status::ERR;
+}
+
+bool LoadWorker::bid(SimulatedUser &user) {
+  std::vector<BidServerbound> packets_out(pipeline_depth);
+  std::vector<ReplyBidClientbound> replies(pipeline_depth);
+  std::vector<TcpPacket *> out, in;
+  for (uint32_t i = 0; i < pipeline_depth; ++i) {
+    packets_out[i].user_id = user.user_id;
+    packets_out[i].password = user.password;
+    packets_out[i].auction_id = pickAuction();
+    // Ever higher bids, so most of them are accepted
+    packets_out[i].bid_value = shared.next_bid_value++ % BID_MAX_VALUE + 1;
+    out.push_back(&packets_out[i]);
+    in.push_back(&replies[i]);
+  }
+  connection.sendTcpPacketsAndWaitForReplies(out, in);
+  return std::all_of(replies.begin(), replies.end(),
+                     [](ReplyBidClientbound &rbd) {
+                       return rbd.status != ReplyBidClientbound::status::ERR &&
+                              rbd.status != ReplyBidClientbound::status::NLG;
+                     });
+}
+
+bool LoadWorker::open(SimulatedUser &user) {
+  std::uniform_int_distribution<size_t> pick_asset(0,
+                                                   shared.assets.size() - 1);
+  OpenAuctionServerbound packet_out;
+  packet_out.user_id = user.user_id;
+  packet_out.password = user.password;
+  packet_out.auction_name = "load" + std::to_string(user.user_id);
+  packet_out.start_value =
+      std::uniform_int_distribution<uint32_t>(1, 999)(random);
+  packet_out.time_active = LOAD_AUCTION_DURATION_SECONDS;
+  packet_out.file_path = shared.assets[pick_asset(random)];
+  packet_out.file_name = packet_out.file_path.filename().string();
+  ReplyOpenAuctionClientbound roa;
+  connection.sendTcpPacketAndWaitForReply(packet_out, roa);
+  if (roa.status == ReplyOpenAuctionClientbound::status::OK) {
+    user.hosted_auctions.push_back(roa.auction_id);
+    uint32_t highest = shared.highest_auction_id.load();
+    while (roa.auction_id > highest &&
+           !shared.highest_auction_id.compare_exchange_weak(highest,
+                                                            roa.auction_id)) {
+    }
+  }
+  // NOK once the server holds as many auctions as it can
+  return roa.status == ReplyOpenAuctionClientbound::status::OK ||
+         roa.status == ReplyOpenAuctionClientbound::status::NOK;
+}
+
+bool LoadWorker::showAsset() {
+  ShowAssetRangeServerbound packet_out;
+  packet_out.auction_id = pickAuction();
+  ReplyShowAssetRangeClientbound rsr;
+  rsr.save_path = "/dev/null";
+  rsr.interactive = false;
+  connection.sendTcpPacketAndWaitForReply(packet_out, rsr);
+  return rsr.status != ReplyShowAssetRangeClientbound::status::ERR;
+}
+
+bool LoadWorker::close(SimulatedUser &user) {
+  CloseAuctionServerbound packet_out;
+  packet_out.user_id = user.user_id;
+  packet_out.password = user.password;
+  if (user.hosted_auctions.empty()) {
+    // The server refuses, but still has to look the auction up
+    packet_out.auction_id = pickAuction();
+  } else {
+    packet_out.auction_id = user.hosted_auctions.back();
+    user.hosted_auctions.pop_back();
+  }
+  ReplyCloseAuctionClientbound rcl;
+  connection.sendTcpPacketAndWaitForReply(packet_out, rcl);
+  return rcl.status != ReplyCloseAuctionClientbound::status::ERR &&
+         rcl.status != ReplyCloseAuctionClientbound::status::NLG;
+}
+
+// Nearest-rank percentile of sorted latencies
+static double percentile_ms(const std::vector<uint32_t> &sorted,
+                            double percent) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(
+      std::ceil(percent / 100 * static_cast<double>(sorted.size())));
+  return sorted[std::clamp(rank, size_t{1}, sorted.size()) - 1] / 1000.0;
+}
+
+void printReport(std::ostream &stream,
+                 std::array<OperationStats, OPERATION_COUNT> &stats,
+                 double elapsed_seconds) {
+  stream << std::left << std::setw(12) << "operation" << std::right
+         << std::setw(10) << "requests" << std::setw(8) << "errors"
+         << std::setw(10) << "req/s" << std::setw(10) << "p50 ms"
+         << std::setw(10) << "p99 ms" << std::setw(10) << "p999 ms"
+         << std::endl;
+
+  OperationStats total;
+  auto printRow = [&](const char *name, OperationStats &row) {
+    std::sort(row.latencies.begin(), row.latencies.end());
+    stream << std::left << std::setw(12) << name << std::right
+           << std::setw(10) << row.latencies.size() << std::setw(8)
+           << row.errors << std::fixed << std::setprecision(1)
+           << std::setw(10)
+           << static_cast<double>(row.latencies.size()) / elapsed_seconds
+           << std::setprecision(2) << std::setw(10)
+           << percentile_ms(row.latencies, 50) << std::setw(10)
+           << percentile_ms(row.latencies, 99) << std::setw(10)
+           << percentile_ms(row.latencies, 99.9) << std::endl;
+  };
+
+  for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+    if (stats[op].latencies.empty()) {
+      continue;
+    }
+    total.latencies.insert(total.latencies.end(), stats[op].latencies.begin(),
+                           stats[op].latencies.end());
+    total.errors += stats[op].errors;
+    printRow(OPERATION_NAMES[op], stats[op]);
+  }
+  printRow("total", total);
+}
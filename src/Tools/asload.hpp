@@ -0,0 +1,114 @@
+#ifndef ASLOAD_H
+#define ASLOAD_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Client/user_state.hpp"
+#include "../common/constants.hpp"
+
+enum Operation {
+  LOGIN,
+  LIST,
+  SHOW_RECORD,
+  BID,
+  OPEN,
+  SHOW_ASSET,
+  CLOSE,
+  OPERATION_COUNT
+};
+
+static constexpr const char *OPERATION_NAMES[OPERATION_COUNT] = {
+    "login", "list", "show_record", "bid", "open", "show_asset", "close"};
+
+class LoadConfig {
+public:
+  char *program_path;
+  std::string host = DEFAULT_HOSTNAME;
+  std::string port = DEFAULT_PORT;
+  uint32_t users = LOAD_DEFAULT_USERS;
+  uint32_t concurrency = LOAD_DEFAULT_CONCURRENCY;
+  // Requests per second over all workers; 0 runs closed-loop
+  uint32_t rate = 0;
+  uint32_t duration = LOAD_DEFAULT_DURATION_SECONDS;
+  std::string assets_dir = ASSETS_RELATIVE_DIRERCTORY;
+  std::array<uint32_t, OPERATION_COUNT> mix{};
+  // Bids sent back to back on a kept-alive connection by each bid operation
+  uint32_t pipeline_depth = 1;
+  bool help = false;
+
+  LoadConfig(int argc, char *argv[]);
+  void printHelp(std::ostream &stream);
+  void parseMix(const std::string &spec);
+};
+
+struct SimulatedUser {
+  uint32_t user_id;
+  std::string password;
+  bool logged_in = false;
+  // Open auctions hosted by this user, closed by the close operation
+  std::vector<uint32_t> hosted_auctions;
+};
+
+// Latencies in microseconds, and how many of the requests failed
+struct OperationStats {
+  std::vector<uint32_t> latencies;
+  uint64_t errors = 0;
+};
+
+// State shared by every worker
+struct LoadShared {
+  std::vector<std::filesystem::path> assets;
+  std::atomic<uint32_t> highest_auction_id{0};
+  std::atomic<uint32_t> next_bid_value{1};
+};
+
+// Drives its share of the simulated users over its own sockets, one
+// request at a time
+class LoadWorker {
+  UserState connection;
+  std::vector<SimulatedUser> users;
+  LoadShared &shared;
+  std::mt19937 random;
+  std::discrete_distribution<int> pick_operation;
+  uint32_t pipeline_depth;
+
+  SimulatedUser &pickUser();
+  uint32_t pickAuction();
+  // Returns false if the request failed
+  bool perform(Operation operation, SimulatedUser &user);
+  bool ensureLoggedIn(SimulatedUser &user);
+  bool login(SimulatedUser &user);
+  bool logout(SimulatedUser &user);
+  bool list();
+  bool showRecord();
+  bool bid(SimulatedUser &user);
+  bool open(SimulatedUser &user);
+  bool showAsset();
+  bool close(SimulatedUser &user);
+
+public:
+  std::array<OperationStats, OPERATION_COUNT> stats;
+
+  LoadWorker(LoadConfig &config, LoadShared &__shared,
+             std::vector<SimulatedUser> __users, uint32_t seed);
+  // Paces requests interval apart if it is not zero; latency is then
+  // measured from when each request was due, so a server that falls
+  // behind is not hidden by the requests it delayed
+  void run(std::chrono::steady_clock::time_point deadline,
+           std::chrono::nanoseconds interval);
+  // Logs out the users left logged in
+  void logoutAll();
+};
+
+void printReport(std::ostream &stream,
+                 std::array<OperationStats, OPERATION_COUNT> &stats,
+                 double elapsed_seconds);
+
+#endif
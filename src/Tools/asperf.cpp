@@ -0,0 +1,1111 @@
+// Performance regression check: replays the client scripts in SCRIPTS/ as
+// many copies of their users at once against a server, optionally started
+// from a scratch directory, and compares the throughput and latencies with
+// a baseline recorded on the same machine
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../Client/user_state.hpp"
+#include "../common/constants.hpp"
+#include "../common/field_validation.hpp"
+
+extern bool is_shutting_down;
+
+typedef std::chrono::steady_clock Clock;
+
+enum Command {
+  LOGIN,
+  LOGOUT,
+  UNREGISTER,
+  OPEN,
+  CLOSE,
+  MY_AUCTIONS,
+  MY_BIDS,
+  LIST,
+  SHOW_ASSET,
+  BID,
+  SHOW_RECORD,
+  COMMAND_COUNT
+};
+
+static constexpr const char *COMMAND_NAMES[COMMAND_COUNT] = {
+    "login",      "logout", "unregister", "open", "close",      "myauctions",
+    "mybids",     "list",   "show_asset", "bid",  "show_record"};
+
+// Short forms the client accepts, by command
+static const std::map<std::string, Command> COMMAND_ALIASES = {
+    {"ma", MY_AUCTIONS}, {"mb", MY_BIDS}, {"l", LIST},
+    {"sa", SHOW_ASSET},  {"b", BID},      {"sr", SHOW_RECORD}};
+
+class PerfConfig {
+public:
+  char *program_path;
+  std::string host = DEFAULT_HOSTNAME;
+  std::string port = PERF_DEFAULT_PORT;
+  std::string scripts_dir = PERF_SCRIPTS_DIR;
+  std::string assets_dir = ASSETS_RELATIVE_DIRERCTORY;
+  uint32_t copies = PERF_DEFAULT_COPIES;
+  uint32_t concurrency = PERF_DEFAULT_CONCURRENCY;
+  uint32_t rounds = PERF_DEFAULT_ROUNDS;
+  // Server to start from a scratch directory, if set
+  std::string server_path;
+  // Without the disk, runs vary much less
+  std::string engine = "memory";
+  // Baseline to compare with, and file to record the run as a baseline to
+  std::string baseline_file;
+  std::string record_file;
+  uint32_t tolerance_percent = PERF_DEFAULT_TOLERANCE_PERCENT;
+  bool help = false;
+
+  PerfConfig(int argc, char *argv[]);
+  void printHelp(std::ostream &stream);
+};
+
+// A command of a script, with the user and auction IDs as in the script
+struct ScriptStep {
+  Command command;
+  uint32_t user_id = 0;
+  std::string password;
+  uint32_t auction_id = 0;
+  uint32_t value = 0;
+  std::string auction_name;
+  std::filesystem::path asset;
+  uint32_t duration = 0;
+};
+
+struct Scenario {
+  std::string name;
+  std::vector<ScriptStep> steps;
+};
+
+struct Workload {
+  std::vector<Scenario> scenarios;
+  // Position of each user ID of the scripts, each copy having its own users
+  std::map<uint32_t, uint32_t> script_users;
+  size_t steps = 0;
+  // Auctions each copy may open, so that all copies fit in the server
+  uint32_t opens_per_copy = 0;
+};
+
+// The state of the client running a script of a copy
+struct Session {
+  uint32_t user_id = 0;
+  std::string password;
+  bool logged_in = false;
+  // Auctions opened by the copy, standing in for the IDs in the scripts,
+  // which count the auctions opened by the scripts before them
+  std::vector<uint32_t> opened;
+};
+
+// Latencies in microseconds, and how many of the requests failed
+struct CommandStats {
+  std::vector<uint32_t> latencies;
+  uint64_t errors = 0;
+};
+
+// Runs copies of the scripts, one at a time, over its own sockets
+class PerfWorker {
+  PerfConfig &config;
+  const Workload &workload;
+  UserState connection;
+
+  void runCopy(uint32_t copy);
+  void perform(const ScriptStep &step, Session &session, uint32_t copy);
+  uint32_t auctionOf(const ScriptStep &step, const Session &session);
+  void record(Command command, Clock::time_point start, bool ok);
+  template <class Reply>
+  bool sendUdp(Command command, UdpPacket &packet_out, Reply &reply);
+  template <class Reply>
+  bool sendTcp(Command command, TcpPacket &packet_out, Reply &reply);
+
+public:
+  std::array<CommandStats, COMMAND_COUNT> stats;
+  // Open commands left out once the copy used up its auctions
+  uint64_t skipped_opens = 0;
+
+  PerfWorker(PerfConfig &__config, const Workload &__workload);
+  void run(std::atomic<uint32_t> &next_copy);
+};
+
+struct CommandReport {
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  double p50_ms = 0;
+  double p99_ms = 0;
+};
+
+struct PerfReport {
+  std::string engine;
+  uint32_t copies = 0;
+  uint32_t concurrency = 0;
+  uint32_t rounds = 0;
+  size_t steps = 0;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t skipped_opens = 0;
+  double seconds = 0;
+  double throughput_rps = 0;
+  double p50_ms = 0;
+  double p99_ms = 0;
+  double p999_ms = 0;
+  std::map<std::string, CommandReport> commands;
+
+  void writeJson(std::ostream &stream);
+};
+
+// Runs the server from a new directory under /tmp, as its data is kept
+// relative to the working directory, and removes it once stopped
+class ScratchServer {
+  pid_t pid = -1;
+  std::filesystem::path directory;
+
+public:
+  ScratchServer(const std::string &server_path, const std::string &port,
+                const std::string &engine);
+  ~ScratchServer();
+  ScratchServer(const ScratchServer &) = delete;
+  ScratchServer &operator=(const ScratchServer &) = delete;
+  void stop();
+};
+
+static uint32_t parse_option_value(const char *value, const char *option) {
+  uint32_t result;
+  if (!parse_digits(value, result)) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+PerfConfig::PerfConfig(int argc, char *argv[]) {
+  program_path = argv[0];
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hn:p:d:a:u:c:r:x:e:b:w:t:")) != -1) {
+    switch (opt) {
+    case 'n':
+      host = std::string(optarg);
+      break;
+    case 'p':
+      port = std::string(optarg);
+      break;
+    case 'd':
+      scripts_dir = std::string(optarg);
+      break;
+    case 'a':
+      assets_dir = std::string(optarg);
+      break;
+    case 'u':
+      copies = std::max(parse_option_value(optarg, "-u"), 1u);
+      break;
+    case 'c':
+      concurrency = std::max(parse_option_value(optarg, "-c"), 1u);
+      break;
+    case 'r':
+      rounds = std::max(parse_option_value(optarg, "-r"), 1u);
+      break;
+    case 'x':
+      server_path = std::string(optarg);
+      break;
+    case 'e':
+      engine = std::string(optarg);
+      break;
+    case 'b':
+      baseline_file = std::string(optarg);
+      break;
+    case 'w':
+      record_file = std::string(optarg);
+      break;
+    case 't':
+      tolerance_percent = parse_option_value(optarg, "-t");
+      break;
+    case 'h':
+      help = true;
+      break;
+    default:
+      std::cerr << std::endl;
+      printHelp(std::cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  validate_port_number(port);
+  concurrency = std::min(concurrency, copies);
+  if (!server_path.empty()) {
+    host = "127.0.0.1";
+  }
+}
+
+void PerfConfig::printHelp(std::ostream &stream) {
+  stream << "Usage: " << program_path
+         << " [-x AS] [-n ASIP] [-p ASport] [-d scripts] [-a assets] "
+            "[-u copies] [-c concurrency] [-r rounds] [-e engine] "
+            "[-b baseline] "
+            "[-w baseline] [-t percent]"
+         << std::endl;
+  stream << "Available options:" << std::endl;
+  stream << "-x AS\t\tStart this server on a scratch directory and the "
+            "loopback interface, instead of using a running one."
+         << std::endl;
+  stream << "-n ASIP\t\tSet hostname of Auction Server. Default: "
+         << DEFAULT_HOSTNAME << std::endl;
+  stream << "-p ASport\tSet port of Auction Server. Default: "
+         << PERF_DEFAULT_PORT << std::endl;
+  stream << "-d scripts\tDirectory of the client scripts to replay. Default: "
+         << PERF_SCRIPTS_DIR << std::endl;
+  stream << "-a assets\tDirectory of the assets the scripts open auctions "
+            "with. Default: "
+         << ASSETS_RELATIVE_DIRERCTORY << std::endl;
+  stream << "-u copies\tNumber of copies of the users of the scripts. "
+            "Default: "
+         << PERF_DEFAULT_COPIES << std::endl;
+  stream << "-c concurrency\tNumber of copies running at once. Default: "
+         << PERF_DEFAULT_CONCURRENCY << std::endl;
+  stream << "-r rounds\tReport the median of this many runs, each on a "
+            "fresh server if started with -x. Default: "
+         << PERF_DEFAULT_ROUNDS << std::endl;
+  stream << "-e engine\tStorage engine of the started server. Default: "
+            "memory"
+         << std::endl;
+  stream << "-b baseline\tFail if the run regressed from this baseline."
+         << std::endl;
+  stream << "-w baseline\tRecord the run as a baseline to this file."
+         << std::endl;
+  stream << "-t percent\tRegression tolerated over the baseline. Default: "
+         << PERF_DEFAULT_TOLERANCE_PERCENT << std::endl;
+  stream << "-h\t\tPrint this menu." << std::endl;
+}
+
+// The asset as given in the script, relative to the working directory, or
+// else the asset of the same name, or the first asset, of the assets dir
+static std::filesystem::path resolve_asset(const std::string &path,
+                                           const std::string &assets_dir) {
+  std::error_code error;
+  if (std::filesystem::is_regular_file(path, error)) {
+    return path;
+  }
+  std::filesystem::path same_name = std::filesystem::path(assets_dir) /
+                                    std::filesystem::path(path).filename();
+  if (std::filesystem::is_regular_file(same_name, error)) {
+    return same_name;
+  }
+  std::vector<std::filesystem::path> assets;
+  for (auto &entry : std::filesystem::directory_iterator(assets_dir, error)) {
+    if (entry.is_regular_file()) {
+      assets.push_back(entry.path());
+    }
+  }
+  if (assets.empty()) {
+    throw std::runtime_error("No asset for " + path + " in " + assets_dir);
+  }
+  return *std::min_element(assets.begin(), assets.end());
+}
+
+// Reads a line of a script into a step, or returns false for the lines
+// that send nothing: exit, sleep, RCOMP and blank lines
+static bool parse_step(const std::string &line, const PerfConfig &config,
+                       ScriptStep &step) {
+  std::istringstream fields(line);
+  std::string name;
+  if (!(fields >> name)) {
+    return false;
+  }
+  auto alias = COMMAND_ALIASES.find(name);
+  auto command = std::find(std::begin(COMMAND_NAMES), std::end(COMMAND_NAMES),
+                           name);
+  if (alias != COMMAND_ALIASES.end()) {
+    step.command = alias->second;
+  } else if (command != std::end(COMMAND_NAMES)) {
+    step.command = static_cast<Command>(command - std::begin(COMMAND_NAMES));
+  } else {
+    return false;
+  }
+
+  std::string first, second, third, fourth;
+  fields >> first >> second >> third >> fourth;
+  bool valid = true;
+  switch (step.command) {
+  case LOGIN:
+    valid = parse_digits(first, step.user_id);
+    step.password = second;
+    break;
+  case OPEN:
+    step.auction_name = first;
+    step.asset = resolve_asset(second, config.assets_dir);
+    valid = parse_digits(third, step.value) &&
+            parse_digits(fourth, step.duration);
+    break;
+  case CLOSE:
+  case SHOW_ASSET:
+  case SHOW_RECORD:
+    valid = parse_digits(first, step.auction_id);
+    break;
+  case BID:
+    valid = parse_digits(first, step.auction_id) &&
+            parse_digits(second, step.value);
+    break;
+  case LOGOUT:
+  case UNREGISTER:
+  case MY_AUCTIONS:
+  case MY_BIDS:
+  case LIST:
+  case COMMAND_COUNT:
+  default:
+    break;
+  }
+  if (!valid) {
+    throw std::runtime_error("Invalid script line: " + line);
+  }
+  return true;
+}
+
+static Workload load_workload(const PerfConfig &config) {
+  std::vector<std::filesystem::path> scripts;
+  std::error_code error;
+  for (auto &entry :
+       std::filesystem::directory_iterator(config.scripts_dir, error)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".txt") {
+      scripts.push_back(entry.path());
+    }
+  }
+  if (scripts.empty()) {
+    throw std::runtime_error("No scripts in " + config.scripts_dir);
+  }
+  std::sort(scripts.begin(), scripts.end());
+
+  Workload workload;
+  for (auto &script : scripts) {
+    std::ifstream file(script);
+    Scenario scenario;
+    scenario.name = script.filename().string();
+    std::string line;
+    while (std::getline(file, line)) {
+      ScriptStep step;
+      if (!parse_step(line, config, step)) {
+        continue;
+      }
+      if (step.command == LOGIN) {
+        workload.script_users.emplace(
+            step.user_id, static_cast<uint32_t>(workload.script_users.size()));
+      }
+      scenario.steps.push_back(std::move(step));
+    }
+    workload.steps += scenario.steps.size();
+    workload.scenarios.push_back(std::move(scenario));
+  }
+
+  if (PERF_FIRST_USER_ID + uint64_t{config.copies} *
+                               workload.script_users.size() >
+      999999) {
+    throw std::runtime_error("Too many copies for the user IDs available");
+  }
+  workload.opens_per_copy = AUCTION_MAX_NUMBER / config.copies;
+  return workload;
+}
+
+PerfWorker::PerfWorker(PerfConfig &__config, const Workload &__workload)
+    : config{__config}, workload{__workload},
+      connection{__config.host, __config.port, false} {}
+
+void PerfWorker::run(std::atomic<uint32_t> &next_copy) {
+  uint32_t copy;
+  while (!is_shutting_down && (copy = next_copy++) < config.copies) {
+    runCopy(copy);
+  }
+}
+
+void PerfWorker::runCopy(uint32_t copy) {
+  Session session;
+  for (const Scenario &scenario : workload.scenarios) {
+    for (const ScriptStep &step : scenario.steps) {
+      if (is_shutting_down) {
+        return;
+      }
+      perform(step, session, copy);
+    }
+    // Each script is run by a new client, and the previous one logged its
+    // user out as it exited
+    if (session.logged_in) {
+      ScriptStep logout;
+      logout.command = LOGOUT;
+      perform(logout, session, copy);
+    }
+  }
+}
+
+// The auction opened by the copy that the script's auction ID stands for
+uint32_t PerfWorker::auctionOf(const ScriptStep &step,
+                               const Session &session) {
+  if (session.opened.empty() || step.auction_id == 0) {
+    return step.auction_id;
+  }
+  return session.opened[(step.auction_id - 1) % session.opened.size()];
+}
+
+void PerfWorker::record(Command command, Clock::time_point start, bool ok) {
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start);
+  stats[command].latencies.push_back(static_cast<uint32_t>(latency.count()));
+  if (!ok) {
+    stats[command].errors++;
+  }
+}
+
+template <class Reply>
+bool PerfWorker::sendUdp(Command command, UdpPacket &packet_out,
+                         Reply &reply) {
+  Clock::time_point start = Clock::now();
+  bool ok;
+  try {
+    connection.sendUdpPacketAndWaitForReply(packet_out, reply);
+    ok = reply.status != Reply::status::ERR;
+  } catch (std::exception &) {
+    ok = false;
+  }
+  record(command, start, ok);
+  return ok;
+}
+
+template <class Reply>
+bool PerfWorker::sendTcp(Command command, TcpPacket &packet_out,
+                         Reply &reply) {
+  Clock::time_point start = Clock::now();
+  bool ok;
+  try {
+    connection.sendTcpPacketAndWaitForReply(packet_out, reply);
+    ok = reply.status != Reply::status::ERR;
+  } catch (std::exception &) {
+    ok = false;
+  }
+  record(command, start, ok);
+  return ok;
+}
+
+// Sends the request of the step as the client would: commands that need a
+// logged in user are not sent without one, nor is a login with one
+void PerfWorker::perform(const ScriptStep &step, Session &session,
+                         uint32_t copy) {
+  bool needs_login = step.command != LOGIN && step.command != LIST &&
+                     step.command != SHOW_ASSET && step.command != SHOW_RECORD;
+  if ((needs_login && !session.logged_in) ||
+      (step.command == LOGIN && session.logged_in)) {
+    return;
+  }
+
+  switch (step.command) {
+  case LOGIN: {
+    LoginServerbound packet_out;
+    packet_out.user_id = PERF_FIRST_USER_ID +
+                         copy * static_cast<uint32_t>(
+                                    workload.script_users.size()) +
+                         workload.script_users.at(step.user_id);
+    packet_out.password = step.password;
+    ReplyLoginClientbound rli;
+    if (sendUdp(LOGIN, packet_out, rli) &&
+        (rli.status == ReplyLoginClientbound::status::OK ||
+         rli.status == ReplyLoginClientbound::status::REG)) {
+      session.user_id = packet_out.user_id;
+      session.password = packet_out.password;
+      session.logged_in = true;
+    }
+    break;
+  }
+  case LOGOUT: {
+    LogoutServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    packet_out.password = session.password;
+    ReplyLogoutClientbound rlo;
+    if (sendUdp(LOGOUT, packet_out, rlo) &&
+        rlo.status == ReplyLogoutClientbound::status::OK) {
+      session.logged_in = false;
+    }
+    break;
+  }
+  case UNREGISTER: {
+    UnregisterServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    packet_out.password = session.password;
+    ReplyUnregisterClientbound rur;
+    if (sendUdp(UNREGISTER, packet_out, rur) &&
+        rur.status == ReplyUnregisterClientbound::status::OK) {
+      session.logged_in = false;
+    }
+    break;
+  }
+  case OPEN: {
+    if (session.opened.size() >= workload.opens_per_copy) {
+      skipped_opens++;
+      break;
+    }
+    OpenAuctionServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    packet_out.password = session.password;
+    packet_out.auction_name = step.auction_name;
+    packet_out.start_value = step.value;
+    packet_out.time_active = step.duration;
+    packet_out.file_path = step.asset;
+    packet_out.file_name = step.asset.filename().string();
+    ReplyOpenAuctionClientbound roa;
+    if (sendTcp(OPEN, packet_out, roa) &&
+        roa.status == ReplyOpenAuctionClientbound::status::OK) {
+      session.opened.push_back(roa.auction_id);
+    }
+    break;
+  }
+  case CLOSE: {
+    CloseAuctionServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    packet_out.password = session.password;
+    packet_out.auction_id = auctionOf(step, session);
+    ReplyCloseAuctionClientbound rcl;
+    sendTcp(CLOSE, packet_out, rcl);
+    break;
+  }
+  case MY_AUCTIONS: {
+    ListMyAuctionsServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    ReplyListMyAuctionsClientbound rma;
+    sendUdp(MY_AUCTIONS, packet_out, rma);
+    break;
+  }
+  case MY_BIDS: {
+    MyBidsServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    ReplyMyBidsClientbound rmb;
+    sendUdp(MY_BIDS, packet_out, rmb);
+    break;
+  }
+  case LIST: {
+    ListAuctionsServerbound packet_out;
+    ReplyListAuctionsClientbound rls;
+    sendUdp(LIST, packet_out, rls);
+    break;
+  }
+  case SHOW_ASSET: {
+    ShowAssetRangeServerbound packet_out;
+    packet_out.auction_id = auctionOf(step, session);
+    ReplyShowAssetRangeClientbound rsr;
+    rsr.save_path = "/dev/null";
+    rsr.interactive = false;
+    sendTcp(SHOW_ASSET, packet_out, rsr);
+    break;
+  }
+  case BID: {
+    BidServerbound packet_out;
+    packet_out.user_id = session.user_id;
+    packet_out.password = session.password;
+    packet_out.auction_id = auctionOf(step, session);
+    packet_out.bid_value = step.value;
+    ReplyBidClientbound rbd;
+    sendTcp(BID, packet_out, rbd);
+    break;
+  }
+  case SHOW_RECORD: {
+    ShowRecordServerbound packet_out;
+    packet_out.auction_id = auctionOf(step, session);
+    ReplyShowRecordClientbound rrc;
+    sendUdp(SHOW_RECORD, packet_out, rrc);
+    break;
+  }
+  case COMMAND_COUNT:
+  default:
+    break;
+  }
+}
+
+ScratchServer::ScratchServer(const std::string &server_path,
+                             const std::string &port,
+                             const std::string &engine) {
+  std::string executable = std::filesystem::absolute(server_path).string();
+  char scratch[] = "/tmp/asperf-XXXXXX";
+  if (mkdtemp(scratch) == nullptr) {
+    throw std::runtime_error("Failed to create a scratch directory");
+  }
+  directory = scratch;
+  std::string log = (directory / "AS.log").string();
+
+  pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("Failed to start the server");
+  }
+  if (pid == 0) {
+    int fd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (chdir(scratch) != 0 || fd < 0 || dup2(fd, STDOUT_FILENO) < 0 ||
+        dup2(fd, STDERR_FILENO) < 0) {
+      _exit(EXIT_FAILURE);
+    }
+    execl(executable.c_str(), executable.c_str(), "-p", port.c_str(), "-s",
+          engine.c_str(), static_cast<char *>(nullptr));
+    _exit(EXIT_FAILURE);
+  }
+
+  // The server is ready once it accepts TCP connections
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(std::stoul(port)));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  auto deadline =
+      Clock::now() + std::chrono::milliseconds(PERF_SERVER_START_TIMEOUT_MS);
+  while (true) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    bool ready =
+        fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&address),
+                           sizeof(address)) == 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (ready) {
+      return;
+    }
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid) {
+      pid = -1;
+      throw std::runtime_error("The server exited on startup, see " + log);
+    }
+    if (Clock::now() > deadline) {
+      stop();
+      throw std::runtime_error("The server did not start listening, see " +
+                               log);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+}
+
+ScratchServer::~ScratchServer() { stop(); }
+
+// Shuts the server down as CTRL + C would, keeping its directory for
+// inspection if it did not exit cleanly
+void ScratchServer::stop() {
+  if (pid < 0) {
+    return;
+  }
+  kill(pid, SIGINT);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  pid = -1;
+  if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+  } else {
+    std::cerr << "The server did not exit cleanly, see " << directory.string()
+              << "/AS.log" << std::endl;
+  }
+}
+
+// Nearest-rank percentile of sorted latencies
+static double percentile_ms(const std::vector<uint32_t> &sorted,
+                            double percent) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(
+      std::ceil(percent / 100 * static_cast<double>(sorted.size())));
+  return sorted[std::clamp(rank, size_t{1}, sorted.size()) - 1] / 1000.0;
+}
+
+void PerfReport::writeJson(std::ostream &stream) {
+  stream << std::fixed << std::setprecision(3);
+  stream << "{\n  \"engine\": \"" << engine << "\",\n  \"copies\": " << copies
+         << ",\n  \"concurrency\": " << concurrency
+         << ",\n  \"rounds\": " << rounds
+         << ",\n  \"steps\": " << steps << ",\n  \"requests\": " << requests
+         << ",\n  \"errors\": " << errors
+         << ",\n  \"skipped_opens\": " << skipped_opens
+         << ",\n  \"seconds\": " << seconds
+         << ",\n  \"throughput_rps\": " << throughput_rps
+         << ",\n  \"p50_ms\": " << p50_ms << ",\n  \"p99_ms\": " << p99_ms
+         << ",\n  \"p999_ms\": " << p999_ms << ",\n  \"commands\": {";
+  bool first = true;
+  for (auto &[name, command] : commands) {
+    stream << (first ? "\n" : ",\n") << "    \"" << name
+           << "\": {\"requests\": " << command.requests
+           << ", \"errors\": " << command.errors
+           << ", \"p50_ms\": " << command.p50_ms
+           << ", \"p99_ms\": " << command.p99_ms << "}";
+    first = false;
+  }
+  stream << "\n  }\n}" << std::endl;
+  stream.unsetf(std::ios_base::floatfield);
+}
+
+static PerfReport build_report(
+    const PerfConfig &config, const Workload &workload,
+    const std::vector<std::unique_ptr<PerfWorker>> &workers, double seconds) {
+  PerfReport report;
+  report.engine = config.server_path.empty() ? "external" : config.engine;
+  report.copies = config.copies;
+  report.concurrency = config.concurrency;
+  report.rounds = 1;
+  report.steps = workload.steps;
+  report.seconds = seconds;
+
+  std::vector<uint32_t> all;
+  for (size_t command = 0; command < COMMAND_COUNT; ++command) {
+    std::vector<uint32_t> latencies;
+    CommandReport row;
+    for (auto &worker : workers) {
+      const CommandStats &stats = worker->stats[command];
+      latencies.insert(latencies.end(), stats.latencies.begin(),
+                       stats.latencies.end());
+      row.errors += stats.errors;
+    }
+    if (latencies.empty()) {
+      continue;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    row.requests = latencies.size();
+    row.p50_ms = percentile_ms(latencies, 50);
+    row.p99_ms = percentile_ms(latencies, 99);
+    report.commands[COMMAND_NAMES[command]] = row;
+    report.requests += row.requests;
+    report.errors += row.errors;
+    all.insert(all.end(), latencies.begin(), latencies.end());
+  }
+  for (auto &worker : workers) {
+    report.skipped_opens += worker->skipped_opens;
+  }
+
+  std::sort(all.begin(), all.end());
+  report.throughput_rps = static_cast<double>(report.requests) / seconds;
+  report.p50_ms = percentile_ms(all, 50);
+  report.p99_ms = percentile_ms(all, 99);
+  report.p999_ms = percentile_ms(all, 99.9);
+  return report;
+}
+
+// Sends bids, closes and asset downloads in turn back to back on one
+// kept-alive connection, from a user the scripts never log in; each reply
+// is read as the reply to its request, so one out of order fails the check
+static void check_pipelining(PerfConfig &config) {
+  UserState connection(config.host, config.port, true);
+  std::vector<BidServerbound> bids;
+  std::vector<CloseAuctionServerbound> closes;
+  std::vector<ShowAssetRangeServerbound> assets;
+  std::vector<ReplyBidClientbound> rbds;
+  std::vector<ReplyCloseAuctionClientbound> rcls;
+  std::vector<ReplyShowAssetRangeClientbound> rsrs;
+  // Pointers into the vectors are taken once they are all filled
+  bids.resize(PERF_PIPELINE_CHECK_REQUESTS / 3);
+  closes.resize(bids.size());
+  assets.resize(bids.size());
+  rbds.resize(bids.size());
+  rcls.resize(bids.size());
+  rsrs.resize(bids.size());
+
+  std::vector<TcpPacket *> out, in;
+  for (size_t i = 0; i < bids.size(); ++i) {
+    uint32_t auction_id = static_cast<uint32_t>(i) + 1;
+    bids[i].user_id = PERF_FIRST_USER_ID - 1;
+    bids[i].password = "pipeline";
+    bids[i].auction_id = auction_id;
+    bids[i].bid_value = auction_id;
+    closes[i].user_id = bids[i].user_id;
+    closes[i].password = bids[i].password;
+    closes[i].auction_id = auction_id;
+    assets[i].auction_id = auction_id;
+    rsrs[i].save_path = "/dev/null";
+    rsrs[i].interactive = false;
+    out.insert(out.end(), {&bids[i], &closes[i], &assets[i]});
+    in.insert(in.end(), {&rbds[i], &rcls[i], &rsrs[i]});
+  }
+
+  try {
+    connection.sendTcpPacketsAndWaitForReplies(out, in);
+  } catch (UnexpectedPacketException &e) {
+    throw std::runtime_error(
+        "Pipelined requests were not answered in order: " +
+        std::string(e.what()));
+  }
+  if (!connection.isTcpKeptAlive()) {
+    throw std::runtime_error("The server did not keep the connection alive");
+  }
+  for (size_t i = 0; i < bids.size(); ++i) {
+    if (rbds[i].status == ReplyBidClientbound::status::ERR ||
+        rcls[i].status == ReplyCloseAuctionClientbound::status::ERR ||
+        rsrs[i].status == ReplyShowAssetRangeClientbound::status::ERR) {
+      throw std::runtime_error("A pipelined request was answered ERR");
+    }
+  }
+}
+
+static PerfReport run_round(PerfConfig &config, const Workload &workload) {
+  std::unique_ptr<ScratchServer> server;
+  if (!config.server_path.empty()) {
+    server = std::make_unique<ScratchServer>(config.server_path, config.port,
+                                             config.engine);
+  }
+  check_pipelining(config);
+
+  std::vector<std::unique_ptr<PerfWorker>> workers;
+  for (uint32_t i = 0; i < config.concurrency; ++i) {
+    workers.push_back(std::make_unique<PerfWorker>(config, workload));
+  }
+  std::atomic<uint32_t> next_copy{0};
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (auto &worker : workers) {
+    threads.emplace_back([&worker, &next_copy] { worker->run(next_copy); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  if (server) {
+    server->stop();
+  }
+  return build_report(config, workload, workers, seconds);
+}
+
+static double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+// Takes the median of each metric over the rounds, and the most errors of
+// any round
+static PerfReport median_report(const std::vector<PerfReport> &rounds) {
+  PerfReport report = rounds.front();
+  report.rounds = static_cast<uint32_t>(rounds.size());
+  auto median_of = [&](auto metric) {
+    std::vector<double> values;
+    for (const PerfReport &round : rounds) {
+      values.push_back(metric(round));
+    }
+    return median(values);
+  };
+  report.seconds = median_of([](const PerfReport &r) { return r.seconds; });
+  report.throughput_rps =
+      median_of([](const PerfReport &r) { return r.throughput_rps; });
+  report.p50_ms = median_of([](const PerfReport &r) { return r.p50_ms; });
+  report.p99_ms = median_of([](const PerfReport &r) { return r.p99_ms; });
+  report.p999_ms = median_of([](const PerfReport &r) { return r.p999_ms; });
+  for (const PerfReport &round : rounds) {
+    report.errors = std::max(report.errors, round.errors);
+  }
+
+  for (auto &[name, command] : report.commands) {
+    auto of_command = [&name = name](const PerfReport &r) {
+      auto found = r.commands.find(name);
+      return found != r.commands.end() ? found->second : CommandReport();
+    };
+    command.p50_ms = median_of(
+        [&](const PerfReport &r) { return of_command(r).p50_ms; });
+    command.p99_ms = median_of(
+        [&](const PerfReport &r) { return of_command(r).p99_ms; });
+    for (const PerfReport &round : rounds) {
+      command.errors = std::max(command.errors, of_command(round).errors);
+    }
+  }
+  return report;
+}
+
+// Flattens the objects of a JSON document into "a.b" keys and the text of
+// their values; only the nested objects of strings and numbers that
+// writeJson writes are supported
+static std::map<std::string, std::string> read_json(std::istream &stream) {
+  std::map<std::string, std::string> values;
+  std::vector<std::string> path;
+  std::string key;
+  bool have_key = false;
+  auto full_key = [&]() {
+    std::string result;
+    for (const std::string &component : path) {
+      if (!component.empty()) {
+        result += component + ".";
+      }
+    }
+    return result + key;
+  };
+
+  char c;
+  while (stream.get(c)) {
+    if (isspace(c) || c == ',' || c == ':') {
+      continue;
+    }
+    if (c == '{') {
+      path.push_back(have_key ? key : "");
+      have_key = false;
+    } else if (c == '}') {
+      if (path.empty()) {
+        throw std::runtime_error("Unbalanced braces in the baseline");
+      }
+      path.pop_back();
+    } else if (c == '"') {
+      std::string text;
+      while (stream.get(c) && c != '"') {
+        text.push_back(c);
+      }
+      if (have_key) {
+        values[full_key()] = text;
+      } else {
+        key = text;
+      }
+      have_key = !have_key;
+    } else if (have_key) {
+      std::string text(1, c);
+      while (stream.peek() != EOF && !isspace(stream.peek()) &&
+             stream.peek() != ',' && stream.peek() != '}') {
+        text.push_back(static_cast<char>(stream.get()));
+      }
+      values[full_key()] = text;
+      have_key = false;
+    } else {
+      throw std::runtime_error("Unsupported JSON in the baseline");
+    }
+  }
+  return values;
+}
+
+// Prints how each metric moved from the baseline, and tells whether none
+// regressed beyond the tolerance
+static bool compare_with_baseline(std::ostream &stream,
+                                  const PerfReport &report,
+                                  std::map<std::string, std::string> &baseline,
+                                  uint32_t tolerance_percent) {
+  std::ostringstream workload;
+  workload << report.engine << " " << report.copies << " "
+           << report.concurrency << " " << report.rounds << " "
+           << report.steps;
+  if (workload.str() != baseline["engine"] + " " + baseline["copies"] + " " +
+                            baseline["concurrency"] + " " +
+                            baseline["rounds"] + " " + baseline["steps"]) {
+    stream << "The baseline was recorded with another workload (engine, "
+              "copies, concurrency, rounds or scripts); record it again "
+              "with -w"
+           << std::endl;
+    return false;
+  }
+
+  double tolerance = tolerance_percent / 100.0;
+  bool passed = true;
+  stream << std::left << std::setw(26) << "metric" << std::right
+         << std::setw(12) << "baseline" << std::setw(12) << "current"
+         << std::setw(10) << "change" << std::endl;
+  // Throughput regresses when it drops, latencies when they grow
+  auto check = [&](const std::string &metric, double current,
+                   bool higher_is_better) {
+    if (baseline.count(metric) == 0) {
+      return;
+    }
+    double before = std::stod(baseline[metric]);
+    bool regressed =
+        higher_is_better
+            ? current < before * (1 - tolerance)
+            : current > before * (1 + tolerance) &&
+                  current - before > PERF_LATENCY_SLACK_MS;
+    passed = passed && !regressed;
+    stream << std::left << std::setw(26) << metric << std::right << std::fixed
+           << std::setprecision(2) << std::setw(12) << before << std::setw(12)
+           << current << std::setw(9)
+           << (before > 0 ? (current - before) / before * 100 : 0) << "%"
+           << (regressed ? "  REGRESSED" : "") << std::endl;
+  };
+  check("throughput_rps", report.throughput_rps, true);
+  check("p50_ms", report.p50_ms, false);
+  check("p99_ms", report.p99_ms, false);
+  for (auto &[name, command] : report.commands) {
+    if (command.requests >= PERF_MIN_CHECKED_REQUESTS) {
+      check("commands." + name + ".p99_ms", command.p99_ms, false);
+    }
+  }
+
+  uint64_t errors_before = baseline.count("errors") > 0
+                               ? std::stoull(baseline["errors"])
+                               : 0;
+  if (report.errors > errors_before) {
+    stream << report.errors << " requests failed, " << errors_before
+           << " in the baseline" << std::endl;
+    passed = false;
+  }
+  stream << (passed ? "No regression" : "Performance regressed")
+         << " beyond " << tolerance_percent << "% of the baseline"
+         << std::endl;
+  return passed;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    setup_signal_handlers();
+
+    PerfConfig config(argc, argv);
+    if (config.help) {
+      config.printHelp(std::cout);
+      return EXIT_SUCCESS;
+    }
+
+    Workload workload = load_workload(config);
+    std::map<std::string, std::string> baseline;
+    if (!config.baseline_file.empty()) {
+      std::ifstream file(config.baseline_file);
+      if (!file) {
+        std::cerr << "Failed to open the baseline " << config.baseline_file
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      baseline = read_json(file);
+    }
+
+    std::cerr << "Replaying " << workload.scenarios.size() << " scripts ("
+              << workload.steps << " commands) as " << config.copies
+              << " copies of their users, " << config.concurrency
+              << " at once..." << std::endl;
+    std::vector<PerfReport> rounds;
+    for (uint32_t round = 1; round <= config.rounds; ++round) {
+      rounds.push_back(run_round(config, workload));
+      if (is_shutting_down) {
+        std::cerr << "Interrupted" << std::endl;
+        return EXIT_FAILURE;
+      }
+      std::cerr << "Round " << round << "/" << config.rounds << ": "
+                << std::fixed << std::setprecision(1)
+                << rounds.back().throughput_rps << " req/s, p99 "
+                << std::setprecision(2) << rounds.back().p99_ms << " ms"
+                << std::endl;
+    }
+
+    PerfReport report = median_report(rounds);
+    report.writeJson(std::cout);
+    if (!config.record_file.empty()) {
+      std::ofstream file(config.record_file);
+      report.writeJson(file);
+      if (!file) {
+        std::cerr << "Failed to write the baseline " << config.record_file
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if (!config.baseline_file.empty() &&
+        !compare_with_baseline(std::cout, report, baseline,
+                               config.tolerance_percent)) {
+      return EXIT_FAILURE;
+    }
+  } catch (std::exception &e) {
+    std::cerr << "Encountered unrecoverable error while checking the "
+                 "performance. Shutting down..."
+              << std::endl
+              << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
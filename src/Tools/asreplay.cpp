@@ -0,0 +1,639 @@
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../common/common.hpp"
+#include "../common/constants.hpp"
+#include "../common/exceptions.hpp"
+#include "../common/field_validation.hpp"
+
+extern bool is_shutting_down;
+
+typedef std::chrono::steady_clock Clock;
+
+class ReplayConfig {
+public:
+  char *program_path;
+  std::string host = DEFAULT_HOSTNAME;
+  std::string port = DEFAULT_PORT;
+  std::string capture_file;
+  // Times faster than captured; 0 replays as fast as the server answers
+  uint32_t speed = 1;
+  uint32_t lanes = 1;
+  std::string assets_dir = std::string(BASE_DIR) + ASSET_STORE_DIR;
+  // Per-request results are written here, if set
+  std::string log_file;
+  bool verbose = false;
+  bool help = false;
+
+  ReplayConfig(int argc, char *argv[]);
+  void printHelp(std::ostream &stream);
+};
+
+struct CapturedRequest {
+  bool tcp;
+  uint64_t at_us;
+  // "ip:port" of the UDP client, or the number of the TCP connection
+  std::string client;
+  std::string request;
+  std::string reply;
+  size_t asset_offset = 0;
+  uint32_t asset_size = 0;
+  std::string asset_hash;
+  // The last request of its client, after which its socket is closed
+  bool last = false;
+};
+
+enum Outcome { MATCHED, MISMATCHED, FAILED };
+
+struct ReplayResult {
+  // Unset for the requests left out of an interrupted replay
+  bool replayed = false;
+  Outcome outcome = FAILED;
+  uint32_t latency_us = 0;
+  // How late the request was sent, behind the scaled capture times
+  uint64_t lag_us = 0;
+  std::string reply;
+};
+
+// A socket to the server, for one captured client
+struct ReplayConnection {
+  int fd = -1;
+  // Reply bytes received past the previous reply
+  std::string buffered;
+};
+
+static uint32_t parse_option_value(const char *value, const char *option) {
+  uint32_t result;
+  if (!parse_digits(value, result)) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+ReplayConfig::ReplayConfig(int argc, char *argv[]) {
+  program_path = argv[0];
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hvn:p:f:s:c:a:l:")) != -1) {
+    switch (opt) {
+    case 'n':
+      host = std::string(optarg);
+      break;
+    case 'p':
+      port = std::string(optarg);
+      break;
+    case 'f':
+      capture_file = std::string(optarg);
+      break;
+    case 's':
+      speed = std::string(optarg) == "max" ? 0
+                                            : parse_option_value(optarg, "-s");
+      break;
+    case 'c':
+      lanes = std::max(parse_option_value(optarg, "-c"), 1u);
+      break;
+    case 'a':
+      assets_dir = std::string(optarg);
+      break;
+    case 'l':
+      log_file = std::string(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    case 'h':
+      help = true;
+      break;
+    default:
+      std::cerr << std::endl;
+      printHelp(std::cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  validate_port_number(port);
+  if (capture_file.empty() && !help) {
+    std::cerr << "A capture file must be given with -f" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void ReplayConfig::printHelp(std::ostream &stream) {
+  stream << "Usage: " << program_path
+         << " -f capture [-n ASIP] [-p ASport] [-s speed] [-c lanes] "
+            "[-a assets] [-l log] [-v]"
+         << std::endl;
+  stream << "Available options:" << std::endl;
+  stream << "-f capture\tTraffic captured by the server with -c." << std::endl;
+  stream << "-n ASIP\t\tSet hostname of Auction Server. Default: "
+         << DEFAULT_HOSTNAME << std::endl;
+  stream << "-p ASport\tSet port of Auction Server. Default: " << DEFAULT_PORT
+         << std::endl;
+  stream << "-s speed\tTimes faster than captured, or max to send each "
+            "request once the previous one is answered. Default: 1"
+         << std::endl;
+  stream << "-c lanes\tNumber of clients replayed at once; each captured "
+            "client stays on one lane. Default: 1"
+         << std::endl;
+  stream << "-a assets\tDirectory of the uploaded assets, named by their "
+            "SHA-256 hash. Default: "
+         << BASE_DIR << ASSET_STORE_DIR << std::endl;
+  stream << "-l log\t\tWrite the latency and outcome of every request to log."
+         << std::endl;
+  stream << "-v\t\tPrint the replies that differ from the capture."
+         << std::endl;
+  stream << "-h\t\tPrint this menu." << std::endl;
+}
+
+static void read_exactly(std::istream &stream, std::string &out,
+                         size_t length) {
+  out.resize(length);
+  if (!stream.read(out.data(), static_cast<std::streamsize>(length))) {
+    throw std::runtime_error("The capture file is truncated");
+  }
+}
+
+// Reads every request of the capture, in the order they arrived
+static std::vector<CapturedRequest> read_capture(const std::string &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw FileOpenException(path);
+  }
+  std::string magic;
+  uint32_t version = 0;
+  file >> magic >> version;
+  if (magic != CAPTURE_FILE_MAGIC || version != CAPTURE_FORMAT_VERSION) {
+    throw std::runtime_error("Not a capture of this server version: " + path);
+  }
+  file.ignore(1);
+
+  std::vector<CapturedRequest> requests;
+  std::string header;
+  while (std::getline(file, header)) {
+    std::istringstream fields(header);
+    CapturedRequest captured;
+    std::string kind;
+    size_t request_length = 0;
+    size_t reply_length = 0;
+    fields >> kind >> captured.at_us >> captured.client >> request_length >>
+        reply_length;
+    captured.tcp = kind == "T";
+    if (captured.tcp) {
+      fields >> captured.asset_offset >> captured.asset_size >>
+          captured.asset_hash;
+    }
+    if (!fields || (kind != "T" && kind != "U") ||
+        captured.asset_offset > request_length) {
+      throw std::runtime_error("Invalid capture record: " + header);
+    }
+    read_exactly(file, captured.request, request_length);
+    read_exactly(file, captured.reply, reply_length);
+    file.ignore(1);
+    requests.push_back(std::move(captured));
+  }
+
+  std::stable_sort(requests.begin(), requests.end(),
+                   [](const CapturedRequest &a, const CapturedRequest &b) {
+                     return a.at_us < b.at_us;
+                   });
+  std::map<std::string, size_t> last_of_client;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    last_of_client[(requests[i].tcp ? "T" : "U") + requests[i].client] = i;
+  }
+  for (auto &[client, index] : last_of_client) {
+    requests[index].last = true;
+  }
+  return requests;
+}
+
+// Contents of the uploaded assets, by hash. Assets missing from the
+// directory are replaced by filler of the same size.
+static std::map<std::string, std::string>
+load_assets(const std::vector<CapturedRequest> &requests,
+            const std::string &assets_dir) {
+  std::map<std::string, std::string> assets;
+  uint32_t missing = 0;
+  for (const CapturedRequest &captured : requests) {
+    if (captured.asset_size == 0 || assets.count(captured.asset_hash) > 0) {
+      continue;
+    }
+    // The server keeps them under a directory of the first two characters
+    std::ifstream file(assets_dir + "/" + captured.asset_hash.substr(0, 2) +
+                           "/" + captured.asset_hash,
+                       std::ios::in | std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    if (!file || contents.str().length() != captured.asset_size) {
+      ++missing;
+      assets[captured.asset_hash] = std::string(captured.asset_size, 'x');
+    } else {
+      assets[captured.asset_hash] = contents.str();
+    }
+  }
+  if (missing > 0) {
+    std::cerr << missing << " asset(s) not found in " << assets_dir
+              << ", uploading filler of the same size instead" << std::endl;
+  }
+  return assets;
+}
+
+// Replaces the dates and times in a reply, and the seconds that follow them,
+// which depend on when the server ran, so replies that only differ in them
+// match
+static std::string without_times(const std::string &reply) {
+  std::string result = reply;
+  for (size_t i = 0; i + 19 <= result.length(); ++i) {
+    static const char PATTERN[] = "dddd-dd-dd dd:dd:dd";
+    bool matches = true;
+    for (size_t j = 0; j < 19 && matches; ++j) {
+      matches = PATTERN[j] == 'd' ? isdigit(result[i + j]) != 0
+                                  : result[i + j] == PATTERN[j];
+    }
+    if (matches) {
+      size_t end = i + 19;
+      if (end < result.length() && result[end] == ' ') {
+        ++end;
+        while (end < result.length() && isdigit(result[end]) != 0) {
+          ++end;
+        }
+      }
+      result.replace(i, end - i, "YYYY-MM-DD HH:MM:SS S");
+    }
+  }
+  return result;
+}
+
+static int open_socket(struct addrinfo *address, uint32_t timeout_seconds) {
+  int fd = socket(address->ai_family, address->ai_socktype, 0);
+  if (fd < 0) {
+    throw UnrecoverableError("Failed to create a socket", errno);
+  }
+  struct timeval timeout;
+  timeout.tv_sec = timeout_seconds;
+  timeout.tv_usec = 0;
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+      connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+    int error = errno;
+    close(fd);
+    throw UnrecoverableError("Failed to connect to the server", error);
+  }
+  return fd;
+}
+
+static void send_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t sent = send(fd, data.data(), data.length(), 0);
+    if (sent <= 0) {
+      throw std::runtime_error("Failed to send the request");
+    }
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+}
+
+static char next_byte(ReplayConnection &connection) {
+  if (connection.buffered.empty()) {
+    char buffer[SOCKET_BUFFER_LEN];
+    ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      throw std::runtime_error("The server closed the connection");
+    }
+    connection.buffered.assign(buffer, static_cast<size_t>(n));
+  }
+  char c = connection.buffered.front();
+  connection.buffered.erase(0, 1);
+  return c;
+}
+
+// Reads a TCP reply, leaving out the asset it carries as the capture does:
+// "RSA OK <name> <size> " and "RSR OK <name> <size> <hash> <offset> " are
+// followed by the asset
+static std::string receive_tcp_reply(ReplayConnection &connection) {
+  std::string reply;
+  std::vector<std::string> fields(1);
+  while (true) {
+    char c = next_byte(connection);
+    reply.push_back(c);
+    if (c == '\n') {
+      return reply;
+    }
+    if (c != ' ') {
+      fields.back().push_back(c);
+      continue;
+    }
+
+    size_t asset_size = 0;
+    if (fields.size() == 4 && fields[0] == "RSA" && fields[1] == "OK") {
+      asset_size = std::stoul(fields[3]);
+    } else if (fields.size() == 6 && fields[0] == "RSR" && fields[1] == "OK") {
+      asset_size = std::stoul(fields[3]) - std::stoul(fields[5]);
+    }
+    for (size_t i = 0; i < asset_size; ++i) {
+      next_byte(connection);
+    }
+    fields.emplace_back();
+  }
+}
+
+class ReplayLane {
+  const ReplayConfig &config;
+  const std::map<std::string, std::string> &assets;
+  struct addrinfo *udp_address;
+  struct addrinfo *tcp_address;
+  std::map<std::string, ReplayConnection> connections;
+
+  std::string replayUdp(const CapturedRequest &captured,
+                        ReplayConnection &connection);
+  std::string replayTcp(const CapturedRequest &captured,
+                        ReplayConnection &connection);
+
+public:
+  // Indexes of the requests of this lane, in order
+  std::vector<size_t> requests;
+
+  ReplayLane(const ReplayConfig &__config,
+             const std::map<std::string, std::string> &__assets,
+             struct addrinfo *__udp_address, struct addrinfo *__tcp_address)
+      : config{__config}, assets{__assets}, udp_address{__udp_address},
+        tcp_address{__tcp_address} {}
+
+  void run(const std::vector<CapturedRequest> &captured,
+           std::vector<ReplayResult> &results, Clock::time_point start);
+};
+
+std::string ReplayLane::replayUdp(const CapturedRequest &captured,
+                                  ReplayConnection &connection) {
+  if (connection.fd < 0) {
+    connection.fd = open_socket(udp_address, UDP_TIMEOUT_SECONDS);
+  }
+  send_all(connection.fd, captured.request);
+  char buffer[SOCKET_BUFFER_LEN];
+  ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+  if (n < 0) {
+    throw std::runtime_error("Timed out waiting for the reply");
+  }
+  return std::string(buffer, static_cast<size_t>(n));
+}
+
+std::string ReplayLane::replayTcp(const CapturedRequest &captured,
+                                  ReplayConnection &connection) {
+  if (connection.fd < 0) {
+    connection.fd = open_socket(tcp_address, TCP_READ_TIMEOUT_SECONDS);
+  }
+  std::string_view request = captured.request;
+  if (captured.asset_size > 0) {
+    send_all(connection.fd, request.substr(0, captured.asset_offset));
+    send_all(connection.fd, assets.at(captured.asset_hash));
+    send_all(connection.fd, request.substr(captured.asset_offset));
+  } else {
+    send_all(connection.fd, request);
+  }
+  return receive_tcp_reply(connection);
+}
+
+void ReplayLane::run(const std::vector<CapturedRequest> &captured,
+                     std::vector<ReplayResult> &results,
+                     Clock::time_point start) {
+  for (size_t index : requests) {
+    if (is_shutting_down) {
+      break;
+    }
+    const CapturedRequest &request = captured[index];
+    ReplayResult &result = results[index];
+    Clock::time_point sent = Clock::now();
+    if (config.speed > 0) {
+      Clock::time_point due =
+          start + std::chrono::microseconds(request.at_us / config.speed);
+      std::this_thread::sleep_until(due);
+      sent = Clock::now();
+      result.lag_us = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(sent - due)
+              .count());
+    }
+
+    std::string key = (request.tcp ? "T" : "U") + request.client;
+    ReplayConnection &connection = connections[key];
+    try {
+      result.reply = request.tcp ? replayTcp(request, connection)
+                                 : replayUdp(request, connection);
+      result.outcome = without_times(result.reply) ==
+                               without_times(request.reply)
+                           ? MATCHED
+                           : MISMATCHED;
+    } catch (std::exception &e) {
+      result.outcome = FAILED;
+      result.reply = e.what();
+    }
+    result.latency_us = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                              sent)
+            .count());
+    result.replayed = true;
+
+    // The next request of the client reconnects after a failure
+    if (request.last || result.outcome == FAILED) {
+      if (connection.fd >= 0) {
+        close(connection.fd);
+      }
+      connections.erase(key);
+    }
+  }
+  for (auto &[key, connection] : connections) {
+    close(connection.fd);
+  }
+}
+
+static std::string printable(std::string_view bytes) {
+  std::string out;
+  for (char c : bytes) {
+    if (c == '\n') {
+      out += "\\n";
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+// Nearest-rank percentile of sorted latencies
+static double percentile_ms(const std::vector<uint32_t> &sorted,
+                            double percent) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(
+      std::ceil(percent / 100 * static_cast<double>(sorted.size())));
+  return sorted[std::clamp(rank, size_t{1}, sorted.size()) - 1] / 1000.0;
+}
+
+struct PacketStats {
+  std::vector<uint32_t> latencies;
+  uint64_t mismatches = 0;
+  uint64_t errors = 0;
+};
+
+static void print_report(std::ostream &stream,
+                         const std::vector<CapturedRequest> &captured,
+                         const std::vector<ReplayResult> &results) {
+  std::map<std::string, PacketStats> stats;
+  PacketStats total;
+  for (size_t i = 0; i < captured.size(); ++i) {
+    if (!results[i].replayed) {
+      continue;
+    }
+    for (PacketStats *row :
+         {&stats[captured[i].request.substr(0, PACKET_ID_LEN)], &total}) {
+      row->latencies.push_back(results[i].latency_us);
+      row->mismatches += results[i].outcome == MISMATCHED;
+      row->errors += results[i].outcome == FAILED;
+    }
+  }
+
+  stream << std::left << std::setw(8) << "packet" << std::right
+         << std::setw(10) << "requests" << std::setw(12) << "mismatches"
+         << std::setw(8) << "errors" << std::setw(10) << "p50 ms"
+         << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+         << std::endl;
+  auto printRow = [&](const std::string &name, PacketStats &row) {
+    std::sort(row.latencies.begin(), row.latencies.end());
+    stream << std::left << std::setw(8) << name << std::right
+           << std::setw(10) << row.latencies.size() << std::setw(12)
+           << row.mismatches << std::setw(8) << row.errors << std::fixed
+           << std::setprecision(2) << std::setw(10)
+           << percentile_ms(row.latencies, 50) << std::setw(10)
+           << percentile_ms(row.latencies, 99) << std::setw(10)
+           << percentile_ms(row.latencies, 100) << std::endl;
+  };
+  for (auto &[name, row] : stats) {
+    printRow(name, row);
+  }
+  printRow("total", total);
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    setup_signal_handlers();
+
+    ReplayConfig config(argc, argv);
+    if (config.help) {
+      config.printHelp(std::cout);
+      return EXIT_SUCCESS;
+    }
+
+    std::vector<CapturedRequest> captured = read_capture(config.capture_file);
+    std::map<std::string, std::string> assets =
+        load_assets(captured, config.assets_dir);
+
+    struct addrinfo hints;
+    struct addrinfo *udp_address = NULL;
+    struct addrinfo *tcp_address = NULL;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    int error = getaddrinfo(config.host.c_str(), config.port.c_str(), &hints,
+                            &udp_address);
+    hints.ai_socktype = SOCK_STREAM;
+    if (error == 0) {
+      error = getaddrinfo(config.host.c_str(), config.port.c_str(), &hints,
+                          &tcp_address);
+    }
+    if (error != 0) {
+      throw UnrecoverableError(std::string("Failed to get the address of "
+                                           "the server: ") +
+                               gai_strerror(error));
+    }
+
+    // Each client stays on one lane, so its requests are sent in order
+    std::vector<ReplayLane> lanes(
+        config.lanes, ReplayLane(config, assets, udp_address, tcp_address));
+    std::hash<std::string> hash;
+    for (size_t i = 0; i < captured.size(); ++i) {
+      std::string key = (captured[i].tcp ? "T" : "U") + captured[i].client;
+      lanes[hash(key) % config.lanes].requests.push_back(i);
+    }
+
+    std::cout << "Replaying " << captured.size() << " requests from "
+              << config.capture_file << " over " << config.lanes
+              << " lane(s), "
+              << (config.speed > 0 ? std::to_string(config.speed) + "x"
+                                   : std::string("max"))
+              << " speed..." << std::endl;
+
+    std::vector<ReplayResult> results(captured.size());
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (ReplayLane &lane : lanes) {
+      threads.emplace_back([&lane, &captured, &results, start] {
+        lane.run(captured, results, start);
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    freeaddrinfo(udp_address);
+    freeaddrinfo(tcp_address);
+
+    uint64_t max_lag_us = 0;
+    for (size_t i = 0; i < captured.size(); ++i) {
+      if (!results[i].replayed) {
+        continue;
+      }
+      max_lag_us = std::max(max_lag_us, results[i].lag_us);
+      if (config.verbose && results[i].outcome != MATCHED) {
+        std::cerr << "#" << i << " " << printable(captured[i].request)
+                  << "\n  captured: " << printable(captured[i].reply)
+                  << "\n  replayed: " << printable(results[i].reply)
+                  << std::endl;
+      }
+    }
+
+    if (!config.log_file.empty()) {
+      std::ofstream log(config.log_file);
+      log << "index packet client at_us lag_us latency_us outcome\n";
+      for (size_t i = 0; i < captured.size(); ++i) {
+        static const char *OUTCOMES[] = {"match", "mismatch", "error"};
+        if (!results[i].replayed) {
+          continue;
+        }
+        log << i << " " << captured[i].request.substr(0, PACKET_ID_LEN) << " "
+            << (captured[i].tcp ? "T" : "U") << captured[i].client << " "
+            << captured[i].at_us << " " << results[i].lag_us << " "
+            << results[i].latency_us << " " << OUTCOMES[results[i].outcome]
+            << "\n";
+      }
+    }
+
+    std::cout << "Replayed in " << std::fixed << std::setprecision(2)
+              << elapsed << "s";
+    if (config.speed > 0) {
+      std::cout << ", up to " << static_cast<double>(max_lag_us) / 1000.0
+                << " ms behind schedule";
+    }
+    std::cout << std::endl;
+    print_report(std::cout, captured, results);
+  } catch (std::exception &e) {
+    std::cerr << "Encountered unrecoverable error while replaying. Shutting "
+                 "down..."
+              << std::endl
+              << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
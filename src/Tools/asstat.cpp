@@ -0,0 +1,214 @@
+#include <getopt.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+
+#include "../Client/user_state.hpp"
+#include "../common/constants.hpp"
+#include "../common/field_validation.hpp"
+
+extern bool is_shutting_down;
+
+typedef std::map<std::string, uint64_t> Stats;
+typedef std::chrono::steady_clock Clock;
+
+class StatConfig {
+public:
+  char *program_path;
+  std::string host = DEFAULT_HOSTNAME;
+  std::string port = DEFAULT_PORT;
+  // Seconds between reports; 0 prints a single report since startup
+  uint32_t interval = 0;
+  // Reports to print when repeating; 0 repeats until interrupted
+  uint32_t count = 0;
+  bool help = false;
+
+  StatConfig(int argc, char *argv[]);
+  void printHelp(std::ostream &stream);
+};
+
+static uint32_t parse_option_value(const char *value, const char *option) {
+  uint32_t result;
+  if (!parse_digits(value, result)) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+StatConfig::StatConfig(int argc, char *argv[]) {
+  program_path = argv[0];
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hn:p:i:c:")) != -1) {
+    switch (opt) {
+    case 'n':
+      host = std::string(optarg);
+      break;
+    case 'p':
+      port = std::string(optarg);
+      break;
+    case 'i':
+      interval = parse_option_value(optarg, "-i");
+      break;
+    case 'c':
+      count = parse_option_value(optarg, "-c");
+      break;
+    case 'h':
+      help = true;
+      break;
+    default:
+      std::cerr << std::endl;
+      printHelp(std::cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  validate_port_number(port);
+}
+
+void StatConfig::printHelp(std::ostream &stream) {
+  stream << "Usage: " << program_path
+         << " [-n ASIP] [-p ASport] [-i seconds] [-c count]" << std::endl;
+  stream << "Available options:" << std::endl;
+  stream << "-n ASIP\t\tSet hostname of Auction Server. Default: "
+         << DEFAULT_HOSTNAME << std::endl;
+  stream << "-p ASport\tSet port of Auction Server. Default: " << DEFAULT_PORT
+         << std::endl;
+  stream << "-i seconds\tReport every this many seconds, with rates over "
+            "the interval. Default: a single report since startup"
+         << std::endl;
+  stream << "-c count\tNumber of reports when repeating. Default: until "
+            "interrupted"
+         << std::endl;
+  stream << "-h\t\tPrint this menu." << std::endl;
+}
+
+static Stats query_stats(UserState &connection) {
+  AdminStatsServerbound request;
+  ReplyAdminStatsClientbound reply;
+  connection.sendUdpPacketAndWaitForReply(request, reply);
+
+  if (reply.status == ReplyAdminStatsClientbound::NOK) {
+    throw std::runtime_error(
+        "The server only reports its stats over the loopback interface");
+  }
+  if (reply.status != ReplyAdminStatsClientbound::OK) {
+    throw std::runtime_error("The server failed to gather its stats");
+  }
+  return Stats(reply.stats.begin(), reply.stats.end());
+}
+
+// Change of a counter since the previous report
+static uint64_t delta(Stats &now, Stats &before, const std::string &name) {
+  uint64_t previous = before[name];
+  return now[name] >= previous ? now[name] - previous : now[name];
+}
+
+static void print_percentage(std::ostream &stream, uint64_t part,
+                             uint64_t whole) {
+  if (whole == 0) {
+    stream << "-";
+  } else {
+    stream << std::fixed << std::setprecision(1)
+           << 100.0 * static_cast<double>(part) / static_cast<double>(whole)
+           << "%";
+  }
+}
+
+static void print_report(std::ostream &stream, Stats &now, Stats &before,
+                         double seconds) {
+  uint64_t uptime = now["uptime_s"];
+  stream << "uptime " << uptime / 86400 << "d " << std::setfill('0')
+         << std::setw(2) << uptime % 86400 / 3600 << ":" << std::setw(2)
+         << uptime % 3600 / 60 << ":" << std::setw(2) << uptime % 60
+         << std::setfill(' ') << "   users " << now["users"] << " ("
+         << now["logged_in_users"] << " logged in)   auctions "
+         << now["active_auctions"] << " active, " << now["auctions"]
+         << " total" << std::endl;
+
+  stream << "tcp " << now["busy_workers"] + now["watchers"]
+         << " connection(s) (" << now["busy_workers"] << " on workers, "
+         << now["watchers"] << " watching)   workers " << now["busy_workers"]
+         << "/" << now["tcp_workers"] << " busy, ";
+  print_percentage(stream, delta(now, before, "worker_busy_ms"),
+                   static_cast<uint64_t>(seconds * 1000) * now["tcp_workers"]);
+  stream << " utilized" << std::endl;
+
+  stream << "write queue " << now["pending_writes"] << " pending, "
+         << delta(now, before, "write_failures") << " failed   reply cache ";
+  print_percentage(stream, delta(now, before, "reply_cache_hits"),
+                   delta(now, before, "reply_cache_lookups"));
+  stream << " hits   change log ";
+  print_percentage(stream, delta(now, before, "change_log_hits"),
+                   delta(now, before, "change_log_lookups"));
+  stream << " hits" << std::endl;
+
+  stream << std::left << std::setw(8) << "packet" << std::right
+         << std::setw(12) << "req/s" << std::setw(12) << "errors/s"
+         << std::endl;
+  for (auto &[name, value] : now) {
+    if (name.rfind("requests_", 0) != 0) {
+      continue;
+    }
+    std::string packet = name.substr(std::string("requests_").length());
+    uint64_t requests = delta(now, before, name);
+    if (requests == 0) {
+      continue;
+    }
+    uint64_t errors = delta(now, before, "errors_" + packet);
+    stream << std::left << std::setw(8) << packet << std::right << std::fixed
+           << std::setprecision(1) << std::setw(12)
+           << static_cast<double>(requests) / seconds << std::setw(12)
+           << static_cast<double>(errors) / seconds << std::endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    setup_signal_handlers();
+
+    StatConfig config(argc, argv);
+    if (config.help) {
+      config.printHelp(std::cout);
+      return EXIT_SUCCESS;
+    }
+
+    UserState connection(config.host, config.port, false);
+
+    // The first report covers the time since the server started
+    Stats before;
+    Stats now = query_stats(connection);
+    Clock::time_point queried_at = Clock::now();
+    double seconds =
+        static_cast<double>(std::max<uint64_t>(now["uptime_s"], 1));
+    print_report(std::cout, now, before, seconds);
+
+    for (uint32_t reports = 1;
+         config.interval > 0 && (config.count == 0 || reports < config.count);
+         ++reports) {
+      for (uint32_t i = 0; i < config.interval && !is_shutting_down; ++i) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+      if (is_shutting_down) {
+        break;
+      }
+
+      before = now;
+      now = query_stats(connection);
+      Clock::time_point previous = queried_at;
+      queried_at = Clock::now();
+      seconds = std::chrono::duration<double>(queried_at - previous).count();
+      std::cout << std::endl;
+      print_report(std::cout, now, before, seconds);
+    }
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,467 @@
+// Benchmark of the storage engines: fills a scratch ASDIR with users,
+// auctions and bids in steps, and at each step times the storage calls
+// the request handlers make, from 1 up to K threads at once. Results are
+// printed as JSON, one row per population step, operation and thread
+// count, so they can be plotted as scaling curves.
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/constants.hpp"
+#include "../common/exceptions.hpp"
+#include "../common/field_validation.hpp"
+#include "../common/sha256.hpp"
+#include "../common/storage_engine.hpp"
+
+class StoreBenchConfig {
+public:
+  char *program_path;
+  std::string engine = STORAGE_ENGINE_FILESYSTEM;
+  uint32_t users = STORE_BENCH_DEFAULT_USERS;
+  uint32_t auctions = STORE_BENCH_DEFAULT_AUCTIONS;
+  uint32_t bids = STORE_BENCH_DEFAULT_BIDS;
+  uint32_t steps = 1;
+  uint32_t max_threads = STORE_BENCH_DEFAULT_THREADS;
+  uint32_t ops = STORE_BENCH_DEFAULT_OPS;
+  // Scratch directory the ASDIR is created in; a new temporary one if empty
+  std::string directory;
+  bool keep = false;
+  bool help = false;
+
+  StoreBenchConfig(int argc, char *argv[]);
+  void printHelp(std::ostream &stream);
+};
+
+struct StoreBenchRow {
+  uint32_t users;
+  uint32_t auctions;
+  std::string operation;
+  uint32_t threads;
+  uint64_t ops;
+  double seconds;
+  double mean_us;
+  double p99_us;
+};
+
+// A timed call, given the calling thread's index and its random generator;
+// returns false if there was nothing left for the thread to do
+using StorageOperation = std::function<bool(uint32_t, std::mt19937 &)>;
+
+class StoreBench {
+  StoreBenchConfig &config;
+  std::unique_ptr<StorageEngine> storage;
+  uint32_t registered_users = 0;
+  std::atomic<uint32_t> next_auction_id{1};
+  // Open auctions filled with bids, which the read and bid operations use
+  std::vector<uint32_t> populated_auctions;
+  // Above the start value of every auction, so the first bids are accepted
+  std::atomic<uint32_t> next_bid_value{STORE_BENCH_START_VALUE + 1};
+  // Auctions opened by each thread of the open operation, for it to close
+  std::vector<std::vector<AuctionData>> opened_auctions;
+  std::vector<StoreBenchRow> rows;
+
+  static std::string userIdOf(uint32_t index) {
+    return std::to_string(LOAD_FIRST_USER_ID + index);
+  }
+  uint32_t pickUser(std::mt19937 &random);
+  // Auctions in the storage, open or closed
+  uint32_t auctionCount() const {
+    return std::min<uint32_t>(next_auction_id, AUCTION_MAX_NUMBER + 1) - 1;
+  }
+  uint32_t pickAuction(std::mt19937 &random);
+  // Opens an auction hosted by the given user; returns it, or nothing once
+  // every auction ID is taken
+  std::optional<AuctionData> openAuction(uint32_t user);
+  void populate(uint32_t target_users, uint32_t target_auctions);
+  void measure(const std::string &operation, uint32_t threads,
+               uint32_t ops_per_thread, const StorageOperation &op);
+
+public:
+  explicit StoreBench(StoreBenchConfig &__config) : config{__config} {}
+  void run();
+  void printJson(std::ostream &stream);
+};
+
+int main(int argc, char *argv[]) {
+  try {
+    StoreBenchConfig config(argc, argv);
+    if (config.help) {
+      config.printHelp(std::cout);
+      return EXIT_SUCCESS;
+    }
+
+    bool temporary = config.directory.empty();
+    if (temporary) {
+      char scratch[] = "/tmp/asstorebench-XXXXXX";
+      if (mkdtemp(scratch) == nullptr) {
+        throw std::runtime_error("Failed to create a scratch directory");
+      }
+      config.directory = scratch;
+    }
+    std::filesystem::create_directories(config.directory);
+    // The engines keep their data relative to the working directory
+    std::filesystem::current_path(config.directory);
+    if (std::filesystem::exists(BASE_DIR)) {
+      std::cerr << "Refusing to run over an existing " << BASE_DIR << " in "
+                << config.directory << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    StoreBench bench(config);
+    bench.run();
+    bench.printJson(std::cout);
+
+    if (!config.keep) {
+      std::filesystem::remove_all(BASE_DIR);
+      if (temporary) {
+        std::filesystem::current_path("/");
+        std::filesystem::remove(config.directory);
+      }
+    } else {
+      std::cerr << "Kept the scratch ASDIR in " << config.directory
+                << std::endl;
+    }
+  } catch (std::exception &e) {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static uint32_t parse_option_value(const char *value, const char *option) {
+  uint32_t result;
+  if (!parse_digits(value, result)) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return result;
+}
+
+StoreBenchConfig::StoreBenchConfig(int argc, char *argv[]) {
+  program_path = argv[0];
+  int opt;
+
+  while ((opt = getopt(argc, argv, "he:u:a:b:s:t:o:d:k")) != -1) {
+    switch (opt) {
+    case 'e':
+      engine = std::string(optarg);
+      break;
+    case 'u':
+      users = parse_option_value(optarg, "-u");
+      break;
+    case 'a':
+      auctions = parse_option_value(optarg, "-a");
+      break;
+    case 'b':
+      bids = parse_option_value(optarg, "-b");
+      break;
+    case 's':
+      steps = parse_option_value(optarg, "-s");
+      break;
+    case 't':
+      max_threads = parse_option_value(optarg, "-t");
+      break;
+    case 'o':
+      ops = parse_option_value(optarg, "-o");
+      break;
+    case 'd':
+      directory = std::string(optarg);
+      break;
+    case 'k':
+      keep = true;
+      break;
+    case 'h':
+      help = true;
+      break;
+    default:
+      std::cerr << std::endl;
+      printHelp(std::cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (!is_storage_engine(engine)) {
+    std::cerr << "Unknown storage engine: " << engine << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (users == 0 || users > USER_ID_MAX - LOAD_FIRST_USER_ID + 1) {
+    std::cerr << "The number of users must be between 1 and "
+              << USER_ID_MAX - LOAD_FIRST_USER_ID + 1 << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (auctions == 0 || auctions >= AUCTION_MAX_NUMBER) {
+    std::cerr << "The number of auctions must be between 1 and "
+              << AUCTION_MAX_NUMBER - 1
+              << ", leaving auction IDs for the open operation" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  steps = std::clamp(steps, 1u, auctions);
+  max_threads = std::max(max_threads, 1u);
+  ops = std::max(ops, 1u);
+}
+
+void StoreBenchConfig::printHelp(std::ostream &stream) {
+  stream << "Usage: " << program_path
+         << " [-e engine] [-u users] [-a auctions] [-b bids] [-s steps] "
+            "[-t threads] [-o ops] [-d directory] [-k]"
+         << std::endl;
+  stream << "Available options:" << std::endl;
+  stream << "-e engine\tStorage engine to benchmark, fs or memory. Default: "
+         << STORAGE_ENGINE_FILESYSTEM << std::endl;
+  stream << "-u users\tNumber of users to register. Default: "
+         << STORE_BENCH_DEFAULT_USERS << std::endl;
+  stream << "-a auctions\tNumber of auctions to open. Default: "
+         << STORE_BENCH_DEFAULT_AUCTIONS << std::endl;
+  stream << "-b bids\t\tBids placed on each auction. Default: "
+         << STORE_BENCH_DEFAULT_BIDS << std::endl;
+  stream << "-s steps\tMeasure as users and auctions are added in this many "
+            "steps. Default: 1"
+         << std::endl;
+  stream << "-t threads\tMeasure with 1, 2, 4... up to this many threads. "
+            "Default: "
+         << STORE_BENCH_DEFAULT_THREADS << std::endl;
+  stream << "-o ops\t\tOperations per thread in each measurement. Default: "
+         << STORE_BENCH_DEFAULT_OPS << std::endl;
+  stream << "-d directory\tCreate the ASDIR in this directory. Default: a new "
+            "temporary directory"
+         << std::endl;
+  stream << "-k\t\tKeep the ASDIR when done." << std::endl;
+  stream << "-h\t\tPrint this menu." << std::endl;
+}
+
+uint32_t StoreBench::pickUser(std::mt19937 &random) {
+  return std::uniform_int_distribution<uint32_t>(0, registered_users - 1)(
+      random);
+}
+
+uint32_t StoreBench::pickAuction(std::mt19937 &random) {
+  return populated_auctions[std::uniform_int_distribution<size_t>(
+      0, populated_auctions.size() - 1)(random)];
+}
+
+std::optional<AuctionData> StoreBench::openAuction(uint32_t user) {
+  uint32_t auction_id = next_auction_id++;
+  if (auction_id > AUCTION_MAX_NUMBER) {
+    return std::nullopt;
+  }
+  AuctionData auction(auction_id, LOAD_FIRST_USER_ID + user,
+                      "bench" + std::to_string(auction_id),
+                      STORE_BENCH_START_VALUE,
+                      AUCTION_DURATION_MAX_VALUE, "asset.txt", time(nullptr),
+                      " ", 0, std::vector<Bid>());
+
+  // Assets differ, so the asset store keeps one per auction
+  std::string asset = "Asset of auction " + std::to_string(auction_id) + "\n";
+  asset.resize(STORE_BENCH_ASSET_BYTES, '.');
+  AssetUpload upload;
+  storage->prepareAssetUpload(upload);
+  if (upload.contents) {
+    *upload.contents = asset;
+  } else {
+    std::ofstream(upload.staging_path, std::ios::binary) << asset;
+  }
+  Sha256 digest;
+  digest.update(asset.data(), asset.size());
+  upload.hash = digest.hexdigest();
+
+  storage->openAuction(userIdOf(user), auction, upload);
+  return auction;
+}
+
+void StoreBench::populate(uint32_t target_users, uint32_t target_auctions) {
+  for (; registered_users < target_users; ++registered_users) {
+    storage->registerUser(userIdOf(registered_users),
+                          "pw" + userIdOf(registered_users));
+  }
+
+  std::mt19937 random(target_auctions);
+  while (populated_auctions.size() < target_auctions) {
+    auto auction = openAuction(static_cast<uint32_t>(
+        populated_auctions.size() % registered_users));
+    if (!auction) {
+      break;
+    }
+    for (uint32_t bid = 0; bid < config.bids; ++bid) {
+      storage->bid(*auction, next_bid_value++, userIdOf(pickUser(random)));
+    }
+    populated_auctions.push_back(auction->getId());
+  }
+}
+
+void StoreBench::measure(const std::string &operation, uint32_t threads,
+                         uint32_t ops_per_thread, const StorageOperation &op) {
+  std::vector<std::vector<double>> latencies(threads);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937 random(t);
+      for (uint32_t i = 0; i < ops_per_thread; ++i) {
+        auto op_start = std::chrono::steady_clock::now();
+        if (!op(t, random)) {
+          break;
+        }
+        latencies[t].push_back(
+            std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - op_start)
+                .count());
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  std::vector<double> all;
+  for (auto &thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  if (all.empty()) {
+    return;
+  }
+  std::sort(all.begin(), all.end());
+  double sum = 0;
+  for (double latency : all) {
+    sum += latency;
+  }
+  size_t p99_rank = (all.size() * 99 + 99) / 100;
+  rows.push_back({registered_users, auctionCount(), operation, threads,
+                  all.size(), seconds, sum / static_cast<double>(all.size()),
+                  all[p99_rank - 1]});
+}
+
+void StoreBench::run() {
+  std::vector<uint32_t> thread_counts;
+  for (uint32_t threads = 1; threads < config.max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(config.max_threads);
+
+  // Auction IDs left once populated are shared out among the open
+  // measurements, as IDs are never reused
+  uint32_t open_budget =
+      (AUCTION_MAX_NUMBER - config.auctions) /
+      static_cast<uint32_t>(config.steps * thread_counts.size());
+
+  bool persistent = config.engine != STORAGE_ENGINE_MEMORY;
+  storage = make_storage_engine(config.engine);
+  next_auction_id = storage->getAuctionsCount();
+
+  for (uint32_t step = 1; step <= config.steps; ++step) {
+    populate(config.users * step / config.steps,
+             config.auctions * step / config.steps);
+
+    if (persistent) {
+      // Destroying the engine flushes its pending writes, which are not
+      // timed; the restart reads everything back
+      storage.reset();
+      auto start = std::chrono::steady_clock::now();
+      storage = make_storage_engine(config.engine);
+      std::chrono::duration<double, std::micro> elapsed =
+          std::chrono::steady_clock::now() - start;
+      rows.push_back({registered_users, auctionCount(), "startup", 1, 1,
+                      elapsed.count() / 1e6, elapsed.count(),
+                      elapsed.count()});
+    }
+
+    for (uint32_t threads : thread_counts) {
+      measure("getAllAuctions", threads, config.ops,
+              [&](uint32_t, std::mt19937 &) {
+                auto auctions = storage->getAllAuctions();
+                return !auctions.empty();
+              });
+      measure("getUserAuctions", threads, config.ops,
+              [&](uint32_t, std::mt19937 &random) {
+                storage->getUserAuctions(userIdOf(pickUser(random)), "HOSTED");
+                return true;
+              });
+      measure("getAuction", threads, config.ops,
+              [&](uint32_t, std::mt19937 &random) {
+                storage->getAuction(pickAuction(random));
+                return true;
+              });
+      measure("getAuctionsCount", threads, config.ops,
+              [&](uint32_t, std::mt19937 &) {
+                return storage->getAuctionsCount() > 0;
+              });
+
+      // Read outside the timed calls, as the handlers do before bidding
+      std::vector<AuctionData> auctions;
+      std::mt19937 random(threads);
+      for (uint32_t i = 0; i < std::min(config.ops, 64u); ++i) {
+        auctions.push_back(storage->getAuction(pickAuction(random)));
+      }
+      std::vector<std::vector<AuctionData>> targets(threads, auctions);
+      measure("bid", threads, config.ops,
+              [&](uint32_t thread, std::mt19937 &thread_random) {
+                AuctionData &auction =
+                    targets[thread][std::uniform_int_distribution<size_t>(
+                        0, auctions.size() - 1)(thread_random)];
+                try {
+                  storage->bid(auction, next_bid_value++,
+                               userIdOf(pickUser(thread_random)));
+                } catch (LargerBidAlreadyExistsException &e) {
+                  // Lost a race with another thread, as clients can
+                }
+                return true;
+              });
+
+      opened_auctions.assign(threads, {});
+      measure("openAuction", threads, open_budget / threads,
+              [&](uint32_t thread, std::mt19937 &thread_random) {
+                auto auction = openAuction(pickUser(thread_random));
+                if (!auction) {
+                  return false;
+                }
+                opened_auctions[thread].push_back(*auction);
+                return true;
+              });
+      measure("closeAuction", threads, config.ops,
+              [&](uint32_t thread, std::mt19937 &) {
+                if (opened_auctions[thread].empty()) {
+                  return false;
+                }
+                storage->closeAuction(opened_auctions[thread].back());
+                opened_auctions[thread].pop_back();
+                return true;
+              });
+    }
+  }
+  storage->shutdown();
+}
+
+void StoreBench::printJson(std::ostream &stream) {
+  stream << "{\n  \"engine\": \"" << config.engine
+         << "\",\n  \"bids_per_auction\": " << config.bids
+         << ",\n  \"results\": [";
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const StoreBenchRow &row = rows[i];
+    stream << (i == 0 ? "\n" : ",\n") << "    {\"users\": " << row.users
+           << ", \"auctions\": " << row.auctions << ", \"operation\": \""
+           << row.operation << "\", \"threads\": " << row.threads
+           << ", \"ops\": " << row.ops << ", \"ops_per_sec\": "
+           << static_cast<double>(row.ops) / row.seconds
+           << ", \"mean_us\": " << row.mean_us
+           << ", \"p99_us\": " << row.p99_us << "}";
+  }
+  stream << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,91 @@
+#include "asset_store.hpp"
+
+#include <iostream>
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+#include "logger.hpp"
+#include "sha256.hpp"
+
+AssetUpload::~AssetUpload() {
+  if (!staging_path.empty()) {
+    std::error_code ec;
+    std::filesystem::remove(staging_path, ec);
+  }
+}
+
+AssetStore::AssetStore(const std::filesystem::path &__root) : root{__root} {
+  std::filesystem::create_directories(root / ASSET_STAGING_DIR);
+}
+
+std::filesystem::path AssetStore::blobPath(const std::string &hash) const {
+  // Fan out by the first byte of the hash to keep directories small
+  return root / hash.substr(0, 2) / hash;
+}
+
+std::filesystem::path AssetStore::newStagingPath() {
+  return root / ASSET_STAGING_DIR /
+         ("upload_" + std::to_string(stagingCounter++));
+}
+
+void AssetStore::commit(AssetUpload &upload) {
+  if (!is_sha256_hex(upload.hash)) {
+    throw InvalidAuctionAssetException(upload.hash);
+  }
+  std::filesystem::path blob = blobPath(upload.hash);
+
+  std::lock_guard<std::mutex> lock(refcountsLock);
+  if (std::filesystem::exists(blob)) {
+    // Already stored, the staging file is dropped by the upload
+  } else {
+    std::filesystem::create_directory(blob.parent_path());
+    std::filesystem::rename(upload.staging_path, blob);
+    upload.staging_path.clear();
+  }
+  refcounts[upload.hash]++;
+}
+
+void AssetStore::addReference(const std::string &hash) {
+  std::lock_guard<std::mutex> lock(refcountsLock);
+  refcounts[hash]++;
+}
+
+void AssetStore::releaseReference(const std::string &hash) {
+  std::lock_guard<std::mutex> lock(refcountsLock);
+  auto refcount = refcounts.find(hash);
+  if (refcount == refcounts.end()) {
+    return;
+  }
+  if (--refcount->second == 0) {
+    refcounts.erase(refcount);
+    std::error_code ec;
+    std::filesystem::remove(blobPath(hash), ec);
+  }
+}
+
+void AssetStore::collectGarbage() {
+  std::lock_guard<std::mutex> lock(refcountsLock);
+  uint32_t removed = 0;
+  for (const auto &shard : std::filesystem::directory_iterator(root)) {
+    if (!shard.is_directory()) {
+      continue;
+    }
+    if (shard.path().filename() == ASSET_STAGING_DIR) {
+      // Uploads that were never committed
+      for (const auto &entry : std::filesystem::directory_iterator(shard)) {
+        std::filesystem::remove(entry.path());
+      }
+      continue;
+    }
+    for (const auto &blob : std::filesystem::directory_iterator(shard)) {
+      std::string hash = blob.path().filename().string();
+      if (refcounts.find(hash) == refcounts.end()) {
+        std::filesystem::remove(blob.path());
+        removed++;
+      }
+    }
+  }
+  if (removed > 0) {
+    cinfo << "Removed " << removed << " unreferenced asset(s)" << std::endl;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// An asset being uploaded: it is received into a staging file and hashed on
+// the fly. If it is never committed to the store, the staging file is removed.
+class AssetUpload {
+public:
+  std::filesystem::path staging_path;
+  // Set instead of staging_path when the asset is received into memory
+  std::shared_ptr<std::string> contents;
+  std::string hash;
+
+  AssetUpload() = default;
+  AssetUpload(const AssetUpload &) = delete;
+  AssetUpload &operator=(const AssetUpload &) = delete;
+  ~AssetUpload();
+};
+
+// Content-addressed asset store: each distinct asset is stored once under its
+// SHA-256 hash and auctions hold references to it. Blobs whose reference
+// count drops to zero are garbage collected.
+class AssetStore {
+  std::filesystem::path root;
+  std::unordered_map<std::string, uint32_t> refcounts;
+  std::mutex refcountsLock;
+  std::atomic<uint64_t> stagingCounter{0};
+
+public:
+  AssetStore(const std::filesystem::path &__root);
+  std::filesystem::path blobPath(const std::string &hash) const;
+  std::filesystem::path newStagingPath();
+  // Moves the upload into the store (or drops it if already stored) and
+  // takes a reference to it
+  void commit(AssetUpload &upload);
+  void addReference(const std::string &hash);
+  void releaseReference(const std::string &hash);
+  // Removes blobs nobody references and leftover staging files
+  void collectGarbage();
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "auction_archive.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+
+static void appendDurably(const std::filesystem::path &file_path,
+                          const std::string &data) {
+  int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    throw FileOpenException(file_path.string());
+  }
+  size_t written = 0;
+  while (written < data.length()) {
+    ssize_t n = write(fd, data.c_str() + written, data.length() - written);
+    if (n < 0) {
+      close(fd);
+      throw FileWriteException(file_path.string());
+    }
+    written += (size_t)n;
+  }
+  if (fsync(fd) != 0) {
+    close(fd);
+    throw FileWriteException(file_path.string());
+  }
+  close(fd);
+}
+
+AuctionArchive::AuctionArchive(const std::filesystem::path &__root)
+    : root{__root} {
+  std::filesystem::create_directories(root);
+  loadIndex();
+}
+
+std::filesystem::path AuctionArchive::segmentPath(uint32_t segment) const {
+  std::ostringstream oss;
+  oss << "SEGMENT_" << std::setw(6) << std::setfill('0') << segment << ".pack";
+  return root / oss.str();
+}
+
+void AuctionArchive::loadIndex() {
+  std::ifstream file(root / ARCHIVE_INDEX_FILE);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    uint32_t auctionId;
+    ArchiveLocation location;
+    if (ss >> auctionId >> location.segment >> location.offset >>
+        location.length) {
+      // Later entries take precedence, an auction may be packed again if
+      // the server stopped before its directory was removed
+      index[auctionId] = location;
+      currentSegment = std::max(currentSegment, location.segment);
+    }
+  }
+
+  if (std::filesystem::exists(segmentPath(currentSegment))) {
+    currentSegmentSize =
+        (uint64_t)std::filesystem::file_size(segmentPath(currentSegment));
+  }
+}
+
+bool AuctionArchive::contains(uint32_t auctionId) {
+  std::lock_guard<std::mutex> lock(indexLock);
+  return index.find(auctionId) != index.end();
+}
+
+std::vector<uint32_t> AuctionArchive::getAuctionIds() {
+  std::lock_guard<std::mutex> lock(indexLock);
+  std::vector<uint32_t> ids;
+  ids.reserve(index.size());
+  for (const auto &entry : index) {
+    ids.push_back(entry.first);
+  }
+  return ids;
+}
+
+std::string AuctionArchive::read(uint32_t auctionId) {
+  ArchiveLocation location;
+  {
+    std::lock_guard<std::mutex> lock(indexLock);
+    auto entry = index.find(auctionId);
+    if (entry == index.end()) {
+      throw AuctionDoesNotExistException(std::to_string(auctionId));
+    }
+    location = entry->second;
+  }
+
+  std::filesystem::path segment = segmentPath(location.segment);
+  std::ifstream file(segment, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    throw FileOpenException(segment.string());
+  }
+  std::string record(location.length, '\0');
+  file.seekg((std::streamoff)location.offset);
+  file.read(&record[0], (std::streamsize)location.length);
+  if (!file.good()) {
+    throw FileReadException(segment.string());
+  }
+  return record;
+}
+
+void AuctionArchive::append(uint32_t auctionId, const std::string &record) {
+  std::lock_guard<std::mutex> lock(indexLock);
+  if (currentSegmentSize > 0 &&
+      currentSegmentSize + record.length() > ARCHIVE_SEGMENT_MAX_BYTES) {
+    currentSegment++;
+    currentSegmentSize = 0;
+  }
+
+  ArchiveLocation location;
+  location.segment = currentSegment;
+  location.offset = currentSegmentSize;
+  location.length = record.length();
+
+  // The record must be on disk before the index points to it
+  appendDurably(segmentPath(location.segment), record);
+  currentSegmentSize += record.length();
+
+  std::ostringstream entry;
+  entry << auctionId << " " << location.segment << " " << location.offset
+        << " " << location.length << "\n";
+  appendDurably(root / ARCHIVE_INDEX_FILE, entry.str());
+
+  index[auctionId] = location;
+}
@@ -0,0 +1,40 @@
+#ifndef AUCTION_ARCHIVE_H
+#define AUCTION_ARCHIVE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ArchiveLocation {
+  uint32_t segment;
+  uint64_t offset;
+  uint64_t length;
+};
+
+// Cold storage for closed auctions. Each auction is packed into a single
+// record appended to a segment file, and an append-only index maps auction
+// IDs to the location of their record.
+class AuctionArchive {
+  std::filesystem::path root;
+  std::map<uint32_t, ArchiveLocation> index;
+  std::mutex indexLock;
+  uint32_t currentSegment = 0;
+  uint64_t currentSegmentSize = 0;
+
+  std::filesystem::path segmentPath(uint32_t segment) const;
+  void loadIndex();
+
+public:
+  AuctionArchive(const std::filesystem::path &__root);
+  bool contains(uint32_t auctionId);
+  std::vector<uint32_t> getAuctionIds();
+  // Returns the record of an archived auction
+  std::string read(uint32_t auctionId);
+  // Durably appends the record of an auction to the archive
+  void append(uint32_t auctionId, const std::string &record);
+};
+
+#endif
@@ -81,15 +81,17 @@ std::string AuctionData::getStartTimeString() const {
   return ss.str();
 }
 
-std ::string AuctionData::getEndTimeString() const { return endTime; }
+const std::string &AuctionData::getEndTimeString() const { return endTime; }
 
-std::string AuctionData::getAssetFname() const { return assetFname; }
+const std::string &AuctionData::getAssetFname() const {
+  return assetFname;
+}
 
 std::time_t AuctionData::getStartTime() const { return startTime; }
 
 uint32_t AuctionData::getEndTimeSec() const { return endTimeSec; }
 
-std::vector<Bid> AuctionData::getBids() const { return bids; }
+const std::vector<Bid> &AuctionData::getBids() const { return bids; }
 
 bool AuctionData::hasBids() const { return bids.size() > 0; }
 
@@ -30,15 +30,15 @@ public:
   uint32_t getId() const;
   std::string getUidString() const;
   std::string toString() const;
-  std::string getAssetFname() const;
+  const std::string &getAssetFname() const;
   const std::string &getName() const;
   uint32_t getInitialBid() const;
   uint32_t getDurationSeconds() const;
   std::time_t getStartTime() const;
   std::string getStartTimeString() const;
-  std::string getEndTimeString() const;
+  const std::string &getEndTimeString() const;
   uint32_t getEndTimeSec() const;
-  std::vector<Bid> getBids() const;
+  const std::vector<Bid> &getBids() const;
   bool hasBids() const;
   bool isActive() const;
   uint32_t getOwnerId() const;
@@ -11,9 +11,16 @@
 #define TCP_READ_TIMEOUT_SECONDS (15)
 #define TCP_WRITE_TIMEOUT_SECONDS (20 * 60) // 20 minutes
 #define SERVER_RECV_RESTART_TIMEOUT_SECONDS (3)
+// Kept-alive connections are closed after being idle for this long
+#define TCP_KEEPALIVE_IDLE_SECONDS (30)
+// Idle kept-alive connections held by the server, the longest idle ones are
+// closed past this
+#define TCP_KEEPALIVE_MAX_IDLE_CONNECTIONS (512)
 
 #define SOCKET_BUFFER_LEN (8192) // 8KB to be able to read 6010 bytes
 #define PACKET_ID_LEN (3)
+// Everything a TCP packet sends before its file data
+#define TCP_HEADER_BUFFER_LEN (256)
 
 #define USER_ID_STR_LEN (6)
 #define USER_ID_MAX ((uint32_t)pow(10, USER_ID_STR_LEN) - 1)
@@ -37,6 +44,8 @@
 
 #define SECONDS_MAX_LEN (6)
 
+#define ADMIN_STAT_NAME_MAX_LEN (32)
+
 #define ASSETS_RELATIVE_DIRERCTORY "ASSETS"
 
 #define EXCEPTION_RETRY_MAX (3)
@@ -48,12 +57,105 @@
 #define BASE_DIR "ASDIR/"
 #define AUCTION_DIR "AUCTIONS/"
 #define USER_DIR "USERS/"
+#define ASSET_STORE_DIR "ASSETS/"
+#define ASSET_STAGING_DIR "STAGING"
+#define ARCHIVE_DIR "ARCHIVE/"
+#define ARCHIVE_INDEX_FILE "INDEX.txt"
+
+#define ARCHIVE_SEGMENT_MAX_BYTES (64 * 1024 * 1024)
+#define ARCHIVE_MIN_AGE_SECONDS (60 * 60) // Closed for at least 1 hour
+#define ARCHIVE_COMPACTION_INTERVAL_SECONDS (60)
+
+#define STORAGE_ENGINE_FILESYSTEM "fs"
+#define STORAGE_ENGINE_MEMORY "memory"
+#define DEFAULT_STORAGE_ENGINE STORAGE_ENGINE_FILESYSTEM
+
+#define WRITE_BEHIND_QUEUE_MAX_LEN (4096)
+// A failed write is retried with a delay doubling up to the maximum
+#define WRITE_BEHIND_RETRY_MS (100)
+#define WRITE_BEHIND_RETRY_MAX_MS (5000)
+// Attempts made at shutdown before the failed write is given up
+#define WRITE_BEHIND_SHUTDOWN_RETRIES (5)
+
+// Replies are kept for as long as the client may still be resending
+#define UDP_REPLY_CACHE_TTL_SECONDS (UDP_TIMEOUT_SECONDS * UDP_RESEND_TRIES)
+#define UDP_REPLY_CACHE_MAX_ENTRIES (4096)
+
+// Clients further behind than this many auction changes get the full list
+#define AUCTION_CATALOG_LOG_MAX_LEN (1024)
 
 #define HELP_MENU_COMMAND_COLUMN_WIDTH (28)
 #define HELP_MENU_DESCRIPTION_COLUMN_WIDTH (32)
 #define HELP_MENU_ALIAS_COLUMN_WIDTH (40)
 
+#define METRICS_DUMP_INTERVAL_SECONDS (10)
+// User and auction locks listed in metric dumps, the ones waited on longest
+#define LOCK_REPORT_TOP_N (10)
+// Spans kept per thread until traces are written out
+#define TRACE_RING_CAPACITY (4096)
+#define TRACE_DEFAULT_SAMPLE_EVERY (10)
+// First line of traffic captures, with the version of their format
+#define CAPTURE_FILE_MAGIC "AS-CAPTURE"
+#define CAPTURE_FORMAT_VERSION (1)
+
+// Log messages queued per thread until the flush thread writes them out
+#define LOG_RING_CAPACITY (1024)
+#define LOG_MESSAGE_MAX_LEN (240)
+#define LOG_FLUSH_INTERVAL_MS (50)
+// Messages of a thread that only differ in their numbers let through per
+// second, and how many kinds of them are told apart
+#define LOG_REPEAT_MAX_PER_SECOND (20)
+#define LOG_REPEAT_SLOTS (64)
+
 #define TCP_WORKER_POOL_SIZE (50)
 #define TCP_MAX_QUEUE_SIZE (5)
 
+#define WATCH_MAX_AUCTIONS (20)
+// Watchers that fall this far behind on events are disconnected
+#define WATCH_OUTBOX_MAX_BYTES (64 * 1024)
+
+// Load generator (asload)
+#define LOAD_DEFAULT_USERS (1000)
+#define LOAD_DEFAULT_CONCURRENCY (16)
+#define LOAD_DEFAULT_DURATION_SECONDS (10)
+#define LOAD_DEFAULT_MIX                                                       \
+  "login=10,list=30,show_record=25,bid=20,open=5,show_asset=5,close=5"
+// Simulated users take the IDs from here on, clear of hand-picked ones
+#define LOAD_FIRST_USER_ID (100000)
+#define LOAD_AUCTION_DURATION_SECONDS (600)
+
+// Protocol microbenchmarks (asbench) run each case for at least this long
+#define BENCH_MIN_DURATION_MS (100)
+#define BENCH_ASSET_BYTES (4096)
+
+// Storage benchmark (asstorebench)
+#define STORE_BENCH_DEFAULT_USERS (1000)
+#define STORE_BENCH_DEFAULT_AUCTIONS (500)
+#define STORE_BENCH_DEFAULT_BIDS (20)
+#define STORE_BENCH_DEFAULT_THREADS (8)
+#define STORE_BENCH_DEFAULT_OPS (200)
+#define STORE_BENCH_ASSET_BYTES (4096)
+#define STORE_BENCH_START_VALUE (100)
+
+// Performance regression check (asperf)
+#define PERF_DEFAULT_PORT "58090"
+#define PERF_SCRIPTS_DIR "SCRIPTS"
+#define PERF_DEFAULT_COPIES (32)
+#define PERF_DEFAULT_CONCURRENCY (8)
+// Each metric is the median of the rounds, each on a fresh server
+#define PERF_DEFAULT_ROUNDS (3)
+// Copies of the scripted users take the IDs from here on, clear of asload's
+#define PERF_FIRST_USER_ID (200000)
+// Throughput may drop, and latencies grow, by this much over the baseline
+#define PERF_DEFAULT_TOLERANCE_PERCENT (25)
+// Latencies this close to the baseline pass regardless of the tolerance, as
+// sub-millisecond percentiles vary more than that between runs
+#define PERF_LATENCY_SLACK_MS (2.0)
+// Commands with fewer requests per round have too noisy a p99 to check
+#define PERF_MIN_CHECKED_REQUESTS (1000)
+#define PERF_SERVER_START_TIMEOUT_MS (5000)
+// Requests sent back to back on one connection before each round, whose
+// replies must come back in order
+#define PERF_PIPELINE_CHECK_REQUESTS (30)
+
 #endif
\ No newline at end of file
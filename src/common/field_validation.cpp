@@ -0,0 +1,189 @@
+#include "field_validation.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+enum CharClass : unsigned {
+  DIGIT = 1,
+  ALPHA = 2,
+  NAME_PUNCTUATION = 4, // '_' and '-'
+  DOT = 8,
+};
+
+template <unsigned Classes> static bool matchesScalar(char c) {
+  if ((Classes & DIGIT) && c >= '0' && c <= '9') {
+    return true;
+  }
+  if ((Classes & ALPHA) &&
+      ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+    return true;
+  }
+  if ((Classes & NAME_PUNCTUATION) && (c == '_' || c == '-')) {
+    return true;
+  }
+  return (Classes & DOT) && c == '.';
+}
+
+#if defined(__SSE2__)
+// Bytes above 0x7f compare as negative, so they never fall in a range
+static __m128i inRange(__m128i chars, char low, char high) {
+  return _mm_and_si128(
+      _mm_cmpgt_epi8(chars, _mm_set1_epi8(static_cast<char>(low - 1))),
+      _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(high + 1)), chars));
+}
+
+template <unsigned Classes> static __m128i matchesBlock(__m128i chars) {
+  __m128i match = _mm_setzero_si128();
+  if constexpr ((Classes & DIGIT) != 0) {
+    match = _mm_or_si128(match, inRange(chars, '0', '9'));
+  }
+  if constexpr ((Classes & ALPHA) != 0) {
+    // Setting bit 5 maps 'A'-'Z' onto 'a'-'z' and nothing else onto them
+    __m128i folded = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    match = _mm_or_si128(match, inRange(folded, 'a', 'z'));
+  }
+  if constexpr ((Classes & NAME_PUNCTUATION) != 0) {
+    match = _mm_or_si128(match, _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+    match = _mm_or_si128(match, _mm_cmpeq_epi8(chars, _mm_set1_epi8('-')));
+  }
+  if constexpr ((Classes & DOT) != 0) {
+    match = _mm_or_si128(match, _mm_cmpeq_epi8(chars, _mm_set1_epi8('.')));
+  }
+  return match;
+}
+#endif
+
+#if defined(__AVX2__)
+static __m256i inRange(__m256i chars, char low, char high) {
+  return _mm256_and_si256(
+      _mm256_cmpgt_epi8(chars, _mm256_set1_epi8(static_cast<char>(low - 1))),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), chars));
+}
+
+template <unsigned Classes> static __m256i matchesBlock(__m256i chars) {
+  __m256i match = _mm256_setzero_si256();
+  if constexpr ((Classes & DIGIT) != 0) {
+    match = _mm256_or_si256(match, inRange(chars, '0', '9'));
+  }
+  if constexpr ((Classes & ALPHA) != 0) {
+    __m256i folded = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    match = _mm256_or_si256(match, inRange(folded, 'a', 'z'));
+  }
+  if constexpr ((Classes & NAME_PUNCTUATION) != 0) {
+    match =
+        _mm256_or_si256(match, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_')));
+    match =
+        _mm256_or_si256(match, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('-')));
+  }
+  if constexpr ((Classes & DOT) != 0) {
+    match =
+        _mm256_or_si256(match, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('.')));
+  }
+  return match;
+}
+#endif
+
+template <unsigned Classes> static bool allMatch(std::string_view str) {
+  const char *data = str.data();
+  size_t len = str.length();
+
+#if defined(__AVX2__)
+  while (len >= 32) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    if (static_cast<uint32_t>(_mm256_movemask_epi8(
+            matchesBlock<Classes>(chars))) != 0xffffffffu) {
+      return false;
+    }
+    data += 32;
+    len -= 32;
+  }
+#endif
+
+#if defined(__SSE2__)
+  while (len >= 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    if (_mm_movemask_epi8(matchesBlock<Classes>(chars)) != 0xffff) {
+      return false;
+    }
+    data += 16;
+    len -= 16;
+  }
+  if (len > 0) {
+    // Copy the tail, so no byte past the end of the field is loaded
+    char tail[16] = {0};
+    std::memcpy(tail, data, len);
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tail));
+    uint32_t valid = static_cast<uint32_t>(
+        _mm_movemask_epi8(matchesBlock<Classes>(chars)));
+    uint32_t wanted = (1u << len) - 1;
+    return (valid & wanted) == wanted;
+  }
+  return true;
+#else
+  for (size_t i = 0; i < len; ++i) {
+    if (!matchesScalar<Classes>(data[i])) {
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
+bool is_digits(std::string_view str) { return allMatch<DIGIT>(str); }
+
+bool is_alphanumeric_field(std::string_view str) {
+  return allMatch<DIGIT | ALPHA>(str);
+}
+
+bool is_name_field(std::string_view str) {
+  return allMatch<DIGIT | ALPHA | NAME_PUNCTUATION>(str);
+}
+
+bool is_file_name_field(std::string_view str) {
+  return allMatch<DIGIT | ALPHA | NAME_PUNCTUATION | DOT>(str);
+}
+
+bool parse_digits(std::string_view str, uint32_t &value) {
+  size_t len = str.length();
+  if (len == 0 || len > 8) {
+    return false;
+  }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Right-align the digits in a word, behind leading zeros
+  char block[8];
+  std::memset(block, '0', sizeof(block));
+  std::memcpy(block + sizeof(block) - len, str.data(), len);
+  uint64_t chunk;
+  std::memcpy(&chunk, block, sizeof(chunk));
+
+  // Every byte must be 0x30-0x39: high nibble 3, and still 3 after adding 6
+  if (((chunk & 0xf0f0f0f0f0f0f0f0) |
+       (((chunk + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4)) !=
+      0x3333333333333333) {
+    return false;
+  }
+
+  // Combine pairs of digits, then pairs of pairs, then the two halves
+  chunk -= 0x3030303030303030;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & 0x000000ff000000ff) * 0x000f424000000064) +
+           (((chunk >> 16) & 0x000000ff000000ff) * 0x0000271000000001)) >>
+          32;
+  value = static_cast<uint32_t>(chunk);
+  return true;
+#else
+  uint32_t result = 0;
+  for (char c : str) {
+    if (!matchesScalar<DIGIT>(c)) {
+      return false;
+    }
+    result = result * 10 + static_cast<uint32_t>(c - '0');
+  }
+  value = result;
+  return true;
+#endif
+}
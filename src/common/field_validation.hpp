@@ -0,0 +1,23 @@
+#ifndef FIELD_VALIDATION_H
+#define FIELD_VALIDATION_H
+
+#include <cstdint>
+#include <string_view>
+
+// Character class checks for protocol fields. Fields are classified 32
+// bytes at a time with AVX2, 16 with SSE2, or a byte at a time elsewhere.
+
+// [0-9]
+bool is_digits(std::string_view str);
+// [0-9A-Za-z]
+bool is_alphanumeric_field(std::string_view str);
+// [0-9A-Za-z_-], as in auction names
+bool is_name_field(std::string_view str);
+// [0-9A-Za-z._-], as in asset file names
+bool is_file_name_field(std::string_view str);
+
+// Converts up to 8 digits at once; fails on an empty, longer or
+// non-numeric field
+bool parse_digits(std::string_view str, uint32_t &value);
+
+#endif
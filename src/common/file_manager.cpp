@@ -1,51 +1,230 @@
 #include "file_manager.hpp"
 
-FileManager::FileManager() {
+#include "logger.hpp"
+#include "sha256.hpp"
+#include "tracing.hpp"
+
+FileManager::FileManager()
+    : assetStore(std::filesystem::path(BASE_DIR) / ASSET_STORE_DIR),
+      archive(std::filesystem::path(BASE_DIR) / ARCHIVE_DIR) {
   std::filesystem::create_directory(BASE_DIR);
   std::string UserDir = std::string(BASE_DIR) + std::string("/") + USER_DIR;
   std::filesystem::create_directory(UserDir);
   std::string AuctionDir =
       std::string(BASE_DIR) + std::string("/") + AUCTION_DIR;
   std::filesystem::create_directory(AuctionDir);
+
+  // Directories named after IDs are left over from the flat layout
+  for (const std::string &name : writer.list(UserDir)) {
+    flatLayout = flatLayout || isFlatLayoutName(name);
+  }
+  for (const std::string &name : writer.list(AuctionDir)) {
+    flatLayout = flatLayout || isFlatLayoutName(name);
+  }
+
+  for (const std::string &userId : listUsers()) {
+    if (UserRegistered(userId)) {
+      ++registeredUsers;
+    }
+    if (UserLoggedIn(userId)) {
+      ++loggedInUsers;
+    }
+  }
+
+  // Rebuild the asset reference counts from the auctions referencing them
+  for (const std::string &auctionId : listAuctions()) {
+    std::string hash = getAuctionAssetHash(auctionId);
+    if (!hash.empty()) {
+      assetStore.addReference(hash);
+    }
+  }
+  for (uint32_t auctionIdInt : archive.getAuctionIds()) {
+    std::string auctionId = AuctionData::idToString(auctionIdInt);
+    if (!writer.exists(BASE_DIR + auctionDirectory(auctionId))) {
+      std::string hash = getAuctionAssetHash(auctionId);
+      if (!hash.empty()) {
+        assetStore.addReference(hash);
+      }
+    }
+  }
+  assetStore.collectGarbage();
+
+  if (flatLayout) {
+    migrationThread = std::thread(&FileManager::migrateFlatLayout, this);
+  }
 }
 
-bool FileManager::writeToFile(const std::string &filename,
-                              const std::string &data,
-                              const std::string &directory) {
+FileManager::~FileManager() {
+  stopMigration = true;
+  if (migrationThread.joinable()) {
+    migrationThread.join();
+  }
+}
 
-  std::ofstream file(std::string(BASE_DIR) + std::string("/") + directory +
-                     std::string("/") + filename);
+/* Shard names use the letters a-p, so they never clash with the numeric
+   directories of the flat layout */
+static std::string shardName(uint8_t byte) {
+  std::string name(2, 'a');
+  name[0] = (char)('a' + (byte >> 4));
+  name[1] = (char)('a' + (byte & 0xf));
+  return name;
+}
 
-  if (!file.is_open()) {
-    throw FileOpenException(filename);
-    return false;
+/* FNV-1a, spreads sequential IDs evenly across shards */
+static uint32_t shardHash(const std::string &id) {
+  uint32_t hash = 2166136261u;
+  for (char c : id) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619u;
   }
+  return hash;
+}
 
-  file << data;
+/* Padded and unpadded user IDs refer to the same user */
+static std::string normalizeUserId(const std::string &userId) {
+  return std::to_string(std::stoul(userId));
+}
 
-  if (!file.good()) {
-    throw FileWriteException(filename);
-    return false;
+bool FileManager::isFlatLayoutName(const std::string &name) {
+  return !name.empty() && std::all_of(name.begin(), name.end(), ::isdigit);
+}
+
+std::string FileManager::shardedUserDirectory(const std::string &userId) {
+  uint32_t hash = shardHash(userId);
+  return USER_DIR + shardName((uint8_t)(hash >> 24)) + "/" +
+         shardName((uint8_t)(hash >> 16)) + "/" + userId;
+}
+
+std::string FileManager::shardedAuctionDirectory(const std::string &auctionId) {
+  return AUCTION_DIR + shardName((uint8_t)(shardHash(auctionId) >> 24)) + "/" +
+         auctionId;
+}
+
+/* Directory of a user, relative to BASE_DIR. Users that were not migrated
+   from the flat layout yet are still found there */
+std::string FileManager::userDirectory(const std::string &userId) {
+  std::string id = normalizeUserId(userId);
+  std::string sharded = shardedUserDirectory(id);
+  if (flatLayout) {
+    std::string flat = USER_DIR + id;
+    if (!writer.exists(BASE_DIR + sharded) && writer.exists(BASE_DIR + flat)) {
+      return flat;
+    }
+  }
+  return sharded;
+}
+
+/* Directory of an auction, relative to BASE_DIR */
+std::string FileManager::auctionDirectory(const std::string &auctionId) {
+  std::string sharded = shardedAuctionDirectory(auctionId);
+  if (flatLayout) {
+    std::string flat = AUCTION_DIR + auctionId;
+    if (!writer.exists(BASE_DIR + sharded) && writer.exists(BASE_DIR + flat)) {
+      return flat;
+    }
+  }
+  return sharded;
+}
+
+std::vector<std::string> FileManager::listUsers() {
+  std::vector<std::string> users;
+  std::string userDir = std::string(BASE_DIR) + USER_DIR;
+  for (const std::string &shard : writer.list(userDir)) {
+    if (isFlatLayoutName(shard)) {
+      users.push_back(shard);
+      continue;
+    }
+    for (const std::string &subShard : writer.list(userDir + shard)) {
+      for (const std::string &userId :
+           writer.list(userDir + shard + "/" + subShard)) {
+        users.push_back(userId);
+      }
+    }
+  }
+  return users;
+}
+
+std::vector<std::string> FileManager::listAuctions() {
+  std::vector<std::string> auctions;
+  std::string auctionDir = std::string(BASE_DIR) + AUCTION_DIR;
+  for (const std::string &shard : writer.list(auctionDir)) {
+    if (isFlatLayoutName(shard)) {
+      auctions.push_back(shard);
+      continue;
+    }
+    for (const std::string &auctionId : writer.list(auctionDir + shard)) {
+      auctions.push_back(auctionId);
+    }
+  }
+  return auctions;
+}
+
+/* Online migration from the flat layout: each user and auction is moved
+   while holding its lock. The move goes through the write queue, so writes
+   queued for the flat path by callers that resolved it earlier still land
+   in the sharded directory, and reads keep finding the files at the flat
+   path until the move is applied */
+void FileManager::migrateFlatLayout() {
+  uint32_t migrated = 0;
+  std::string userDir = std::string(BASE_DIR) + USER_DIR;
+  for (const std::string &name : writer.list(userDir)) {
+    if (stopMigration) {
+      return;
+    }
+    if (!isFlatLayoutName(name)) {
+      continue;
+    }
+    safeLockUser(name, [&]() {
+      writer.moveDirectory(userDir + name,
+                           BASE_DIR +
+                               shardedUserDirectory(normalizeUserId(name)));
+      migrated++;
+    });
+  }
+
+  std::string auctionDir = std::string(BASE_DIR) + AUCTION_DIR;
+  for (const std::string &name : writer.list(auctionDir)) {
+    if (stopMigration) {
+      return;
+    }
+    if (!isFlatLayoutName(name)) {
+      continue;
+    }
+    safeLockAuction(name, [&]() {
+      writer.moveDirectory(auctionDir + name,
+                           BASE_DIR + shardedAuctionDirectory(name));
+      migrated++;
+    });
   }
 
-  file.close();
+  flatLayout = false;
+  cinfo << "Migrated " << migrated
+        << " user and auction directories to the sharded layout" << std::endl;
+}
+
+bool FileManager::writeToFile(const std::string &filename,
+                              const std::string &data,
+                              const std::string &directory) {
 
+  writer.write(std::string(BASE_DIR) + std::string("/") + directory +
+                   std::string("/") + filename,
+               data);
   return true;
 }
 
 std::string FileManager::readFromFile(const std::string &filename,
                                       const std::string &directory) {
-  std::ifstream file(std::string(BASE_DIR) + std::string("/") + directory +
-                     std::string("/") + filename);
-  std::string data;
+  TraceSpan span("readFromFile");
+  std::optional<std::string> file = writer.read(
+      std::string(BASE_DIR) + std::string("/") + directory +
+      std::string("/") + filename);
 
-  if (!file.is_open()) {
+  if (!file.has_value()) {
     throw FileOpenException(filename);
     return "";
   }
 
-  std::getline(file, data, '\0');
-  file.close();
+  std::string data = std::move(*file);
 
   if (data.empty()) {
     throw FileReadException(filename);
@@ -55,116 +234,159 @@ std::string FileManager::readFromFile(const std::string &filename,
   return data;
 }
 
+ProfiledMutex &
+FileManager::lookupMutex(std::map<std::string, ProfiledMutex> &mutexes,
+                         const std::string &key) {
+  // Entries are never erased, so the reference outlives the lookup
+  std::scoped_lock<std::mutex> guard(mutexesLock);
+  return mutexes[key];
+}
+
 void FileManager::safeLockUser(const std::string &userId,
                                std::function<void()> func) {
   try {
-    std::lock_guard<std::mutex> lock(userMutexes[userId]);
+    std::unique_lock<ProfiledMutex> lock(
+        lookupMutex(userMutexes, normalizeUserId(userId)), std::defer_lock);
+    {
+      TraceSpan span("user lock wait");
+      lock.lock();
+    }
     func();
   } catch (const std::exception &e) {
-    std::cerr << "An exception occurred: " << e.what() << '\n';
+    cerror << "An exception occurred: " << e.what() << std::endl;
   } catch (...) {
-    std::cerr << "An unknown exception occurred.\n";
+    cerror << "An unknown exception occurred." << std::endl;
   }
 }
 
 void FileManager::safeLockAuction(const std::string &auctionId,
                                   std::function<void()> func) {
   try {
-    std::lock_guard<std::mutex> lock(auctionMutexes[auctionId]);
+    std::unique_lock<ProfiledMutex> lock(
+        lookupMutex(auctionMutexes, auctionId), std::defer_lock);
+    {
+      TraceSpan span("auction lock wait");
+      lock.lock();
+    }
     func();
   } catch (const std::exception &e) {
-    std::cerr << "An exception occurred: " << e.what() << '\n';
+    cerror << "An exception occurred: " << e.what() << std::endl;
   } catch (...) {
-    std::cerr << "An unknown exception occurred.\n";
+    cerror << "An unknown exception occurred." << std::endl;
   }
 }
 
 void FileManager::createUserDirectory(const std::string &userId) {
-  std::string UserDir =
-      std::string(BASE_DIR) + "/" + std::string(USER_DIR) + "/" + userId;
-  std::filesystem::create_directory(UserDir);
-  std::filesystem::create_directory(UserDir + "/HOSTED");
-  std::filesystem::create_directory(UserDir + "/BIDDED");
+  std::filesystem::path userDir =
+      std::filesystem::path(BASE_DIR) / userDirectory(userId);
+  // Create the shards the first time they are used
+  writer.createDirectory(userDir.parent_path().parent_path());
+  writer.createDirectory(userDir.parent_path());
+  std::string UserDir = userDir.string();
+  writer.createDirectory(UserDir);
+  writer.createDirectory(UserDir + "/HOSTED");
+  writer.createDirectory(UserDir + "/BIDDED");
 }
 
 void FileManager::createUserPassFile(const std::string &userId,
                                      const std::string &password) {
-  std::ofstream file(std::string(BASE_DIR) + "/" + USER_DIR + "/" + userId +
-                     "/" + userId + "_pass.txt");
-  file << password;
-  if (!file.good()) {
-    throw FileWriteException(userId + "_pass.txt");
-  }
-  file.close();
+  writer.write(BASE_DIR + userDirectory(userId) + "/" + userId + "_pass.txt",
+               password);
 }
 
 void FileManager::createUserLoginFile(const std::string &userId) {
-  std::ofstream file(std::string(BASE_DIR) + "/" + USER_DIR + "/" + userId +
-                     "/" + userId + "_login.txt");
-  file.close();
+  writer.write(BASE_DIR + userDirectory(userId) + "/" + userId + "_login.txt",
+               "");
 }
 
 void FileManager::removeUserLoginFile(const std::string &userId) {
-  std::filesystem::remove(std::string(BASE_DIR) + "/" + USER_DIR + "/" +
-                          userId + "/" + userId + "_login.txt");
+  writer.remove(BASE_DIR + userDirectory(userId) + "/" + userId +
+                "_login.txt");
 }
 
 void FileManager::removeUserFiles(const std::string &userId) {
-  std::filesystem::remove(std::string(BASE_DIR) + "/" + USER_DIR + "/" +
-                          userId + "/" + userId + "_login.txt");
-  std::filesystem::remove(std::string(BASE_DIR) + "/" + USER_DIR + "/" +
-                          userId + "/" + userId + "_pass.txt");
+  std::string userDir = BASE_DIR + userDirectory(userId);
+  writer.remove(userDir + "/" + userId + "_login.txt");
+  writer.remove(userDir + "/" + userId + "_pass.txt");
 }
 
 void FileManager::createAuctionDirectory(const std::string &auctionId) {
-  std::filesystem::create_directory(std::string(BASE_DIR) + "/" + AUCTION_DIR +
-                                    std::string("/") + auctionId);
+  std::string auctionDir = auctionDirectory(auctionId);
+  // Create the shard the first time it is used
+  writer.createDirectory(
+      BASE_DIR + auctionDir.substr(0, auctionDir.find_last_of('/')));
+  writer.createDirectory(BASE_DIR + auctionDir);
 }
 
 void FileManager::createUserAuctionFile(const std::string &userId,
                                         const std::string &auctionId,
                                         const std::string &directory) {
-  std::ofstream file(std::string(BASE_DIR) + "/" + USER_DIR + std::string("/") +
-                     userId + std::string("/") + directory + std::string("/") +
-                     auctionId);
-  file.close();
+  writer.write(BASE_DIR + userDirectory(userId) + "/" + directory + "/" +
+                   auctionId,
+               "");
 }
 
 void FileManager::removeUserAuctionFile(const std::string &userId,
                                         const std::string &auctionId,
                                         const std::string &directory) {
-  std::filesystem::remove(std::string(BASE_DIR) + "/" + USER_DIR +
-                          std::string("/") + userId + std::string("/") +
-                          directory + std::string("/") + auctionId);
+  writer.remove(BASE_DIR + userDirectory(userId) + "/" + directory + "/" +
+                auctionId);
 }
 
 void FileManager::createAuctionStartFile(const std::string &auctionId,
                                          const AuctionData &data) {
   if (!writeToFile("START (" + auctionId + ").txt", data.toString(),
-                   AUCTION_DIR + std::string("/") + auctionId)) {
-    std::cerr << "Unable to create START file for auction: " << auctionId
-              << std::endl;
+                   auctionDirectory(auctionId))) {
+    cerror << "Unable to create START file for auction: " << auctionId
+           << std::endl;
   }
 }
 
 void FileManager::createAuctionAssetFile(const std::string &auctionId,
-                                         const std::string &assetFname) {
-  /* The file was created when we read the socket */
-  std::filesystem::path destination_filePath =
-      std::filesystem::path(BASE_DIR) / AUCTION_DIR / auctionId / assetFname;
+                                         AssetUpload &upload) {
+  /* The file was staged when we read the socket */
   try {
-    // Check if the source file exists and is a regular file
-    if (std::filesystem::exists(assetFname) &&
-        std::filesystem::is_regular_file(assetFname)) {
-      // Move the file to the destination directory
-      std::filesystem::rename(assetFname, destination_filePath);
-    } else {
-      std::cerr << "Source file does not exist or is not a regular file."
-                << std::endl;
-    }
+    assetStore.commit(upload);
   } catch (const std::filesystem::filesystem_error &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    cerror << "Error: " << e.what() << std::endl;
+    throw FileWriteException(upload.staging_path.string());
   }
+
+  // The auction only keeps a reference to the stored asset
+  try {
+    writeToFile("ASSET (" + auctionId + ").txt", upload.hash,
+                auctionDirectory(auctionId));
+  } catch (...) {
+    assetStore.releaseReference(upload.hash);
+    throw;
+  }
+}
+
+/* Returns an empty string for auctions that store the asset themselves */
+std::string FileManager::getAuctionAssetHash(const std::string &auctionId) {
+  std::string assetFile = "ASSET (" + auctionId + ").txt";
+  if (writer.exists(BASE_DIR + auctionDirectory(auctionId) + "/" +
+                    assetFile)) {
+    return readFromFile(assetFile,
+                        auctionDirectory(auctionId));
+  }
+
+  uint32_t auctionIdInt = static_cast<uint32_t>(std::stoul(auctionId));
+  if (archive.contains(auctionIdInt)) {
+    std::stringstream ss(archive.read(auctionIdInt));
+    std::string line;
+    while (std::getline(ss, line)) {
+      if (line.rfind("ASSET ", 0) == 0) {
+        return line.substr(6);
+      }
+    }
+  }
+  return "";
+}
+
+/* The asset is staged in the asset store while it is received */
+void FileManager::prepareAssetUpload(AssetUpload &upload) {
+  upload.staging_path = assetStore.newStagingPath();
 }
 
 void FileManager::createAuctionEndFile(const std::string &auctionId,
@@ -173,24 +395,22 @@ void FileManager::createAuctionEndFile(const std::string &auctionId,
   std::stringstream ss;
   ss << endTime << " " << activeSeconds;
   if (!writeToFile("END (" + auctionId + ").txt", ss.str(),
-                   AUCTION_DIR + std::string("/") + auctionId)) {
+                   auctionDirectory(auctionId))) {
     throw FileWriteException("END (" + auctionId + ").txt");
   }
 }
 
 void FileManager::createBidsDirectory(const std::string &auctionId) {
-  std::filesystem::create_directory(std::string(BASE_DIR) + "/" + AUCTION_DIR +
-                                    std::string("/") + auctionId + "/BIDS");
+  writer.createDirectory(BASE_DIR + auctionDirectory(auctionId) + "/BIDS");
 }
 
 void FileManager::createBidFile(const std::string &auctionId,
                                 const std::string &userId,
                                 const std::string &bidValue,
                                 std::time_t startTime) {
-  std::string bidFileName = std::string(BASE_DIR) + "/" + AUCTION_DIR +
-                            std::string("/") + auctionId + "/BIDS/" + bidValue +
-                            ".txt";
-  std::ofstream file(bidFileName);
+  TraceSpan span("createBidFile");
+  std::string bidFileName = BASE_DIR + auctionDirectory(auctionId) +
+                            "/BIDS/" + bidValue + ".txt";
 
   // get date of now in format YYYY-MM-DD HH:MM:SS
   std::time_t bidDateTime = time(0);
@@ -198,49 +418,59 @@ void FileManager::createBidFile(const std::string &auctionId,
   // calculate the number of seconds elapsed since the start of the auction
   std::time_t bidSecTime = bidDateTime - startTime;
 
-  if (file.is_open()) {
-    file << userId << " " << bidValue << " "
-         << std::put_time(std::gmtime(&bidDateTime), "%Y-%m-%d %H:%M:%S") << " "
-         << bidSecTime;
-    file.close();
-  } else {
-    throw FileOpenException(bidFileName);
-  }
+  std::ostringstream file;
+  file << userId << " " << bidValue << " "
+       << std::put_time(std::gmtime(&bidDateTime), "%Y-%m-%d %H:%M:%S") << " "
+       << bidSecTime;
+  writer.write(bidFileName, file.str());
 }
 
 std::string FileManager::getUserPassword(const std::string &userId) {
   if (UserRegistered(userId)) {
     return readFromFile(userId + "_pass.txt",
-                        USER_DIR + std::string("/") + std::string(userId));
+                        userDirectory(userId));
   }
   throw UserNotRegisteredException(userId);
   return "";
 }
 
 bool FileManager::UserLoggedIn(const std::string &userId) {
-  return std::filesystem::exists(std::string(BASE_DIR) + "/" + USER_DIR + "/" +
-                                 userId + "/" + userId + "_login.txt");
+  return writer.exists(BASE_DIR + userDirectory(userId) + "/" + userId +
+                       "_login.txt");
 }
 
 bool FileManager::UserRegistered(const std::string &userId) {
-  return std::filesystem::exists(std::string(BASE_DIR) + "/" + USER_DIR + "/" +
-                                 userId + "/" + userId + "_pass.txt");
+  return writer.exists(BASE_DIR + userDirectory(userId) + "/" + userId +
+                       "_pass.txt");
 }
 
 /*Returns True if END file does not exist and therefore auction is active*/
 bool FileManager::auctionIsActive(const std::string &auctionId) {
+  // Only closed auctions are archived
+  if (archive.contains(static_cast<uint32_t>(std::stoul(auctionId)))) {
+    return false;
+  }
 
-  return !std::filesystem::exists(std::string(BASE_DIR) + "/" + AUCTION_DIR +
-                                  std::string("/") + auctionId + "/END (" +
-                                  auctionId + ").txt");
+  return !writer.exists(BASE_DIR + auctionDirectory(auctionId) + "/END (" +
+                        auctionId + ").txt");
 }
 
 void FileManager::loginUser(const std::string &userId) {
-  safeLockUser(userId, [&]() { createUserLoginFile(userId); });
+  safeLockUser(userId, [&]() {
+    if (!UserLoggedIn(userId)) {
+      ++loggedInUsers;
+    }
+    createUserLoginFile(userId);
+  });
 }
 
 void FileManager::logoutUser(const std::string &userId) {
-  safeLockUser(userId, [&]() { removeUserLoginFile(userId); });
+  safeLockUser(userId, [&]() {
+    if (UserLoggedIn(userId)) {
+      --loggedInUsers;
+    }
+    removeUserLoginFile(userId);
+  });
 }
 
 void FileManager::registerUser(const std::string &userId,
@@ -248,22 +478,32 @@ void FileManager::registerUser(const std::string &userId,
 
   safeLockUser(userId, [&]() { createUserDirectory(userId); });
 
-  safeLockUser(userId, [&]() { createUserPassFile(userId, password); });
+  safeLockUser(userId, [&]() {
+    if (!UserRegistered(userId)) {
+      ++registeredUsers;
+    }
+    createUserPassFile(userId, password);
+  });
 }
 
 void FileManager::unregisterUser(const std::string &userId) {
-  safeLockUser(userId, [&]() { removeUserFiles(userId); });
+  safeLockUser(userId, [&]() {
+    if (UserRegistered(userId)) {
+      --registeredUsers;
+    }
+    if (UserLoggedIn(userId)) {
+      --loggedInUsers;
+    }
+    removeUserFiles(userId);
+  });
 }
 
 std::vector<std::pair<uint32_t, bool>>
 FileManager::getUserAuctions(const std::string &userId,
                              const std::string &directory) {
   std::vector<std::pair<uint32_t, bool>> auctionList;
-  for (const auto &entry : std::filesystem::directory_iterator(
-           std::string(BASE_DIR) + "/" + USER_DIR + std::string("/") + userId +
-           std::string("/") + directory)) {
-    std::string auctionId = entry.path().filename().string();
-
+  for (const std::string &auctionId :
+       writer.list(BASE_DIR + userDirectory(userId) + "/" + directory)) {
     safeLockAuction(auctionId, [&]() {
       // update auction
       UpdateAuction(auctionId);
@@ -284,18 +524,28 @@ FileManager::getUserAuctions(const std::string &userId,
 
 std::vector<std::pair<uint32_t, bool>> FileManager::getAllAuctions() {
   std::vector<std::pair<uint32_t, bool>> auctionList;
-  for (const auto &entry : std::filesystem::directory_iterator(
-           std::string(BASE_DIR) + "/" + AUCTION_DIR)) {
-    if (std::filesystem::is_directory(entry.status())) {
-      // update auction
-      std::string auctionId = entry.path().filename().string();
-      safeLockAuction(auctionId, [&]() {
-        UpdateAuction(auctionId);
-        bool isActive = auctionIsActive(auctionId);
-        uint32_t intAuctionId = static_cast<uint32_t>(std::stoi(auctionId));
+  for (const std::string &auctionId : listAuctions()) {
+    // update auction
+    safeLockAuction(auctionId, [&]() {
+      UpdateAuction(auctionId);
+      bool isActive = auctionIsActive(auctionId);
+      uint32_t intAuctionId = static_cast<uint32_t>(std::stoi(auctionId));
+
+      auctionList.push_back(std::make_pair(intAuctionId, isActive));
+    });
+  }
 
-        auctionList.push_back(std::make_pair(intAuctionId, isActive));
-      });
+  // Archived auctions are always closed
+  std::vector<uint32_t> archivedIds = archive.getAuctionIds();
+  size_t liveCount = auctionList.size();
+  std::sort(auctionList.begin(), auctionList.end());
+  for (uint32_t auctionIdInt : archivedIds) {
+    auto live = std::lower_bound(auctionList.begin(),
+                                 auctionList.begin() + (long)liveCount,
+                                 std::make_pair(auctionIdInt, false));
+    if (live == auctionList.begin() + (long)liveCount ||
+        live->first != auctionIdInt) {
+      auctionList.push_back(std::make_pair(auctionIdInt, false));
     }
   }
 
@@ -311,90 +561,109 @@ std::vector<std::pair<uint32_t, bool>> FileManager::getAllAuctions() {
 }
 
 AuctionData FileManager::getAuction(const uint32_t auctionIdInt) {
+  TraceSpan span("getAuction");
   AuctionData data;
 
   std::string auctionId = AuctionData::idToString(auctionIdInt);
+  std::string startFileName = "START (" + auctionId + ").txt";
   // check if start file exists
-  if (!std::filesystem::exists(std::string(BASE_DIR) +
-                               std::string(AUCTION_DIR) + auctionId +
-                               "/START (" + auctionId + ").txt")) {
+  if (!writer.exists(BASE_DIR + auctionDirectory(auctionId) + "/" +
+                     startFileName) &&
+      !archive.contains(auctionIdInt)) {
     throw AuctionDoesNotExistException(auctionId);
   }
 
   safeLockAuction(auctionId, [&]() {
+    if (!writer.exists(BASE_DIR + auctionDirectory(auctionId) + "/" +
+                       startFileName)) {
+      // The auction was packed into the archive
+      data = unpackAuction(auctionIdInt, archive.read(auctionIdInt));
+      return;
+    }
+
     // update Auction
     UpdateAuction(auctionId);
     std::string startFile =
         readFromFile("START (" + auctionId + ").txt",
-                     AUCTION_DIR + std::string("/") + auctionId);
-    std::stringstream ss(startFile);
-    std::string uid, name, assetFname, startValue, timeActive, startDate,
-        startHour, startFulltime;
-    std::getline(ss, uid, ' ');
-    std::getline(ss, name, ' ');
-    std::getline(ss, assetFname, ' ');
-    std::getline(ss, startValue, ' ');
-    std::getline(ss, timeActive, ' ');
-    std::getline(ss, startDate, ' ');
-    std::getline(ss, startHour, ' ');
-    std::getline(ss, startFulltime, ' ');
-
-    uint32_t initialBid = static_cast<uint32_t>(std::stoul(startValue));
-    uint32_t durationSeconds = static_cast<uint32_t>(std::stoul(timeActive));
-    uint32_t uidInt = static_cast<uint32_t>(std::stoul(uid));
-
-    std::time_t startTime = static_cast<std::time_t>(std::stoll(startFulltime));
-
+                     auctionDirectory(auctionId));
+    std::string endFile;
     if (!auctionIsActive(auctionId)) {
-
-      std::string endFile =
-          readFromFile("END (" + auctionId + ").txt",
-                       AUCTION_DIR + std::string("/") + auctionId);
-      std::stringstream ssEnd(endFile);
-      std::string endDate, endHour, endSecTime;
-      std::getline(ssEnd, endDate, ' ');
-      std::getline(ssEnd, endHour, ' ');
-      std::getline(ssEnd, endSecTime, ' ');
-
-      uint32_t endTimeSec = static_cast<uint32_t>(std::stoul(endSecTime));
-
-      std ::vector<Bid> bids = getAuctionBids(auctionId);
-      data = AuctionData(auctionIdInt, uidInt, name, initialBid,
-                         durationSeconds, assetFname, startTime,
-                         endDate + ' ' + endHour, endTimeSec, bids);
-    } else {
-      std::string endDatetime = " ";
-      std ::vector<Bid> bids = getAuctionBids(auctionId);
-      data =
-          AuctionData(auctionIdInt, uidInt, name, initialBid, durationSeconds,
-                      assetFname, startTime, endDatetime, 0, bids);
+      endFile = readFromFile("END (" + auctionId + ").txt",
+                             auctionDirectory(auctionId));
     }
+    data = parseAuction(auctionIdInt, startFile, endFile,
+                        getAuctionBids(auctionId));
   });
 
   return data;
 }
 
+/* An empty endFile means the auction is still active */
+AuctionData FileManager::parseAuction(const uint32_t auctionIdInt,
+                                      const std::string &startFile,
+                                      const std::string &endFile,
+                                      const std::vector<Bid> &bids) {
+  std::stringstream ss(startFile);
+  std::string uid, name, assetFname, startValue, timeActive, startDate,
+      startHour, startFulltime;
+  std::getline(ss, uid, ' ');
+  std::getline(ss, name, ' ');
+  std::getline(ss, assetFname, ' ');
+  std::getline(ss, startValue, ' ');
+  std::getline(ss, timeActive, ' ');
+  std::getline(ss, startDate, ' ');
+  std::getline(ss, startHour, ' ');
+  std::getline(ss, startFulltime, ' ');
+
+  uint32_t initialBid = static_cast<uint32_t>(std::stoul(startValue));
+  uint32_t durationSeconds = static_cast<uint32_t>(std::stoul(timeActive));
+  uint32_t uidInt = static_cast<uint32_t>(std::stoul(uid));
+
+  std::time_t startTime = static_cast<std::time_t>(std::stoll(startFulltime));
+
+  if (!endFile.empty()) {
+    std::stringstream ssEnd(endFile);
+    std::string endDate, endHour, endSecTime;
+    std::getline(ssEnd, endDate, ' ');
+    std::getline(ssEnd, endHour, ' ');
+    std::getline(ssEnd, endSecTime, ' ');
+
+    uint32_t endTimeSec = static_cast<uint32_t>(std::stoul(endSecTime));
+
+    return AuctionData(auctionIdInt, uidInt, name, initialBid,
+                       durationSeconds, assetFname, startTime,
+                       endDate + ' ' + endHour, endTimeSec, bids);
+  } else {
+    std::string endDatetime = " ";
+    return AuctionData(auctionIdInt, uidInt, name, initialBid,
+                       durationSeconds, assetFname, startTime, endDatetime, 0,
+                       bids);
+  }
+}
+
+Bid FileManager::parseBid(const std::string &bidFile) {
+  std::stringstream ss(bidFile);
+  std::string bidder_user_id, bid_value, date, hours, sec_time;
+  std::getline(ss, bidder_user_id, ' ');
+  std::getline(ss, bid_value, ' ');
+  std::getline(ss, date, ' ');
+  std::getline(ss, hours, ' ');
+  std::getline(ss, sec_time, ' ');
+  Bid bid;
+  bid.bidder_user_id = static_cast<uint32_t>(std::stoi(bidder_user_id));
+  bid.bid_value = static_cast<uint32_t>(std::stoi(bid_value));
+  bid.date_time = date + ' ' + hours;
+  bid.sec_time = static_cast<uint32_t>(std::stoi(sec_time));
+  return bid;
+}
+
 std::vector<Bid> FileManager::getAuctionBids(const std::string &auctionId) {
   std::vector<Bid> bids;
-  for (const auto &entry : std::filesystem::directory_iterator(
-           std::string(BASE_DIR) + "/" + AUCTION_DIR + std::string("/") +
-           auctionId + "/BIDS")) {
-    std::string bidValue = entry.path().filename().string();
-    std::string bidFile = readFromFile(
-        bidValue, AUCTION_DIR + std::string("/") + auctionId + "/BIDS");
-    std::stringstream ss(bidFile);
-    std::string bidder_user_id, bid_value, date, hours, sec_time;
-    std::getline(ss, bidder_user_id, ' ');
-    std::getline(ss, bid_value, ' ');
-    std::getline(ss, date, ' ');
-    std::getline(ss, hours, ' ');
-    std::getline(ss, sec_time, ' ');
-    Bid bid;
-    bid.bidder_user_id = static_cast<uint32_t>(std::stoi(bidder_user_id));
-    bid.bid_value = static_cast<uint32_t>(std::stoi(bid_value));
-    bid.date_time = date + ' ' + hours;
-    bid.sec_time = static_cast<uint32_t>(std::stoi(sec_time));
-    bids.push_back(bid);
+  for (const std::string &bidValue :
+       writer.list(BASE_DIR + auctionDirectory(auctionId) + "/BIDS")) {
+    std::string bidFile =
+        readFromFile(bidValue, auctionDirectory(auctionId) + "/BIDS");
+    bids.push_back(parseBid(bidFile));
   }
 
   // sort bids by bid value
@@ -406,8 +675,109 @@ std::vector<Bid> FileManager::getAuctionBids(const std::string &auctionId) {
   return bids;
 }
 
+/* Packs the files of a closed auction into a single archive record:
+   one "<FILE> <contents>" line per START, END, ASSET and bid file */
+std::string FileManager::packAuction(const std::string &auctionId) {
+  std::string auctionDir = auctionDirectory(auctionId);
+  std::ostringstream record;
+  record << "START "
+         << readFromFile("START (" + auctionId + ").txt", auctionDir) << "\n";
+  record << "END " << readFromFile("END (" + auctionId + ").txt", auctionDir)
+         << "\n";
+
+  std::string hash = getAuctionAssetHash(auctionId);
+  if (hash.empty()) {
+    // Move assets stored by the auction itself into the asset store, so the
+    // record only needs to reference them
+    AuctionData data = parseAuction(
+        static_cast<uint32_t>(std::stoul(auctionId)),
+        readFromFile("START (" + auctionId + ").txt", auctionDir), "", {});
+    std::filesystem::path legacyPath =
+        std::filesystem::path(BASE_DIR) / auctionDir / data.getAssetFname();
+    if (std::filesystem::exists(legacyPath)) {
+      AssetUpload upload;
+      upload.staging_path = assetStore.newStagingPath();
+      std::filesystem::rename(legacyPath, upload.staging_path);
+      upload.hash = sha256_file(upload.staging_path);
+      createAuctionAssetFile(auctionId, upload);
+      hash = upload.hash;
+    }
+  }
+  if (!hash.empty()) {
+    record << "ASSET " << hash << "\n";
+  }
+
+  for (const std::string &bidValue :
+       writer.list(std::string(BASE_DIR) + "/" + auctionDir + "/BIDS")) {
+    record << "BID " << readFromFile(bidValue, auctionDir + "/BIDS") << "\n";
+  }
+  return record.str();
+}
+
+AuctionData FileManager::unpackAuction(const uint32_t auctionIdInt,
+                                       const std::string &record) {
+  std::stringstream ss(record);
+  std::string line, startFile, endFile;
+  std::vector<Bid> bids;
+  while (std::getline(ss, line)) {
+    if (line.rfind("START ", 0) == 0) {
+      startFile = line.substr(6);
+    } else if (line.rfind("END ", 0) == 0) {
+      endFile = line.substr(4);
+    } else if (line.rfind("BID ", 0) == 0) {
+      bids.push_back(parseBid(line.substr(4)));
+    }
+  }
+  if (startFile.empty() || endFile.empty()) {
+    throw FileReadException("archived auction " +
+                            AuctionData::idToString(auctionIdInt));
+  }
+
+  std::sort(bids.begin(), bids.end(), [](const Bid &a, const Bid &b) {
+    return a.bid_value < b.bid_value;
+  });
+
+  return parseAuction(auctionIdInt, startFile, endFile, bids);
+}
+
+/* Packs auctions closed for at least minAgeSeconds into the archive and
+   removes their directories. Returns the number of archived auctions */
+uint32_t FileManager::archiveClosedAuctions(uint32_t minAgeSeconds) {
+  std::vector<std::string> auctionIds = listAuctions();
+
+  uint32_t archived = 0;
+  std::time_t now = std::time(nullptr);
+  for (const std::string &auctionId : auctionIds) {
+    safeLockAuction(auctionId, [&]() {
+      std::string auctionDir = auctionDirectory(auctionId);
+      UpdateAuction(auctionId);
+      if (auctionIsActive(auctionId)) {
+        return;
+      }
+
+      uint32_t auctionIdInt = static_cast<uint32_t>(std::stoul(auctionId));
+      AuctionData data = parseAuction(
+          auctionIdInt,
+          readFromFile("START (" + auctionId + ").txt", auctionDir),
+          readFromFile("END (" + auctionId + ").txt", auctionDir), {});
+      std::time_t endTime = data.getStartTime() + data.getEndTimeSec();
+      if (endTime + minAgeSeconds > now) {
+        return;
+      }
+
+      archive.append(auctionIdInt, packAuction(auctionId));
+      // Nothing may be pending in the directory when it is removed
+      writer.flush();
+      std::filesystem::remove_all(BASE_DIR + auctionDir);
+      archived++;
+    });
+  }
+  return archived;
+}
+
 void FileManager::openAuction(const std::string &userId,
-                              const AuctionData &data) {
+                              const AuctionData &data, AssetUpload &upload) {
+  TraceSpan span("openAuction");
 
   // print
   std::string auctionId = data.getIdString();
@@ -418,9 +788,8 @@ void FileManager::openAuction(const std::string &userId,
   safeLockAuction(auctionId,
                   [&]() { createAuctionStartFile(auctionId, data); });
   safeLockAuction(auctionId, [&]() { createBidsDirectory(auctionId); });
-  safeLockAuction(auctionId, [&]() {
-    createAuctionAssetFile(auctionId, data.getAssetFname());
-  });
+  safeLockAuction(auctionId,
+                  [&]() { createAuctionAssetFile(auctionId, upload); });
 }
 
 /* check START FILE to see if the endtime has passed */
@@ -431,7 +800,7 @@ void FileManager::UpdateAuction(const std::string &auctionId) {
   if (auctionIsActive(auctionId)) {
     std::string startFile =
         readFromFile("START (" + auctionId + ").txt",
-                     AUCTION_DIR + std::string("/") + auctionId);
+                     auctionDirectory(auctionId));
     std::stringstream ss(startFile);
     std::string uid, name, assetFname, startValue, timeActive, startDate,
         startHour, startFulltime;
@@ -463,6 +832,7 @@ void FileManager::UpdateAuction(const std::string &auctionId) {
 }
 
 void FileManager::closeAuction(AuctionData &auction) {
+  TraceSpan span("closeAuction");
 
   std::time_t now = std::time(nullptr);
 
@@ -485,15 +855,25 @@ void FileManager::closeAuction(AuctionData &auction) {
   });
 }
 
-std::filesystem::path FileManager::showAsset(AuctionData &auction) {
+AssetSource FileManager::showAsset(AuctionData &auction) {
+  TraceSpan span("showAsset");
   std::filesystem::path assetPath;
+  std::string assetHash;
 
   safeLockAuction(auction.getIdString(), [&]() {
     // update auction
     UpdateAuction(auction.getIdString());
 
-    assetPath = std::filesystem::path(BASE_DIR) / AUCTION_DIR /
-                auction.getIdString() / auction.getAssetFname();
+    std::string hash = getAuctionAssetHash(auction.getIdString());
+    if (hash.empty()) {
+      // Auctions created before the asset store keep their own copy
+      assetPath = std::filesystem::path(BASE_DIR) /
+                  auctionDirectory(auction.getIdString()) /
+                  auction.getAssetFname();
+    } else {
+      assetPath = assetStore.blobPath(hash);
+      assetHash = hash;
+    }
     if (assetPath.empty()) {
       throw InvalidFilePathException(assetPath);
     }
@@ -506,50 +886,98 @@ std::filesystem::path FileManager::showAsset(AuctionData &auction) {
     return std::filesystem::path();
   });
 
-  return assetPath;
+  AssetSource source;
+  source.path = assetPath;
+  source.hash = assetHash;
+  return source;
 }
 
 void FileManager::bid(AuctionData &auction, uint32_t bidValue,
                       const std::string &userId) {
+  TraceSpan span("bid");
 
-  if (auctionIsActive(auction.getIdString())) {
-    // bid value string must be a 6 digit number so fill with 0's
-    std::string bidValueString = std::to_string(bidValue);
-    while (bidValueString.length() < 6) {
-      bidValueString = "0" + bidValueString;
-    }
-
-    safeLockAuction(auction.getIdString(), [&]() {
-      createBidFile(auction.getIdString(), userId, bidValueString,
-                    auction.getStartTime());
-    });
+  // bid value string must be a 6 digit number so fill with 0's
+  std::string bidValueString = std::to_string(bidValue);
+  while (bidValueString.length() < 6) {
+    bidValueString = "0" + bidValueString;
+  }
 
-    safeLockUser(userId, [&]() {
-      createUserAuctionFile(userId, auction.getIdString(), "BIDDED");
-    });
-  } else {
+  // The auction was read before the lock, another bid may have been placed
+  // or the auction may have ended since. safeLockAuction swallows
+  // exceptions, so the outcome is thrown once the lock is released
+  bool active = true;
+  bool outbid = false;
+  safeLockAuction(auction.getIdString(), [&]() {
+    UpdateAuction(auction.getIdString());
+    if (!auctionIsActive(auction.getIdString())) {
+      active = false;
+      return;
+    }
+    // Bid files are named after the padded value, the last one is highest
+    std::vector<std::string> bids = writer.list(
+        BASE_DIR + auctionDirectory(auction.getIdString()) + "/BIDS");
+    uint32_t highest = bids.empty()
+                           ? auction.getInitialBid()
+                           : static_cast<uint32_t>(std::stoul(bids.back()));
+    if (bidValue <= highest) {
+      outbid = true;
+      return;
+    }
+    createBidFile(auction.getIdString(), userId, bidValueString,
+                  auction.getStartTime());
+  });
+  if (!active) {
     throw AuctionNotActiveException(auction.getIdString());
   }
+  if (outbid) {
+    throw LargerBidAlreadyExistsException(std::to_string(bidValue));
+  }
+
+  safeLockUser(userId, [&]() {
+    createUserAuctionFile(userId, auction.getIdString(), "BIDDED");
+  });
 }
 
+/* Returns the ID of the next auction, one past the highest live or
+   archived ID so IDs are never reused */
 uint32_t FileManager::getAuctionsCount() {
-  uint32_t count = 1;
-  for (const auto &entry : std::filesystem::directory_iterator(
-           std::string(BASE_DIR) + "/" + AUCTION_DIR)) {
-    if (std::filesystem::is_directory(entry.status())) {
-      count++;
-    }
+  uint32_t lastId = 0;
+  for (const std::string &auctionId : listAuctions()) {
+    lastId = std::max(lastId, static_cast<uint32_t>(std::stoul(auctionId)));
+  }
+  for (uint32_t auctionIdInt : archive.getAuctionIds()) {
+    lastId = std::max(lastId, auctionIdInt);
   }
-  return count;
+  return lastId + 1;
+}
+
+StorageStats FileManager::stats() {
+  StorageStats stats;
+  stats.users = registeredUsers;
+  stats.logged_in_users = loggedInUsers;
+  stats.pending_writes = writer.pendingWrites();
+  stats.write_failures = writer.failedWrites();
+  return stats;
+}
+
+std::vector<LockStats> FileManager::lockStats() {
+  std::vector<LockStats> locks;
+  std::scoped_lock<std::mutex> guard(mutexesLock);
+  for (auto &[userId, mutex] : userMutexes) {
+    locks.push_back(mutex.stats("user", userId));
+  }
+  for (auto &[auctionId, mutex] : auctionMutexes) {
+    locks.push_back(mutex.stats("auction", auctionId));
+  }
+  return locks;
 }
 
 void FileManager::shutdown() {
   // logout all users
-  for (const auto &entry : std::filesystem::directory_iterator(
-           std::string(BASE_DIR) + "/" + USER_DIR)) {
-    if (std::filesystem::is_directory(entry.status())) {
-      std::string userId = entry.path().filename().string();
-      logoutUser(userId);
-    }
+  for (const std::string &userId : listUsers()) {
+    logoutUser(userId);
   }
+
+  // Everything must be on disk before the server exits
+  writer.finish();
 }
\ No newline at end of file
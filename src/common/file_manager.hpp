@@ -2,6 +2,8 @@
 #ifndef FILE_MANAGER_H
 #define FILE_MANAGER_H
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <filesystem>
@@ -12,15 +14,23 @@
 #include <map>
 #include <mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "asset_store.hpp"
+#include "auction_archive.hpp"
 #include "auction_data.hpp"
 #include "constants.hpp"
 #include "exceptions.hpp"
+#include "profiled_mutex.hpp"
+#include "storage_engine.hpp"
+#include "write_behind_queue.hpp"
 
-class FileManager {
+// Storage engine that keeps everything under BASE_DIR
+class FileManager : public StorageEngine {
 public:
   FileManager();
+  ~FileManager();
   void createUserDirectory(const std::string &userId);
   void createUserPassFile(const std::string &userId,
                           const std::string &password);
@@ -37,7 +47,8 @@ public:
   void createAuctionStartFile(const std::string &auctionId,
                               const AuctionData &data);
   void createAuctionAssetFile(const std::string &auctionId,
-                              const std::string &assetFname);
+                              AssetUpload &upload);
+  std::string getAuctionAssetHash(const std::string &auctionId);
   void createAuctionEndFile(const std::string &auctionId,
                             const std::string &endTime,
                             const uint32_t &activeSeconds);
@@ -51,30 +62,75 @@ public:
   void safeLockUser(const std::string &userId, std::function<void()> func);
   void safeLockAuction(const std::string &auctionId,
                        std::function<void()> func);
-  bool UserLoggedIn(const std::string &userId);
-  bool UserRegistered(const std::string &userId);
+  bool UserLoggedIn(const std::string &userId) override;
+  bool UserRegistered(const std::string &userId) override;
   bool auctionIsActive(const std::string &auctionId);
   void UpdateAuction(const std::string &auctionId);
-  std::string getUserPassword(const std::string &userId);
-  void loginUser(const std::string &userId);
-  void logoutUser(const std::string &userId);
-  void registerUser(const std::string &userId, const std::string &password);
-  void unregisterUser(const std::string &userId);
+  std::string getUserPassword(const std::string &userId) override;
+  void loginUser(const std::string &userId) override;
+  void logoutUser(const std::string &userId) override;
+  void registerUser(const std::string &userId,
+                    const std::string &password) override;
+  void unregisterUser(const std::string &userId) override;
   std::vector<std::pair<uint32_t, bool>>
-  getUserAuctions(const std::string &userId, const std::string &directory);
-  std::vector<std::pair<uint32_t, bool>> getAllAuctions();
-  AuctionData getAuction(const uint32_t auctionIdInt);
+  getUserAuctions(const std::string &userId,
+                  const std::string &directory) override;
+  std::vector<std::pair<uint32_t, bool>> getAllAuctions() override;
+  AuctionData getAuction(const uint32_t auctionIdInt) override;
+  AuctionData parseAuction(const uint32_t auctionIdInt,
+                           const std::string &startFile,
+                           const std::string &endFile,
+                           const std::vector<Bid> &bids);
+  Bid parseBid(const std::string &bidFile);
   std::vector<Bid> getAuctionBids(const std::string &auctionId);
-  void openAuction(const std::string &userId, const AuctionData &data);
-  void closeAuction(AuctionData &auction);
-  std::filesystem::path showAsset(AuctionData &auction);
-  void bid(AuctionData &auction, uint32_t bidValue, const std::string &userId);
-  uint32_t getAuctionsCount();
-  void shutdown();
+  std::string packAuction(const std::string &auctionId);
+  AuctionData unpackAuction(const uint32_t auctionIdInt,
+                            const std::string &record);
+  uint32_t archiveClosedAuctions(uint32_t minAgeSeconds) override;
+  void prepareAssetUpload(AssetUpload &upload) override;
+  void openAuction(const std::string &userId, const AuctionData &data,
+                   AssetUpload &upload) override;
+  void closeAuction(AuctionData &auction) override;
+  AssetSource showAsset(AuctionData &auction) override;
+  void bid(AuctionData &auction, uint32_t bidValue,
+           const std::string &userId) override;
+  uint32_t getAuctionsCount() override;
+  StorageStats stats() override;
+  std::vector<LockStats> lockStats() override;
+  void shutdown() override;
+
+  // Directories relative to BASE_DIR
+  std::string userDirectory(const std::string &userId);
+  std::string auctionDirectory(const std::string &auctionId);
+  std::vector<std::string> listUsers();
+  std::vector<std::string> listAuctions();
+  void migrateFlatLayout();
 
 private:
-  std::map<std::string, std::mutex> userMutexes;
-  std::map<std::string, std::mutex> auctionMutexes;
+  // Set while directories of the flat layout (USERS/<uid>, AUCTIONS/<aid>)
+  // may still exist, they are migrated in the background
+  std::atomic<bool> flatLayout{false};
+  std::atomic<bool> stopMigration{false};
+  std::thread migrationThread;
+  // Counted once on startup and kept up to date under the user locks, so
+  // STA does not read every user's files
+  std::atomic<uint64_t> registeredUsers{0};
+  std::atomic<uint64_t> loggedInUsers{0};
+
+  static bool isFlatLayoutName(const std::string &name);
+  std::string shardedUserDirectory(const std::string &userId);
+  std::string shardedAuctionDirectory(const std::string &auctionId);
+  ProfiledMutex &lookupMutex(std::map<std::string, ProfiledMutex> &mutexes,
+                             const std::string &key);
+
+  AssetStore assetStore;
+  AuctionArchive archive;
+  // Every file under USERS and AUCTIONS is read and written through it
+  WriteBehindQueue writer;
+  // Guards the maps, not the locks in them
+  std::mutex mutexesLock;
+  std::map<std::string, ProfiledMutex> userMutexes;
+  std::map<std::string, ProfiledMutex> auctionMutexes;
 };
 
 #endif
\ No newline at end of file
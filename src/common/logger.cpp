@@ -0,0 +1,312 @@
+#include "logger.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "constants.hpp"
+
+LogStream cinfo(Logger::INFO);
+LogStream cwarning(Logger::WARNING);
+LogStream cerror(Logger::ERROR);
+
+std::atomic<int> Logger::min_level{Logger::INFO};
+std::atomic<bool> Logger::running{false};
+std::thread Logger::flusher;
+
+static const char LEVEL_LETTERS[] = {'D', 'I', 'W', 'E'};
+
+typedef std::chrono::system_clock LogClock;
+
+struct LogRecord {
+  LogClock::time_point time;
+  Logger::Level level;
+  uint32_t thread_id;
+  size_t length;
+  char text[LOG_MESSAGE_MAX_LEN];
+};
+
+// Messages of a thread that only differ in their numbers, over a second
+struct RepeatSlot {
+  uint64_t key = 0;
+  int64_t second = 0;
+  uint32_t count = 0;
+  uint32_t suppressed = 0;
+};
+
+// Only its thread adds records and only the flush thread removes them, so
+// neither side ever waits for the other. A thread that finds it full drops
+// its message, and the flush thread reports how many were dropped.
+struct LogRing {
+  std::vector<LogRecord> records;
+  // Records removed so far, written by the flush thread
+  alignas(64) std::atomic<uint64_t> head{0};
+  // Records added so far, written by the owner
+  alignas(64) std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> dropped{0};
+  // Dropped messages already reported, only used by the flush thread
+  uint64_t reported_dropped = 0;
+  std::atomic<bool> owned{false};
+  uint32_t thread_id;
+  // Only used by the owner
+  RepeatSlot repeats[LOG_REPEAT_SLOTS];
+};
+
+static std::mutex rings_lock;
+// Rings are handed over to new threads once their thread exits
+static std::vector<std::unique_ptr<LogRing>> rings;
+// Serializes writes to the terminal
+static std::mutex output_lock;
+
+struct RingOwner {
+  LogRing *ring = nullptr;
+
+  ~RingOwner() {
+    if (ring != nullptr) {
+      ring->owned.store(false, std::memory_order_release);
+    }
+  }
+};
+
+static LogRing &local_ring() {
+  thread_local RingOwner owner;
+  if (owner.ring != nullptr) {
+    return *owner.ring;
+  }
+
+  std::scoped_lock<std::mutex> guard(rings_lock);
+  for (std::unique_ptr<LogRing> &ring : rings) {
+    bool owned = false;
+    if (ring->owned.compare_exchange_strong(owned, true,
+                                            std::memory_order_acquire)) {
+      owner.ring = ring.get();
+      std::fill(std::begin(ring->repeats), std::end(ring->repeats),
+                RepeatSlot());
+      return *owner.ring;
+    }
+  }
+  std::unique_ptr<LogRing> created = std::make_unique<LogRing>();
+  created->records.resize(LOG_RING_CAPACITY);
+  created->owned.store(true, std::memory_order_relaxed);
+  created->thread_id = static_cast<uint32_t>(rings.size()) + 1;
+  owner.ring = created.get();
+  rings.push_back(std::move(created));
+  return *owner.ring;
+}
+
+// FNV-1a hash of the message without its digits, so messages that only
+// differ in IDs, ports or counts are alike
+static uint64_t similarity_key(const std::string &message) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : message) {
+    if (c < '0' || c > '9') {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+// Tells whether the message is let through, and how many messages alike it
+// were suppressed since the last one that was
+static bool let_through(LogRing &ring, const std::string &message,
+                        int64_t second, uint32_t &suppressed,
+                        uint32_t &evicted) {
+  uint64_t key = similarity_key(message);
+  RepeatSlot &slot = ring.repeats[key % LOG_REPEAT_SLOTS];
+  suppressed = 0;
+  evicted = 0;
+  if (slot.key != key) {
+    evicted = slot.suppressed;
+    slot = RepeatSlot{key, second, 0, 0};
+  } else if (slot.second != second) {
+    suppressed = slot.suppressed;
+    slot = RepeatSlot{key, second, 0, 0};
+  }
+
+  if (slot.count >= LOG_REPEAT_MAX_PER_SECOND) {
+    ++slot.suppressed;
+    return false;
+  }
+  ++slot.count;
+  return true;
+}
+
+static void push(LogRing &ring, LogClock::time_point time,
+                 Logger::Level level, const std::string &message) {
+  uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+  if (tail - ring.head.load(std::memory_order_acquire) == LOG_RING_CAPACITY) {
+    ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    return;
+  }
+
+  LogRecord &record = ring.records[tail % LOG_RING_CAPACITY];
+  record.time = time;
+  record.level = level;
+  record.thread_id = ring.thread_id;
+  record.length = std::min(message.length(), size_t{LOG_MESSAGE_MAX_LEN});
+  std::memcpy(record.text, message.data(), record.length);
+  if (record.length < message.length()) {
+    std::memcpy(record.text + record.length - 3, "...", 3);
+  }
+  ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+static void format_line(std::string &out, LogClock::time_point time,
+                        Logger::Level level, uint32_t thread_id,
+                        const char *text, size_t length) {
+  std::time_t seconds = LogClock::to_time_t(time);
+  long micros = static_cast<long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          time.time_since_epoch())
+          .count() %
+      1000000);
+  struct tm local;
+  localtime_r(&seconds, &local);
+  char prefix[48];
+  int written = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06ld %c %u ",
+                         local.tm_hour, local.tm_min, local.tm_sec, micros,
+                         LEVEL_LETTERS[level], thread_id);
+  out.append(prefix, static_cast<size_t>(std::max(written, 0)));
+  out.append(text, length);
+  out.push_back('\n');
+}
+
+static void write_out(const std::string &out, const std::string &errors) {
+  std::scoped_lock<std::mutex> guard(output_lock);
+  if (!out.empty()) {
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.length()));
+    std::cout.flush();
+  }
+  if (!errors.empty()) {
+    std::cerr.write(errors.data(),
+                    static_cast<std::streamsize>(errors.length()));
+    std::cerr.flush();
+  }
+}
+
+// Writes out the queued messages of every thread, in the order they were
+// logged, in one write per stream
+static void drain() {
+  std::vector<LogRecord> batch;
+  std::string dropped;
+  {
+    std::scoped_lock<std::mutex> guard(rings_lock);
+    for (std::unique_ptr<LogRing> &ring : rings) {
+      uint64_t head = ring->head.load(std::memory_order_relaxed);
+      uint64_t tail = ring->tail.load(std::memory_order_acquire);
+      for (; head < tail; ++head) {
+        batch.push_back(ring->records[head % LOG_RING_CAPACITY]);
+      }
+      ring->head.store(tail, std::memory_order_release);
+
+      uint64_t ring_dropped = ring->dropped.load(std::memory_order_relaxed);
+      if (ring_dropped > ring->reported_dropped) {
+        std::string message =
+            "Dropped " +
+            std::to_string(ring_dropped - ring->reported_dropped) +
+            " log message(s), the queue of the thread was full";
+        format_line(dropped, LogClock::now(), Logger::WARNING,
+                    ring->thread_id, message.data(), message.length());
+        ring->reported_dropped = ring_dropped;
+      }
+    }
+  }
+
+  std::stable_sort(batch.begin(), batch.end(),
+                   [](const LogRecord &a, const LogRecord &b) {
+                     return a.time < b.time;
+                   });
+  std::string out;
+  std::string errors = dropped;
+  for (LogRecord &record : batch) {
+    format_line(record.level >= Logger::WARNING ? errors : out, record.time,
+                record.level, record.thread_id, record.text, record.length);
+  }
+  write_out(out, errors);
+}
+
+void Logger::start(Level __min_level) {
+  min_level.store(__min_level, std::memory_order_relaxed);
+  running.store(true, std::memory_order_release);
+  flusher = std::thread(flushLoop);
+}
+
+void Logger::stop() {
+  if (!running.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  flusher.join();
+  drain();
+}
+
+void Logger::flushLoop() {
+  while (running.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+    drain();
+  }
+}
+
+std::ostringstream &Logger::pending() {
+  thread_local std::ostringstream stream;
+  return stream;
+}
+
+void Logger::commit(Level level) {
+  std::ostringstream &stream = pending();
+  std::string message = stream.str();
+  stream.str("");
+  stream.flags(std::ios_base::dec | std::ios_base::skipws);
+  stream.fill(' ');
+  if (message.empty()) {
+    return;
+  }
+
+  LogClock::time_point now = LogClock::now();
+  if (!running.load(std::memory_order_acquire)) {
+    std::string line;
+    format_line(line, now, level, 0, message.data(), message.length());
+    write_out(level >= WARNING ? "" : line, level >= WARNING ? line : "");
+    return;
+  }
+
+  LogRing &ring = local_ring();
+  uint32_t suppressed;
+  uint32_t evicted;
+  int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                       now.time_since_epoch())
+                       .count();
+  bool allowed = let_through(ring, message, second, suppressed, evicted);
+  if (evicted > 0) {
+    push(ring, now, level,
+         "[" + std::to_string(evicted) + " similar message(s) suppressed]");
+  }
+  if (!allowed) {
+    return;
+  }
+  if (suppressed > 0) {
+    message += " [" + std::to_string(suppressed) + " similar suppressed]";
+  }
+  push(ring, now, level, message);
+}
+
+LogStream &LogStream::operator<<(std::ostream &(*f)(std::ostream &)) {
+  if (!Logger::enabled(level)) {
+    return *this;
+  }
+  // std::endl ends the message, other manipulators apply to it
+  if (f == static_cast<std::ostream &(*)(std::ostream &)>(std::endl)) {
+    Logger::commit(level);
+  } else {
+    f(Logger::pending());
+  }
+  return *this;
+}
@@ -0,0 +1,75 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Log messages are queued in a lock-free ring buffer per thread, and written
+// out in batches by a background thread, so logging never blocks on the
+// terminal. Lines are "<time> <level> <thread> <message>". Each thread lets
+// through at most LOG_REPEAT_MAX_PER_SECOND messages that only differ in
+// their numbers, and counts the rest. Until started, and once stopped, the
+// logger writes each message right away.
+class Logger {
+public:
+  enum Level { DEBUG, INFO, WARNING, ERROR };
+
+  static void start(Level min_level);
+  // Writes out every queued message, must be called once no thread logs
+  static void stop();
+  static bool enabled(Level level) {
+    return level >= min_level.load(std::memory_order_relaxed);
+  }
+  // The message being built by this thread
+  static std::ostringstream &pending();
+  // Queues the message built by this thread
+  static void commit(Level level);
+
+private:
+  static std::atomic<int> min_level;
+  static std::atomic<bool> running;
+  static std::thread flusher;
+
+  static void flushLoop();
+};
+
+// Builds a log message of a level, which is queued on std::endl:
+//   cinfo << "Listening on port " << port << std::endl;
+class LogStream {
+  Logger::Level level;
+
+public:
+  constexpr explicit LogStream(Logger::Level __level) : level{__level} {};
+
+  template <class T> LogStream &operator<<(const T &val) {
+    if (Logger::enabled(level)) {
+      Logger::pending() << val;
+    }
+    return *this;
+  }
+
+  LogStream &operator<<(std::ostream &(*f)(std::ostream &));
+
+  LogStream &operator<<(std::ios &(*f)(std::ios &)) {
+    if (Logger::enabled(level)) {
+      f(Logger::pending());
+    }
+    return *this;
+  }
+
+  LogStream &operator<<(std::ios_base &(*f)(std::ios_base &)) {
+    if (Logger::enabled(level)) {
+      f(Logger::pending());
+    }
+    return *this;
+  }
+};
+
+extern LogStream cinfo;
+extern LogStream cwarning;
+extern LogStream cerror;
+
+#endif
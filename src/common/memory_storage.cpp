@@ -0,0 +1,284 @@
+#include "memory_storage.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include "exceptions.hpp"
+#include "tracing.hpp"
+
+static std::string formatTime(std::time_t time) {
+  std::ostringstream oss;
+  oss << std::put_time(std::gmtime(&time), "%Y-%m-%d %H:%M:%S");
+  return oss.str();
+}
+
+bool MemoryStorage::UserLoggedIn(const std::string &userId) {
+  std::shared_lock<std::shared_mutex> lock(usersLock);
+  auto user = users.find(userId);
+  return user != users.end() && user->second.loggedIn;
+}
+
+bool MemoryStorage::UserRegistered(const std::string &userId) {
+  std::shared_lock<std::shared_mutex> lock(usersLock);
+  auto user = users.find(userId);
+  return user != users.end() && !user->second.password.empty();
+}
+
+std::string MemoryStorage::getUserPassword(const std::string &userId) {
+  std::shared_lock<std::shared_mutex> lock(usersLock);
+  auto user = users.find(userId);
+  if (user == users.end() || user->second.password.empty()) {
+    throw UserNotRegisteredException(userId);
+  }
+  return user->second.password;
+}
+
+void MemoryStorage::loginUser(const std::string &userId) {
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  users[userId].loggedIn = true;
+}
+
+void MemoryStorage::logoutUser(const std::string &userId) {
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  auto user = users.find(userId);
+  if (user != users.end()) {
+    user->second.loggedIn = false;
+  }
+}
+
+void MemoryStorage::registerUser(const std::string &userId,
+                                 const std::string &password) {
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  users[userId].password = password;
+}
+
+/* Like the filesystem engine, the auctions of the user are kept */
+void MemoryStorage::unregisterUser(const std::string &userId) {
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  auto user = users.find(userId);
+  if (user != users.end()) {
+    user->second.password.clear();
+    user->second.loggedIn = false;
+  }
+}
+
+std::vector<std::pair<uint32_t, bool>>
+MemoryStorage::getUserAuctions(const std::string &userId,
+                               const std::string &directory) {
+  std::set<uint32_t> auctionIds;
+  {
+    std::shared_lock<std::shared_mutex> lock(usersLock);
+    auto user = users.find(userId);
+    if (user == users.end()) {
+      return {};
+    }
+    auctionIds = directory == "HOSTED" ? user->second.hosted
+                                       : user->second.bidded;
+  }
+  return listAuctions(auctionIds);
+}
+
+std::vector<std::pair<uint32_t, bool>> MemoryStorage::getAllAuctions() {
+  std::set<uint32_t> auctionIds;
+  {
+    std::shared_lock<std::shared_mutex> lock(auctionsLock);
+    for (const auto &auction : auctions) {
+      auctionIds.insert(auction.first);
+    }
+  }
+
+  std::vector<std::pair<uint32_t, bool>> auctionList =
+      listAuctions(auctionIds);
+  if (auctionList.empty()) {
+    throw NoAuctionsException();
+  }
+  return auctionList;
+}
+
+std::vector<std::pair<uint32_t, bool>>
+MemoryStorage::listAuctions(const std::set<uint32_t> &auctionIds) {
+  std::vector<std::pair<uint32_t, bool>> auctionList;
+  for (uint32_t auctionId : auctionIds) {
+    std::shared_ptr<MemoryAuction> auction = findAuction(auctionId);
+    std::lock_guard<ProfiledMutex> lock(auction->lock);
+    updateAuction(*auction);
+    auctionList.push_back(std::make_pair(auctionId, auction->data.isActive()));
+  }
+  return auctionList;
+}
+
+std::shared_ptr<MemoryAuction> MemoryStorage::findAuction(uint32_t auctionId) {
+  std::shared_lock<std::shared_mutex> lock(auctionsLock);
+  auto auction = auctions.find(auctionId);
+  if (auction == auctions.end()) {
+    throw AuctionDoesNotExistException(AuctionData::idToString(auctionId));
+  }
+  return auction->second;
+}
+
+/* Closes the auction if its duration has passed, must hold its lock */
+void MemoryStorage::updateAuction(MemoryAuction &auction) {
+  if (!auction.data.isActive()) {
+    return;
+  }
+  std::time_t endTime =
+      auction.data.getStartTime() + auction.data.getDurationSeconds();
+  if (std::time(nullptr) >= endTime) {
+    auction.data.setEndTime(formatTime(endTime));
+    auction.data.setEndTimeSec(auction.data.getDurationSeconds());
+  }
+}
+
+AuctionData MemoryStorage::getAuction(const uint32_t auctionIdInt) {
+  TraceSpan span("getAuction");
+  std::shared_ptr<MemoryAuction> auction = findAuction(auctionIdInt);
+  std::unique_lock<ProfiledMutex> lock(auction->lock, std::defer_lock);
+  {
+    TraceSpan wait("auction lock wait");
+    lock.lock();
+  }
+  updateAuction(*auction);
+  return auction->data;
+}
+
+void MemoryStorage::prepareAssetUpload(AssetUpload &upload) {
+  upload.contents = std::make_shared<std::string>();
+}
+
+void MemoryStorage::openAuction(const std::string &userId,
+                                const AuctionData &data, AssetUpload &upload) {
+  TraceSpan span("openAuction");
+  auto auction = std::make_shared<MemoryAuction>();
+  auction->data = data;
+
+  {
+    std::lock_guard<std::mutex> lock(assetsLock);
+    std::shared_ptr<const std::string> stored;
+    auto cached = assets.find(upload.hash);
+    if (cached != assets.end()) {
+      stored = cached->second.lock();
+    }
+    if (!stored) {
+      // Doubling the sweep size keeps sweeps amortized constant per asset
+      if (assets.size() >= assetsSweepSize) {
+        for (auto entry = assets.begin(); entry != assets.end();) {
+          entry = entry->second.expired() ? assets.erase(entry) : ++entry;
+        }
+        assetsSweepSize = std::max(assetsSweepSize, 2 * assets.size());
+      }
+      stored = std::move(upload.contents);
+      assets[upload.hash] = stored;
+    }
+    auction->asset = stored;
+    auction->assetHash = upload.hash;
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> lock(auctionsLock);
+    auctions[data.getId()] = auction;
+  }
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  users[userId].hosted.insert(data.getId());
+}
+
+void MemoryStorage::closeAuction(AuctionData &auction) {
+  TraceSpan span("closeAuction");
+  std::shared_ptr<MemoryAuction> stored = findAuction(auction.getId());
+  std::lock_guard<ProfiledMutex> lock(stored->lock);
+  updateAuction(*stored);
+  if (!stored->data.isActive()) {
+    throw AuctionNotActiveException(auction.getIdString());
+  }
+
+  std::time_t now = std::time(nullptr);
+  stored->data.setEndTime(formatTime(now));
+  stored->data.setEndTimeSec(
+      static_cast<uint32_t>(now - stored->data.getStartTime()));
+}
+
+AssetSource MemoryStorage::showAsset(AuctionData &auction) {
+  std::shared_ptr<MemoryAuction> stored = findAuction(auction.getId());
+  std::lock_guard<ProfiledMutex> lock(stored->lock);
+  updateAuction(*stored);
+
+  AssetSource source;
+  source.contents = stored->asset;
+  source.hash = stored->assetHash;
+  return source;
+}
+
+void MemoryStorage::bid(AuctionData &auction, uint32_t bidValue,
+                        const std::string &userId) {
+  TraceSpan span("bid");
+  std::shared_ptr<MemoryAuction> stored = findAuction(auction.getId());
+  {
+    std::unique_lock<ProfiledMutex> lock(stored->lock, std::defer_lock);
+    {
+      TraceSpan wait("auction lock wait");
+      lock.lock();
+    }
+    updateAuction(*stored);
+    if (!stored->data.isActive()) {
+      throw AuctionNotActiveException(auction.getIdString());
+    }
+    // Another bid may have been placed since the auction was read
+    if (bidValue <= stored->data.getHighestBidValue()) {
+      throw LargerBidAlreadyExistsException(std::to_string(bidValue));
+    }
+
+    std::time_t now = std::time(nullptr);
+    Bid bid;
+    bid.bidder_user_id = static_cast<uint32_t>(std::stoul(userId));
+    bid.bid_value = bidValue;
+    bid.date_time = formatTime(now);
+    bid.sec_time = static_cast<uint32_t>(now - stored->data.getStartTime());
+    stored->data.addBid(bid);
+  }
+
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  users[std::to_string(std::stoul(userId))].bidded.insert(auction.getId());
+}
+
+/* Nothing to move, memory is the only tier */
+uint32_t MemoryStorage::archiveClosedAuctions(uint32_t) { return 0; }
+
+uint32_t MemoryStorage::getAuctionsCount() {
+  std::shared_lock<std::shared_mutex> lock(auctionsLock);
+  if (auctions.empty()) {
+    return 1;
+  }
+  return auctions.rbegin()->first + 1;
+}
+
+StorageStats MemoryStorage::stats() {
+  std::shared_lock<std::shared_mutex> lock(usersLock);
+  StorageStats stats;
+  for (auto &[userId, user] : users) {
+    if (!user.password.empty()) {
+      ++stats.users;
+    }
+    if (user.loggedIn) {
+      ++stats.logged_in_users;
+    }
+  }
+  return stats;
+}
+
+std::vector<LockStats> MemoryStorage::lockStats() {
+  std::shared_lock<std::shared_mutex> lock(auctionsLock);
+  std::vector<LockStats> locks;
+  for (auto &[auctionId, auction] : auctions) {
+    locks.push_back(
+        auction->lock.stats("auction", AuctionData::idToString(auctionId)));
+  }
+  return locks;
+}
+
+void MemoryStorage::shutdown() {
+  std::unique_lock<std::shared_mutex> lock(usersLock);
+  for (auto &user : users) {
+    user.second.loggedIn = false;
+  }
+}
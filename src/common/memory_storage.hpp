@@ -0,0 +1,76 @@
+#ifndef MEMORY_STORAGE_H
+#define MEMORY_STORAGE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "storage_engine.hpp"
+
+struct MemoryUser {
+  std::string password; // Empty when the user is not registered
+  bool loggedIn = false;
+  std::set<uint32_t> hosted;
+  std::set<uint32_t> bidded;
+};
+
+struct MemoryAuction {
+  ProfiledMutex lock;
+  AuctionData data;
+  std::shared_ptr<const std::string> asset;
+  std::string assetHash;
+};
+
+// Keeps every user, auction and asset in memory, nothing survives a restart.
+// The maps are guarded by reader/writer locks and each auction has its own
+// lock, so requests for different auctions don't contend.
+class MemoryStorage : public StorageEngine {
+  std::unordered_map<std::string, MemoryUser> users;
+  std::shared_mutex usersLock;
+  std::map<uint32_t, std::shared_ptr<MemoryAuction>> auctions;
+  std::shared_mutex auctionsLock;
+  // Identical assets share the same buffer while some auction references it
+  std::unordered_map<std::string, std::weak_ptr<const std::string>> assets;
+  std::mutex assetsLock;
+  // Expired entries are swept once the map reaches this size
+  size_t assetsSweepSize = 64;
+
+  std::shared_ptr<MemoryAuction> findAuction(uint32_t auctionId);
+  void updateAuction(MemoryAuction &auction);
+  std::vector<std::pair<uint32_t, bool>>
+  listAuctions(const std::set<uint32_t> &auctionIds);
+
+public:
+  bool UserLoggedIn(const std::string &userId) override;
+  bool UserRegistered(const std::string &userId) override;
+  std::string getUserPassword(const std::string &userId) override;
+  void loginUser(const std::string &userId) override;
+  void logoutUser(const std::string &userId) override;
+  void registerUser(const std::string &userId,
+                    const std::string &password) override;
+  void unregisterUser(const std::string &userId) override;
+  std::vector<std::pair<uint32_t, bool>>
+  getUserAuctions(const std::string &userId,
+                  const std::string &directory) override;
+  std::vector<std::pair<uint32_t, bool>> getAllAuctions() override;
+  AuctionData getAuction(const uint32_t auctionIdInt) override;
+  void prepareAssetUpload(AssetUpload &upload) override;
+  void openAuction(const std::string &userId, const AuctionData &data,
+                   AssetUpload &upload) override;
+  void closeAuction(AuctionData &auction) override;
+  AssetSource showAsset(AuctionData &auction) override;
+  void bid(AuctionData &auction, uint32_t bidValue,
+           const std::string &userId) override;
+  uint32_t archiveClosedAuctions(uint32_t minAgeSeconds) override;
+  uint32_t getAuctionsCount() override;
+  StorageStats stats() override;
+  // Users share the locks of the user map, so only auctions are reported
+  std::vector<LockStats> lockStats() override;
+  void shutdown() override;
+};
+
+#endif
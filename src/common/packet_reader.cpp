@@ -0,0 +1,149 @@
+#include "packet_reader.hpp"
+
+#include <algorithm>
+
+#include "protocol.hpp"
+
+void PacketReader::readPacketId(const char *id) {
+  std::string_view expected(id);
+  if (buffer.substr(position, expected.length()) == expected) {
+    position += expected.length();
+    return;
+  }
+
+  std::string_view error_id(ErrorUdpPacket::ID);
+  if (buffer.substr(position, error_id.length()) == error_id) {
+    position += error_id.length();
+    // Without the packet delimiter, the error packet would be invalid
+    readPacketDelimiter();
+    throw ErrorUdpPacketException();
+  }
+  throw UnexpectedPacketException();
+}
+
+void PacketReader::readChar(char chr) {
+  if (readChar() != chr) {
+    throw InvalidPacketException();
+  }
+}
+
+char PacketReader::readChar() {
+  if (position >= buffer.length()) {
+    throw InvalidPacketException();
+  }
+  return buffer[position++];
+}
+
+char PacketReader::peek() const {
+  if (position >= buffer.length()) {
+    return 0;
+  }
+  return buffer[position];
+}
+
+void PacketReader::readSpace() { readChar(' '); }
+
+void PacketReader::readPacketDelimiter() {
+  readChar('\n');
+  if (position != buffer.length()) {
+    // If there is more data in the buffer, the packet is invalid
+    throw InvalidPacketException();
+  }
+}
+
+std::string_view PacketReader::readString(uint32_t max_len) {
+  size_t start = position;
+  size_t end = std::min(buffer.length(), start + max_len);
+  while (position < end && buffer[position] != ' ' &&
+         buffer[position] != '\n') {
+    ++position;
+  }
+  // A field is always followed by a separator
+  if (position >= buffer.length()) {
+    throw InvalidPacketException();
+  }
+  return buffer.substr(start, position - start);
+}
+
+uint32_t PacketReader::readInt() {
+  size_t start = position;
+  uint64_t value = 0;
+  while (position < buffer.length() && buffer[position] >= '0' &&
+         buffer[position] <= '9') {
+    value = value * 10 + static_cast<uint64_t>(buffer[position] - '0');
+    if (value > INT32_MAX) {
+      throw InvalidPacketException();
+    }
+    ++position;
+  }
+  if (position == start || position >= buffer.length()) {
+    throw InvalidPacketException();
+  }
+  return static_cast<uint32_t>(value);
+}
+
+uint64_t PacketReader::readLong() {
+  size_t start = position;
+  uint64_t value = 0;
+  while (position < buffer.length() && buffer[position] >= '0' &&
+         buffer[position] <= '9') {
+    uint64_t digit = static_cast<uint64_t>(buffer[position] - '0');
+    if (value > (UINT64_MAX - digit) / 10) {
+      throw InvalidPacketException();
+    }
+    value = value * 10 + digit;
+    ++position;
+  }
+  if (position == start || position >= buffer.length()) {
+    throw InvalidPacketException();
+  }
+  return value;
+}
+
+uint32_t PacketReader::readUserId() {
+  return parse_packet_user_id(readString(USER_ID_STR_LEN));
+}
+
+uint32_t PacketReader::readAuctionId() {
+  return parse_packet_auction_id(readString(AUCTION_ID_MAX_LEN));
+}
+
+std::string_view PacketReader::readDateTime() {
+  size_t start = position;
+  for (int part = 0; part < 2; ++part) {
+    size_t separator = buffer.find(' ', position);
+    if (separator == std::string_view::npos) {
+      throw InvalidPacketException();
+    }
+    position = separator + 1;
+  }
+  // The view excludes the trailing space
+  return buffer.substr(start, position - start - 1);
+}
+
+Bid PacketReader::readBid() {
+  Bid bid = Bid();
+  readChar('B');
+  readSpace();
+  bid.bidder_user_id = readUserId();
+  readSpace();
+  bid.bid_value = readInt();
+  readSpace();
+  bid.date_time = std::string(readDateTime());
+  bid.sec_time = readInt();
+  return bid;
+}
+
+std::vector<std::pair<uint32_t, bool>> PacketReader::readAuctions() {
+  std::vector<std::pair<uint32_t, bool>> auctions;
+
+  while (peek() != '\n') {
+    readSpace();
+    uint32_t auctionId = readAuctionId();
+    readSpace();
+    bool auctionStatus = readInt();
+    auctions.emplace_back(auctionId, auctionStatus);
+  }
+
+  return auctions;
+}
@@ -0,0 +1,44 @@
+#ifndef PACKET_READER_H
+#define PACKET_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "auction_data.hpp"
+
+// Cursor over a received UDP datagram. Fields are validated in place and
+// returned as views into the datagram, so parsing never allocates; the
+// datagram must outlive every view returned by the reader.
+class PacketReader {
+  std::string_view buffer;
+  size_t position = 0;
+
+  void readChar(char chr);
+
+public:
+  explicit PacketReader(std::string_view __buffer) : buffer{__buffer} {}
+
+  // Throws ErrorUdpPacketException if the packet is an ERR packet instead
+  void readPacketId(const char *id);
+  void readSpace();
+  char readChar();
+  // Returns 0 at the end of the datagram
+  char peek() const;
+  // Reads the final '\n', which must be the last byte of the datagram
+  void readPacketDelimiter();
+  // Reads up to max_len bytes, stopping before a space or a newline
+  std::string_view readString(uint32_t max_len);
+  uint32_t readInt();
+  uint64_t readLong();
+  uint32_t readUserId();
+  uint32_t readAuctionId();
+  // Reads "YYYY-MM-DD HH:MM:SS" and the space that follows it
+  std::string_view readDateTime();
+  Bid readBid();
+  std::vector<std::pair<uint32_t, bool>> readAuctions();
+};
+
+#endif
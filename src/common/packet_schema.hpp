@@ -0,0 +1,171 @@
+#ifndef PACKET_SCHEMA_H
+#define PACKET_SCHEMA_H
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "constants.hpp"
+#include "packet_reader.hpp"
+#include "packet_writer.hpp"
+#include "protocol.hpp"
+
+// Packets declare their wire format as a list of fields:
+//
+//   using LoginSchema =
+//       PacketSchema<LoginServerbound, UserIdField<&LoginServerbound::user_id>,
+//                    PasswordField<&LoginServerbound::password>>;
+//
+// and the schema expands into straight-line code encoding and decoding
+// those fields, from a buffer for UDP and from a socket for TCP.
+// Every field is preceded by a space on the wire.
+
+// Gives the schema fields access to the socket readers of TCP packets
+struct TcpFieldAccess {
+  static void writeString(TcpPacket &packet, int fd, std::string_view str) {
+    packet.writeString(fd, str);
+  }
+  static void readSpace(TcpPacket &packet, int fd) { packet.readSpace(fd); }
+  static void readPacketDelimiter(TcpPacket &packet, int fd) {
+    packet.readPacketDelimiter(fd);
+  }
+  static std::string readString(TcpPacket &packet, int fd) {
+    return packet.readString(fd);
+  }
+  static uint32_t readInt(TcpPacket &packet, int fd) {
+    return packet.readInt(fd);
+  }
+  static uint32_t readUserId(TcpPacket &packet, int fd) {
+    return packet.readUserId(fd);
+  }
+  static uint32_t readAuctionId(TcpPacket &packet, int fd) {
+    return packet.readAuctionId(fd);
+  }
+};
+
+template <auto Member> struct UserIdField {
+  template <typename P> static void write(const P &packet, PacketWriter &w) {
+    w.writeChar(' ');
+    w.writeUserId(packet.*Member);
+  }
+  template <typename P> static void read(P &packet, PacketReader &reader) {
+    reader.readSpace();
+    packet.*Member = reader.readUserId();
+  }
+  template <typename P> static void receive(P &packet, int fd) {
+    TcpFieldAccess::readSpace(packet, fd);
+    packet.*Member = TcpFieldAccess::readUserId(packet, fd);
+  }
+};
+
+template <auto Member> struct AuctionIdField {
+  template <typename P> static void write(const P &packet, PacketWriter &w) {
+    w.writeChar(' ');
+    w.writeAuctionId(packet.*Member);
+  }
+  template <typename P> static void read(P &packet, PacketReader &reader) {
+    reader.readSpace();
+    packet.*Member = reader.readAuctionId();
+  }
+  template <typename P> static void receive(P &packet, int fd) {
+    TcpFieldAccess::readSpace(packet, fd);
+    packet.*Member = TcpFieldAccess::readAuctionId(packet, fd);
+  }
+};
+
+// Written zero-padded to Width digits when Width is set
+template <auto Member, size_t Width = 0> struct IntField {
+  template <typename P> static void write(const P &packet, PacketWriter &w) {
+    w.writeChar(' ');
+    w.writePaddedInt(packet.*Member, Width);
+  }
+  template <typename P> static void read(P &packet, PacketReader &reader) {
+    reader.readSpace();
+    packet.*Member = reader.readInt();
+  }
+  template <typename P> static void receive(P &packet, int fd) {
+    TcpFieldAccess::readSpace(packet, fd);
+    packet.*Member = TcpFieldAccess::readInt(packet, fd);
+  }
+};
+
+// Contents are checked by the handlers, the parser only bounds the length
+template <auto Member, uint32_t MaxLen> struct StringField {
+  template <typename P> static void write(const P &packet, PacketWriter &w) {
+    w.writeChar(' ');
+    w.write(packet.*Member);
+  }
+  template <typename P> static void read(P &packet, PacketReader &reader) {
+    reader.readSpace();
+    packet.*Member = reader.readString(MaxLen);
+  }
+  template <typename P> static void receive(P &packet, int fd) {
+    TcpFieldAccess::readSpace(packet, fd);
+    packet.*Member = TcpFieldAccess::readString(packet, fd);
+  }
+};
+
+template <auto Member> using PasswordField = StringField<Member, PASSWORD_LEN>;
+
+// Reply status, spelled on the wire as listed in the packet's STATUS_NAMES,
+// which must follow the order of its status enum
+template <auto Member> struct StatusField {
+  template <typename P> static void write(const P &packet, PacketWriter &w) {
+    size_t status = static_cast<size_t>(packet.*Member);
+    if (status >= std::size(P::STATUS_NAMES)) {
+      throw PacketSerializationException();
+    }
+    w.writeChar(' ');
+    w.write(P::STATUS_NAMES[status]);
+  }
+  template <typename P> static void read(P &packet, PacketReader &reader) {
+    reader.readSpace();
+    setStatus(packet, reader.readString(PACKET_ID_LEN));
+  }
+  template <typename P> static void receive(P &packet, int fd) {
+    TcpFieldAccess::readSpace(packet, fd);
+    setStatus(packet, TcpFieldAccess::readString(packet, fd));
+  }
+  template <typename P>
+  static void setStatus(P &packet, std::string_view name) {
+    using Status = std::remove_reference_t<decltype(packet.*Member)>;
+    for (size_t i = 0; i < std::size(P::STATUS_NAMES); ++i) {
+      if (name == P::STATUS_NAMES[i]) {
+        packet.*Member = static_cast<Status>(i);
+        return;
+      }
+    }
+    throw InvalidPacketException();
+  }
+};
+
+// Reading starts after the packet ID, which is consumed by whoever
+// dispatches on it; writing includes the ID.
+template <typename Packet, typename... Fields> struct PacketSchema {
+  static void write(const Packet &packet, PacketWriter &writer) {
+    writer.write(Packet::ID);
+    (Fields::write(packet, writer), ...);
+    writer.writeChar('\n');
+  }
+
+  static void read(Packet &packet, PacketReader &reader) {
+    (Fields::read(packet, reader), ...);
+    reader.readPacketDelimiter();
+  }
+
+  static void send(Packet &packet, int fd) {
+    char buffer[TCP_HEADER_BUFFER_LEN];
+    PacketWriter writer(buffer, sizeof(buffer));
+    write(packet, writer);
+    TcpFieldAccess::writeString(packet, fd, writer.data());
+  }
+
+  static void receive(Packet &packet, int fd) {
+    (Fields::receive(packet, fd), ...);
+    TcpFieldAccess::readPacketDelimiter(packet, fd);
+  }
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "packet_writer.hpp"
+
+#include <charconv>
+#include <cstring>
+
+#include "constants.hpp"
+#include "protocol.hpp"
+
+char *PacketWriter::reserve(size_t len) {
+  if (len > capacity - length) {
+    throw PacketSerializationException();
+  }
+  char *start = buffer + length;
+  length += len;
+  return start;
+}
+
+void PacketWriter::write(std::string_view str) {
+  std::memcpy(reserve(str.length()), str.data(), str.length());
+}
+
+void PacketWriter::writeChar(char chr) { *reserve(1) = chr; }
+
+void PacketWriter::writeInt(uint32_t value) {
+  char digits[10];
+  std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  write(std::string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+void PacketWriter::writeLong(uint64_t value) {
+  char digits[20];
+  std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  write(std::string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+void PacketWriter::writePaddedInt(uint32_t value, size_t width) {
+  char digits[10];
+  std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  size_t len = static_cast<size_t>(result.ptr - digits);
+  if (len < width) {
+    std::memset(reserve(width - len), '0', width - len);
+  }
+  write(std::string_view(digits, len));
+}
+
+void PacketWriter::writeUserId(uint32_t user_id) {
+  writePaddedInt(user_id, USER_ID_STR_LEN);
+}
+
+void PacketWriter::writeAuctionId(uint32_t auction_id) {
+  writePaddedInt(auction_id, AUCTION_ID_MAX_LEN);
+}
+
+void PacketWriter::writeDateTime(std::time_t time) {
+  struct tm date;
+  if (gmtime_r(&time, &date) == nullptr) {
+    throw PacketSerializationException();
+  }
+  writePaddedInt(static_cast<uint32_t>(date.tm_year + 1900), 4);
+  writeChar('-');
+  writePaddedInt(static_cast<uint32_t>(date.tm_mon + 1), 2);
+  writeChar('-');
+  writePaddedInt(static_cast<uint32_t>(date.tm_mday), 2);
+  writeChar(' ');
+  writePaddedInt(static_cast<uint32_t>(date.tm_hour), 2);
+  writeChar(':');
+  writePaddedInt(static_cast<uint32_t>(date.tm_min), 2);
+  writeChar(':');
+  writePaddedInt(static_cast<uint32_t>(date.tm_sec), 2);
+}
+
+void PacketWriter::writeAuctions(
+    const std::vector<std::pair<uint32_t, bool>> &auctions) {
+  for (size_t i = 0; i < auctions.size(); ++i) {
+    if (i != 0) {
+      writeChar(' ');
+    }
+    writeAuctionId(auctions[i].first);
+    writeChar(' ');
+    writeChar(auctions[i].second ? '1' : '0');
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef PACKET_WRITER_H
+#define PACKET_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Serializes a packet straight into a caller-provided buffer, so building a
+// reply never allocates. Throws PacketSerializationException if the packet
+// does not fit in the buffer.
+class PacketWriter {
+  char *buffer;
+  size_t capacity;
+  size_t length = 0;
+
+  char *reserve(size_t len);
+
+public:
+  PacketWriter(char *__buffer, size_t __capacity)
+      : buffer{__buffer}, capacity{__capacity} {}
+
+  void write(std::string_view str);
+  void writeChar(char chr);
+  void writeInt(uint32_t value);
+  // For counters, which may outgrow writeInt
+  void writeLong(uint64_t value);
+  // Writes the value left-padded with zeros to the given width
+  void writePaddedInt(uint32_t value, size_t width);
+  void writeUserId(uint32_t user_id);
+  void writeAuctionId(uint32_t auction_id);
+  // Writes "YYYY-MM-DD HH:MM:SS" in UTC
+  void writeDateTime(std::time_t time);
+  // Writes "AID state" pairs separated by spaces
+  void writeAuctions(const std::vector<std::pair<uint32_t, bool>> &auctions);
+
+  std::string_view data() const { return std::string_view(buffer, length); }
+  size_t size() const { return length; }
+  // Discards what was written, so the buffer can be reused
+  void clear() { length = 0; }
+};
+
+#endif
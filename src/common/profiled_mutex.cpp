@@ -0,0 +1,116 @@
+#include "profiled_mutex.hpp"
+
+#include <algorithm>
+
+static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+static uint64_t nanoseconds(std::chrono::steady_clock::duration duration) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+void ProfiledMutex::lock() {
+  if (mutex.try_lock()) {
+    acquired_at = Clock::now();
+    add(acquisitions, 1);
+    return;
+  }
+
+  Clock::time_point waiting_since = Clock::now();
+  mutex.lock();
+  acquired_at = Clock::now();
+  uint64_t waited = nanoseconds(acquired_at - waiting_since);
+  add(acquisitions, 1);
+  add(contended, 1);
+  add(wait_ns, waited);
+  if (waited > max_wait_ns.load(std::memory_order_relaxed)) {
+    max_wait_ns.store(waited, std::memory_order_relaxed);
+  }
+}
+
+bool ProfiledMutex::try_lock() {
+  if (!mutex.try_lock()) {
+    return false;
+  }
+  acquired_at = Clock::now();
+  add(acquisitions, 1);
+  return true;
+}
+
+void ProfiledMutex::unlock() {
+  add(hold_ns, nanoseconds(Clock::now() - acquired_at));
+  mutex.unlock();
+}
+
+LockStats ProfiledMutex::stats(const std::string &kind,
+                               const std::string &key) const {
+  LockStats stats;
+  stats.kind = kind;
+  stats.key = key;
+  stats.acquisitions = acquisitions.load(std::memory_order_relaxed);
+  stats.contended = contended.load(std::memory_order_relaxed);
+  stats.wait_ns = wait_ns.load(std::memory_order_relaxed);
+  stats.max_wait_ns = max_wait_ns.load(std::memory_order_relaxed);
+  stats.hold_ns = hold_ns.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void write_lock_report(std::ostream &stream, std::vector<LockStats> locks,
+                       size_t top) {
+  // Longest waits first, then the most held, within each kind
+  std::sort(locks.begin(), locks.end(),
+            [](const LockStats &a, const LockStats &b) {
+              if (a.kind != b.kind) {
+                return a.kind < b.kind;
+              }
+              if (a.wait_ns != b.wait_ns) {
+                return a.wait_ns > b.wait_ns;
+              }
+              return a.hold_ns > b.hold_ns;
+            });
+  std::vector<LockStats> hottest;
+  for (size_t i = 0; i < locks.size(); ++i) {
+    if (i < top || locks[i].kind != locks[i - top].kind) {
+      hottest.push_back(locks[i]);
+    }
+  }
+
+  struct Family {
+    const char *name;
+    const char *type;
+    const char *help;
+    bool seconds;
+    uint64_t LockStats::*value;
+  };
+  static const Family FAMILIES[] = {
+      {"as_lock_acquisitions_total", "counter", "Times the lock was taken.",
+       false, &LockStats::acquisitions},
+      {"as_lock_contended_total", "counter",
+       "Times the lock was taken after waiting for another holder.", false,
+       &LockStats::contended},
+      {"as_lock_wait_seconds_total", "counter",
+       "Time spent waiting for the lock.", true, &LockStats::wait_ns},
+      {"as_lock_wait_max_seconds", "gauge",
+       "Longest single wait for the lock.", true, &LockStats::max_wait_ns},
+      {"as_lock_hold_seconds_total", "counter", "Time the lock was held.",
+       true, &LockStats::hold_ns},
+  };
+  for (const Family &family : FAMILIES) {
+    stream << "# HELP " << family.name << " " << family.help
+           << " Only the locks waited on the longest are listed.\n"
+           << "# TYPE " << family.name << " " << family.type << "\n";
+    for (const LockStats &lock : hottest) {
+      stream << family.name << "{kind=\"" << lock.kind << "\",key=\""
+             << lock.key << "\"} ";
+      if (family.seconds) {
+        stream << static_cast<double>(lock.*family.value) / 1e9;
+      } else {
+        stream << lock.*family.value;
+      }
+      stream << "\n";
+    }
+  }
+}
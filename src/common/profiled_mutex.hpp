@@ -0,0 +1,54 @@
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How much a lock was contended since it was created
+struct LockStats {
+  // What the lock guards ("user", "auction") and which one
+  std::string kind;
+  std::string key;
+  uint64_t acquisitions = 0;
+  // Acquisitions that had to wait for another holder
+  uint64_t contended = 0;
+  uint64_t wait_ns = 0;
+  uint64_t max_wait_ns = 0;
+  uint64_t hold_ns = 0;
+};
+
+// A mutex that counts its acquisitions and times how long they waited and
+// held it. Uncontended acquisitions are not timed until they are held.
+// Counters are only written while the mutex is held, so plain stores are
+// enough; they are atomic so reports can read them at any time.
+class ProfiledMutex {
+  typedef std::chrono::steady_clock Clock;
+
+  std::mutex mutex;
+  std::atomic<uint64_t> acquisitions{0};
+  std::atomic<uint64_t> contended{0};
+  std::atomic<uint64_t> wait_ns{0};
+  std::atomic<uint64_t> max_wait_ns{0};
+  std::atomic<uint64_t> hold_ns{0};
+  // Only used by the holder
+  Clock::time_point acquired_at;
+
+public:
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  LockStats stats(const std::string &kind, const std::string &key) const;
+};
+
+// Writes the locks of each kind that waited the longest, at most top of
+// each, in the Prometheus text exposition format
+void write_lock_report(std::ostream &stream, std::vector<LockStats> locks,
+                       size_t top);
+
+#endif
@@ -10,323 +10,152 @@
 #include <string>
 
 #include "common.hpp"
-#include "protocol.hpp"
+#include "field_validation.hpp"
+#include "packet_schema.hpp"
 
 extern bool is_shutting_down;
 
-void UdpPacket::readPacketId(std::stringstream &buffer, const char *packet_id) {
-  char current_char;
-  const char *errorID = ErrorUdpPacket::ID;
-  int errorID_counter = 0;
-  while (*packet_id != '\0') {
-    buffer >> current_char;
-    if (!buffer.good() || current_char != *packet_id) {
-      // Check if the unexpected packet is an error packet
-      if (current_char != errorID[errorID_counter]) {
-
-        // If it is not an error packet, throw an exception
-        throw UnexpectedPacketException();
-      } else {
-
-        // While the packet seems to be an error packet, keep reading
-        errorID_counter++;
-      }
-
-      // If it's confirmed that the packet is an error packet, throw an
-      // exception
-      if (errorID_counter == 3) {
-        // Without the packet delimiter, the error packet would be invalid
-        readPacketDelimiter(buffer);
-        throw ErrorUdpPacketException();
-      }
-    }
-    ++packet_id;
-  }
-}
-
-void UdpPacket::readChar(std::stringstream &buffer, char chr) {
-  if (readChar(buffer) != chr) {
+void UdpPacket::deserialize(std::stringstream &buffer) {
+  const std::string data = buffer.str();
+  std::streampos start = buffer.tellg();
+  if (start < 0) {
     throw InvalidPacketException();
   }
+  PacketReader reader(
+      std::string_view(data).substr(static_cast<size_t>(start)));
+  deserialize(reader);
+  buffer.seekg(0, std::ios::end);
 }
 
-char UdpPacket::readChar(std::stringstream &buffer) {
-  char c;
-  buffer >> c;
-  if (!buffer.good()) {
-    throw InvalidPacketException();
-  }
-  return c;
+std::stringstream UdpPacket::serialize() {
+  char data[SOCKET_BUFFER_LEN];
+  PacketWriter writer(data, sizeof(data));
+  serialize(writer);
+  std::stringstream buffer;
+  buffer.write(data, static_cast<std::streamsize>(writer.size()));
+  return buffer;
 }
 
-char UdpPacket::readAlphabeticalChar(std::stringstream &buffer) {
-  char c;
-  buffer >> c;
+// ----- Packet type seriliazation and deserialization methods -----
+using LoginServerboundSchema =
+    PacketSchema<LoginServerbound,
+                 UserIdField<&LoginServerbound::user_id>,
+                 PasswordField<&LoginServerbound::password>>;
 
-  if (!buffer.good() || !isalpha((unsigned char)c)) {
-    throw InvalidPacketException();
-  }
-  return (char)tolower((unsigned char)c);
+void LoginServerbound::serialize(PacketWriter &writer) {
+  LoginServerboundSchema::write(*this, writer);
 }
 
-void UdpPacket::readSpace(std::stringstream &buffer) { readChar(buffer, ' '); }
-
-void UdpPacket::readPacketDelimiter(std::stringstream &buffer) {
-  readChar(buffer, '\n');
-  buffer.peek();
-  if (!buffer.eof()) { // If there is more data in the buffer, the packet is
-                       // invalid
-    throw InvalidPacketException();
-  }
+void LoginServerbound::deserialize(PacketReader &reader) {
+  // Serverbound packets don't read their ID
+  LoginServerboundSchema::read(*this, reader);
 }
 
-std::string UdpPacket::readString(std::stringstream &buffer, uint32_t max_len) {
-  std::string str;
-  uint32_t i = 0;
-  while (i < max_len) {
-    char c = (char)buffer.get();
-    if (!buffer.good()) {
-      throw InvalidPacketException();
-    }
-    if (c == ' ' || c == '\n') {
-      buffer.unget();
-      break;
-    }
-    str += c;
-    ++i;
-  }
-  return str;
-};
+using ReplyLoginClientboundSchema =
+    PacketSchema<ReplyLoginClientbound,
+                 StatusField<&ReplyLoginClientbound::status>>;
 
-uint32_t UdpPacket::readInt(std::stringstream &buffer) {
-  int64_t i;
-  buffer >> i;
-  if (!buffer.good() || i < 0 || i > INT32_MAX) {
-    throw InvalidPacketException();
-  }
-  return (uint32_t)i;
-};
+void ReplyLoginClientbound::serialize(PacketWriter &writer) {
+  ReplyLoginClientboundSchema::write(*this, writer);
+}
 
-uint32_t UdpPacket::readUserId(std::stringstream &buffer) {
-  std::string id_str = readString(buffer, USER_ID_STR_LEN);
-  return parse_packet_user_id(id_str);
-};
+void ReplyLoginClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyLoginClientbound::ID);
+  ReplyLoginClientboundSchema::read(*this, reader);
+}
 
-uint32_t UdpPacket::readAuctionId(std::stringstream &buffer) {
-  std::string id_str = readString(buffer, AUCTION_ID_MAX_LEN);
-  return parse_packet_auction_id(id_str);
-};
+using LogoutServerboundSchema =
+    PacketSchema<LogoutServerbound,
+                 UserIdField<&LogoutServerbound::user_id>,
+                 PasswordField<&LogoutServerbound::password>>;
 
-// ----- Packet type seriliazation and deserialization methods -----
-std::stringstream LoginServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << LoginServerbound::ID << " ";
-  write_user_id(buffer, user_id);
-  buffer << " " << password;
-  buffer << std::endl;
-  return buffer;
-};
+void LogoutServerbound::serialize(PacketWriter &writer) {
+  LogoutServerboundSchema::write(*this, writer);
+}
 
-void LoginServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void LogoutServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readSpace(buffer);
-  user_id = readUserId(buffer);
-  readSpace(buffer);
-  password = readString(buffer, PASSWORD_LEN);
-  readPacketDelimiter(buffer);
-};
-
-std::stringstream ReplyLoginClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyLoginClientbound::ID << " ";
-  if (status == ReplyLoginClientbound::status::OK) {
-    buffer << "OK";
-  } else if (status == ReplyLoginClientbound::status::NOK) {
-    buffer << "NOK";
-  } else if (status == ReplyLoginClientbound::status::REG) {
-    buffer << "REG";
-  } else if (status == ReplyLoginClientbound::status::ERR) {
-    buffer << "ERR";
-  } else {
-    throw PacketSerializationException();
-  }
-  buffer << std::endl;
-  return buffer;
+  LogoutServerboundSchema::read(*this, reader);
 }
 
-void ReplyLoginClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyLoginClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
-  if (status_str == "OK") {
-    status = OK;
-  } else if (status_str == "NOK") {
-    status = NOK;
-  } else if (status_str == "REG") {
-    status = REG;
-  } else if (status_str == "ERR") {
-    status = ERR;
-  } else {
-    throw InvalidPacketException();
-  }
-  readPacketDelimiter(buffer);
-};
-
-std::stringstream LogoutServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << LogoutServerbound::ID << " ";
-  write_user_id(buffer, user_id);
-  buffer << " " << password;
-  buffer << std::endl;
-  return buffer;
-};
+using ReplyLogoutClientboundSchema =
+    PacketSchema<ReplyLogoutClientbound,
+                 StatusField<&ReplyLogoutClientbound::status>>;
 
-void LogoutServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  // Serverbound packets don't read their ID
-  readSpace(buffer);
-  user_id = readUserId(buffer);
-  readSpace(buffer);
-  password = readString(buffer, PASSWORD_LEN);
-  readPacketDelimiter(buffer);
-};
+void ReplyLogoutClientbound::serialize(PacketWriter &writer) {
+  ReplyLogoutClientboundSchema::write(*this, writer);
+}
 
-std::stringstream ReplyLogoutClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyLogoutClientbound::ID << " ";
-  if (status == ReplyLogoutClientbound::status::OK) {
-    buffer << "OK";
-  } else if (status == ReplyLogoutClientbound::status::NOK) {
-    buffer << "NOK";
-  } else if (status == ReplyLogoutClientbound::status::UNR) {
-    buffer << "UNR";
-  } else if (status == ReplyLogoutClientbound::status::ERR) {
-    buffer << "ERR";
-  } else {
-    throw PacketSerializationException();
-  }
-  buffer << std::endl;
-  return buffer;
-};
+void ReplyLogoutClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyLogoutClientbound::ID);
+  ReplyLogoutClientboundSchema::read(*this, reader);
+}
 
-void ReplyLogoutClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyLogoutClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
-  if (status_str == "OK") {
-    status = OK;
-  } else if (status_str == "NOK") {
-    status = NOK;
-  } else if (status_str == "UNR") {
-    status = UNR;
-  } else if (status_str == "ERR") {
-    status = ERR;
-  } else {
-    throw InvalidPacketException();
-  }
-  readPacketDelimiter(buffer);
-};
+using UnregisterServerboundSchema =
+    PacketSchema<UnregisterServerbound,
+                 UserIdField<&UnregisterServerbound::user_id>,
+                 PasswordField<&UnregisterServerbound::password>>;
 
-std::stringstream UnregisterServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << UnregisterServerbound::ID << " ";
-  write_user_id(buffer, user_id);
-  buffer << " " << password << std::endl;
-  return buffer;
-};
+void UnregisterServerbound::serialize(PacketWriter &writer) {
+  UnregisterServerboundSchema::write(*this, writer);
+}
 
-void UnregisterServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void UnregisterServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readSpace(buffer);
-  user_id = readUserId(buffer);
-  readSpace(buffer);
-  password = readString(buffer, PASSWORD_LEN);
-  readPacketDelimiter(buffer);
-};
+  UnregisterServerboundSchema::read(*this, reader);
+}
 
-std::stringstream ReplyUnregisterClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyUnregisterClientbound::ID << " ";
-  if (status == ReplyUnregisterClientbound::status::OK) {
-    buffer << "OK";
-  } else if (status == ReplyUnregisterClientbound::status::NOK) {
-    buffer << "NOK";
-  } else if (status == ReplyUnregisterClientbound::status::UNR) {
-    buffer << "UNR";
-  } else if (status == ReplyUnregisterClientbound::status::ERR) {
-    buffer << "ERR";
-  } else {
-    throw PacketSerializationException();
-  }
-  buffer << std::endl;
-  return buffer;
-};
+using ReplyUnregisterClientboundSchema =
+    PacketSchema<ReplyUnregisterClientbound,
+                 StatusField<&ReplyUnregisterClientbound::status>>;
 
-void ReplyUnregisterClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyUnregisterClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
-  if (status_str == "OK") {
-    status = OK;
-  } else if (status_str == "NOK") {
-    status = NOK;
-  } else if (status_str == "UNR") {
-    status = UNR;
-  } else if (status_str == "ERR") {
-    status = ERR;
-  } else {
-    throw InvalidPacketException();
-  }
-  readPacketDelimiter(buffer);
-};
+void ReplyUnregisterClientbound::serialize(PacketWriter &writer) {
+  ReplyUnregisterClientboundSchema::write(*this, writer);
+}
 
-std::stringstream ListMyAuctionsServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << ListMyAuctionsServerbound::ID << " ";
-  write_user_id(buffer, user_id);
-  buffer << std::endl;
-  return buffer;
-};
+void ReplyUnregisterClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyUnregisterClientbound::ID);
+  ReplyUnregisterClientboundSchema::read(*this, reader);
+}
+
+using ListMyAuctionsServerboundSchema =
+    PacketSchema<ListMyAuctionsServerbound,
+                 UserIdField<&ListMyAuctionsServerbound::user_id>>;
+
+void ListMyAuctionsServerbound::serialize(PacketWriter &writer) {
+  ListMyAuctionsServerboundSchema::write(*this, writer);
+}
 
-void ListMyAuctionsServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void ListMyAuctionsServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readSpace(buffer);
-  user_id = readUserId(buffer);
-  readPacketDelimiter(buffer);
-};
+  ListMyAuctionsServerboundSchema::read(*this, reader);
+}
 
-std::stringstream ReplyListMyAuctionsClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyListMyAuctionsClientbound::ID << " ";
+void ReplyListMyAuctionsClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyListMyAuctionsClientbound::ID);
+  writer.writeChar(' ');
   if (status == ReplyListMyAuctionsClientbound::status::OK) {
-    buffer << "OK " << auctionsToString(auctions);
+    writer.write("OK ");
+    writer.writeAuctions(auctions);
   } else if (status == ReplyListMyAuctionsClientbound::status::NOK) {
-    buffer << "NOK";
+    writer.write("NOK");
   } else if (status == ReplyListMyAuctionsClientbound::status::NLG) {
-    buffer << "NLG";
+    writer.write("NLG");
   } else if (status == ReplyListMyAuctionsClientbound::status::ERR) {
-    buffer << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  buffer << std::endl;
-  return buffer;
+  writer.writeChar('\n');
 };
 
-void ReplyListMyAuctionsClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyListMyAuctionsClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
+void ReplyListMyAuctionsClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyListMyAuctionsClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
   if (status_str == "OK") {
     status = OK;
-    auctions = readAuctions(buffer);
+    auctions = reader.readAuctions();
   } else if (status_str == "NOK") {
     status = NOK;
   } else if (status_str == "NLG") {
@@ -336,51 +165,47 @@ void ReplyListMyAuctionsClientbound::deserialize(std::stringstream &buffer) {
   } else {
     throw InvalidPacketException();
   }
-  readPacketDelimiter(buffer);
+  reader.readPacketDelimiter();
 };
 
-std::stringstream MyBidsServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << MyBidsServerbound::ID << " ";
-  write_user_id(buffer, user_id);
-  buffer << std::endl;
-  return buffer;
-};
+using MyBidsServerboundSchema =
+    PacketSchema<MyBidsServerbound,
+                 UserIdField<&MyBidsServerbound::user_id>>;
+
+void MyBidsServerbound::serialize(PacketWriter &writer) {
+  MyBidsServerboundSchema::write(*this, writer);
+}
 
-void MyBidsServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void MyBidsServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readSpace(buffer);
-  user_id = readUserId(buffer);
-  readPacketDelimiter(buffer);
-};
+  MyBidsServerboundSchema::read(*this, reader);
+}
 
-std::stringstream ReplyMyBidsClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyMyBidsClientbound::ID << " ";
+void ReplyMyBidsClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyMyBidsClientbound::ID);
+  writer.writeChar(' ');
   if (status == ReplyMyBidsClientbound::status::OK) {
-    buffer << "OK " << auctionsToString(auctions);
+    writer.write("OK ");
+    writer.writeAuctions(auctions);
   } else if (status == ReplyMyBidsClientbound::status::NOK) {
-    buffer << "NOK";
+    writer.write("NOK");
   } else if (status == ReplyMyBidsClientbound::status::NLG) {
-    buffer << "NLG";
+    writer.write("NLG");
   } else if (status == ReplyMyBidsClientbound::status::ERR) {
-    buffer << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  buffer << std::endl;
-  return buffer;
+  writer.writeChar('\n');
 };
 
-void ReplyMyBidsClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyMyBidsClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
+void ReplyMyBidsClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyMyBidsClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
   if (status_str == "OK") {
     status = OK;
-    auctions = readAuctions(buffer);
+    auctions = reader.readAuctions();
   } else if (status_str == "NOK") {
     status = NOK;
   } else if (status_str == "NLG") {
@@ -390,45 +215,43 @@ void ReplyMyBidsClientbound::deserialize(std::stringstream &buffer) {
   } else {
     throw InvalidPacketException();
   }
-  readPacketDelimiter(buffer);
+  reader.readPacketDelimiter();
 };
 
-std::stringstream ListAuctionsServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << ListAuctionsServerbound::ID << std::endl;
-  return buffer;
-};
+using ListAuctionsServerboundSchema = PacketSchema<ListAuctionsServerbound>;
+
+void ListAuctionsServerbound::serialize(PacketWriter &writer) {
+  ListAuctionsServerboundSchema::write(*this, writer);
+}
 
-void ListAuctionsServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void ListAuctionsServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readPacketDelimiter(buffer);
-};
+  ListAuctionsServerboundSchema::read(*this, reader);
+}
 
-std::stringstream ReplyListAuctionsClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyListAuctionsClientbound::ID << " ";
+void ReplyListAuctionsClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyListAuctionsClientbound::ID);
+  writer.writeChar(' ');
   if (status == ReplyListAuctionsClientbound::status::OK) {
-    buffer << "OK " << auctionsToString(auctions);
+    writer.write("OK ");
+    writer.writeAuctions(auctions);
   } else if (status == ReplyListAuctionsClientbound::status::NOK) {
-    buffer << "NOK";
+    writer.write("NOK");
   } else if (status == ReplyListAuctionsClientbound::status::ERR) {
-    buffer << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  buffer << std::endl;
-  return buffer;
+  writer.writeChar('\n');
 };
 
-void ReplyListAuctionsClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyListAuctionsClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
+void ReplyListAuctionsClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyListAuctionsClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
   if (status_str == "OK") {
     status = OK;
-    auctions = readAuctions(buffer);
+    auctions = reader.readAuctions();
   } else if (status_str == "NOK") {
     status = NOK;
   } else if (status_str == "ERR") {
@@ -436,36 +259,101 @@ void ReplyListAuctionsClientbound::deserialize(std::stringstream &buffer) {
   } else {
     throw InvalidPacketException();
   }
-  readPacketDelimiter(buffer);
+  reader.readPacketDelimiter();
 };
 
-std::stringstream ShowRecordServerbound::serialize() {
-  std::stringstream buffer;
-  buffer << ShowRecordServerbound::ID << " ";
-  write_auction_id(buffer, auction_id);
-  buffer << std::endl;
-  return buffer;
-};
+using ListSinceServerboundSchema =
+    PacketSchema<ListSinceServerbound, IntField<&ListSinceServerbound::epoch>,
+                 IntField<&ListSinceServerbound::version>>;
 
-void ShowRecordServerbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
+void ListSinceServerbound::serialize(PacketWriter &writer) {
+  ListSinceServerboundSchema::write(*this, writer);
+}
+
+void ListSinceServerbound::deserialize(PacketReader &reader) {
   // Serverbound packets don't read their ID
-  readSpace(buffer);
-  auction_id = readAuctionId(buffer);
-  readPacketDelimiter(buffer);
+  ListSinceServerboundSchema::read(*this, reader);
+}
+
+void ReplyListSinceClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyListSinceClientbound::ID);
+  writer.writeChar(' ');
+  if (status == ReplyListSinceClientbound::status::ERR) {
+    writer.write("ERR");
+    writer.writeChar('\n');
+    return;
+  }
+  if (status == ReplyListSinceClientbound::status::OK) {
+    writer.write("OK ");
+  } else if (status == ReplyListSinceClientbound::status::ALL) {
+    writer.write("ALL ");
+  } else {
+    throw PacketSerializationException();
+  }
+  writer.writeInt(epoch);
+  writer.writeChar(' ');
+  writer.writeInt(version);
+  if (!auctions.empty()) {
+    writer.writeChar(' ');
+    writer.writeAuctions(auctions);
+  }
+  writer.writeChar('\n');
 };
 
-std::stringstream ReplyShowRecordClientbound::serialize() {
-  std::stringstream buffer;
-  buffer << ReplyShowRecordClientbound::ID << " ";
+void ReplyListSinceClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyListSinceClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
+  if (status_str == "ERR") {
+    status = ERR;
+    reader.readPacketDelimiter();
+    return;
+  }
+  if (status_str == "OK") {
+    status = OK;
+  } else if (status_str == "ALL") {
+    status = ALL;
+  } else {
+    throw InvalidPacketException();
+  }
+  reader.readSpace();
+  epoch = reader.readInt();
+  reader.readSpace();
+  version = reader.readInt();
+  auctions = reader.readAuctions();
+  reader.readPacketDelimiter();
+};
+
+using ShowRecordServerboundSchema =
+    PacketSchema<ShowRecordServerbound,
+                 AuctionIdField<&ShowRecordServerbound::auction_id>>;
+
+void ShowRecordServerbound::serialize(PacketWriter &writer) {
+  ShowRecordServerboundSchema::write(*this, writer);
+}
+
+void ShowRecordServerbound::deserialize(PacketReader &reader) {
+  // Serverbound packets don't read their ID
+  ShowRecordServerboundSchema::read(*this, reader);
+}
+
+void ReplyShowRecordClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyShowRecordClientbound::ID);
+  writer.writeChar(' ');
 
   if (status == ReplyShowRecordClientbound::status::OK) {
-    buffer << "OK ";
-    write_user_id(buffer, auction.getOwnerId());
-    buffer << " " << auction.getName() << " " << auction.getAssetFname();
-    buffer << " " << auction.getInitialBid() << " ";
-    buffer << auction.getStartTimeString() << " ";
-    buffer << auction.getDurationSeconds();
+    writer.write("OK ");
+    writer.writeUserId(auction.getOwnerId());
+    writer.writeChar(' ');
+    writer.write(auction.getName());
+    writer.writeChar(' ');
+    writer.write(auction.getAssetFname());
+    writer.writeChar(' ');
+    writer.writeInt(auction.getInitialBid());
+    writer.writeChar(' ');
+    writer.writeDateTime(auction.getStartTime());
+    writer.writeChar(' ');
+    writer.writeInt(auction.getDurationSeconds());
 
     if (auction.hasBids()) {
       const std::vector<Bid> &bids = auction.getBids();
@@ -478,70 +366,73 @@ std::stringstream ReplyShowRecordClientbound::serialize() {
         // Access bids by index
         const Bid &currentBid = bids[i];
         // Perform operations with currentBid
-        buffer << " B ";
-        write_user_id(buffer, currentBid.bidder_user_id);
-        buffer << " " << currentBid.bid_value;
-        buffer << " " << currentBid.date_time;
-        buffer << " " << currentBid.sec_time;
+        writer.write(" B ");
+        writer.writeUserId(currentBid.bidder_user_id);
+        writer.writeChar(' ');
+        writer.writeInt(currentBid.bid_value);
+        writer.writeChar(' ');
+        writer.write(currentBid.date_time);
+        writer.writeChar(' ');
+        writer.writeInt(currentBid.sec_time);
       }
     }
     if (!auction.isActive()) {
-      buffer << " E ";
-      buffer << auction.getEndTimeString();
-      buffer << " " << auction.getEndTimeSec();
+      writer.write(" E ");
+      writer.write(auction.getEndTimeString());
+      writer.writeChar(' ');
+      writer.writeInt(auction.getEndTimeSec());
     }
   } else if (status == ReplyShowRecordClientbound::status::NOK) {
-    buffer << "NOK";
+    writer.write("NOK");
   } else if (status == ReplyShowRecordClientbound::status::ERR) {
-    buffer << "ERR";
+    writer.write("ERR");
   } else {
     throw InvalidPacketException();
   }
-  buffer << std::endl;
-  return buffer;
+  writer.writeChar('\n');
 };
 
-void ReplyShowRecordClientbound::deserialize(std::stringstream &buffer) {
-  buffer >> std::noskipws;
-  readPacketId(buffer, ReplyShowRecordClientbound::ID);
-  readSpace(buffer);
-  auto status_str = readString(buffer, PACKET_ID_LEN);
+void ReplyShowRecordClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyShowRecordClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
 
   if (status_str == "OK") {
     status = OK;
-    readSpace(buffer);
+    reader.readSpace();
     // Read auction data
-    auction.setOwnerId(readUserId(buffer));
-    readSpace(buffer);
-    auction.setName(readString(buffer, AUCTION_NAME_MAX_LENGTH));
-    readSpace(buffer);
-    auction.setAssetFname(readString(buffer, ASSET_NAME_MAX_LENGTH));
-    readSpace(buffer);
-    auction.setInitialBid(readInt(buffer));
-    readSpace(buffer);
-
-    startTime = read_date_time(buffer);
+    auction.setOwnerId(reader.readUserId());
+    reader.readSpace();
+    auction.setName(std::string(reader.readString(AUCTION_NAME_MAX_LENGTH)));
+    reader.readSpace();
+    auction.setAssetFname(
+        std::string(reader.readString(ASSET_NAME_MAX_LENGTH)));
+    reader.readSpace();
+    auction.setInitialBid(reader.readInt());
+    reader.readSpace();
+
+    startTime = reader.readDateTime();
     // Don't need to readSpace() because read date time reads an extra space
 
-    auction.setDurationSeconds(readInt(buffer));
+    auction.setDurationSeconds(reader.readInt());
 
     // Read bids and end time
     int bidCounter = 0;
-    if (buffer.peek() != '\n') { // Check if there are bids or end time
-      while (buffer.peek() == ' ') {
-        readSpace(buffer);
-        if (buffer.peek() == 'B') { // Read bid
-          auction.addBid(readBid(buffer));
+    if (reader.peek() != '\n') { // Check if there are bids or end time
+      while (reader.peek() == ' ') {
+        reader.readSpace();
+        if (reader.peek() == 'B') { // Read bid
+          auction.addBid(reader.readBid());
           bidCounter++;
           if (bidCounter > 50) { // You cant receive more than 50 bids
             throw InvalidPacketException();
           }
-        } else if (buffer.peek() == 'E') { // Read end time
-          readChar(buffer);
-          readSpace(buffer);
-          endTime = read_date_time(buffer);
+        } else if (reader.peek() == 'E') { // Read end time
+          reader.readChar();
+          reader.readSpace();
+          endTime = reader.readDateTime();
           auction.setEndTime(endTime);
-          auction.setEndTimeSec(readInt(buffer));
+          auction.setEndTimeSec(reader.readInt());
           break;
         }
       }
@@ -553,22 +444,85 @@ void ReplyShowRecordClientbound::deserialize(std::stringstream &buffer) {
   } else {
     throw InvalidPacketException();
   }
-  readPacketDelimiter(buffer);
+  reader.readPacketDelimiter();
 };
 
-std::stringstream ErrorUdpPacket::serialize() {
-  std::stringstream buffer;
-  buffer << ErrorUdpPacket::ID << std::endl;
-  return buffer;
+using AdminStatsServerboundSchema = PacketSchema<AdminStatsServerbound>;
+
+void AdminStatsServerbound::serialize(PacketWriter &writer) {
+  AdminStatsServerboundSchema::write(*this, writer);
+}
+
+void AdminStatsServerbound::deserialize(PacketReader &reader) {
+  // Serverbound packets don't read their ID
+  AdminStatsServerboundSchema::read(*this, reader);
+}
+
+void ReplyAdminStatsClientbound::serialize(PacketWriter &writer) {
+  writer.write(ReplyAdminStatsClientbound::ID);
+  writer.writeChar(' ');
+  if (status == ReplyAdminStatsClientbound::status::OK) {
+    writer.write("OK");
+    for (auto &stat : stats) {
+      writer.writeChar(' ');
+      writer.write(stat.first);
+      writer.writeChar(' ');
+      writer.writeLong(stat.second);
+    }
+  } else if (status == ReplyAdminStatsClientbound::status::NOK) {
+    writer.write("NOK");
+  } else if (status == ReplyAdminStatsClientbound::status::ERR) {
+    writer.write("ERR");
+  } else {
+    throw PacketSerializationException();
+  }
+  writer.writeChar('\n');
 };
 
-void ErrorUdpPacket::deserialize(std::stringstream &buffer) {
-  (void)buffer;
+void ReplyAdminStatsClientbound::deserialize(PacketReader &reader) {
+  reader.readPacketId(ReplyAdminStatsClientbound::ID);
+  reader.readSpace();
+  auto status_str = reader.readString(PACKET_ID_LEN);
+  if (status_str == "OK") {
+    status = OK;
+    while (reader.peek() != '\n') {
+      reader.readSpace();
+      std::string name(reader.readString(ADMIN_STAT_NAME_MAX_LEN));
+      reader.readSpace();
+      stats.emplace_back(name, reader.readLong());
+    }
+  } else if (status_str == "NOK") {
+    status = NOK;
+  } else if (status_str == "ERR") {
+    status = ERR;
+  } else {
+    throw InvalidPacketException();
+  }
+  reader.readPacketDelimiter();
+};
+
+using ErrorUdpPacketSchema = PacketSchema<ErrorUdpPacket>;
+
+void ErrorUdpPacket::serialize(PacketWriter &writer) {
+  ErrorUdpPacketSchema::write(*this, writer);
+}
+
+void ErrorUdpPacket::deserialize(PacketReader &reader) {
+  (void)reader;
   // unimplemented
 };
 
-void TcpPacket::writeString(int fd, const std::string &str) {
-  const char *buffer = str.c_str();
+thread_local TcpTranscript *TcpPacket::transcript = nullptr;
+
+void TcpPacket::writeString(int fd, std::string_view str) {
+  if (transcript != nullptr) {
+    transcript->sent.append(str);
+  }
+  writeAsset(fd, str);
+}
+
+void TcpPacket::writeAsset(int fd, std::string_view str) {
+  const char *buffer = str.data();
   ssize_t bytes_to_send = (ssize_t)str.length();
   ssize_t bytes_sent = 0;
   while (bytes_sent < bytes_to_send) {
@@ -624,6 +578,9 @@ char TcpPacket::readChar(int fd) {
   if (read(fd, &c, 1) != 1) {
     throw InvalidPacketException();
   }
+  if (transcript != nullptr) {
+    transcript->received.push_back(c);
+  }
   return c;
 }
 
@@ -642,6 +599,9 @@ std::string TcpPacket::readString(const int fd) {
     result += c;
   }
   delimiter = c;
+  if (transcript != nullptr) {
+    transcript->received.append(result);
+  }
 
   result.pop_back();
 
@@ -677,44 +637,27 @@ uint32_t TcpPacket::readAuctionId(const int fd) {
 
 uint32_t TcpPacket::readFileSize(const int fd) {
   std::string file_size_str = readString(fd);
-  if (file_size_str.length() > ASSET_FILE_SIZE_MAX_LEN) {
-    throw InvalidPacketException();
-  }
-  for (char c : file_size_str) {
-    if (!isdigit(c)) {
-      throw InvalidPacketException();
-    }
-  }
-  try {
-    int file_size = std::stoi(file_size_str);
-    if (file_size < 0 || file_size > (int)ASSET_MAX_BYTES) {
-      throw InvalidPacketException();
-    }
-    return (uint32_t)file_size;
-  } catch (...) {
+  uint32_t file_size;
+  if (file_size_str.length() > ASSET_FILE_SIZE_MAX_LEN ||
+      !parse_digits(file_size_str, file_size) || file_size > ASSET_MAX_BYTES) {
     throw InvalidPacketException();
   }
+  return file_size;
 }
 
 std::string TcpPacket::readFileName(const int fd) {
   std::string str = readString(fd);
-  if (str.length() > ASSET_NAME_MAX_LENGTH) {
+  if (str.length() > ASSET_NAME_MAX_LENGTH || !is_file_name_field(str)) {
     throw InvalidPacketException();
   }
-  for (uint32_t i = 0; i < str.length(); ++i) {
-    char c = str[i];
-    if (!isalpha((unsigned char)c) && !isdigit(c) && c != '-' && c != '_' &&
-        c != '.') {
-      throw InvalidPacketException();
-    }
-  }
   return str;
 }
 
 void TcpPacket::readAndSaveToFile(const int fd, const std::string &file_name,
                                   const size_t file_size,
-                                  const bool cancellable) {
-  std::ofstream file(file_name);
+                                  const bool cancellable, Sha256 *digest,
+                                  const bool append) {
+  std::ofstream file(file_name, append ? std::ios::app : std::ios::trunc);
   if (!file.good()) {
     throw IOException();
   }
@@ -765,12 +708,16 @@ void TcpPacket::readAndSaveToFile(const int fd, const std::string &file_name,
         file.close();
         throw IOException();
       }
+      if (digest != nullptr) {
+        digest->update(buffer, (size_t)n);
+      }
       remaining_size -= (size_t)n;
 
       size_t downloaded_size = file_size - remaining_size;
-      if (((downloaded_size - (size_t)n) * 100 / file_size) %
-              PROGRESS_BAR_STEP_SIZE >
-          (downloaded_size * 100 / file_size) % PROGRESS_BAR_STEP_SIZE) {
+      if (cancellable &&
+          ((downloaded_size - (size_t)n) * 100 / file_size) %
+                  PROGRESS_BAR_STEP_SIZE >
+              (downloaded_size * 100 / file_size) % PROGRESS_BAR_STEP_SIZE) {
         std::cout << "Downloading Asset: " << downloaded_size * 100 / file_size
                   << "%" << std::endl;
       }
@@ -790,20 +737,61 @@ void TcpPacket::readAndSaveToFile(const int fd, const std::string &file_name,
   file.close();
 }
 
+void TcpPacket::readAndSaveToString(const int fd, std::string &contents,
+                                    const size_t file_size, Sha256 *digest) {
+  contents.resize(file_size);
+  size_t received = 0;
+  while (received < file_size) {
+    fd_set file_descriptors;
+    FD_ZERO(&file_descriptors);
+    FD_SET(fd, &file_descriptors);
+
+    struct timeval timeout;
+    timeout.tv_sec = TCP_READ_TIMEOUT_SECONDS;
+    timeout.tv_usec = 0;
+
+    int ready_fd = select(fd + 1, &file_descriptors, NULL, NULL, &timeout);
+    if (is_shutting_down) {
+      throw OperationCancelledException();
+    }
+    if (ready_fd <= 0) {
+      throw ConnectionTimeoutException();
+    }
+    ssize_t n = read(fd, &contents[received], file_size - received);
+    if (n <= 0) {
+      throw InvalidPacketException();
+    }
+    if (digest != nullptr) {
+      digest->update(&contents[received], (size_t)n);
+    }
+    received += (size_t)n;
+  }
+}
+
 void OpenAuctionServerbound::send(int fd) {
-  std::stringstream stream;
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
   file_size = getFileSize(file_path);
 
-  stream << OpenAuctionServerbound::ID << " ";
-  write_user_id(stream, user_id);
-  stream << " " << password << " " << auction_name << " ";
-  stream << start_value << " " << time_active << " ";
-  stream << file_name << " " << file_size << " ";
-
-  writeString(fd, stream.str());
+  writer.write(OpenAuctionServerbound::ID);
+  writer.writeChar(' ');
+  writer.writeUserId(user_id);
+  writer.writeChar(' ');
+  writer.write(password);
+  writer.writeChar(' ');
+  writer.write(auction_name);
+  writer.writeChar(' ');
+  writer.writeInt(start_value);
+  writer.writeChar(' ');
+  writer.writeInt(time_active);
+  writer.writeChar(' ');
+  writer.write(file_name);
+  writer.writeChar(' ');
+  writer.writeInt(file_size);
+  writer.writeChar(' ');
+
+  writeString(fd, writer.data());
 
-  stream.str(std::string()); // clears the stream
-  stream.clear();            // resets any error flags
   sendFile(fd, file_path);   // Send file_data
 
   writeString(fd, "\n"); // Send packet delimiter
@@ -826,28 +814,44 @@ void OpenAuctionServerbound::receive(int fd) {
   readSpace(fd);
   file_size = readFileSize(fd);
   readSpace(fd);
-  readAndSaveToFile(fd, file_name, file_size, false);
+  if (transcript != nullptr) {
+    transcript->asset_offset = transcript->received.length();
+    transcript->asset_size = file_size;
+  }
+  Sha256 digest;
+  if (file_contents) {
+    readAndSaveToString(fd, *file_contents, file_size, &digest);
+  } else {
+    readAndSaveToFile(fd, file_path.empty() ? file_name : file_path.string(),
+                      file_size, false, &digest);
+  }
+  file_hash = digest.hexdigest();
+  if (transcript != nullptr) {
+    transcript->asset_hash = file_hash;
+  }
   readPacketDelimiter(fd);
 }
 
 void ReplyOpenAuctionClientbound::send(int fd) {
-  std::stringstream stream;
-  stream << ReplyOpenAuctionClientbound::ID << " ";
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  writer.write(ReplyOpenAuctionClientbound::ID);
+  writer.writeChar(' ');
 
   if (status == OK) {
-    stream << "OK ";
-    write_auction_id(stream, auction_id);
+    writer.write("OK ");
+    writer.writeAuctionId(auction_id);
   } else if (status == NOK) {
-    stream << "NOK";
+    writer.write("NOK");
   } else if (status == NLG) {
-    stream << "NLG";
+    writer.write("NLG");
   } else if (status == ERR) {
-    stream << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  stream << std::endl;
-  writeString(fd, stream.str());
+  writer.writeChar('\n');
+  writeString(fd, writer.data());
 }
 
 void ReplyOpenAuctionClientbound::receive(int fd) {
@@ -870,105 +874,79 @@ void ReplyOpenAuctionClientbound::receive(int fd) {
   readPacketDelimiter(fd);
 }
 
+using CloseAuctionServerboundSchema =
+    PacketSchema<CloseAuctionServerbound,
+                 UserIdField<&CloseAuctionServerbound::user_id>,
+                 PasswordField<&CloseAuctionServerbound::password>,
+                 AuctionIdField<&CloseAuctionServerbound::auction_id>>;
+
 void CloseAuctionServerbound::send(int fd) {
-  std::stringstream stream;
-  stream << CloseAuctionServerbound::ID << " ";
-  write_user_id(stream, user_id);
-  stream << " " << password << " ";
-  write_auction_id(stream, auction_id);
-  stream << std::endl;
-  writeString(fd, stream.str());
+  CloseAuctionServerboundSchema::send(*this, fd);
 }
 
 void CloseAuctionServerbound::receive(int fd) {
   // Serverbound packets don't read their ID
-  readSpace(fd);
-  user_id = readUserId(fd);
-  readSpace(fd);
-  password = readString(fd);
-  readSpace(fd);
-  auction_id = readAuctionId(fd);
-  readPacketDelimiter(fd);
+  CloseAuctionServerboundSchema::receive(*this, fd);
 }
 
+using ReplyCloseAuctionClientboundSchema =
+    PacketSchema<ReplyCloseAuctionClientbound,
+                 StatusField<&ReplyCloseAuctionClientbound::status>>;
+
 void ReplyCloseAuctionClientbound::send(int fd) {
-  std::stringstream stream;
-  stream << ReplyCloseAuctionClientbound::ID << " ";
-  if (status == OK) {
-    stream << "OK";
-  } else if (status == EAU) {
-    stream << "EAU";
-  } else if (status == EOW) {
-    stream << "EOW";
-  } else if (status == END) {
-    stream << "END";
-  } else if (status == NLG) {
-    stream << "NLG";
-  } else if (status == ERR) {
-    stream << "ERR";
-  } else {
-    throw PacketSerializationException();
-  }
-  stream << std::endl;
-  writeString(fd, stream.str());
+  ReplyCloseAuctionClientboundSchema::send(*this, fd);
 }
 
 void ReplyCloseAuctionClientbound::receive(int fd) {
   readPacketId(fd, ReplyCloseAuctionClientbound::ID);
-  readSpace(fd);
-  auto status_str = readString(fd);
-  if (status_str == "OK") {
-    this->status = OK;
-  } else if (status_str == "EAU") {
-    this->status = EAU;
-  } else if (status_str == "EOW") {
-    this->status = EOW;
-  } else if (status_str == "END") {
-    this->status = END;
-  } else if (status_str == "NLG") {
-    this->status = NLG;
-  } else if (status_str == "ERR") {
-    this->status = ERR;
-  } else {
-    throw InvalidPacketException();
-  }
-  readPacketDelimiter(fd);
+  ReplyCloseAuctionClientboundSchema::receive(*this, fd);
 }
 
+using ShowAssetServerboundSchema =
+    PacketSchema<ShowAssetServerbound,
+                 AuctionIdField<&ShowAssetServerbound::auction_id>>;
+
 void ShowAssetServerbound::send(int fd) {
-  std::stringstream stream;
-  stream << ShowAssetServerbound::ID << " ";
-  write_auction_id(stream, auction_id);
-  stream << std::endl;
-  writeString(fd, stream.str());
+  ShowAssetServerboundSchema::send(*this, fd);
 }
 
 void ShowAssetServerbound::receive(int fd) {
   // Serverbound packets don't read their ID
-  readSpace(fd);
-  auction_id = readAuctionId(fd);
-  readPacketDelimiter(fd);
+  ShowAssetServerboundSchema::receive(*this, fd);
 }
 
 void ReplyShowAssetClientbound::send(int fd) {
-  std::stringstream stream;
-  stream << ReplyShowAssetClientbound::ID << " ";
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  writer.write(ReplyShowAssetClientbound::ID);
+  writer.writeChar(' ');
   if (status == OK) {
-    file_size = getFileSize(file_path);
-    stream << "OK " << file_name << " " << file_size << " ";
-    writeString(fd, stream.str());
-    stream.str(std::string()); // clears the stream
-    stream.clear();            // resets any error flags
-    sendFile(fd, file_path);
+    if (file_contents) {
+      file_size = (uint32_t)file_contents->length();
+    } else {
+      file_size = getFileSize(file_path);
+    }
+    writer.write("OK ");
+    writer.write(file_name);
+    writer.writeChar(' ');
+    writer.writeInt(file_size);
+    writer.writeChar(' ');
+    writeString(fd, writer.data());
+    writer.clear();
+    if (file_contents) {
+      writeAsset(fd, *file_contents);
+    } else {
+      sendFile(fd, file_path);
+    }
   } else if (status == NOK) {
-    stream << "NOK";
+    writer.write("NOK");
   } else if (status == ERR) {
-    stream << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  stream << std::endl;
-  writeString(fd, stream.str());
+  writer.writeChar('\n');
+  writeString(fd, writer.data());
 }
 
 void ReplyShowAssetClientbound::receive(int fd) {
@@ -982,7 +960,8 @@ void ReplyShowAssetClientbound::receive(int fd) {
     readSpace(fd);
     file_size = readFileSize(fd);
     readSpace(fd);
-    readAndSaveToFile(fd, file_name, file_size, false);
+    readAndSaveToFile(fd, save_path.empty() ? file_name : save_path.string(),
+                      file_size, interactive);
   } else if (status_str == "NOK") {
     status = NOK;
   } else if (status_str == "ERR") {
@@ -993,78 +972,220 @@ void ReplyShowAssetClientbound::receive(int fd) {
   readPacketDelimiter(fd);
 }
 
-void BidServerbound::send(int fd) {
-  std::stringstream stream;
-  stream << BidServerbound::ID << " ";
-  write_user_id(stream, user_id);
-  stream << " " << password << " ";
-  write_auction_id(stream, auction_id);
-  stream << " " << fillZeros(bid_value, BID_MAX_LEN) << std::endl;
-  writeString(fd, stream.str());
+using ShowAssetRangeServerboundSchema =
+    PacketSchema<ShowAssetRangeServerbound,
+                 AuctionIdField<&ShowAssetRangeServerbound::auction_id>,
+                 IntField<&ShowAssetRangeServerbound::offset>,
+                 StringField<&ShowAssetRangeServerbound::hash,
+                             SHA256_HEX_LEN>>;
+
+void ShowAssetRangeServerbound::send(int fd) {
+  ShowAssetRangeServerboundSchema::send(*this, fd);
 }
 
-void BidServerbound::receive(int fd) {
+void ShowAssetRangeServerbound::receive(int fd) {
   // Serverbound packets don't read their ID
-  readSpace(fd);
-  user_id = readUserId(fd);
-  readSpace(fd);
-  password = readString(fd);
-  readSpace(fd);
-  auction_id = readAuctionId(fd);
-  readSpace(fd);
-  bid_value = readInt(fd);
-  readPacketDelimiter(fd);
+  ShowAssetRangeServerboundSchema::receive(*this, fd);
+  if (hash != "-" && !is_sha256_hex(hash)) {
+    throw InvalidPacketException();
+  }
 }
 
-void ReplyBidClientbound::send(int fd) {
-  std::stringstream stream;
-  stream << ReplyBidClientbound::ID << " ";
-  if (status == ACC) {
-    stream << "ACC";
+void ReplyShowAssetRangeClientbound::send(int fd) {
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  writer.write(ReplyShowAssetRangeClientbound::ID);
+  writer.writeChar(' ');
+  if (status == OK) {
+    if (file_contents) {
+      file_size = (uint32_t)file_contents->length();
+    } else {
+      file_size = getFileSize(file_path);
+    }
+    if (offset > file_size) {
+      throw PacketSerializationException();
+    }
+    writer.write("OK ");
+    writer.write(file_name);
+    writer.writeChar(' ');
+    writer.writeInt(file_size);
+    writer.writeChar(' ');
+    writer.write(hash.empty() ? "-" : hash);
+    writer.writeChar(' ');
+    writer.writeInt(offset);
+    writer.writeChar(' ');
+    writeString(fd, writer.data());
+    writer.clear();
+    if (file_contents) {
+      writeAsset(fd, std::string_view(*file_contents).substr(offset));
+    } else {
+      sendFile(fd, file_path, offset);
+    }
   } else if (status == NOK) {
-    stream << "NOK";
-  } else if (status == NLG) {
-    stream << "NLG";
-  } else if (status == ILG) {
-    stream << "ILG";
-  } else if (status == REF) {
-    stream << "REF";
+    writer.write("NOK");
   } else if (status == ERR) {
-    stream << "ERR";
+    writer.write("ERR");
   } else {
     throw PacketSerializationException();
   }
-  stream << std::endl;
-  writeString(fd, stream.str());
+  writer.writeChar('\n');
+  writeString(fd, writer.data());
 }
 
-void ReplyBidClientbound::receive(int fd) {
-  readPacketId(fd, ReplyBidClientbound::ID);
+void ReplyShowAssetRangeClientbound::receive(int fd) {
+  readPacketId(fd, ReplyShowAssetRangeClientbound::ID);
   readSpace(fd);
   auto status_str = readString(fd);
-  if (status_str == "ACC") {
-    this->status = ACC;
+  if (status_str == "OK") {
+    status = OK;
+    readSpace(fd);
+    file_name = readFileName(fd);
+    readSpace(fd);
+    file_size = readFileSize(fd);
+    readSpace(fd);
+    hash = readString(fd);
+    if (hash != "-" && !is_sha256_hex(hash)) {
+      throw InvalidPacketException();
+    }
+    readSpace(fd);
+    offset = readInt(fd);
+    if (offset > file_size) {
+      throw InvalidPacketException();
+    }
+    readSpace(fd);
+    header_received = true;
+    readAndSaveToFile(fd, save_path.empty() ? file_name : save_path.string(),
+                      file_size - offset, interactive, nullptr, offset > 0);
   } else if (status_str == "NOK") {
-    this->status = NOK;
-  } else if (status_str == "NLG") {
-    this->status = NLG;
-  } else if (status_str == "ILG") {
-    this->status = ILG;
-  } else if (status_str == "REF") {
-    this->status = REF;
+    status = NOK;
   } else if (status_str == "ERR") {
-    this->status = ERR;
+    status = ERR;
   } else {
     throw InvalidPacketException();
   }
   readPacketDelimiter(fd);
 }
 
-void ErrorTcpPacket::send(int fd) {
-  writeString(fd, ErrorTcpPacket::ID);
-  writeString(fd, "\n");
+using BidServerboundSchema =
+    PacketSchema<BidServerbound,
+                 UserIdField<&BidServerbound::user_id>,
+                 PasswordField<&BidServerbound::password>,
+                 AuctionIdField<&BidServerbound::auction_id>,
+                 IntField<&BidServerbound::bid_value, BID_MAX_LEN>>;
+
+void BidServerbound::send(int fd) { BidServerboundSchema::send(*this, fd); }
+
+void BidServerbound::receive(int fd) {
+  // Serverbound packets don't read their ID
+  BidServerboundSchema::receive(*this, fd);
+}
+
+using ReplyBidClientboundSchema =
+    PacketSchema<ReplyBidClientbound,
+                 StatusField<&ReplyBidClientbound::status>>;
+
+void ReplyBidClientbound::send(int fd) {
+  ReplyBidClientboundSchema::send(*this, fd);
+}
+
+void ReplyBidClientbound::receive(int fd) {
+  readPacketId(fd, ReplyBidClientbound::ID);
+  ReplyBidClientboundSchema::receive(*this, fd);
+}
+
+using KeepAliveServerboundSchema = PacketSchema<KeepAliveServerbound>;
+
+void KeepAliveServerbound::send(int fd) {
+  KeepAliveServerboundSchema::send(*this, fd);
+}
+
+void KeepAliveServerbound::receive(int fd) {
+  // Serverbound packets don't read their ID
+  KeepAliveServerboundSchema::receive(*this, fd);
+}
+
+using ReplyKeepAliveClientboundSchema =
+    PacketSchema<ReplyKeepAliveClientbound,
+                 StatusField<&ReplyKeepAliveClientbound::status>>;
+
+void ReplyKeepAliveClientbound::send(int fd) {
+  ReplyKeepAliveClientboundSchema::send(*this, fd);
+}
+
+void ReplyKeepAliveClientbound::receive(int fd) {
+  readPacketId(fd, ReplyKeepAliveClientbound::ID);
+  ReplyKeepAliveClientboundSchema::receive(*this, fd);
+}
+
+void WatchServerbound::send(int fd) {
+  if (auction_ids.empty() || auction_ids.size() > WATCH_MAX_AUCTIONS) {
+    throw PacketSerializationException();
+  }
+  char buffer[TCP_HEADER_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  writer.write(WatchServerbound::ID);
+  for (uint32_t auction_id : auction_ids) {
+    writer.writeChar(' ');
+    writer.writeAuctionId(auction_id);
+  }
+  writer.writeChar('\n');
+  writeString(fd, writer.data());
+}
+
+void WatchServerbound::receive(int fd) {
+  // Serverbound packets don't read their ID
+  auction_ids.clear();
+  readSpace(fd);
+  char next;
+  do {
+    if (auction_ids.size() == WATCH_MAX_AUCTIONS) {
+      throw InvalidPacketException();
+    }
+    auction_ids.push_back(readAuctionId(fd));
+    next = readChar(fd);
+  } while (next == ' ');
+  if (next != '\n') {
+    throw InvalidPacketException();
+  }
+}
+
+using ReplyWatchClientboundSchema =
+    PacketSchema<ReplyWatchClientbound,
+                 StatusField<&ReplyWatchClientbound::status>>;
+
+void ReplyWatchClientbound::send(int fd) {
+  ReplyWatchClientboundSchema::send(*this, fd);
 }
 
+void ReplyWatchClientbound::receive(int fd) {
+  readPacketId(fd, ReplyWatchClientbound::ID);
+  ReplyWatchClientboundSchema::receive(*this, fd);
+}
+
+using WatchEventClientboundSchema =
+    PacketSchema<WatchEventClientbound,
+                 AuctionIdField<&WatchEventClientbound::auction_id>,
+                 StatusField<&WatchEventClientbound::event>,
+                 UserIdField<&WatchEventClientbound::user_id>,
+                 IntField<&WatchEventClientbound::bid_value>>;
+
+void WatchEventClientbound::serialize(PacketWriter &writer) {
+  WatchEventClientboundSchema::write(*this, writer);
+}
+
+void WatchEventClientbound::send(int fd) {
+  WatchEventClientboundSchema::send(*this, fd);
+}
+
+void WatchEventClientbound::receive(int fd) {
+  readPacketId(fd, WatchEventClientbound::ID);
+  WatchEventClientboundSchema::receive(*this, fd);
+}
+
+using ErrorTcpPacketSchema = PacketSchema<ErrorTcpPacket>;
+
+void ErrorTcpPacket::send(int fd) { ErrorTcpPacketSchema::send(*this, fd); }
+
 void ErrorTcpPacket::receive(int fd) {
   (void)fd;
   // unimplemented
@@ -1073,9 +1194,10 @@ void ErrorTcpPacket::receive(int fd) {
 // Packet sending and receiving
 void send_packet(UdpPacket &packet, int socket, struct sockaddr *address,
                  socklen_t addrlen) {
-  const std::stringstream buffer = packet.serialize();
-  ssize_t n = sendto(socket, buffer.str().c_str(), buffer.str().length(), 0,
-                     address, addrlen);
+  char buffer[SOCKET_BUFFER_LEN];
+  PacketWriter writer(buffer, sizeof(buffer));
+  packet.serialize(writer);
+  ssize_t n = sendto(socket, buffer, writer.size(), 0, address, addrlen);
   if (n == -1) {
     throw UnrecoverableError("Failed to send UDP packet", errno);
   }
@@ -1100,7 +1222,6 @@ void wait_for_packet(UdpPacket &packet, int socket) {
     throw ConnectionTimeoutException();
   }
 
-  std::stringstream data;
   char buffer[SOCKET_BUFFER_LEN];
 
   ssize_t n = recvfrom(socket, buffer, SOCKET_BUFFER_LEN, 0, NULL, NULL);
@@ -1109,74 +1230,39 @@ void wait_for_packet(UdpPacket &packet, int socket) {
                              errno);
   }
 
-  data.write(buffer, n);
-
-  packet.deserialize(data);
+  PacketReader reader(std::string_view(buffer, static_cast<size_t>(n)));
+  packet.deserialize(reader);
 }
 
-std::string read_date_time(std::stringstream &buffer) {
-  std::string date, time;
-  std::getline(buffer, date, ' ');
-  std::getline(buffer, time, ' ');
-  return date + " " + time;
-}
-
-void write_auction_id(std::stringstream &buffer, const uint32_t auction_id) {
-  buffer << std::setfill('0') << std::setw(AUCTION_ID_MAX_LEN) << auction_id;
-  buffer.copyfmt(std::ios(NULL)); // reset formatting
-}
-
-void write_user_id(std::stringstream &buffer, const uint32_t user_id) {
-  buffer << std::setfill('0') << std::setw(USER_ID_STR_LEN) << user_id;
-  buffer.copyfmt(std::ios(NULL)); // reset formatting
-}
-
-uint32_t parse_packet_user_id(std::string &id_str) {
-  if (id_str.length() != USER_ID_STR_LEN) {
-    throw InvalidPacketException();
-  }
-  for (char c : id_str) {
-    if (!isdigit(c)) {
-      throw InvalidPacketException();
-    }
-  }
-  try {
-    int i = std::stoi(id_str);
-    if (i < 0 || i > (int)USER_ID_MAX) {
-      throw InvalidPacketException();
-    }
-    return (uint32_t)i;
-  } catch (...) {
+// Parses a fixed-width, zero-padded ID without allocating
+static uint32_t parse_packet_id_digits(std::string_view id_str, size_t length,
+                                       uint32_t max) {
+  uint32_t id;
+  if (id_str.length() != length || !parse_digits(id_str, id) || id > max) {
     throw InvalidPacketException();
   }
+  return id;
 }
 
-uint32_t parse_packet_auction_id(std::string &id_str) {
-  if (id_str.length() != AUCTION_ID_MAX_LEN) {
-    throw InvalidPacketException();
-  }
-  for (char c : id_str) {
-    if (!isdigit(c)) {
-      throw InvalidPacketException();
-    }
-  }
-  try {
-    int i = std::stoi(id_str);
-    if (i < 0 || i > AUCTION_MAX_NUMBER) {
-      throw InvalidPacketException();
-    }
-    return (uint32_t)i;
-  } catch (...) {
-    throw InvalidPacketException();
-  }
+uint32_t parse_packet_user_id(std::string_view id_str) {
+  return parse_packet_id_digits(id_str, USER_ID_STR_LEN, USER_ID_MAX);
 }
 
-void sendFile(int connection_fd, std::filesystem::path file_path) {
+uint32_t parse_packet_auction_id(std::string_view id_str) {
+  return parse_packet_id_digits(id_str, AUCTION_ID_MAX_LEN,
+                                AUCTION_MAX_NUMBER);
+}
+
+void sendFile(int connection_fd, std::filesystem::path file_path,
+              uint32_t offset) {
   std::ifstream file(file_path, std::ios::in | std::ios::binary);
   if (!file) {
     std::cerr << "Error opening file: " << file_path << std::endl;
     throw PacketSerializationException();
   }
+  if (offset > 0 && !file.seekg(offset)) {
+    throw PacketSerializationException();
+  }
 
   char buffer[FILE_BUFFER_LEN];
   while (file) {
@@ -1194,49 +1280,6 @@ void sendFile(int connection_fd, std::filesystem::path file_path) {
   }
 }
 
-std::string auctionsToString(const std::vector<std::pair<uint32_t, bool>> &auctions) {
-  std::ostringstream formattedString;
-  for (size_t i = 0; i < auctions.size(); ++i) {
-    formattedString << fillZeros(auctions[i].first, AUCTION_ID_MAX_LEN) << " ";
-    formattedString << auctions[i].second;
-    if (i != auctions.size() - 1) {
-      formattedString << " ";
-    }
-  }
-  return formattedString.str();
-}
-
-std::vector<std::pair<uint32_t, bool>>
-UdpPacket::readAuctions(std::stringstream &buffer) {
-  std::vector<std::pair<uint32_t, bool>> auctions;
-
-  uint32_t auctionId;
-  bool auctionStatus;
-  while (buffer.peek() != '\n') {
-    readSpace(buffer);
-    auctionId = readAuctionId(buffer);
-    readSpace(buffer);
-    auctionStatus = readInt(buffer);
-    // emplace_back adds element to the end of the vector
-    auctions.emplace_back(auctionId, auctionStatus);
-  }
-
-  return auctions;
-}
-
-Bid UdpPacket::readBid(std::stringstream &buffer) {
-  Bid bid = Bid();
-  readChar(buffer, 'B');
-  readSpace(buffer);
-  bid.bidder_user_id = readUserId(buffer);
-  readSpace(buffer);
-  bid.bid_value = readInt(buffer);
-  readSpace(buffer);
-  bid.date_time = read_date_time(buffer);
-  bid.sec_time = readInt(buffer);
-  return bid;
-}
-
 std::string auctionID_ToString(uint32_t auction_id) {
   return fillZeros(auction_id, AUCTION_ID_MAX_LEN);
 }
@@ -9,10 +9,15 @@
 #include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <string_view>
 #include <vector>
 
 #include "auction_data.hpp"
+#include "constants.hpp"
 #include "file_manager.hpp"
+#include "packet_reader.hpp"
+#include "packet_writer.hpp"
+#include "sha256.hpp"
 
 // Thrown when the PacketID does not match what was expected
 class UnexpectedPacketException : public std::runtime_error {
@@ -87,26 +92,28 @@ public:
       : std::runtime_error("Operation cancelled by user") {}
 };
 
-class UdpPacket {
-private:
-  void readChar(std::stringstream &buffer, char chr);
+typedef uint32_t PacketId;
 
-protected:
-  void readPacketId(std::stringstream &buffer, const char *id);
-  void readSpace(std::stringstream &buffer);
-  char readChar(std::stringstream &buffer);
-  char readAlphabeticalChar(std::stringstream &buffer);
-  void readPacketDelimiter(std::stringstream &buffer);
-  std::string readString(std::stringstream &buffer, uint32_t max_len);
-  uint32_t readInt(std::stringstream &buffer);
-  uint32_t readUserId(std::stringstream &buffer);
-  uint32_t readAuctionId(std::stringstream &buffer);
-  Bid readBid(std::stringstream &buffer);
-  std::vector<std::pair<uint32_t, bool>> readAuctions(std::stringstream &buffer);
-
-public:
-  virtual std::stringstream serialize() = 0;
-  virtual void deserialize(std::stringstream &buffer) = 0;
+// Packs a three-byte packet ID into an integer, so it can be compared and
+// hashed without building a string. IDs of any other length pack to 0.
+constexpr PacketId pack_packet_id(std::string_view id) {
+  if (id.length() != PACKET_ID_LEN) {
+    return 0;
+  }
+  return static_cast<PacketId>(static_cast<unsigned char>(id[0])) << 16 |
+         static_cast<PacketId>(static_cast<unsigned char>(id[1])) << 8 |
+         static_cast<PacketId>(static_cast<unsigned char>(id[2]));
+}
+
+class UdpPacket {
+public:
+  virtual void serialize(PacketWriter &writer) = 0;
+  virtual void deserialize(PacketReader &reader) = 0;
+  // Adapter for callers that want the packet in a stream
+  std::stringstream serialize();
+  // Adapter for callers holding the datagram in a stream, reads from the
+  // current position of the stream
+  void deserialize(std::stringstream &buffer);
 
   virtual ~UdpPacket() = default;
 };
@@ -118,8 +125,10 @@ public:
   uint32_t user_id;
   std::string password;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to Start Auction Packet (RLI)
@@ -127,9 +136,12 @@ class ReplyLoginClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, REG, ERR };
   static constexpr const char *ID = "RLI";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "REG", "ERR"};
   status status;
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Logout Packet (LOU)
@@ -139,8 +151,10 @@ public:
   uint32_t user_id;
   std::string password;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to Logout Packet (RLO)
@@ -148,9 +162,12 @@ class ReplyLogoutClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, UNR, ERR };
   static constexpr const char *ID = "RLO";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "UNR", "ERR"};
   status status;
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Unregister Packet (UNR)
@@ -160,8 +177,10 @@ public:
   uint32_t user_id;
   std::string password;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to Unregister Packet (RUN)
@@ -169,9 +188,12 @@ class ReplyUnregisterClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, UNR, ERR };
   static constexpr const char *ID = "RUR";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "UNR", "ERR"};
   status status;
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // List MyAuctions Packet (LMA)
@@ -181,8 +203,10 @@ public:
   static constexpr const char *ID = "LMA";
   uint32_t user_id;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to List MyAuctions Packet (RLM)
@@ -191,11 +215,14 @@ class ReplyListMyAuctionsClientbound : public UdpPacket {
 public:
   enum status { OK, NLG, NOK, ERR };
   static constexpr const char *ID = "RMA";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NLG", "NOK", "ERR"};
   std::vector<std::pair<uint32_t, bool>> auctions;
 
   status status;
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // List my bids Packet (LMB)
@@ -205,8 +232,10 @@ public:
   static constexpr const char *ID = "LMB";
   uint32_t user_id;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to List my bids Packet (RMB)
@@ -215,11 +244,14 @@ class ReplyMyBidsClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, NLG, ERR };
   static constexpr const char *ID = "RMB";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "NLG", "ERR"};
   status status;
   std::vector<std::pair<uint32_t, bool>> auctions;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // List Auctions Packet (LST)
@@ -228,8 +260,10 @@ class ListAuctionsServerbound : public UdpPacket {
 public:
   static constexpr const char *ID = "LST";
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 // Reply to List Auctions Packet (RLS)
@@ -238,19 +272,55 @@ class ReplyListAuctionsClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, ERR };
   static constexpr const char *ID = "RLS";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
   status status;
   std::vector<std::pair<uint32_t, bool>> auctions;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 class ErrorUdpPacket : public UdpPacket {
 public:
   static constexpr const char *ID = "ERR";
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
+};
+
+// Asks for the auctions changed since a version of the list returned by a
+// previous reply; version 0 asks for the full list
+class ListSinceServerbound : public UdpPacket {
+public:
+  static constexpr const char *ID = "LSC";
+  uint32_t epoch;
+  uint32_t version;
+
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
+};
+
+// OK carries the changed auctions only, ALL the full list of auctions
+class ReplyListSinceClientbound : public UdpPacket {
+public:
+  enum status { OK, ALL, ERR };
+  static constexpr const char *ID = "RLC";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "ALL", "ERR"};
+  status status;
+  uint32_t epoch = 0;
+  uint32_t version = 0;
+  std::vector<std::pair<uint32_t, bool>> auctions;
+
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 class ShowRecordServerbound : public UdpPacket {
@@ -258,32 +328,83 @@ public:
   static constexpr const char *ID = "SRC";
   uint32_t auction_id;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
 };
 
 class ReplyShowRecordClientbound : public UdpPacket {
 public:
   enum status { OK, NOK, ERR };
   static constexpr const char *ID = "RRC";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
   status status;
 
   AuctionData auction;
   std::string startTime;
   std::string endTime;
 
-  std::stringstream serialize();
-  void deserialize(std::stringstream &buffer);
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
+};
+
+// Asks a running server for its live statistics; only answered when sent
+// over the loopback interface
+class AdminStatsServerbound : public UdpPacket {
+public:
+  static constexpr const char *ID = "STA";
+
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
+};
+
+// Reply to Admin Stats Packet (RST): "name value" pairs, so statistics can
+// be added without changing the packet. NOK if not sent over loopback.
+class ReplyAdminStatsClientbound : public UdpPacket {
+public:
+  enum status { OK, NOK, ERR };
+  static constexpr const char *ID = "RST";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
+  status status;
+  std::vector<std::pair<std::string, uint64_t>> stats;
+
+  using UdpPacket::deserialize;
+  using UdpPacket::serialize;
+  void serialize(PacketWriter &writer);
+  void deserialize(PacketReader &reader);
+};
+
+// What a thread reads and writes through TcpPacket while transcribing, to
+// capture requests and their replies. Asset contents are left out, only
+// their size, hash and place in the request are kept.
+struct TcpTranscript {
+  std::string received;
+  std::string sent;
+  // Where the asset goes in received, if the request has one
+  size_t asset_offset = 0;
+  uint32_t asset_size = 0;
+  std::string asset_hash;
 };
 
 class TcpPacket {
+  friend struct TcpFieldAccess;
+
 private:
   char delimiter = 0;
 
   void readChar(int fd, char chr);
 
 protected:
-  void writeString(int fd, const std::string &str);
+  static thread_local TcpTranscript *transcript;
+
+  void writeString(int fd, std::string_view str);
+  // Writes asset contents, which are not transcribed
+  void writeAsset(int fd, std::string_view str);
   void readPacketId(int fd, const char *id);
   void readSpace(int fd);
   char readChar(int fd);
@@ -294,13 +415,24 @@ protected:
   uint32_t readAuctionId(const int fd);
   std::string readFileName(const int fd);
   uint32_t readFileSize(const int fd);
+  // Progress is reported, and ENTER cancels, only if cancellable. Appends to
+  // the file instead of replacing it when resuming a download.
   void readAndSaveToFile(const int fd, const std::string &file_name,
-                         const size_t file_size, const bool cancellable);
+                         const size_t file_size, const bool cancellable,
+                         Sha256 *digest = nullptr, const bool append = false);
+  void readAndSaveToString(const int fd, std::string &contents,
+                           const size_t file_size, Sha256 *digest = nullptr);
 
 public:
   virtual void send(int fd) = 0;
   virtual void receive(int fd) = 0;
 
+  // Transcribes what this thread reads and writes into transcript, until
+  // called with nullptr
+  static void transcribe(TcpTranscript *__transcript) {
+    transcript = __transcript;
+  }
+
   virtual ~TcpPacket() = default;
 };
 
@@ -314,7 +446,12 @@ public:
   uint32_t time_active;
   std::string file_name;
   uint32_t file_size;
+  // Asset source when sending; destination when receiving, if set
   std::filesystem::path file_path;
+  // Destination when receiving into memory, takes precedence over file_path
+  std::shared_ptr<std::string> file_contents;
+  // SHA-256 of the asset, computed while receiving it
+  std::string file_hash;
 
   void send(int fd);
   void receive(int fd);
@@ -324,6 +461,7 @@ class ReplyOpenAuctionClientbound : public TcpPacket {
 public:
   enum status { OK, NOK, NLG, ERR };
   static constexpr const char *ID = "ROA";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "NLG", "ERR"};
   status status;
   uint32_t auction_id;
 
@@ -346,6 +484,8 @@ class ReplyCloseAuctionClientbound : public TcpPacket {
 public:
   enum status { OK, EAU, EOW, END, NLG, ERR };
   static constexpr const char *ID = "RCL";
+  static constexpr const char *STATUS_NAMES[] = {"OK",  "EAU", "EOW",
+                                                 "END", "NLG", "ERR"};
   status status;
 
   void send(int fd);
@@ -365,10 +505,57 @@ class ReplyShowAssetClientbound : public TcpPacket {
 public:
   enum status { OK, NOK, ERR };
   static constexpr const char *ID = "RSA";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
+  status status;
+  std::string file_name;
+  uint32_t file_size;
+  std::filesystem::path file_path;
+  // Asset source when sending from memory, takes precedence over file_path
+  std::shared_ptr<const std::string> file_contents;
+  // Received into file_name in the working directory, unless set
+  std::filesystem::path save_path;
+  // Cleared to download without reporting progress or watching stdin
+  bool interactive = true;
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+// Asks for the asset from a byte on, to resume a download. The hash is the
+// one of the asset the downloaded bytes belong to, or "-" when starting
+// from byte 0; the download is restarted if it does not match anymore.
+class ShowAssetRangeServerbound : public TcpPacket {
+public:
+  static constexpr const char *ID = "SAR";
+  uint32_t auction_id;
+  uint32_t offset = 0;
+  std::string hash = "-";
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+// Carries the asset from offset on; file_size is the size of the whole
+// asset, and hash its SHA-256 ("-" if unknown, which restarts resumed
+// downloads). Received into save_path.
+class ReplyShowAssetRangeClientbound : public TcpPacket {
+public:
+  enum status { OK, NOK, ERR };
+  static constexpr const char *ID = "RSR";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
   status status;
   std::string file_name;
   uint32_t file_size;
+  std::string hash;
+  uint32_t offset;
   std::filesystem::path file_path;
+  // Asset source when sending from memory, takes precedence over file_path
+  std::shared_ptr<const std::string> file_contents;
+  std::filesystem::path save_path;
+  // Cleared to download without reporting progress or watching stdin
+  bool interactive = true;
+  // Set once the header is read, before the data is saved to save_path
+  bool header_received = false;
 
   void send(int fd);
   void receive(int fd);
@@ -390,12 +577,76 @@ class ReplyBidClientbound : public TcpPacket {
 public:
   enum status { ACC, NOK, NLG, ILG, REF, ERR };
   static constexpr const char *ID = "RBD";
+  static constexpr const char *STATUS_NAMES[] = {"ACC", "NOK", "NLG",
+                                                 "ILG", "REF", "ERR"};
+  status status;
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+// Keep-alive Packet (KAL), asks the server to keep serving requests on the
+// connection until it is closed or left idle
+class KeepAliveServerbound : public TcpPacket {
+public:
+  static constexpr const char *ID = "KAL";
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+class ReplyKeepAliveClientbound : public TcpPacket {
+public:
+  enum status { OK, ERR };
+  static constexpr const char *ID = "RKA";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "ERR"};
+  status status;
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+// Subscribes to bid and end events of the given auctions; after the reply,
+// the server keeps the connection open to push WatchEventClientbound
+// packets, and closes it once every watched auction has ended
+class WatchServerbound : public TcpPacket {
+public:
+  static constexpr const char *ID = "WAT";
+  std::vector<uint32_t> auction_ids;
+
+  void send(int fd);
+  void receive(int fd);
+};
+
+class ReplyWatchClientbound : public TcpPacket {
+public:
+  enum status { OK, NOK, ERR };
+  static constexpr const char *ID = "RWA";
+  static constexpr const char *STATUS_NAMES[] = {"OK", "NOK", "ERR"};
   status status;
 
   void send(int fd);
   void receive(int fd);
 };
 
+// A new highest bid (BID), or the end of an auction (END) along with its
+// winning bid, which is user 000000 with value 0 if there were no bids
+class WatchEventClientbound : public TcpPacket {
+public:
+  enum event { BID, END };
+  static constexpr const char *ID = "EVT";
+  static constexpr const char *STATUS_NAMES[] = {"BID", "END"};
+  uint32_t auction_id;
+  event event;
+  uint32_t user_id;
+  uint32_t bid_value;
+
+  // Events are serialized once and fanned out to every watcher
+  void serialize(PacketWriter &writer);
+  void send(int fd);
+  void receive(int fd);
+};
+
 class ErrorTcpPacket : public TcpPacket {
 public:
   static constexpr const char *ID = "ERR";
@@ -411,23 +662,16 @@ void wait_for_packet(UdpPacket &packet, int socket);
 
 void write_date_time(std::stringstream &buffer, const time_t &time);
 
-std::string read_date_time(std::stringstream &buffer);
-
-void write_auction_id(std::stringstream &buffer, const uint32_t auction_id);
+uint32_t parse_packet_user_id(std::string_view id_str);
 
-void write_user_id(std::stringstream &buffer, const uint32_t user_id);
+uint32_t parse_packet_auction_id(std::string_view id_str);
 
-uint32_t parse_packet_user_id(std::string &id_str);
-
-uint32_t parse_packet_auction_id(std::string &id_str);
-
-void sendFile(int connection_fd, std::filesystem::path image_path);
+// Sends the file from the given byte on
+void sendFile(int connection_fd, std::filesystem::path image_path,
+              uint32_t offset = 0);
 
 uint32_t getFileSize(std::filesystem::path file_path);
 
-std::string
-auctionsToString(const std::vector<std::pair<uint32_t, bool>> &auctions);
-
 std::string fillZeros(uint32_t number, int length);
 
 void readBid(std::stringstream &buffer, AuctionData &auction);
@@ -0,0 +1,159 @@
+#include "sha256.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "constants.hpp"
+#include "exceptions.hpp"
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr(uint32_t x, uint32_t n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+Sha256::Sha256() {
+  state[0] = 0x6a09e667;
+  state[1] = 0xbb67ae85;
+  state[2] = 0x3c6ef372;
+  state[3] = 0xa54ff53a;
+  state[4] = 0x510e527f;
+  state[5] = 0x9b05688c;
+  state[6] = 0x1f83d9ab;
+  state[7] = 0x5be0cd19;
+}
+
+void Sha256::transform(const uint8_t *chunk) {
+  uint32_t w[64];
+  for (uint32_t i = 0; i < 16; ++i) {
+    w[i] = (uint32_t)chunk[i * 4] << 24 | (uint32_t)chunk[i * 4 + 1] << 16 |
+           (uint32_t)chunk[i * 4 + 2] << 8 | (uint32_t)chunk[i * 4 + 3];
+  }
+  for (uint32_t i = 16; i < 64; ++i) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (uint32_t i = 0; i < 64; ++i) {
+    uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t temp1 = h + s1 + ch + SHA256_K[i] + w[i];
+    uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t temp2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp1 + temp2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void Sha256::update(const char *data, size_t len) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  total_len += len;
+
+  // Fill up a partially filled block first
+  if (block_len > 0) {
+    size_t to_copy = std::min(len, (size_t)SHA256_BLOCK_LEN - block_len);
+    memcpy(block + block_len, bytes, to_copy);
+    block_len += to_copy;
+    bytes += to_copy;
+    len -= to_copy;
+    if (block_len < SHA256_BLOCK_LEN) {
+      return;
+    }
+    transform(block);
+    block_len = 0;
+  }
+
+  while (len >= SHA256_BLOCK_LEN) {
+    transform(bytes);
+    bytes += SHA256_BLOCK_LEN;
+    len -= SHA256_BLOCK_LEN;
+  }
+
+  memcpy(block, bytes, len);
+  block_len = len;
+}
+
+std::string Sha256::hexdigest() {
+  uint64_t bit_len = total_len * 8;
+
+  // Padding: a single 1 bit, zeros and then the message length in bits
+  block[block_len++] = 0x80;
+  if (block_len > SHA256_BLOCK_LEN - 8) {
+    memset(block + block_len, 0, SHA256_BLOCK_LEN - block_len);
+    transform(block);
+    block_len = 0;
+  }
+  memset(block + block_len, 0, SHA256_BLOCK_LEN - 8 - block_len);
+  for (uint32_t i = 0; i < 8; ++i) {
+    block[SHA256_BLOCK_LEN - 1 - i] = (uint8_t)(bit_len >> (i * 8));
+  }
+  transform(block);
+  block_len = 0;
+
+  static const char hex_chars[] = "0123456789abcdef";
+  std::string result(SHA256_HEX_LEN, '0');
+  for (uint32_t i = 0; i < 8; ++i) {
+    for (uint32_t j = 0; j < 8; ++j) {
+      result[i * 8 + j] = hex_chars[(state[i] >> (28 - j * 4)) & 0xf];
+    }
+  }
+  return result;
+}
+
+std::string sha256_file(const std::filesystem::path &file_path) {
+  std::ifstream file(file_path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw FileOpenException(file_path.string());
+  }
+
+  Sha256 hasher;
+  char buffer[FILE_BUFFER_LEN];
+  while (file) {
+    file.read(buffer, FILE_BUFFER_LEN);
+    hasher.update(buffer, (size_t)file.gcount());
+  }
+  return hasher.hexdigest();
+}
+
+bool is_sha256_hex(const std::string &str) {
+  if (str.length() != SHA256_HEX_LEN) {
+    return false;
+  }
+  for (char c : str) {
+    if (!isdigit((unsigned char)c) && (c < 'a' || c > 'f')) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,33 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#define SHA256_BLOCK_LEN (64)
+#define SHA256_DIGEST_LEN (32)
+#define SHA256_HEX_LEN (64)
+
+// Incremental SHA-256, so content can be hashed while it is being streamed
+class Sha256 {
+  uint32_t state[8];
+  uint8_t block[SHA256_BLOCK_LEN];
+  size_t block_len = 0;
+  uint64_t total_len = 0;
+
+  void transform(const uint8_t *chunk);
+
+public:
+  Sha256();
+  void update(const char *data, size_t len);
+  // Finishes the hash and returns it as a lowercase hex string
+  std::string hexdigest();
+};
+
+std::string sha256_file(const std::filesystem::path &file_path);
+
+bool is_sha256_hex(const std::string &str);
+
+#endif
@@ -0,0 +1,16 @@
+#include "storage_engine.hpp"
+
+#include "constants.hpp"
+#include "file_manager.hpp"
+#include "memory_storage.hpp"
+
+std::unique_ptr<StorageEngine> make_storage_engine(const std::string &engine) {
+  if (engine == STORAGE_ENGINE_MEMORY) {
+    return std::make_unique<MemoryStorage>();
+  }
+  return std::make_unique<FileManager>();
+}
+
+bool is_storage_engine(const std::string &engine) {
+  return engine == STORAGE_ENGINE_FILESYSTEM || engine == STORAGE_ENGINE_MEMORY;
+}
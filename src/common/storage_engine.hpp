@@ -0,0 +1,79 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "asset_store.hpp"
+#include "auction_data.hpp"
+#include "profiled_mutex.hpp"
+
+// Where the asset of an auction can be read from: a file for engines that
+// keep assets on disk, or a buffer shared with the engine otherwise.
+struct AssetSource {
+  std::filesystem::path path;
+  std::shared_ptr<const std::string> contents;
+  // SHA-256 of the asset, empty for assets stored before it was kept
+  std::string hash;
+};
+
+// Counts reported to administrators of a running server
+struct StorageStats {
+  uint64_t users = 0;
+  uint64_t logged_in_users = 0;
+  // Changes accepted but not yet persisted
+  uint64_t pending_writes = 0;
+  // Attempts to persist a change that failed and will be retried
+  uint64_t write_failures = 0;
+};
+
+// Everything the server needs to persist users and auctions. User IDs are
+// unpadded, auction IDs are padded to AUCTION_ID_MAX_LEN digits.
+class StorageEngine {
+public:
+  virtual ~StorageEngine() = default;
+
+  virtual bool UserLoggedIn(const std::string &userId) = 0;
+  virtual bool UserRegistered(const std::string &userId) = 0;
+  virtual std::string getUserPassword(const std::string &userId) = 0;
+  virtual void loginUser(const std::string &userId) = 0;
+  virtual void logoutUser(const std::string &userId) = 0;
+  virtual void registerUser(const std::string &userId,
+                            const std::string &password) = 0;
+  virtual void unregisterUser(const std::string &userId) = 0;
+  // directory is either "HOSTED" or "BIDDED"
+  virtual std::vector<std::pair<uint32_t, bool>>
+  getUserAuctions(const std::string &userId, const std::string &directory) = 0;
+
+  virtual std::vector<std::pair<uint32_t, bool>> getAllAuctions() = 0;
+  virtual AuctionData getAuction(const uint32_t auctionIdInt) = 0;
+  // Tells where an upload must be received before it is passed to openAuction
+  virtual void prepareAssetUpload(AssetUpload &upload) = 0;
+  virtual void openAuction(const std::string &userId, const AuctionData &data,
+                           AssetUpload &upload) = 0;
+  virtual void closeAuction(AuctionData &auction) = 0;
+  virtual AssetSource showAsset(AuctionData &auction) = 0;
+  virtual void bid(AuctionData &auction, uint32_t bidValue,
+                   const std::string &userId) = 0;
+  // Moves auctions closed for at least minAgeSeconds to cold storage, if the
+  // engine has any. Returns the number of moved auctions
+  virtual uint32_t archiveClosedAuctions(uint32_t minAgeSeconds) = 0;
+  // Returns the ID of the next auction
+  virtual uint32_t getAuctionsCount() = 0;
+  // May walk every user, so only meant for occasional queries
+  virtual StorageStats stats() = 0;
+  // Contention of the engine's per-user and per-auction locks
+  virtual std::vector<LockStats> lockStats() = 0;
+  virtual void shutdown() = 0;
+};
+
+// Creates the engine with the given name (STORAGE_ENGINE_*)
+std::unique_ptr<StorageEngine> make_storage_engine(const std::string &engine);
+
+bool is_storage_engine(const std::string &engine);
+
+#endif
@@ -0,0 +1,116 @@
+#include "tracing.hpp"
+
+#include <unistd.h>
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "constants.hpp"
+
+std::atomic<uint32_t> Tracer::sample_every{0};
+std::atomic<uint64_t> Tracer::requests_seen{0};
+thread_local uint64_t Tracer::current_request = 0;
+
+struct TraceEvent {
+  const char *name;
+  Tracer::Clock::time_point start;
+  Tracer::Clock::time_point end;
+  uint64_t request;
+};
+
+// Keeps the latest TRACE_RING_CAPACITY spans of a thread. Only its thread
+// writes to it; the lock is only ever contended while flushing.
+struct TraceRing {
+  std::mutex lock;
+  uint32_t thread_id;
+  std::vector<TraceEvent> events;
+  // Where the next span goes, and how many of the slots hold one
+  size_t next = 0;
+  size_t count = 0;
+};
+
+static std::mutex rings_lock;
+// Rings of every thread that has traced, kept after the thread exits
+static std::vector<std::unique_ptr<TraceRing>> rings;
+static const Tracer::Clock::time_point trace_epoch = Tracer::Clock::now();
+
+static TraceRing &local_ring() {
+  thread_local TraceRing *ring = nullptr;
+  if (ring == nullptr) {
+    std::unique_ptr<TraceRing> created = std::make_unique<TraceRing>();
+    created->events.resize(TRACE_RING_CAPACITY);
+    ring = created.get();
+
+    std::scoped_lock<std::mutex> guard(rings_lock);
+    created->thread_id = static_cast<uint32_t>(rings.size()) + 1;
+    rings.push_back(std::move(created));
+  }
+  return *ring;
+}
+
+static double microseconds(Tracer::Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void Tracer::setSampling(uint32_t __sample_every) {
+  sample_every.store(__sample_every, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char *name, Clock::time_point start,
+                    Clock::time_point end) {
+  TraceRing &ring = local_ring();
+  std::scoped_lock<std::mutex> guard(ring.lock);
+  ring.events[ring.next] = TraceEvent{name, start, end, current_request};
+  ring.next = (ring.next + 1) % TRACE_RING_CAPACITY;
+  if (ring.count < TRACE_RING_CAPACITY) {
+    ++ring.count;
+  }
+}
+
+void Tracer::flushChromeTrace(std::ostream &stream) {
+  // Timestamps are in microseconds; spans are a few of them long
+  stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  bool first = true;
+  int pid = getpid();
+
+  std::scoped_lock<std::mutex> guard(rings_lock);
+  for (std::unique_ptr<TraceRing> &ring : rings) {
+    std::scoped_lock<std::mutex> ring_guard(ring->lock);
+    size_t oldest =
+        (ring->next + TRACE_RING_CAPACITY - ring->count) % TRACE_RING_CAPACITY;
+    for (size_t i = 0; i < ring->count; ++i) {
+      TraceEvent &event = ring->events[(oldest + i) % TRACE_RING_CAPACITY];
+      stream << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name
+             << "\",\"ph\":\"X\",\"pid\":" << pid
+             << ",\"tid\":" << ring->thread_id
+             << ",\"ts\":" << microseconds(event.start - trace_epoch)
+             << ",\"dur\":" << microseconds(event.end - event.start)
+             << ",\"args\":{\"request\":" << event.request << "}}";
+      first = false;
+    }
+    ring->count = 0;
+  }
+  stream << "\n]}\n";
+}
+
+TraceRequest::TraceRequest() {
+  uint32_t every = Tracer::sample_every.load(std::memory_order_relaxed);
+  if (every == 0) {
+    return;
+  }
+  uint64_t seen =
+      Tracer::requests_seen.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (seen % every == 0) {
+    Tracer::current_request = seen;
+    start = Tracer::Clock::now();
+  }
+}
+
+TraceRequest::~TraceRequest() {
+  if (Tracer::tracing()) {
+    Tracer::record(name, start, Tracer::Clock::now());
+    Tracer::current_request = 0;
+  }
+}
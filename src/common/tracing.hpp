@@ -0,0 +1,74 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Spans of sampled requests, kept in a ring buffer per thread and written
+// out as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev). Each
+// sampled request is a span named after its packet ID, enclosing the spans
+// of the stages it went through on the same thread. On threads that are
+// not serving a sampled request, spans cost a thread-local check.
+class Tracer {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Traces one in every sample_every requests; 0 turns tracing off
+  static void setSampling(uint32_t sample_every);
+  static bool tracing() { return current_request != 0; }
+  static void record(const char *name, Clock::time_point start,
+                     Clock::time_point end);
+  // Writes the spans recorded since the previous call, and forgets them
+  static void flushChromeTrace(std::ostream &stream);
+
+private:
+  static std::atomic<uint32_t> sample_every;
+  static std::atomic<uint64_t> requests_seen;
+  // Number of the sampled request served by this thread, 0 if none
+  static thread_local uint64_t current_request;
+
+  friend class TraceRequest;
+};
+
+// Decides whether the request served by this thread is traced, and traces
+// it until destroyed. Named once its packet ID is known.
+class TraceRequest {
+  const char *name = "unknown";
+  Tracer::Clock::time_point start;
+
+public:
+  TraceRequest();
+  ~TraceRequest();
+  TraceRequest(const TraceRequest &) = delete;
+  TraceRequest &operator=(const TraceRequest &) = delete;
+
+  // The name must outlive the trace
+  void setName(const char *__name) { name = __name; }
+};
+
+// Times a stage of the traced request, until destroyed
+class TraceSpan {
+  const char *name;
+  bool active;
+  Tracer::Clock::time_point start;
+
+public:
+  // The name must outlive the trace
+  explicit TraceSpan(const char *__name)
+      : name{__name}, active{Tracer::tracing()} {
+    if (active) {
+      start = Tracer::Clock::now();
+    }
+  }
+  ~TraceSpan() {
+    if (active) {
+      Tracer::record(name, start, Tracer::Clock::now());
+    }
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+#endif
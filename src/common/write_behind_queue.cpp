@@ -0,0 +1,348 @@
+#include "write_behind_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include "constants.hpp"
+#include "logger.hpp"
+#include "tracing.hpp"
+
+// Paths are built in many ways ("ASDIR//USERS/1"), overlay keys must match
+static std::string normalizePath(const std::string &path) {
+  std::string normal = std::filesystem::path(path).lexically_normal().string();
+  while (normal.length() > 1 && normal.back() == '/') {
+    normal.pop_back();
+  }
+  return normal;
+}
+
+/* Moves a directory, merging it into the destination if that exists */
+static void moveDirectoryOnDisk(const std::filesystem::path &from,
+                                const std::filesystem::path &to) {
+  if (!std::filesystem::exists(to)) {
+    std::filesystem::create_directories(to.parent_path());
+    std::filesystem::rename(from, to);
+    return;
+  }
+  for (const auto &entry : std::filesystem::directory_iterator(from)) {
+    std::filesystem::path target = to / entry.path().filename();
+    if (entry.is_directory()) {
+      moveDirectoryOnDisk(entry.path(), target);
+    } else {
+      std::filesystem::rename(entry.path(), target);
+    }
+  }
+  std::filesystem::remove_all(from);
+}
+
+WriteBehindQueue::WriteBehindQueue() {
+  ioThread = std::thread(&WriteBehindQueue::run, this);
+}
+
+/* The I/O thread drains the queue before it stops */
+WriteBehindQueue::~WriteBehindQueue() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+    finishing = true;
+  }
+  queueNotEmpty.notify_one();
+  ioThread.join();
+}
+
+/* Rewrites a normalized path that lies in a moved directory, or only if the
+   move is already on disk. Must be called with the lock held */
+std::string WriteBehindQueue::redirect(const std::string &path,
+                                       bool appliedOnly) {
+  if (moved.empty()) {
+    return path;
+  }
+  for (size_t end = path.length(); end != std::string::npos && end > 0;
+       end = path.find_last_of('/', end - 1)) {
+    auto move = moved.find(path.substr(0, end));
+    if (move != moved.end()) {
+      if (appliedOnly && move->second.sequence >= appliedSequence) {
+        return path;
+      }
+      return move->second.to + path.substr(end);
+    }
+  }
+  return path;
+}
+
+/* Latest pending mutation of a normalized path, if any, and where the path
+   is on disk. Until a move is applied, mutations queued before it are still
+   keyed by the old path, after those queued since. Must be called with the
+   lock held */
+const PendingWrite *WriteBehindQueue::findPending(const std::string &key,
+                                                  std::string &diskPath) {
+  std::string pendingPath = redirect(key, false);
+  diskPath = redirect(key, true);
+  auto pending = overlay.find(pendingPath);
+  if (pending == overlay.end() && diskPath != pendingPath) {
+    pending = overlay.find(diskPath);
+  }
+  return pending == overlay.end() ? nullptr : &pending->second;
+}
+
+/* Whether a move applied since diskPath was resolved took the path away */
+bool WriteBehindQueue::movedSince(const std::string &key,
+                                  const std::string &diskPath) {
+  std::lock_guard<std::mutex> guard(lock);
+  return redirect(key, true) != diskPath;
+}
+
+void WriteBehindQueue::enqueue(PendingWriteKind kind, const std::string &path,
+                               const std::string &data) {
+  std::unique_lock<std::mutex> guard(lock);
+  // Back-pressure: producers wait for the I/O thread to catch up
+  if (queue.size() >= WRITE_BEHIND_QUEUE_MAX_LEN) {
+    TraceSpan span("write queue full wait");
+    queueNotFull.wait(
+        guard, [&]() { return queue.size() < WRITE_BEHIND_QUEUE_MAX_LEN; });
+  }
+
+  PendingWrite write;
+  write.kind = kind;
+  write.path = redirect(normalizePath(path), false);
+  write.data = data;
+  write.sequence = nextSequence++;
+  if (kind == PendingWriteKind::MOVE_DIRECTORY) {
+    // Whatever is queued before the move is applied at the old path first
+    write.data = normalizePath(data);
+    moved[write.path] = MovedDirectory{write.data, write.sequence};
+  } else {
+    overlay[write.path] = write;
+  }
+  queue.push_back(std::move(write));
+  guard.unlock();
+  queueNotEmpty.notify_one();
+}
+
+void WriteBehindQueue::write(const std::string &path, const std::string &data) {
+  enqueue(PendingWriteKind::WRITE, path, data);
+}
+
+void WriteBehindQueue::remove(const std::string &path) {
+  enqueue(PendingWriteKind::REMOVE, path, "");
+}
+
+void WriteBehindQueue::createDirectory(const std::string &path) {
+  enqueue(PendingWriteKind::CREATE_DIRECTORY, path, "");
+}
+
+void WriteBehindQueue::moveDirectory(const std::string &from,
+                                     const std::string &to) {
+  enqueue(PendingWriteKind::MOVE_DIRECTORY, from, to);
+}
+
+/* A path missing from the overlay has all its mutations on disk already.
+   Reads of a path whose directory is moved meanwhile are retried there */
+bool WriteBehindQueue::exists(const std::string &path) {
+  std::string key = normalizePath(path);
+  std::string diskPath;
+  do {
+    std::lock_guard<std::mutex> guard(lock);
+    const PendingWrite *pending = findPending(key, diskPath);
+    if (pending != nullptr) {
+      return pending->kind != PendingWriteKind::REMOVE;
+    }
+  } while (!std::filesystem::exists(diskPath) && movedSince(key, diskPath));
+  return std::filesystem::exists(diskPath);
+}
+
+std::optional<std::string> WriteBehindQueue::read(const std::string &path) {
+  std::string key = normalizePath(path);
+  while (true) {
+    std::string diskPath;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      const PendingWrite *pending = findPending(key, diskPath);
+      if (pending != nullptr) {
+        if (pending->kind != PendingWriteKind::WRITE) {
+          return std::nullopt;
+        }
+        return pending->data;
+      }
+    }
+
+    std::ifstream file(diskPath, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      if (movedSince(key, diskPath)) {
+        continue;
+      }
+      return std::nullopt;
+    }
+    std::string data;
+    std::getline(file, data, '\0');
+    return data;
+  }
+}
+
+std::vector<std::string> WriteBehindQueue::list(const std::string &path) {
+  std::string key = normalizePath(path);
+  while (true) {
+    // Snapshot the pending children first, anything applied afterwards is
+    // already on disk when the directory is listed. Children queued before
+    // a pending move of the directory are keyed by the old path
+    std::map<std::string, bool> pendingChildren;
+    std::string diskPath;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      diskPath = redirect(key, true);
+      for (const std::string &prefix :
+           {diskPath + "/", redirect(key, false) + "/"}) {
+        for (auto pending = overlay.lower_bound(prefix);
+             pending != overlay.end() &&
+             pending->first.compare(0, prefix.length(), prefix) == 0;
+             ++pending) {
+          std::string name = pending->first.substr(prefix.length());
+          if (name.find('/') == std::string::npos) {
+            pendingChildren[name] =
+                pending->second.kind != PendingWriteKind::REMOVE;
+          }
+        }
+      }
+    }
+
+    std::set<std::string> names;
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(diskPath + "/", ec)) {
+      names.insert(entry.path().filename().string());
+    }
+    if (ec && movedSince(key, diskPath)) {
+      continue;
+    }
+    for (const auto &child : pendingChildren) {
+      if (child.second) {
+        names.insert(child.first);
+      } else {
+        names.erase(child.first);
+      }
+    }
+    return std::vector<std::string>(names.begin(), names.end());
+  }
+}
+
+void WriteBehindQueue::flush() {
+  std::unique_lock<std::mutex> guard(lock);
+  uint64_t target = nextSequence;
+  writeApplied.wait(guard, [&]() { return appliedSequence >= target; });
+}
+
+void WriteBehindQueue::finish() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    finishing = true;
+  }
+  queueNotEmpty.notify_one();
+  flush();
+}
+
+size_t WriteBehindQueue::pendingWrites() {
+  std::lock_guard<std::mutex> guard(lock);
+  return queue.size();
+}
+
+uint64_t WriteBehindQueue::failedWrites() {
+  std::lock_guard<std::mutex> guard(lock);
+  return failedAttempts;
+}
+
+/* Returns whether the mutation reached the disk */
+bool WriteBehindQueue::apply(const PendingWrite &write) {
+  std::error_code ec;
+  switch (write.kind) {
+  case PendingWriteKind::WRITE: {
+    std::ofstream file(write.path, std::ios::out | std::ios::binary);
+    file << write.data;
+    file.close();
+    if (file.fail()) {
+      cerror << "Failed to write file: " << write.path << std::endl;
+      return false;
+    }
+    break;
+  }
+  case PendingWriteKind::REMOVE:
+    std::filesystem::remove(write.path, ec);
+    break;
+  case PendingWriteKind::CREATE_DIRECTORY:
+    std::filesystem::create_directory(write.path, ec);
+    break;
+  case PendingWriteKind::MOVE_DIRECTORY:
+    try {
+      moveDirectoryOnDisk(write.path, write.data);
+    } catch (const std::filesystem::filesystem_error &e) {
+      ec = e.code();
+    }
+    break;
+  default:
+    break;
+  }
+  if (ec) {
+    cerror << "Failed to update " << write.path << ": " << ec.message()
+           << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void WriteBehindQueue::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  auto retryDelay = std::chrono::milliseconds(WRITE_BEHIND_RETRY_MS);
+  uint32_t shutdownRetries = 0;
+  while (true) {
+    queueNotEmpty.wait(guard, [&]() { return !queue.empty() || stopping; });
+    if (queue.empty()) {
+      break;
+    }
+
+    // Producers only append, so the head stays put while it is applied
+    PendingWrite write = queue.front();
+    bool applied;
+    if (write.kind == PendingWriteKind::MOVE_DIRECTORY) {
+      // Readers resolve the path under the lock, so the move and its
+      // sequence number must change together
+      applied = apply(write);
+    } else {
+      guard.unlock();
+      applied = apply(write);
+      guard.lock();
+    }
+
+    if (!applied) {
+      failedAttempts++;
+      if (!finishing ||
+          ++shutdownRetries <= WRITE_BEHIND_SHUTDOWN_RETRIES) {
+        // The caller was told the change succeeded, keep it until it does.
+        // Finishing cuts the first wait short, not the shutdown retries
+        queueNotEmpty.wait_for(guard, retryDelay, [&]() {
+          return finishing && shutdownRetries == 0;
+        });
+        retryDelay = std::min(retryDelay * 2, std::chrono::milliseconds(
+                                                  WRITE_BEHIND_RETRY_MAX_MS));
+        continue;
+      }
+      // The rest of the queue must still reach the disk
+      cerror << "Giving up on " << write.path << " at shutdown" << std::endl;
+    }
+    retryDelay = std::chrono::milliseconds(WRITE_BEHIND_RETRY_MS);
+    shutdownRetries = 0;
+    queue.pop_front();
+    queueNotFull.notify_one();
+
+    // Keep the overlay entry if the path was mutated again in the meantime
+    auto pending = overlay.find(write.path);
+    if (pending != overlay.end() &&
+        pending->second.sequence == write.sequence) {
+      overlay.erase(pending);
+    }
+    appliedSequence = write.sequence + 1;
+    writeApplied.notify_all();
+  }
+}
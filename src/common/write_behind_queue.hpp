@@ -0,0 +1,101 @@
+#ifndef WRITE_BEHIND_QUEUE_H
+#define WRITE_BEHIND_QUEUE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class PendingWriteKind {
+  WRITE,
+  REMOVE,
+  CREATE_DIRECTORY,
+  MOVE_DIRECTORY
+};
+
+struct PendingWrite {
+  PendingWriteKind kind;
+  std::string path;
+  // Contents of a WRITE, destination of a MOVE_DIRECTORY
+  std::string data;
+  uint64_t sequence;
+};
+
+// Filesystem mutations are queued and applied in order by a dedicated I/O
+// thread, so callers never wait on the disk unless the queue is full.
+// Until a mutation is applied it is kept in an overlay keyed by path, which
+// every read goes through, so callers always see their own writes.
+// A mutation that fails stays at the head of the queue and is retried, so
+// it is never lost while the server runs; the queue fills up behind it.
+class WriteBehindQueue {
+  std::deque<PendingWrite> queue;
+  // Latest pending mutation of each path
+  std::map<std::string, PendingWrite> overlay;
+  struct MovedDirectory {
+    std::string to;
+    uint64_t sequence;
+  };
+  // Directories moved by moveDirectory and where they went. Kept for the
+  // lifetime of the queue, a caller may still hold a path it resolved
+  // before the move
+  std::map<std::string, MovedDirectory> moved;
+  std::mutex lock;
+  std::condition_variable queueNotEmpty;
+  std::condition_variable queueNotFull;
+  std::condition_variable writeApplied;
+  uint64_t nextSequence = 0;
+  // Every mutation with a lower sequence number is on disk
+  uint64_t appliedSequence = 0;
+  // Attempts to apply a mutation that failed
+  uint64_t failedAttempts = 0;
+  bool stopping = false;
+  // Failed mutations get a few more attempts only
+  bool finishing = false;
+  std::thread ioThread;
+
+  std::string redirect(const std::string &path, bool appliedOnly);
+  const PendingWrite *findPending(const std::string &key,
+                                  std::string &diskPath);
+  bool movedSince(const std::string &key, const std::string &diskPath);
+  void enqueue(PendingWriteKind kind, const std::string &path,
+               const std::string &data);
+  bool apply(const PendingWrite &write);
+  void run();
+
+public:
+  WriteBehindQueue();
+  ~WriteBehindQueue();
+  WriteBehindQueue(const WriteBehindQueue &) = delete;
+  WriteBehindQueue &operator=(const WriteBehindQueue &) = delete;
+
+  void write(const std::string &path, const std::string &data);
+  void remove(const std::string &path);
+  void createDirectory(const std::string &path);
+  // Moves a directory, merging it into the destination if that exists.
+  // Mutations queued afterwards for paths inside it are applied inside the
+  // destination instead
+  void moveDirectory(const std::string &from, const std::string &to);
+
+  bool exists(const std::string &path);
+  // Returns nothing if the file does not exist
+  std::optional<std::string> read(const std::string &path);
+  // Names of the entries of a directory
+  std::vector<std::string> list(const std::string &path);
+
+  // Waits until every mutation queued before the call is on disk
+  void flush();
+  // Same as flush, but a mutation that keeps failing is given up after
+  // WRITE_BEHIND_SHUTDOWN_RETRIES more attempts. Used at shutdown
+  void finish();
+  // Mutations not yet applied
+  size_t pendingWrites();
+  // Failed attempts to apply a mutation since the queue was created
+  uint64_t failedWrites();
+};
+
+#endif